@@ -0,0 +1,63 @@
+#include <cstdlib>
+#include <string>
+
+#include "GltfModel.h"
+#include "Logger.h"
+#include "OGLRenderData.h"
+#include "Timer.h"
+
+/* Imports a glTF model once and writes everything the renderer needs to a baked
+ * model file, the renderer maps it at startup instead of importing the model.
+ * The baked model is read back to check it and to compare the load times.
+ */
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    Logger::log(1,
+                "usage: %s <model.gltf|model.glb> <model.janus> [max joint influences]\n",
+                argv[0]);
+    return 1;
+  }
+  std::string modelFilename = argv[1];
+  std::string bakedFilename = argv[2];
+
+  OGLRenderData renderData{};
+  if (argc > 3) {
+    renderData.rdGltfMaxJointInfluences = std::atoi(argv[3]);
+    if (renderData.rdGltfMaxJointInfluences < 1 || renderData.rdGltfMaxJointInfluences > 8) {
+      Logger::log(1, "%s error: the joint influences must be between 1 and 8\n", __FUNCTION__);
+      return 1;
+    }
+  }
+
+  Timer bakeTimer{};
+  bakeTimer.start();
+  GltfModel model{};
+  if (!model.importModel(renderData, modelFilename)) {
+    Logger::log(1, "%s error: could not import '%s'\n", __FUNCTION__, modelFilename.c_str());
+    return 1;
+  }
+  float importTime = bakeTimer.stop();
+
+  if (!model.writeBakedModel(renderData, bakedFilename)) {
+    Logger::log(1, "%s error: could not write '%s'\n", __FUNCTION__, bakedFilename.c_str());
+    return 1;
+  }
+
+  bakeTimer.start();
+  OGLRenderData bakedRenderData{};
+  GltfModel bakedModel{};
+  if (!bakedModel.readBakedModel(bakedRenderData, bakedFilename)) {
+    Logger::log(1, "%s error: could not read back '%s'\n", __FUNCTION__, bakedFilename.c_str());
+    return 1;
+  }
+  float readTime = bakeTimer.stop();
+
+  Logger::log(1,
+              "%s: import of '%s' took %.2f ms, reading '%s' %.2f ms\n",
+              __FUNCTION__,
+              modelFilename.c_str(),
+              importTime,
+              bakedFilename.c_str(),
+              readTime);
+  return 0;
+}
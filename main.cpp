@@ -1,15 +1,24 @@
 #include "Logger.h"
 #include "Window.h"
 #include <memory>
+#include <string>
 
 int main(int arcc, char *argc[]) {
   std::unique_ptr<Window> w = std::make_unique<Window>();
 
-  if (!w->init(640, 480, "Janus")) {
+  /* --benchmark: compare the GPU time of the skinning paths in a hidden window */
+  bool benchmark = arcc > 1 && std::string(argc[1]) == "--benchmark";
+
+  if (!w->init(640, 480, "Janus", !benchmark)) {
     Logger::log(1, "%s error: Window init error\n", __FUNCTION__);
     return -1;
   }
-  w->mainLoop();
+  if (benchmark) {
+    w->runBenchmark();
+  }
+  else {
+    w->mainLoop();
+  }
   w->cleanup();
   return 0;
 }
\ No newline at end of file
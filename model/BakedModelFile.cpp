@@ -0,0 +1,127 @@
+#include <fstream>
+
+#include "BakedModelFile.h"
+#include "Logger.h"
+
+namespace {
+/* "JNSB", little endian */
+const uint32_t bakedMagic = 0x42534e4a;
+const uint32_t bakedVersion = 2;
+const uint64_t sectionAlignment = 16;
+
+struct FileHeader {
+  uint32_t magic = bakedMagic;
+  uint32_t version = bakedVersion;
+  uint32_t sectionCount = 0;
+  uint32_t reserved = 0;
+};
+
+uint64_t alignOffset(uint64_t offset) {
+  return (offset + sectionAlignment - 1) / sectionAlignment * sectionAlignment;
+}
+}  // namespace
+
+bool BakedModelFile::isBakedFile(std::string fileName) {
+  std::ifstream inFile(fileName, std::ios::binary);
+  uint32_t magic = 0;
+  if (!inFile.read(reinterpret_cast<char *>(&magic), sizeof(magic))) {
+    return false;
+  }
+  return magic == bakedMagic;
+}
+
+/* Header, section table and the aligned sections. */
+bool BakedModelFile::save(std::string fileName) {
+  FileHeader header{};
+  header.sectionCount = mSectionData.size();
+
+  std::vector<SectionEntry> entries(mSectionData.size());
+  uint64_t offset = sizeof(FileHeader) + entries.size() * sizeof(SectionEntry);
+  for (size_t i = 0; i < mSectionData.size(); ++i) {
+    offset = alignOffset(offset);
+    entries.at(i).section = static_cast<uint32_t>(mSectionData.at(i).section);
+    entries.at(i).elementSize = mSectionData.at(i).elementSize;
+    entries.at(i).offset = offset;
+    entries.at(i).count = mSectionData.at(i).count;
+    offset += mSectionData.at(i).bytes.size();
+  }
+
+  std::vector<unsigned char> fileData(offset, 0);
+  std::memcpy(fileData.data(), &header, sizeof(header));
+  if (!entries.empty()) {
+    std::memcpy(fileData.data() + sizeof(header),
+                entries.data(),
+                entries.size() * sizeof(SectionEntry));
+  }
+  for (size_t i = 0; i < mSectionData.size(); ++i) {
+    const std::vector<unsigned char> &bytes = mSectionData.at(i).bytes;
+    if (!bytes.empty()) {
+      std::memcpy(fileData.data() + entries.at(i).offset, bytes.data(), bytes.size());
+    }
+  }
+
+  std::ofstream outFile(fileName, std::ios::binary | std::ios::trunc);
+  if (!outFile.write(reinterpret_cast<const char *>(fileData.data()), fileData.size())) {
+    Logger::log(1, "%s error: could not write file '%s'\n", __FUNCTION__, fileName.c_str());
+    return false;
+  }
+  Logger::log(1,
+              "%s: wrote %i sections with %i bytes to '%s'\n",
+              __FUNCTION__,
+              entries.size(),
+              fileData.size(),
+              fileName.c_str());
+  return true;
+}
+
+/* Only the section table is checked here, the records are validated by the reader. */
+bool BakedModelFile::load(std::string fileName) {
+  mSections.clear();
+  if (!mMapping.map(fileName)) {
+    return false;
+  }
+
+  FileHeader header{};
+  if (mMapping.getSize() < sizeof(header)) {
+    Logger::log(1, "%s error: file '%s' is truncated\n", __FUNCTION__, fileName.c_str());
+    return false;
+  }
+  std::memcpy(&header, mMapping.getData(), sizeof(header));
+  if (header.magic != bakedMagic || header.version != bakedVersion) {
+    Logger::log(1,
+                "%s error: file '%s' has version %i, expected a baked model of version %i\n",
+                __FUNCTION__,
+                fileName.c_str(),
+                header.magic == bakedMagic ? header.version : 0,
+                bakedVersion);
+    return false;
+  }
+
+  uint64_t tableSize = static_cast<uint64_t>(header.sectionCount) * sizeof(SectionEntry);
+  if (sizeof(header) + tableSize > mMapping.getSize()) {
+    Logger::log(1, "%s error: file '%s' is truncated\n", __FUNCTION__, fileName.c_str());
+    return false;
+  }
+  mSections.resize(header.sectionCount);
+  std::memcpy(mSections.data(), mMapping.getData() + sizeof(header), tableSize);
+
+  for (const auto &entry : mSections) {
+    if (entry.offset % sectionAlignment != 0 || entry.elementSize == 0 ||
+        entry.offset > mMapping.getSize() ||
+        entry.count > (mMapping.getSize() - entry.offset) / entry.elementSize)
+    {
+      Logger::log(1,
+                  "%s error: section %i of file '%s' is outside of the file\n",
+                  __FUNCTION__,
+                  entry.section,
+                  fileName.c_str());
+      mSections.clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t BakedModelFile::getFileSize() const {
+  return mMapping.getSize();
+}
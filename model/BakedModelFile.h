@@ -0,0 +1,219 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "MappedFile.h"
+
+/* Baked model files, written by janus-bake. The file is a table of typed
+ * sections, every section is a flat array of one of the records below and
+ * starts at a 16 byte aligned offset. The runtime maps the file and turns the
+ * offsets into pointers, nothing is parsed. Files of another version are
+ * rejected, the version changes with every change of the records.
+ */
+enum class BakedSection : uint32_t {
+  INFO = 1,
+  NODES,
+  NODE_CHILDREN,
+  NAMES,
+  POSITIONS,
+  NORMALS,
+  TEX_COORDS,
+  JOINTS,
+  WEIGHTS,
+  JOINTS_1,
+  WEIGHTS_1,
+  PACKED_VERTICES,
+  INDICES,
+  PRIMITIVES,
+  DRAW_GROUPS,
+  DRAW_COMMANDS,
+  DRAW_COMMAND_LODS,
+  MESH_LOD_TRIANGLES,
+  INFLUENCE_BUCKETS,
+  PALETTES,
+  PALETTE_JOINTS,
+  INVERSE_BIND_MATRICES,
+  BIND_MATRICES,
+  JOINT_BOUNDS,
+  NODE_TO_JOINT,
+  CLIPS,
+  CHANNELS,
+  KEY_TIMES,
+  KEY_VALUES,
+  IMAGES,
+  IMAGE_PIXELS
+};
+
+/* A range of elements in another section, e.g. the children of a node. */
+struct BakedRange {
+  uint32_t first = 0;
+  uint32_t count = 0;
+};
+
+/* Results of the import and the layout of the packed vertices. */
+struct BakedModelInfo {
+  int32_t rootNode = 0;
+  uint32_t indexType = 0;
+  int32_t maxJointInfluences = 0;
+  float pruneError = 0.0f;
+  float exportedACMR = 0.0f;
+  float acmr = 0.0f;
+  uint32_t transformedVertices = 0;
+  glm::vec4 boundingSphere = glm::vec4(0.0f);
+
+  int32_t stride = 0;
+  int32_t quantizedPositions = 0;
+  glm::vec3 positionOffset = glm::vec3(0.0f);
+  glm::vec3 positionScale = glm::vec3(1.0f);
+  int32_t packedNormals = 0;
+  int32_t packedTexCoords = 0;
+  int32_t packedWeights = 0;
+  uint32_t jointType = 0;
+  int32_t normalOffset = 0;
+  int32_t texCoordOffset = 0;
+  int32_t jointOffset = 0;
+  int32_t weightOffset = 0;
+  int32_t secondJointSet = 0;
+  int32_t joint1Offset = 0;
+  int32_t weight1Offset = 0;
+  float maxPositionError = 0.0f;
+  float maxNormalError = 0.0f;
+  float maxTexCoordError = 0.0f;
+  float maxWeightError = 0.0f;
+};
+
+/* The flat skeleton, names are ranges in NAMES and children in NODE_CHILDREN. */
+struct BakedNode {
+  BakedRange name{};
+  BakedRange children{};
+  glm::vec3 translation = glm::vec3(0.0f);
+  /* x, y, z, w */
+  glm::vec4 rotation = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+  glm::vec3 scale = glm::vec3(1.0f);
+};
+
+struct BakedPrimitive {
+  int32_t meshNum = 0;
+  int32_t textureNum = 0;
+  uint32_t firstIndex = 0;
+  uint32_t indexCount = 0;
+  int32_t baseVertex = 0;
+  uint32_t vertexCount = 0;
+  int32_t lod = 0;
+  int32_t jointInfluences = 0;
+  int32_t paletteNum = -1;
+};
+
+/* The commands and their LODs are ranges in DRAW_COMMANDS and DRAW_COMMAND_LODS. */
+struct BakedDrawGroup {
+  int32_t textureNum = 0;
+  int32_t jointInfluences = 0;
+  int32_t paletteNum = -1;
+  BakedRange commands{};
+};
+
+struct BakedClip {
+  BakedRange name{};
+  BakedRange channels{};
+};
+
+/* Key values are packed as vec4, see GltfAnimationChannel::getPackedValues(). */
+struct BakedChannel {
+  int32_t targetNode = -1;
+  uint32_t targetPath = 0;
+  uint32_t interpolation = 0;
+  BakedRange keyTimes{};
+  BakedRange keyValues{};
+};
+
+/* Decoded 8 bit pixels of a material texture, a range in IMAGE_PIXELS. */
+struct BakedImage {
+  int32_t width = 0;
+  int32_t height = 0;
+  int32_t components = 0;
+  BakedRange pixels{};
+};
+
+/* Builds a baked file section by section, or maps one for reading. */
+class BakedModelFile {
+ public:
+  /* Checks the magic number at the start of the file. */
+  static bool isBakedFile(std::string fileName);
+
+  template <typename T>
+  void addSection(BakedSection section, const std::vector<T> &data) {
+    static_assert(std::is_trivially_copyable<T>::value, "sections hold plain records");
+    SectionData sectionData{};
+    sectionData.section = section;
+    sectionData.elementSize = sizeof(T);
+    sectionData.count = data.size();
+    sectionData.bytes.resize(data.size() * sizeof(T));
+    if (!data.empty()) {
+      std::memcpy(sectionData.bytes.data(), data.data(), sectionData.bytes.size());
+    }
+    mSectionData.push_back(sectionData);
+  }
+  bool save(std::string fileName);
+
+  bool load(std::string fileName);
+  size_t getFileSize() const;
+
+  /* Points into the mapping, a missing section has no elements. Returns false if
+   * the section was written with another record size.
+   */
+  template <typename T>
+  bool getSection(BakedSection section, const T *&data, size_t &count) const {
+    static_assert(std::is_trivially_copyable<T>::value, "sections hold plain records");
+    data = nullptr;
+    count = 0;
+    for (const auto &entry : mSections) {
+      if (entry.section != static_cast<uint32_t>(section)) {
+        continue;
+      }
+      if (entry.elementSize != sizeof(T)) {
+        return false;
+      }
+      data = reinterpret_cast<const T *>(mMapping.getData() + entry.offset);
+      count = entry.count;
+    }
+    return true;
+  }
+
+  /* Copies a whole section into a vector. */
+  template <typename T>
+  bool readSection(BakedSection section, std::vector<T> &data) const {
+    const T *sectionData = nullptr;
+    size_t count = 0;
+    if (!getSection(section, sectionData, count)) {
+      return false;
+    }
+    data.assign(sectionData, sectionData + count);
+    return true;
+  }
+
+ private:
+  struct SectionEntry {
+    uint32_t section = 0;
+    uint32_t elementSize = 0;
+    uint64_t offset = 0;
+    uint64_t count = 0;
+  };
+
+  struct SectionData {
+    BakedSection section = BakedSection::INFO;
+    uint32_t elementSize = 0;
+    uint64_t count = 0;
+    std::vector<unsigned char> bytes{};
+  };
+
+  std::vector<SectionData> mSectionData{};
+
+  MappedFile mMapping{};
+  std::vector<SectionEntry> mSections{};
+};
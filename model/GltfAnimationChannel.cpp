@@ -2,23 +2,24 @@
 
 #include <iostream>
 
-void GltfAnimationChannel::loadChannelData(std::shared_ptr<tinygltf::Model> model,
+void GltfAnimationChannel::loadChannelData(std::shared_ptr<GltfFile> file,
                                            tinygltf::Animation anim,
                                            tinygltf::AnimationChannel channel) {
   mTargetNode = channel.target_node;
+  std::shared_ptr<tinygltf::Model> model = file->getModel();
 
   // extract input data from GLTF file
   const tinygltf::Accessor &inputAccessor = model->accessors.at(
       anim.samplers.at(channel.sampler).input);
   const tinygltf::BufferView &inputBufferView = model->bufferViews.at(inputAccessor.bufferView);
-  const tinygltf::Buffer &inputBuffer = model->buffers.at(inputBufferView.buffer);
+  const unsigned char *inputData = file->getBufferViewData(inputAccessor.bufferView);
 
   // Allocate memory for raw time values
   std::vector<float> timings;
   timings.resize(inputAccessor.count);
 
   std::memcpy(timings.data(),
-              &inputBuffer.data.at(0) + inputBufferView.byteOffset,
+              inputData,
               inputBufferView.byteLength);
   setTimings(timings);
 
@@ -38,7 +39,7 @@ void GltfAnimationChannel::loadChannelData(std::shared_ptr<tinygltf::Model> mode
   const tinygltf::Accessor &outputAccessor = model->accessors.at(
       anim.samplers.at(channel.sampler).output);
   const tinygltf::BufferView &outputBufferView = model->bufferViews.at(outputAccessor.bufferView);
-  const tinygltf::Buffer &outputBuffer = model->buffers.at(outputBufferView.buffer);
+  const unsigned char *outputData = file->getBufferViewData(outputAccessor.bufferView);
 
   if (channel.target_path.compare("rotation") == 0) {
     mTargetPath = ETargetPath::ROTATION;
@@ -46,7 +47,7 @@ void GltfAnimationChannel::loadChannelData(std::shared_ptr<tinygltf::Model> mode
     rotations.resize(outputAccessor.count);
 
     std::memcpy(rotations.data(),
-                &outputBuffer.data.at(0) + outputBufferView.byteOffset,
+                outputData,
                 outputBufferView.byteLength);
     setRotations(rotations);
   }
@@ -56,7 +57,7 @@ void GltfAnimationChannel::loadChannelData(std::shared_ptr<tinygltf::Model> mode
     translations.resize(outputAccessor.count);
 
     std::memcpy(translations.data(),
-                &outputBuffer.data.at(0) + outputBufferView.byteOffset,
+                outputData,
                 outputBufferView.byteLength);
     setTranslations(translations);
   }
@@ -66,13 +67,41 @@ void GltfAnimationChannel::loadChannelData(std::shared_ptr<tinygltf::Model> mode
     scale.resize(outputAccessor.count);
 
     std::memcpy(scale.data(),
-                &outputBuffer.data.at(0) + outputBufferView.byteOffset,
+                outputData,
                 outputBufferView.byteLength);
     setScalings(scale);
   }
   // TODO add morph targets?
 }
 
+void GltfAnimationChannel::loadPackedChannelData(int targetNode,
+                                                 ETargetPath targetPath,
+                                                 EInterpolationType interType,
+                                                 std::vector<float> timings,
+                                                 const std::vector<glm::vec4> &values) {
+  mTargetNode = targetNode;
+  mTargetPath = targetPath;
+  mInterType = interType;
+  setTimings(timings);
+
+  switch (mTargetPath) {
+    case ETargetPath::ROTATION: {
+      std::vector<glm::quat> rotations{};
+      for (const auto &value : values) {
+        rotations.emplace_back(value.w, value.x, value.y, value.z);
+      }
+      setRotations(rotations);
+      break;
+    }
+    case ETargetPath::TRANSLATION:
+      setTranslations(std::vector<glm::vec3>(values.begin(), values.end()));
+      break;
+    case ETargetPath::SCALE:
+      setScalings(std::vector<glm::vec3>(values.begin(), values.end()));
+      break;
+  }
+}
+
 float GltfAnimationChannel::calculateInterpolatedTime(float time,
                                                       int prevTimeIndex,
                                                       int nextTimeIndex) {
@@ -86,6 +115,41 @@ float GltfAnimationChannel::getMaxTime() {
   return mTimings.at(mTimings.size() - 1);
 }
 
+size_t GltfAnimationChannel::getDataSize() {
+  return mTimings.size() * sizeof(float) + mScaling.size() * sizeof(glm::vec3) +
+         mTranslations.size() * sizeof(glm::vec3) + mRotations.size() * sizeof(glm::quat);
+}
+
+const std::vector<float> &GltfAnimationChannel::getTimings() {
+  return mTimings;
+}
+
+EInterpolationType GltfAnimationChannel::getInterpolationType() {
+  return mInterType;
+}
+
+std::vector<glm::vec4> GltfAnimationChannel::getPackedValues() {
+  std::vector<glm::vec4> values{};
+  switch (mTargetPath) {
+    case ETargetPath::ROTATION:
+      for (const auto &rotation : mRotations) {
+        values.emplace_back(rotation.x, rotation.y, rotation.z, rotation.w);
+      }
+      break;
+    case ETargetPath::TRANSLATION:
+      for (const auto &translation : mTranslations) {
+        values.emplace_back(translation, 0.0f);
+      }
+      break;
+    case ETargetPath::SCALE:
+      for (const auto &scale : mScaling) {
+        values.emplace_back(scale, 0.0f);
+      }
+      break;
+  }
+  return values;
+}
+
 glm::vec3 GltfAnimationChannel::getScaling(float time) {
   if (mScaling.size() == 0) {
     return glm::vec3(1.0f);
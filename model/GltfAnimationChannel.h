@@ -9,15 +9,23 @@
 #include <tiny_gltf.h>
 #include <vector>
 
+#include "GltfFile.h"
+
 enum class ETargetPath { ROTATION, TRANSLATION, SCALE };
 
 enum class EInterpolationType { STEP, LINEAR, CUBICSPLINE };
 
 class GltfAnimationChannel {
  public:
-  void loadChannelData(std::shared_ptr<tinygltf::Model> model,
+  void loadChannelData(std::shared_ptr<GltfFile> file,
                        tinygltf::Animation anim,
                        tinygltf::AnimationChannel channel);
+  /* Keys in the layout of getPackedValues(), e.g. from a baked model. */
+  void loadPackedChannelData(int targetNode,
+                             ETargetPath targetPath,
+                             EInterpolationType interType,
+                             std::vector<float> timings,
+                             const std::vector<glm::vec4> &values);
   int getTargetNode();
   ETargetPath getTargetPath();
 
@@ -26,6 +34,15 @@ class GltfAnimationChannel {
   glm::quat getRotation(float time);
 
   float getMaxTime();
+  /* Bytes of the decoded keys. */
+  size_t getDataSize();
+
+  /* Raw key data, the values are packed as vec4 (quaternions as x, y, z, w).
+   * Cubic splines store in-tangent, value and out-tangent for every key.
+   */
+  const std::vector<float> &getTimings();
+  EInterpolationType getInterpolationType();
+  std::vector<glm::vec4> getPackedValues();
 
  private:
   int mTargetNode = -1;
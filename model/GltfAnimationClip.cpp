@@ -4,17 +4,98 @@
 
 GltfAnimationClip::GltfAnimationClip(std::string name) : mClipName(name) {}
 
-void GltfAnimationClip::addChannel(std::shared_ptr<tinygltf::Model> model,
+GltfAnimationClip::GltfAnimationClip(std::string name,
+                                     float clipEndTime,
+                                     ChannelLoader channelLoader)
+    : mClipName(name),
+      mClipEndTime(clipEndTime),
+      mChannelLoader(channelLoader),
+      mLoaded(false) {}
+
+void GltfAnimationClip::addChannel(std::shared_ptr<GltfFile> file,
                                    tinygltf::Animation anim,
                                    tinygltf::AnimationChannel channel) {
   std::shared_ptr<GltfAnimationChannel> chan = std::make_shared<GltfAnimationChannel>();
-  chan->loadChannelData(model, anim, channel);
-  mAnimationChannels.push_back(chan);
+  chan->loadChannelData(file, anim, channel);
+  addChannel(chan);
+}
+
+/* The length of the clip is the length of its first channel. */
+void GltfAnimationClip::addChannel(std::shared_ptr<GltfAnimationChannel> channel) {
+  if (mAnimationChannels.empty()) {
+    mClipEndTime = channel->getMaxTime();
+  }
+  mDataSize += channel->getDataSize();
+  mAnimationChannels.push_back(channel);
+}
+
+/* The loaded flag is checked without the lock, the channels are written before
+ * it is set and only evicted while no worker runs.
+ */
+bool GltfAnimationClip::loadChannels(bool async) {
+  mUsed.store(true, std::memory_order_relaxed);
+  if (mLoaded.load(std::memory_order_acquire)) {
+    return true;
+  }
+
+  std::lock_guard<std::mutex> lock(mLoadMutex);
+  if (mLoaded.load(std::memory_order_relaxed)) {
+    return true;
+  }
+  if (mPendingLoad.valid()) {
+    if (async && mPendingLoad.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      return false;
+    }
+    setChannels(mPendingLoad.get());
+    return true;
+  }
+  if (async) {
+    mPendingLoad = std::async(std::launch::async, mChannelLoader);
+    return false;
+  }
+  setChannels(mChannelLoader());
+  return true;
+}
+
+void GltfAnimationClip::setChannels(std::vector<std::shared_ptr<GltfAnimationChannel>> channels) {
+  mDataSize = 0;
+  for (const auto &channel : channels) {
+    mDataSize += channel->getDataSize();
+  }
+  mAnimationChannels = std::move(channels);
+  mLoaded.store(true, std::memory_order_release);
+}
+
+void GltfAnimationClip::evictChannels() {
+  if (!isEvictable() || !isLoaded()) {
+    return;
+  }
+  mLoaded.store(false, std::memory_order_relaxed);
+  mAnimationChannels.clear();
+  mAnimationChannels.shrink_to_fit();
+  mDataSize = 0;
+}
+
+bool GltfAnimationClip::isLoaded() {
+  return mLoaded.load(std::memory_order_acquire);
+}
+
+bool GltfAnimationClip::isEvictable() {
+  return static_cast<bool>(mChannelLoader);
+}
+
+bool GltfAnimationClip::checkAndResetUsed() {
+  return mUsed.exchange(false, std::memory_order_relaxed);
 }
 
-void GltfAnimationClip::setAnimationFrame(std::vector<std::shared_ptr<GltfNode>> nodes,
-                                          std::vector<bool> additiveMask,
+size_t GltfAnimationClip::getDataSize() {
+  return mDataSize;
+}
+
+void GltfAnimationClip::setAnimationFrame(const std::vector<std::shared_ptr<GltfNode>> &nodes,
+                                          const std::vector<bool> &additiveMask,
                                           float time) {
+  loadChannels(false);
   for (auto &channel : mAnimationChannels) {
     int targetNode = channel->getTargetNode();
     if (additiveMask.at(targetNode)) {
@@ -31,18 +112,19 @@ void GltfAnimationClip::setAnimationFrame(std::vector<std::shared_ptr<GltfNode>>
       }
     }
   }
-  /* update all nodes in a single run */
+  /* update all nodes in a single run, masked out nodes are left untouched */
   for (auto &node : nodes) {
-    if (node) {
+    if (node && additiveMask.at(node->getNodeNum())) {
       node->calculateLocalTRSMatrix();
     }
   }
 }
 
-void GltfAnimationClip::blendAnimationFrame(std::vector<std::shared_ptr<GltfNode>> nodes,
-                                            std::vector<bool> additiveMask,
+void GltfAnimationClip::blendAnimationFrame(const std::vector<std::shared_ptr<GltfNode>> &nodes,
+                                            const std::vector<bool> &additiveMask,
                                             float time,
                                             float blendFactor) {
+  loadChannels(false);
   for (auto &channel : mAnimationChannels) {
     int targetNode = channel->getTargetNode();
     if (additiveMask.at(targetNode)) {
@@ -59,16 +141,21 @@ void GltfAnimationClip::blendAnimationFrame(std::vector<std::shared_ptr<GltfNode
       }
     }
   }
-  /* update all nodes in a single run */
+  /* update all nodes in a single run, masked out nodes are left untouched */
   for (auto &node : nodes) {
-    if (node) {
+    if (node && additiveMask.at(node->getNodeNum())) {
       node->calculateLocalTRSMatrix();
     }
   }
 }
 
 float GltfAnimationClip::getClipEndTime() {
-  return mAnimationChannels.at(0)->getMaxTime();
+  return mClipEndTime;
+}
+
+const std::vector<std::shared_ptr<GltfAnimationChannel>> &GltfAnimationClip::getChannels() {
+  loadChannels(false);
+  return mAnimationChannels;
 }
 
 std::string GltfAnimationClip::getClipName() {
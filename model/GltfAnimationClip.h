@@ -1,31 +1,69 @@
 #pragma once
 #include "GltfAnimationChannel.h"
 #include "GltfNode.h"
+#include <atomic>
+#include <functional>
+#include <future>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <tiny_gltf.h>
 #include <vector>
 
+/* A clip is either created with its channels, or registered with its name and
+ * length and a loader decoding the channels on first use. The channels of a
+ * lazy clip can be evicted and are decoded again when the clip is played.
+ */
 class GltfAnimationClip {
  public:
+  using ChannelLoader = std::function<std::vector<std::shared_ptr<GltfAnimationChannel>>()>;
+
   GltfAnimationClip(std::string name);
+  GltfAnimationClip(std::string name, float clipEndTime, ChannelLoader channelLoader);
 
-  void addChannel(std::shared_ptr<tinygltf::Model> model,
+  void addChannel(std::shared_ptr<GltfFile> file,
                   tinygltf::Animation anim,
                   tinygltf::AnimationChannel channel);
+  void addChannel(std::shared_ptr<GltfAnimationChannel> channel);
+
+  /* Decodes the channels if needed and marks the clip as used. An asynchronous
+   * load runs on a worker, false is returned until the channels are ready.
+   */
+  bool loadChannels(bool async);
+  /* Only between frames, no other thread may use the clip. */
+  void evictChannels();
+  bool isLoaded();
+  bool isEvictable();
+  /* Returns whether the clip was used since the last call. */
+  bool checkAndResetUsed();
+  /* Bytes of the decoded channels. */
+  size_t getDataSize();
 
-  void setAnimationFrame(std::vector<std::shared_ptr<GltfNode>> nodes,
-                         std::vector<bool> additiveMask,
+  void setAnimationFrame(const std::vector<std::shared_ptr<GltfNode>> &nodes,
+                         const std::vector<bool> &additiveMask,
                          float time);
 
-  void blendAnimationFrame(std::vector<std::shared_ptr<GltfNode>> nodes,
-                           std::vector<bool> additiveMask,
+  void blendAnimationFrame(const std::vector<std::shared_ptr<GltfNode>> &nodes,
+                           const std::vector<bool> &additiveMask,
                            float time,
                            float blendFactor);
   float getClipEndTime();
+  const std::vector<std::shared_ptr<GltfAnimationChannel>> &getChannels();
   std::string getClipName();
 
  private:
+  void setChannels(std::vector<std::shared_ptr<GltfAnimationChannel>> channels);
+
   std::vector<std::shared_ptr<GltfAnimationChannel>> mAnimationChannels;
   std::string mClipName;
+  float mClipEndTime = 0.0f;
+  size_t mDataSize = 0;
+
+  /* empty for clips created with their channels, they are never evicted */
+  ChannelLoader mChannelLoader{};
+  std::atomic<bool> mLoaded{true};
+  std::atomic<bool> mUsed{false};
+  std::mutex mLoadMutex;
+  /* declared last, the destructor waits for a running load before the members go away */
+  std::future<std::vector<std::shared_ptr<GltfAnimationChannel>>> mPendingLoad{};
 };
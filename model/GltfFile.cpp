@@ -0,0 +1,335 @@
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+
+#include <json.hpp>
+
+#include "GltfFile.h"
+#include "Logger.h"
+#include "ParallelFor.h"
+
+namespace {
+/* "glTF", version 2 and the chunk types "JSON" and "BIN", little endian */
+const uint32_t glbMagic = 0x46546c67;
+const uint32_t glbVersion = 2;
+const uint32_t glbChunkJson = 0x4e4f534a;
+const uint32_t glbChunkBin = 0x004e4942;
+const size_t glbHeaderSize = 12;
+const size_t glbChunkHeaderSize = 8;
+
+/* tinygltf copies the binary chunk into a buffer without uri, the buffer gets a
+ * one byte stand-in instead. The images of the chunk get the same stand-in, they
+ * are decoded from the mapping after parsing.
+ */
+const std::string standInUri = "data:application/octet-stream;base64,AA==";
+const size_t standInLength = 1;
+
+struct BinaryImage {
+  int imageNum = -1;
+  int bufferViewNum = -1;
+  std::string mimeType{};
+};
+
+/* The encoded bytes of an image, kept by the loader callback. */
+struct EncodedImage {
+  int imageNum = -1;
+  std::vector<unsigned char> bytes{};
+};
+
+/* The callback of tinygltf runs serially while the JSON is parsed, it only
+ * collects the images. They are decoded in parallel after parsing.
+ */
+struct DeferredImages {
+  std::vector<BinaryImage> binaryImages{};
+  std::vector<EncodedImage> encodedImages{};
+};
+
+uint32_t readUint32(const unsigned char *data) {
+  uint32_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+bool loadImageData(tinygltf::Image *image,
+                   const int imageNum,
+                   std::string *err,
+                   std::string *warn,
+                   int width,
+                   int height,
+                   const unsigned char *bytes,
+                   int size,
+                   void *userData) {
+  auto *deferredImages = static_cast<DeferredImages *>(userData);
+  for (const auto &binaryImage : deferredImages->binaryImages) {
+    if (binaryImage.imageNum == imageNum) {
+      return true;
+    }
+  }
+  EncodedImage encodedImage{};
+  encodedImage.imageNum = imageNum;
+  encodedImage.bytes.assign(bytes, bytes + size);
+  deferredImages->encodedImages.push_back(std::move(encodedImage));
+  return true;
+}
+
+/* One job per image, the messages are logged in image order afterwards. */
+void decodeImages(const GltfFile &file,
+                  tinygltf::Model &model,
+                  const DeferredImages &deferredImages,
+                  const std::string &fileName) {
+  size_t binaryCount = deferredImages.binaryImages.size();
+  size_t imageCount = binaryCount + deferredImages.encodedImages.size();
+  for (const auto &binaryImage : deferredImages.binaryImages) {
+    tinygltf::Image &image = model.images.at(binaryImage.imageNum);
+    image.bufferView = binaryImage.bufferViewNum;
+    image.mimeType = binaryImage.mimeType;
+  }
+
+  std::vector<std::string> errors(imageCount);
+  std::vector<std::string> warnings(imageCount);
+  std::vector<char> decoded(imageCount, false);
+  std::vector<int> imageNums(imageCount);
+  parallelFor(imageCount, [&](size_t i) {
+    const unsigned char *bytes = nullptr;
+    size_t size = 0;
+    if (i < binaryCount) {
+      const BinaryImage &binaryImage = deferredImages.binaryImages.at(i);
+      imageNums.at(i) = binaryImage.imageNum;
+      bytes = file.getBufferViewData(binaryImage.bufferViewNum);
+      size = model.bufferViews.at(binaryImage.bufferViewNum).byteLength;
+    }
+    else {
+      const EncodedImage &encodedImage = deferredImages.encodedImages.at(i - binaryCount);
+      imageNums.at(i) = encodedImage.imageNum;
+      bytes = encodedImage.bytes.data();
+      size = encodedImage.bytes.size();
+    }
+    decoded.at(i) = tinygltf::LoadImageData(&model.images.at(imageNums.at(i)),
+                                            imageNums.at(i),
+                                            &errors.at(i),
+                                            &warnings.at(i),
+                                            0,
+                                            0,
+                                            bytes,
+                                            static_cast<int>(size),
+                                            nullptr);
+  });
+
+  for (size_t i = 0; i < imageCount; ++i) {
+    if (!warnings.at(i).empty()) {
+      Logger::log(1, "%s: %s", __FUNCTION__, warnings.at(i).c_str());
+    }
+    if (!decoded.at(i)) {
+      Logger::log(1,
+                  "%s: could not decode image %i of file '%s': %s\n",
+                  __FUNCTION__,
+                  imageNums.at(i),
+                  fileName.c_str(),
+                  errors.at(i).c_str());
+    }
+  }
+}
+}  // namespace
+
+bool GltfFile::load(std::string fileName) {
+  mModel = std::make_shared<tinygltf::Model>();
+  mBinaryChunk = nullptr;
+  mBinaryChunkSize = 0;
+  mBinaryBuffer = -1;
+  if (!mMapping.map(fileName)) {
+    return false;
+  }
+
+  if (mMapping.getSize() >= sizeof(uint32_t) && readUint32(mMapping.getData()) == glbMagic) {
+    return loadBinary(fileName);
+  }
+
+  /* the JSON text is parsed by tinygltf, it reads the file itself */
+  mMapping.unmap();
+
+  DeferredImages deferredImages{};
+  tinygltf::TinyGLTF gltfLoader;
+  gltfLoader.SetImageLoader(loadImageData, &deferredImages);
+  std::string loaderErrors;
+  std::string loaderWarnings;
+  bool result = gltfLoader.LoadASCIIFromFile(
+      mModel.get(), &loaderErrors, &loaderWarnings, fileName);
+  logLoaderMessages(loaderErrors, loaderWarnings);
+
+  if (!result) {
+    Logger::log(1, "%s error: could not load file '%s'\n", __FUNCTION__, fileName.c_str());
+    return false;
+  }
+  decodeImages(*this, *mModel, deferredImages, fileName);
+  return true;
+}
+
+bool GltfFile::isBinary() const {
+  return mBinaryChunk != nullptr;
+}
+
+std::shared_ptr<tinygltf::Model> GltfFile::getModel() const {
+  return mModel;
+}
+
+const unsigned char *GltfFile::getBufferViewData(int bufferViewNum) const {
+  const tinygltf::BufferView &bufferView = mModel->bufferViews.at(bufferViewNum);
+  if (bufferView.buffer == mBinaryBuffer) {
+    return mBinaryChunk + bufferView.byteOffset;
+  }
+  return mModel->buffers.at(bufferView.buffer).data.data() + bufferView.byteOffset;
+}
+
+/* The chunks follow the 12 byte header, each with its length and type in front. */
+bool GltfFile::loadBinary(const std::string &fileName) {
+  const unsigned char *data = mMapping.getData();
+  if (mMapping.getSize() < glbHeaderSize + glbChunkHeaderSize) {
+    Logger::log(1, "%s error: file '%s' is truncated\n", __FUNCTION__, fileName.c_str());
+    return false;
+  }
+
+  uint32_t version = readUint32(data + 4);
+  uint32_t fileLength = readUint32(data + 8);
+  if (version != glbVersion || fileLength > mMapping.getSize()) {
+    Logger::log(1,
+                "%s error: file '%s' has version %i and length %i, expected version %i and at "
+                "most %i bytes\n",
+                __FUNCTION__,
+                fileName.c_str(),
+                version,
+                fileLength,
+                glbVersion,
+                mMapping.getSize());
+    return false;
+  }
+
+  size_t jsonLength = readUint32(data + glbHeaderSize);
+  size_t jsonStart = glbHeaderSize + glbChunkHeaderSize;
+  if (readUint32(data + glbHeaderSize + 4) != glbChunkJson || jsonStart + jsonLength > fileLength)
+  {
+    Logger::log(1, "%s error: invalid JSON chunk in file '%s'\n", __FUNCTION__, fileName.c_str());
+    return false;
+  }
+
+  /* the binary chunk is optional */
+  size_t binaryHeader = jsonStart + jsonLength;
+  if (binaryHeader + glbChunkHeaderSize <= fileLength) {
+    size_t binaryLength = readUint32(data + binaryHeader);
+    if (readUint32(data + binaryHeader + 4) != glbChunkBin ||
+        binaryHeader + glbChunkHeaderSize + binaryLength > fileLength)
+    {
+      Logger::log(
+          1, "%s error: invalid binary chunk in file '%s'\n", __FUNCTION__, fileName.c_str());
+      return false;
+    }
+    mBinaryChunk = data + binaryHeader + glbChunkHeaderSize;
+    mBinaryChunkSize = binaryLength;
+  }
+
+  nlohmann::json json = nlohmann::json::parse(
+      data + jsonStart, data + jsonStart + jsonLength, nullptr, false);
+  if (json.is_discarded() || !json.is_object()) {
+    Logger::log(1, "%s error: invalid JSON in file '%s'\n", __FUNCTION__, fileName.c_str());
+    return false;
+  }
+
+  /* only the first buffer may live in the binary chunk */
+  if (json.contains("buffers")) {
+    nlohmann::json &buffers = json["buffers"];
+    for (size_t i = 0; i < buffers.size(); ++i) {
+      if (buffers[i].contains("uri")) {
+        continue;
+      }
+      if (i > 0 || !mBinaryChunk) {
+        Logger::log(1,
+                    "%s error: buffer %i of file '%s' has no data\n",
+                    __FUNCTION__,
+                    i,
+                    fileName.c_str());
+        return false;
+      }
+      mBinaryBuffer = i;
+      buffers[i]["uri"] = standInUri;
+      buffers[i]["byteLength"] = standInLength;
+    }
+  }
+
+  DeferredImages deferredImages{};
+  if (json.contains("images") && json.contains("bufferViews")) {
+    nlohmann::json &images = json["images"];
+    const nlohmann::json &bufferViews = json["bufferViews"];
+    for (size_t i = 0; i < images.size(); ++i) {
+      if (!images[i].contains("bufferView")) {
+        continue;
+      }
+      int bufferViewNum = images[i]["bufferView"].get<int>();
+      if (bufferViewNum < 0 || bufferViewNum >= bufferViews.size() ||
+          bufferViews[bufferViewNum].value("buffer", -1) != mBinaryBuffer)
+      {
+        continue;
+      }
+      BinaryImage binaryImage{};
+      binaryImage.imageNum = static_cast<int>(i);
+      binaryImage.bufferViewNum = bufferViewNum;
+      binaryImage.mimeType = images[i].value("mimeType", std::string());
+      deferredImages.binaryImages.push_back(binaryImage);
+      images[i].erase("bufferView");
+      images[i]["uri"] = standInUri;
+    }
+  }
+
+  tinygltf::TinyGLTF gltfLoader;
+  gltfLoader.SetImageLoader(loadImageData, &deferredImages);
+  std::string jsonText = json.dump();
+  std::string baseDir = std::filesystem::path(fileName).parent_path().string();
+  std::string loaderErrors;
+  std::string loaderWarnings;
+  bool result = gltfLoader.LoadASCIIFromString(mModel.get(),
+                                               &loaderErrors,
+                                               &loaderWarnings,
+                                               jsonText.c_str(),
+                                               jsonText.size(),
+                                               baseDir);
+  logLoaderMessages(loaderErrors, loaderWarnings);
+
+  if (!result) {
+    Logger::log(1, "%s error: could not load file '%s'\n", __FUNCTION__, fileName.c_str());
+    return false;
+  }
+  if (!checkBinaryBufferViews()) {
+    Logger::log(1,
+                "%s error: buffer views of file '%s' exceed the binary chunk\n",
+                __FUNCTION__,
+                fileName.c_str());
+    return false;
+  }
+
+  decodeImages(*this, *mModel, deferredImages, fileName);
+
+  Logger::log(1,
+              "%s: mapped %i bytes of binary data of file '%s'\n",
+              __FUNCTION__,
+              mBinaryChunkSize,
+              fileName.c_str());
+  return true;
+}
+
+bool GltfFile::checkBinaryBufferViews() {
+  for (const auto &bufferView : mModel->bufferViews) {
+    if (bufferView.buffer == mBinaryBuffer &&
+        bufferView.byteOffset + bufferView.byteLength > mBinaryChunkSize)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void GltfFile::logLoaderMessages(const std::string &errors, const std::string &warnings) {
+  if (!warnings.empty()) {
+    Logger::log(1, "%s: warnings while loading glTF model:\n%s\n", __FUNCTION__, warnings.c_str());
+  }
+  if (!errors.empty()) {
+    Logger::log(1, "%s: errors while loading glTF model:\n%s\n", __FUNCTION__, errors.c_str());
+  }
+}
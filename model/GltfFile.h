@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <tiny_gltf.h>
+#include <vector>
+
+#include "MappedFile.h"
+
+/* A glTF asset and the memory holding its binary data. The format follows from
+ * the first bytes of the file: a .glb file is memory mapped and the buffer of
+ * its binary chunk is read in place, only the JSON chunk is parsed. A .gltf
+ * file is loaded by tinygltf, the buffers are decoded into memory.
+ */
+class GltfFile {
+ public:
+  bool load(std::string fileName);
+  bool isBinary() const;
+
+  std::shared_ptr<tinygltf::Model> getModel() const;
+  /* First byte of a buffer view, inside the mapping for the binary chunk. */
+  const unsigned char *getBufferViewData(int bufferViewNum) const;
+
+ private:
+  bool loadBinary(const std::string &fileName);
+  bool checkBinaryBufferViews();
+  void logLoaderMessages(const std::string &errors, const std::string &warnings);
+
+  std::shared_ptr<tinygltf::Model> mModel = nullptr;
+
+  MappedFile mMapping{};
+  const unsigned char *mBinaryChunk = nullptr;
+  size_t mBinaryChunkSize = 0;
+  /* the buffer without uri in a .glb file, -1 if there is none */
+  int mBinaryBuffer = -1;
+};
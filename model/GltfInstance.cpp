@@ -0,0 +1,511 @@
+#include <algorithm>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/dual_quaternion.hpp>
+#include <glm/gtx/matrix_decompose.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+#include <cmath>
+
+#include "GltfInstance.h"
+#include "Logger.h"
+
+GltfInstance::GltfInstance(std::shared_ptr<GltfModel> model, glm::vec3 worldPos, float timeOffset)
+    : mGltfModel(model), mWorldPosition(worldPos), mTimeOffset(timeOffset) {
+  mJointMatrices.resize(mGltfModel->getJointMatrixSize());
+  mJointDualQuats.resize(mGltfModel->getJointDualQuatsSize());
+
+  mRootNode = mGltfModel->createNodeTree(mNodeList);
+  updateNodeMatrices(mRootNode);
+
+  mAdditiveAnimationMask.resize(mNodeList.size());
+  mInvertedAdditiveAnimationMask.resize(mNodeList.size());
+
+  std::fill(mAdditiveAnimationMask.begin(), mAdditiveAnimationMask.end(), true);
+  mInvertedAdditiveAnimationMask = mAdditiveAnimationMask;
+  mInvertedAdditiveAnimationMask.flip();
+  updateLodMasks();
+
+  /* both pose buffers start with the default pose */
+  updateBounds();
+  mFrontJointMatrices = mJointMatrices;
+  mFrontJointDualQuats = mJointDualQuats;
+  mFrontBounds = mBounds;
+}
+
+glm::vec3 GltfInstance::getWorldPosition() {
+  return mWorldPosition;
+}
+
+float GltfInstance::getTimeOffset() {
+  return mTimeOffset;
+}
+
+glm::mat4 GltfInstance::getWorldTransformMatrix() {
+  return glm::translate(glm::mat4(1.0f), mWorldPosition);
+}
+
+const BoundingBox &GltfInstance::getBounds() {
+  return mFrontBounds;
+}
+
+/* Moves the joint boxes into world space, the box is transformed by its
+ * center and the absolute matrix for the extents.
+ */
+void GltfInstance::updateBounds() {
+  const std::vector<BoundingBox> &jointBounds = mGltfModel->getJointBounds();
+  const std::vector<glm::mat4> &bindMatrices = mGltfModel->getBindMatrices();
+  glm::mat4 worldMatrix = getWorldTransformMatrix();
+
+  mBounds = BoundingBox{};
+  for (int i = 0; i < jointBounds.size(); ++i) {
+    const BoundingBox &jointBox = jointBounds.at(i);
+    if (jointBox.isEmpty()) {
+      continue;
+    }
+
+    glm::mat4 jointToWorld = worldMatrix * mJointMatrices.at(i) * bindMatrices.at(i);
+    glm::vec3 center = (jointBox.min + jointBox.max) * 0.5f;
+    glm::vec3 extents = (jointBox.max - jointBox.min) * 0.5f;
+
+    glm::mat3 absMatrix = glm::mat3(jointToWorld);
+    for (int col = 0; col < 3; ++col) {
+      absMatrix[col] = glm::abs(absMatrix[col]);
+    }
+
+    glm::vec3 worldCenter = glm::vec3(jointToWorld * glm::vec4(center, 1.0f));
+    glm::vec3 worldExtents = absMatrix * extents;
+    mBounds.addPoint(worldCenter - worldExtents);
+    mBounds.addPoint(worldCenter + worldExtents);
+  }
+}
+
+/* Pose */
+
+void GltfInstance::updateNodeMatrices(std::shared_ptr<GltfNode> treeNode) {
+  treeNode->calculateNodeMatrix();
+  updateJointMatricesAndQuats(treeNode);
+
+  const std::vector<bool> &lodNodeMask = mGltfModel->getLodNodeMask(mLodTier);
+  int treeNodeJoint = mGltfModel->getNodeToJoint().at(treeNode->getNodeNum());
+
+  for (auto &childNode : treeNode->getChilds()) {
+    if (lodNodeMask.at(childNode->getNodeNum())) {
+      updateNodeMatrices(childNode);
+    }
+    else {
+      updateSkippedNodes(childNode, treeNodeJoint);
+    }
+  }
+}
+
+/* Skipped joints stay in their rest pose relative to the parent, and
+ * for a joint in rest pose the skinning matrix equals the one of the parent.
+ */
+void GltfInstance::updateSkippedNodes(std::shared_ptr<GltfNode> treeNode, int parentJoint) {
+  int joint = mGltfModel->getNodeToJoint().at(treeNode->getNodeNum());
+  if (joint >= 0 && parentJoint >= 0) {
+    mJointMatrices.at(joint) = mJointMatrices.at(parentJoint);
+    mJointDualQuats.at(joint) = mJointDualQuats.at(parentJoint);
+  }
+
+  for (auto &childNode : treeNode->getChilds()) {
+    updateSkippedNodes(childNode, parentJoint >= 0 ? parentJoint : joint);
+  }
+}
+
+void GltfInstance::updateJointMatricesAndQuats(std::shared_ptr<GltfNode> treeNode) {
+  int nodeNum = treeNode->getNodeNum();
+  int joint = mGltfModel->getNodeToJoint().at(nodeNum);
+  if (joint < 0) {
+    /* not part of the skin */
+    return;
+  }
+
+  mJointMatrices.at(joint) = treeNode->getNodeMatrix() *
+                             mGltfModel->getInverseBindMatrices().at(joint);
+
+  // Components of node matrix
+  glm::quat orientation;
+  glm::vec3 scale;
+  glm::vec3 translation;
+  glm::vec3 skew;
+  glm::vec4 perspective;
+  glm::dualquat dq;
+
+  /* Create dual quaternion */
+  if (glm::decompose(
+          mJointMatrices.at(joint), scale, orientation, translation, skew, perspective))
+  {
+    dq[0] = orientation;
+    dq[1] = glm::quat(0.0, translation.x, translation.y, translation.z) * orientation * 0.5f;
+    mJointDualQuats.at(joint) = glm::mat2x4_cast(dq);
+  }
+  else {
+    Logger::log(1, "%s error: could not decompose matrix for node %i\n", __FUNCTION__, nodeNum);
+  }
+}
+
+void GltfInstance::getNodeData(std::shared_ptr<GltfNode> treeNode) {
+  mGltfModel->getNodeData(treeNode);
+  updateJointMatricesAndQuats(treeNode);
+}
+
+void GltfInstance::resetNodeData() {
+  getNodeData(mRootNode);
+  resetNodeData(mRootNode);
+  mLodPoseValid = false;
+}
+
+void GltfInstance::resetNodeData(std::shared_ptr<GltfNode> treeNode) {
+  for (auto &childNode : treeNode->getChilds()) {
+    getNodeData(childNode);
+    resetNodeData(childNode);
+  }
+}
+
+const std::vector<glm::mat4> &GltfInstance::getJointMatrices() {
+  return mFrontJointMatrices;
+}
+
+const std::vector<glm::mat2x4> &GltfInstance::getJointDualQuats() {
+  return mFrontJointDualQuats;
+}
+
+void GltfInstance::swapPoseBuffers() {
+  std::swap(mJointMatrices, mFrontJointMatrices);
+  std::swap(mJointDualQuats, mFrontJointDualQuats);
+  std::swap(mBounds, mFrontBounds);
+}
+
+/* Additive blending */
+
+void GltfInstance::updateAdditiveMask(std::shared_ptr<GltfNode> treeNode, int splitNodeNum) {
+  if (treeNode->getNodeNum() == splitNodeNum) {
+    return;
+  }
+  mAdditiveAnimationMask.at(treeNode->getNodeNum()) = false;
+  for (auto &childNode : treeNode->getChilds()) {
+    updateAdditiveMask(childNode, splitNodeNum);
+  }
+}
+
+void GltfInstance::setSkeletonSplitNode(int nodeNum) {
+  std::fill(mAdditiveAnimationMask.begin(), mAdditiveAnimationMask.end(), true);
+  updateAdditiveMask(mRootNode, nodeNum);
+  mInvertedAdditiveAnimationMask = mAdditiveAnimationMask;
+  mInvertedAdditiveAnimationMask.flip();
+  updateLodMasks();
+}
+
+/* Inverse Kinematics */
+
+void GltfInstance::setInverseKinematicsNodes(int effectorNodeNum, int ikChainRootNodeNum) {
+  if (effectorNodeNum < 0 || effectorNodeNum > (mNodeList.size() - 1)) {
+    Logger::log(1, "%s error: effector node %i is out of range\n", __FUNCTION__, effectorNodeNum);
+    return;
+  }
+
+  if (ikChainRootNodeNum < 0 || ikChainRootNodeNum > (mNodeList.size() - 1)) {
+    Logger::log(
+        1, "%s error: IK chaine root node %i is out of range\n", __FUNCTION__, ikChainRootNodeNum);
+    return;
+  }
+
+  std::vector<std::shared_ptr<GltfNode>> ikNodes{};
+  int currentNodeNum = effectorNodeNum;
+
+  ikNodes.insert(ikNodes.begin(), mNodeList.at(effectorNodeNum));
+  while (currentNodeNum != ikChainRootNodeNum) {
+    std::shared_ptr<GltfNode> node = mNodeList.at(currentNodeNum);
+    if (node) {
+      std::shared_ptr<GltfNode> parentNode = node->getParentNode();
+      if (parentNode) {
+        currentNodeNum = parentNode->getNodeNum();
+        ikNodes.push_back(parentNode);
+      }
+      else {
+        break;
+      }
+    }
+  }
+  mIKSolver.setNodes(ikNodes);
+}
+
+void GltfInstance::setNumIKIterations(int iterations) {
+  mIKSolver.setNumIterations(iterations);
+}
+
+float GltfInstance::getIKTime() {
+  return mIKTime;
+}
+
+/* Animation */
+
+void GltfInstance::blendAnimationFrame(int animNum, float time, float blendFactor) {
+  mGltfModel->getAnimClips().at(animNum)->blendAnimationFrame(
+      mNodeList, mLodAdditiveAnimationMask, time, blendFactor);
+  updateNodeMatrices(mRootNode);
+}
+
+void GltfInstance::crossBlendAnimationFrame(int sourceAnimNumber,
+                                            int destAnimNumber,
+                                            float time,
+                                            float blendFactor) {
+  const std::vector<std::shared_ptr<GltfAnimationClip>> &clips = mGltfModel->getAnimClips();
+  float sourceAnimDuration = clips.at(sourceAnimNumber)->getClipEndTime();
+  float destAnimDuration = clips.at(destAnimNumber)->getClipEndTime();
+
+  float scaledTime = time * (destAnimDuration / sourceAnimDuration);
+
+  clips.at(sourceAnimNumber)->setAnimationFrame(mNodeList, mLodAdditiveAnimationMask, time);
+  clips.at(destAnimNumber)
+      ->blendAnimationFrame(mNodeList, mLodAdditiveAnimationMask, scaledTime, blendFactor);
+
+  clips.at(destAnimNumber)
+      ->setAnimationFrame(mNodeList, mLodInvertedAdditiveAnimationMask, scaledTime);
+  clips.at(sourceAnimNumber)
+      ->blendAnimationFrame(mNodeList, mLodInvertedAdditiveAnimationMask, time, blendFactor);
+
+  updateNodeMatrices(mRootNode);
+}
+
+bool GltfInstance::loadClips(const AnimationSettings &settings) {
+  const std::vector<std::shared_ptr<GltfAnimationClip>> &clips = mGltfModel->getAnimClips();
+  bool sourceLoaded = clips.at(settings.asAnimClip)->loadChannels(settings.asAsyncClipLoading);
+  if (settings.asBlendingMode == blendMode::fadeInOut) {
+    return sourceLoaded;
+  }
+  bool destLoaded = clips.at(settings.asCrossBlendDestAnimClip)
+                        ->loadChannels(settings.asAsyncClipLoading);
+  return sourceLoaded && destLoaded;
+}
+
+void GltfInstance::setPoseCache(std::shared_ptr<PoseCache> poseCache) {
+  mPoseCache = poseCache;
+}
+
+/* Position in the source clip, the instance offset spreads the phases of a crowd. */
+float GltfInstance::getClipTime(const AnimationSettings &settings, double time) {
+  if (!settings.asPlayAnimation) {
+    return settings.asAnimTimePosition;
+  }
+
+  const std::shared_ptr<GltfAnimationClip> &clip = mGltfModel->getAnimClips().at(
+      settings.asAnimClip);
+  return std::fmod((time + mTimeOffset) * settings.asAnimSpeed, clip->getClipEndTime());
+}
+
+void GltfInstance::updatePose(const AnimationSettings &settings, double time, bool solveIK) {
+  float clipTime = getClipTime(settings, time);
+
+  if (!mPoseCache || !settings.asPoseCacheEnabled || settings.asPoseCacheTimeStep <= 0.0f) {
+    evaluatePose(settings, clipTime, solveIK);
+    return;
+  }
+
+  /* snap to the time step, every instance with the same key gets the identical pose */
+  float clipEndTime = mGltfModel->getAnimClips().at(settings.asAnimClip)->getClipEndTime();
+  PoseCacheKey key{};
+  key.clip = settings.asAnimClip;
+  key.destClip = -1;
+  if (settings.asBlendingMode != blendMode::fadeInOut) {
+    key.destClip = settings.asCrossBlendDestAnimClip;
+  }
+  key.timeStep = static_cast<int>(std::floor(clipTime / settings.asPoseCacheTimeStep + 0.5f));
+  key.lodTier = mLodTier;
+  key.ikEnabled = solveIK && settings.asIkMode != ikMode::off;
+  float quantizedTime = std::min(key.timeStep * settings.asPoseCacheTimeStep, clipEndTime);
+
+  std::shared_ptr<PoseCacheEntry> entry = mPoseCache->getEntry(key);
+  bool evaluated = false;
+  std::call_once(entry->evaluated, [&]() {
+    evaluatePose(settings, quantizedTime, solveIK);
+    entry->jointMatrices = mJointMatrices;
+    entry->jointDualQuats = mJointDualQuats;
+    entry->nodeMatrices.resize(mNodeList.size());
+    for (int i = 0; i < mNodeList.size(); ++i) {
+      entry->nodeMatrices.at(i) = mNodeList.at(i)->getNodeMatrix();
+    }
+    evaluated = true;
+  });
+  mPoseCache->countLookup(!evaluated);
+
+  if (!evaluated) {
+    mJointMatrices = entry->jointMatrices;
+    mJointDualQuats = entry->jointDualQuats;
+    for (int i = 0; i < mNodeList.size(); ++i) {
+      mNodeList.at(i)->setNodeMatrix(entry->nodeMatrices.at(i));
+    }
+  }
+}
+
+void GltfInstance::evaluatePose(const AnimationSettings &settings, float clipTime, bool solveIK) {
+  float time = clipTime;
+  if (settings.asPlayAnimation && settings.asAnimationPlayDirection == replayDirection::backward) {
+    time = mGltfModel->getAnimClips().at(settings.asAnimClip)->getClipEndTime() - clipTime;
+  }
+
+  if (settings.asBlendingMode == blendMode::crossFade ||
+      settings.asBlendingMode == blendMode::additive)
+  {
+    crossBlendAnimationFrame(settings.asAnimClip,
+                             settings.asCrossBlendDestAnimClip,
+                             time,
+                             settings.asAnimCrossBlendFactor);
+  }
+  else {
+    blendAnimationFrame(settings.asAnimClip, time, settings.asAnimBlendFactor);
+  }
+
+  /* solve IK */
+  if (solveIK && settings.asIkMode != ikMode::off) {
+    mIKTimer.start();
+    switch (settings.asIkMode) {
+      case ikMode::ccd:
+        mIKSolver.solveCCD(settings.asIkTargetPos);
+        updateNodeMatrices(mIKSolver.getIkChainRootNode());
+        break;
+      case ikMode::fabrik:
+        mIKSolver.solveFABRIK(settings.asIkTargetPos);
+        updateNodeMatrices(mIKSolver.getIkChainRootNode());
+      default:
+        break;
+    }
+    mIKTime = mIKTimer.stop();
+  }
+}
+
+/* Animation level of detail */
+
+void GltfInstance::setLodTier(int tierNum) {
+  if (tierNum == mLodTier) {
+    return;
+  }
+  mLodTier = tierNum;
+  mLodPoseValid = false;
+  updateLodMasks();
+}
+
+int GltfInstance::getLodTier() {
+  return mLodTier;
+}
+
+bool GltfInstance::isBaked() {
+  return getBakedAnimation() != bakedAnimMode::off;
+}
+
+bakedAnimMode GltfInstance::getBakedAnimation() {
+  return mGltfModel->getAnimationLodTiers().at(mLodTier).bakedAnimation;
+}
+
+void GltfInstance::updateLodMasks() {
+  const std::vector<bool> &lodNodeMask = mGltfModel->getLodNodeMask(mLodTier);
+
+  mLodAdditiveAnimationMask.resize(mAdditiveAnimationMask.size());
+  mLodInvertedAdditiveAnimationMask.resize(mInvertedAdditiveAnimationMask.size());
+  for (int i = 0; i < mAdditiveAnimationMask.size(); ++i) {
+    mLodAdditiveAnimationMask.at(i) = mAdditiveAnimationMask.at(i) && lodNodeMask.at(i);
+    mLodInvertedAdditiveAnimationMask.at(i) = mInvertedAdditiveAnimationMask.at(i) &&
+                                              lodNodeMask.at(i);
+  }
+}
+
+bool GltfInstance::updateAnimation(const AnimationSettings &settings, unsigned int instanceNum) {
+  const AnimationLodTier &tier = mGltfModel->getAnimationLodTiers().at(mLodTier);
+  unsigned int interval = std::max(tier.updateInterval, 1);
+  mIKTime = 0.0f;
+
+  /* the pose is fetched on the GPU, the bounds cover every frame of the clip */
+  if (tier.bakedAnimation != bakedAnimMode::off) {
+    mBounds = mGltfModel->getClipBounds(settings.asAnimClip);
+    mBounds.min += mWorldPosition;
+    mBounds.max += mWorldPosition;
+    return false;
+  }
+
+  /* the instance keeps its current pose until the clips are decoded, the swap hands it back */
+  if (!loadClips(settings)) {
+    mJointMatrices = mFrontJointMatrices;
+    mJointDualQuats = mFrontJointDualQuats;
+    mBounds = mFrontBounds;
+    return false;
+  }
+
+  if (interval == 1) {
+    updatePose(settings, settings.asAnimTime, tier.ikEnabled);
+    return true;
+  }
+
+  /* updates are staggered, every instance is sampled on a different frame */
+  unsigned int framesToUpdate = interval - (settings.asFrameNum + instanceNum) % interval;
+
+  if (!mLodPoseValid || framesToUpdate == interval) {
+    /* sample the pose for the frame of the next update, and blend towards it */
+    updatePose(settings,
+               settings.asAnimTime + framesToUpdate * settings.asFrameDuration,
+               tier.ikEnabled);
+
+    if (mLodPoseValid) {
+      /* the previous target pose is the pose of this frame */
+      std::swap(mLodPrevJointMatrices, mLodNextJointMatrices);
+      std::swap(mLodPrevJointDualQuats, mLodNextJointDualQuats);
+    }
+    else {
+      mLodPrevJointMatrices = mFrontJointMatrices;
+      mLodPrevJointDualQuats = mFrontJointDualQuats;
+    }
+    mLodNextJointMatrices = mJointMatrices;
+    mLodNextJointDualQuats = mJointDualQuats;
+
+    mLodFramesSinceUpdate = 0;
+    mLodPoseValid = true;
+    interpolateLodPose(0.0f);
+    mLodFramesUntilUpdate = framesToUpdate;
+    return true;
+  }
+
+  ++mLodFramesSinceUpdate;
+  interpolateLodPose(static_cast<float>(mLodFramesSinceUpdate) / mLodFramesUntilUpdate);
+  return true;
+}
+
+void GltfInstance::samplePose(int clipNum, float clipTime) {
+  AnimationSettings settings{};
+  settings.asPlayAnimation = false;
+  settings.asAnimClip = clipNum;
+  settings.asAnimTimePosition = clipTime;
+
+  evaluatePose(settings, clipTime, false);
+  updateBounds();
+  swapPoseBuffers();
+}
+
+void GltfInstance::interpolateLodPose(float alpha) {
+  float factor = std::clamp(alpha, 0.0f, 1.0f);
+
+  for (int i = 0; i < mJointMatrices.size(); ++i) {
+    /* blend along the shortest path and renormalize the dual quaternion */
+    glm::mat2x4 prevDq = mLodPrevJointDualQuats.at(i);
+    glm::mat2x4 nextDq = mLodNextJointDualQuats.at(i);
+    if (glm::dot(prevDq[0], nextDq[0]) < 0.0f) {
+      nextDq = nextDq * -1.0f;
+    }
+    glm::mat2x4 dq = prevDq * (1.0f - factor) + nextDq * factor;
+    mJointDualQuats.at(i) = dq * (1.0f / glm::length(dq[0]));
+
+    /* the matrix is rebuilt from the blended rotation and translation, a component-wise
+     * blend shrinks joints with large rotations, the scale of the axes is blended apart
+     */
+    glm::dualquat unitDq = glm::dualquat_cast(mJointDualQuats.at(i));
+    glm::quat translation = unitDq.dual * glm::conjugate(unitDq.real) * 2.0f;
+    glm::mat4 jointMatrix = glm::mat4_cast(unitDq.real);
+    jointMatrix[3] = glm::vec4(translation.x, translation.y, translation.z, 1.0f);
+    for (int axis = 0; axis < 3; ++axis) {
+      float prevScale = glm::length(glm::vec3(mLodPrevJointMatrices.at(i)[axis]));
+      float nextScale = glm::length(glm::vec3(mLodNextJointMatrices.at(i)[axis]));
+      jointMatrix[axis] *= prevScale * (1.0f - factor) + nextScale * factor;
+    }
+    mJointMatrices.at(i) = jointMatrix;
+  }
+}
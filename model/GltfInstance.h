@@ -0,0 +1,132 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "GltfModel.h"
+#include "GltfNode.h"
+#include "IKSolver.h"
+#include "PoseCache.h"
+#include "Timer.h"
+
+#include "OGLRenderData.h"
+
+/* A single character on screen. The instance owns the node tree and the
+ * pose of the character, all shared data is read from the GltfModel.
+ */
+class GltfInstance {
+ public:
+  GltfInstance(std::shared_ptr<GltfModel> model, glm::vec3 worldPos, float timeOffset);
+
+  void resetNodeData();
+
+  void setSkeletonSplitNode(int nodeNum);
+
+  const std::vector<glm::mat4> &getJointMatrices();
+  const std::vector<glm::mat2x4> &getJointDualQuats();
+
+  /* Hand the pose written by the animation over to the renderer. */
+  void swapPoseBuffers();
+
+  glm::vec3 getWorldPosition();
+  float getTimeOffset();
+  glm::mat4 getWorldTransformMatrix();
+
+  /* World space bounds of the pose in the front buffer. */
+  const BoundingBox &getBounds();
+  /* Runs on an animation worker thread, after the pose is updated. */
+  void updateBounds();
+
+  /* Inverse Kinematics */
+  void setInverseKinematicsNodes(int effectorNodeNum, int ikChainRootNodeNum);
+  void setNumIKIterations(int iterations);
+  float getIKTime();
+
+  /* Animation level of detail, set on the render thread before the update. */
+  void setLodTier(int tierNum);
+  int getLodTier();
+  /* The LOD tier reads the pose from a baked texture, the instance is not animated. */
+  bool isBaked();
+  bakedAnimMode getBakedAnimation();
+  /* Rebuilds the joint masks after the tiers of the model have changed. */
+  void updateLodMasks();
+
+  /* Poses are shared with other instances through the cache, if enabled in the settings. */
+  void setPoseCache(std::shared_ptr<PoseCache> poseCache);
+
+  /* Position in the source clip at the given time of the global animation clock. */
+  float getClipTime(const AnimationSettings &settings, double time);
+
+  /* Runs on an animation worker thread. Returns false if no pose was evaluated, e.g.
+   * for baked tiers or while the clips are decoded. The bounds are already set then
+   * and updateBounds() must not rebuild them.
+   */
+  bool updateAnimation(const AnimationSettings &settings, unsigned int instanceNum);
+
+  /* Poses a single clip without blending or IK and makes it the front pose, used by the bake. */
+  void samplePose(int clipNum, float clipTime);
+
+ private:
+  void blendAnimationFrame(int animNum, float time, float blendFactor);
+  void crossBlendAnimationFrame(int sourceAnimNumber,
+                                int destAnimNumber,
+                                float time,
+                                float blendFactor);
+  /* Requests the channels of the played clips, false while a background decode runs. */
+  bool loadClips(const AnimationSettings &settings);
+  void updatePose(const AnimationSettings &settings, double time, bool solveIK);
+  void evaluatePose(const AnimationSettings &settings, float clipTime, bool solveIK);
+
+  void getNodeData(std::shared_ptr<GltfNode> treeNode);
+  void resetNodeData(std::shared_ptr<GltfNode> treeNode);
+  void updateNodeMatrices(std::shared_ptr<GltfNode> treeNode);
+  void updateSkippedNodes(std::shared_ptr<GltfNode> treeNode, int parentJoint);
+  void updateJointMatricesAndQuats(std::shared_ptr<GltfNode> treeNode);
+  void updateAdditiveMask(std::shared_ptr<GltfNode> treeNode, int splitNodeNum);
+  void interpolateLodPose(float alpha);
+
+  std::shared_ptr<GltfModel> mGltfModel = nullptr;
+
+  std::shared_ptr<GltfNode> mRootNode = nullptr;
+  std::vector<std::shared_ptr<GltfNode>> mNodeList{};
+
+  /* The pose data is double-buffered: the animation writes to the back buffers,
+   * while the renderer reads the front buffers. Both are exchanged in swapPoseBuffers().
+   */
+  std::vector<glm::mat4> mJointMatrices{};
+  std::vector<glm::mat2x4> mJointDualQuats{};
+  std::vector<glm::mat4> mFrontJointMatrices{};
+  std::vector<glm::mat2x4> mFrontJointDualQuats{};
+
+  BoundingBox mBounds{};
+  BoundingBox mFrontBounds{};
+
+  std::vector<bool> mAdditiveAnimationMask{};
+  std::vector<bool> mInvertedAdditiveAnimationMask{};
+
+  /* additive masks combined with the joint mask of the LOD tier */
+  std::vector<bool> mLodAdditiveAnimationMask{};
+  std::vector<bool> mLodInvertedAdditiveAnimationMask{};
+
+  /* Poses sampled by reduced rate LOD tiers, the output is interpolated between both. */
+  std::vector<glm::mat4> mLodPrevJointMatrices{};
+  std::vector<glm::mat4> mLodNextJointMatrices{};
+  std::vector<glm::mat2x4> mLodPrevJointDualQuats{};
+  std::vector<glm::mat2x4> mLodNextJointDualQuats{};
+
+  int mLodTier = 0;
+  int mLodFramesSinceUpdate = 0;
+  int mLodFramesUntilUpdate = 1;
+  bool mLodPoseValid = false;
+
+  glm::vec3 mWorldPosition = glm::vec3(0.0f);
+  float mTimeOffset = 0.0f;
+
+  std::shared_ptr<PoseCache> mPoseCache = nullptr;
+
+  IKSolver mIKSolver{};
+  Timer mIKTimer{};
+  float mIKTime = 0.0f;
+};
@@ -1,505 +1,2305 @@
 #include <algorithm>
+#include <array>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtc/type_ptr.hpp>
-#include <glm/gtx/dual_quaternion.hpp>
-#include <glm/gtx/matrix_decompose.hpp>
 #include <glm/gtx/quaternion.hpp>
 
-#include <chrono>
 #include <cmath>
+#include <cstring>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <numeric>
+#include <type_traits>
+
+#include <sys/resource.h>
 
 #include "GltfModel.h"
 #include "Logger.h"
+#include "ParallelFor.h"
+#include "Timer.h"
+
+namespace {
+template <typename T>
+double readComponent(const unsigned char *data, bool normalized) {
+  T value;
+  std::memcpy(&value, data, sizeof(T));
+  if (!normalized || std::is_floating_point<T>::value) {
+    return value;
+  }
+  return std::max(static_cast<double>(value) / std::numeric_limits<T>::max(), -1.0);
+}
+
+/* triangle counts of the mesh LODs relative to the full mesh, and the largest
+ * error allowed on the way, relative to the radius of the primitive
+ */
+const std::vector<float> meshLodTriangleRatios = {0.5f, 0.25f, 0.125f};
+const float meshLodMaxError = 0.1f;
+
+/* smaller influences are dropped, the rest is skinned with 1, 2, 4 or 8 joints */
+const float minInfluenceWeight = 0.02f;
+const std::vector<int> jointInfluenceBuckets = {1, 2, 4, 8};
+
+/* frames of every clip for the error of the weight pruning, the first and the last included */
+const int pruneErrorSamplesPerClip = 8;
+
+/* joints a sub-mesh can address with the uint8 joint numbers of the packed vertices */
+const int maxPaletteJoints = 256;
+const GLuint paletteJointBinding = 12;
+
+/* Sorts the influences of both joint sets by weight and keeps the largest ones,
+ * the joints of the others stay with a zero weight. The heaviest influence is
+ * always kept.
+ */
+void pruneInfluences(glm::tvec4<uint16_t> &joints0,
+                     glm::vec4 &weights0,
+                     glm::tvec4<uint16_t> &joints1,
+                     glm::vec4 &weights1,
+                     int maxInfluences,
+                     float minWeight) {
+  std::array<std::pair<float, uint16_t>, 8> influences{};
+  for (int i = 0; i < 4; ++i) {
+    influences.at(i) = {weights0[i], joints0[i]};
+    influences.at(i + 4) = {weights1[i], joints1[i]};
+  }
+  std::stable_sort(influences.begin(), influences.end(), [](const auto &a, const auto &b) {
+    return a.first > b.first;
+  });
+
+  float weightSum = 0.0f;
+  for (int i = 0; i < 8; ++i) {
+    if (i > 0 && (i >= maxInfluences || influences.at(i).first < minWeight)) {
+      influences.at(i).first = 0.0f;
+    }
+    weightSum += influences.at(i).first;
+  }
+  if (weightSum <= 0.0f) {
+    influences.at(0).first = 1.0f;
+    weightSum = 1.0f;
+  }
+
+  for (int i = 0; i < 4; ++i) {
+    joints0[i] = influences.at(i).second;
+    weights0[i] = influences.at(i).first / weightSum;
+    joints1[i] = influences.at(i + 4).second;
+    weights1[i] = influences.at(i + 4).first / weightSum;
+  }
+}
+
+/* the influences with a weight, both sets together */
+int getInfluenceCount(const glm::vec4 &weights0, const glm::vec4 &weights1) {
+  int influences = 0;
+  for (int i = 0; i < 4; ++i) {
+    influences += weights0[i] > 0.0f ? 1 : 0;
+    influences += weights1[i] > 0.0f ? 1 : 0;
+  }
+  return influences;
+}
+
+glm::mat4 getSkinMatrix(const std::vector<glm::mat4> &palette,
+                        const glm::tvec4<uint16_t> &joints0,
+                        const glm::vec4 &weights0,
+                        const glm::tvec4<uint16_t> &joints1,
+                        const glm::vec4 &weights1) {
+  glm::mat4 skinMatrix = glm::mat4(0.0f);
+  for (int i = 0; i < 4; ++i) {
+    skinMatrix += palette.at(joints0[i]) * weights0[i];
+    if (weights1[i] > 0.0f) {
+      skinMatrix += palette.at(joints1[i]) * weights1[i];
+    }
+  }
+  return skinMatrix;
+}
+
+/* The raw bytes of all attributes, equal vertices have equal keys. */
+template <typename... T>
+std::string getVertexKey(const T &...attributes) {
+  std::string key{};
+  (key.append(reinterpret_cast<const char *>(&attributes), sizeof(T)), ...);
+  return key;
+}
+
+/* Parts share a palette if their joints fit into it, a part goes to the palette that needs
+ * the fewest new joints. Equal palettes, e.g. of the mesh LOD and influence bucket copies,
+ * are merged that way too. Returns the palette of every part.
+ */
+std::vector<int> mergePalettes(const std::vector<std::vector<int>> &partJoints,
+                               int jointCount,
+                               std::vector<std::vector<int>> &palettes) {
+  std::vector<int> partPalettes(partJoints.size(), -1);
+  std::vector<std::vector<bool>> inPalette{};
+  palettes.clear();
+
+  for (size_t part = 0; part < partJoints.size(); ++part) {
+    const std::vector<int> &joints = partJoints.at(part);
+    int bestPalette = -1;
+    size_t bestNewJoints = 0;
+    for (int paletteNum = 0; paletteNum < palettes.size(); ++paletteNum) {
+      size_t newJoints = std::count_if(joints.begin(), joints.end(), [&](int joint) {
+        return !inPalette.at(paletteNum).at(joint);
+      });
+      if (palettes.at(paletteNum).size() + newJoints <= maxPaletteJoints &&
+          (bestPalette < 0 || newJoints < bestNewJoints))
+      {
+        bestPalette = paletteNum;
+        bestNewJoints = newJoints;
+      }
+    }
+    if (bestPalette < 0) {
+      bestPalette = palettes.size();
+      palettes.emplace_back();
+      inPalette.emplace_back(jointCount, false);
+    }
+
+    for (int joint : joints) {
+      if (!inPalette.at(bestPalette).at(joint)) {
+        inPalette.at(bestPalette).at(joint) = true;
+        palettes.at(bestPalette).push_back(joint);
+      }
+    }
+    partPalettes.at(part) = bestPalette;
+  }
+  return partPalettes;
+}
+
+/* Reads all components of an accessor, the elements may be interleaved with other
+ * data. Integer components are converted to floats in [0, 1] or [-1, 1] if the
+ * accessor is normalized.
+ */
+template <typename T>
+std::vector<T> readAccessor(const GltfFile &file, int accessorNum, int componentCount) {
+  const tinygltf::Model &model = *file.getModel();
+  const tinygltf::Accessor &accessor = model.accessors.at(accessorNum);
+  if (tinygltf::GetNumComponentsInType(accessor.type) != componentCount) {
+    Logger::log(1,
+                "%s error: accessor %i has %i components instead of %i\n",
+                __FUNCTION__,
+                accessorNum,
+                tinygltf::GetNumComponentsInType(accessor.type),
+                componentCount);
+    return {};
+  }
+  if (accessor.sparse.isSparse || accessor.bufferView < 0) {
+    Logger::log(1, "%s error: sparse accessor %i is not supported\n", __FUNCTION__, accessorNum);
+    return {};
+  }
+
+  const tinygltf::BufferView &bufferView = model.bufferViews.at(accessor.bufferView);
+  const unsigned char *data = file.getBufferViewData(accessor.bufferView) + accessor.byteOffset;
+  int componentSize = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+  int stride = accessor.ByteStride(bufferView);
+
+  std::vector<T> components(accessor.count * componentCount);
+  for (size_t i = 0; i < accessor.count; ++i) {
+    for (int j = 0; j < componentCount; ++j) {
+      const unsigned char *component = data + i * stride + j * componentSize;
+      double value = 0.0;
+      switch (accessor.componentType) {
+        case TINYGLTF_COMPONENT_TYPE_FLOAT:
+          value = readComponent<float>(component, accessor.normalized);
+          break;
+        case TINYGLTF_COMPONENT_TYPE_BYTE:
+          value = readComponent<int8_t>(component, accessor.normalized);
+          break;
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+          value = readComponent<uint8_t>(component, accessor.normalized);
+          break;
+        case TINYGLTF_COMPONENT_TYPE_SHORT:
+          value = readComponent<int16_t>(component, accessor.normalized);
+          break;
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+          value = readComponent<uint16_t>(component, accessor.normalized);
+          break;
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+          value = readComponent<uint32_t>(component, accessor.normalized);
+          break;
+        default:
+          Logger::log(1,
+                      "%s error: accessor %i has unknown component type %i\n",
+                      __FUNCTION__,
+                      accessorNum,
+                      accessor.componentType);
+          return {};
+      }
+      components.at(i * componentCount + j) = static_cast<T>(value);
+    }
+  }
+  return components;
+}
+
+/* Reads an accessor into vectors, e.g. glm::vec3 or glm::tvec4<uint16_t>. */
+template <typename T>
+std::vector<T> readAttribute(const GltfFile &file, int accessorNum) {
+  const int componentCount = T::length();
+  std::vector<typename T::value_type> components = readAccessor<typename T::value_type>(
+      file, accessorNum, componentCount);
+
+  std::vector<T> attribData(components.size() / componentCount);
+  for (size_t i = 0; i < attribData.size(); ++i) {
+    for (int j = 0; j < componentCount; ++j) {
+      attribData.at(i)[j] = components.at(i * componentCount + j);
+    }
+  }
+  return attribData;
+}
+
+/* Optional attributes keep the default values if the primitive has none. */
+template <typename T>
+bool readPrimitiveAttribute(const GltfFile &file,
+                            const tinygltf::Primitive &primitive,
+                            std::string attribType,
+                            std::vector<T> &attribData) {
+  auto attrib = primitive.attributes.find(attribType);
+  if (attrib == primitive.attributes.end()) {
+    return true;
+  }
+
+  std::vector<T> data = readAttribute<T>(file, attrib->second);
+  if (data.size() != attribData.size()) {
+    Logger::log(1,
+                "%s error: %s has %i elements instead of %i\n",
+                __FUNCTION__,
+                attribType.c_str(),
+                data.size(),
+                attribData.size());
+    return false;
+  }
+  attribData = data;
+  return true;
+}
+
+template <typename T>
+void uploadBufferData(GLenum target, GLuint buffer, const std::vector<T> &bufferData) {
+  glBindBuffer(target, buffer);
+  glBufferData(target, bufferData.size() * sizeof(T), bufferData.data(), GL_STATIC_DRAW);
+  glBindBuffer(target, 0);
+}
+
+BakedRange makeRange(size_t first, size_t count) {
+  BakedRange range{};
+  range.first = first;
+  range.count = count;
+  return range;
+}
+
+bool rangeInside(const BakedRange &range, size_t size) {
+  return range.first <= size && range.count <= size - range.first;
+}
+
+/* The matrices of the file are stored as floats, small differences are accepted. */
+bool matricesEqual(const glm::mat4 &a, const glm::mat4 &b) {
+  for (int col = 0; col < 4; ++col) {
+    for (int row = 0; row < 4; ++row) {
+      if (std::abs(a[col][row] - b[col][row]) > 1e-4f * std::max(1.0f, std::abs(a[col][row]))) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+}  // namespace
 
 bool GltfModel::loadModel(OGLRenderData &renderData,
                           std::string modelFilename,
                           std::string textureFilename) {
-  if (!mTex.loadTexture(textureFilename, false)) {
+  /* the texture of all primitives without an own texture, decoded while the model loads */
+  std::future<bool> defaultImageFuture = std::async(std::launch::async, [&]() {
+    mDefaultImage.components = 4;
+    return Texture::loadImage(textureFilename,
+                              false,
+                              mDefaultImage.pixels,
+                              mDefaultImage.width,
+                              mDefaultImage.height);
+  });
+
+  Timer loadTimer{};
+  loadTimer.start();
+  bool baked = BakedModelFile::isBakedFile(modelFilename);
+  bool result = baked ? readBakedModel(renderData, modelFilename)
+                      : importModel(renderData, modelFilename);
+  if (!defaultImageFuture.get()) {
     Logger::log(1, "%s: texture loading failed\n", __FUNCTION__);
     return false;
   }
+  if (!result) {
+    Logger::log(1, "%s error: could not load model '%s'\n", __FUNCTION__, modelFilename.c_str());
+    return false;
+  }
+
+  struct rusage usage {};
+  getrusage(RUSAGE_SELF, &usage);
+  Logger::log(1,
+              "%s: %s model '%s' in %.2f ms, peak resident memory %li KiB\n",
+              __FUNCTION__,
+              baked ? "read baked" : "imported",
+              modelFilename.c_str(),
+              loadTimer.stop(),
+              usage.ru_maxrss);
+
+  /* all GL objects are created here, on the thread owning the context */
+  loadTimer.start();
+  createTextures();
+  createVertexBuffers();
   Logger::log(
-      1, "%s: glTF model texture '%s' successfully loaded\n", __FUNCTION__, modelFilename.c_str());
+      1, "%s: textures and vertex buffers created in %.2f ms\n", __FUNCTION__, loadTimer.stop());
 
-  mModel = std::make_shared<tinygltf::Model>();
+  renderData.rdModelNodeCount = mSkeleton.size();
+  renderData.rdAnimClipSize = mAnimClips.size();
 
-  tinygltf::TinyGLTF gltfLoader;
-  std::string loaderErrors;
-  std::string loaderWarnings;
-  bool result = false;
+  /* default LOD sizes, the last LOD is used for everything smaller */
+  renderData.rdMeshLodMinScreenSizes = {150.0f, 80.0f, 40.0f, 0.0f};
+  renderData.rdMeshLodMinScreenSizes.resize(getMeshLodCount(), 0.0f);
+  renderData.rdGltfLodTriangleCounts = mMeshLodTriangleCounts;
 
-  result = gltfLoader.LoadASCIIFromFile(
-      mModel.get(), &loaderErrors, &loaderWarnings, modelFilename);
+  /* default tiers, full detail up close, fewer updates and joints further away */
+  setAnimationLodTiers({{120.0f, 1, 0, true}, {60.0f, 2, 1, false}, {25.0f, 4, 2, false},
+                        {0.0f, 8, 3, false}});
+  renderData.rdAnimationLodTiers = mAnimationLodTiers;
 
-  if (!loaderWarnings.empty()) {
-    Logger::log(
-        1, "%s: warnings while loading glTF model:\n%s\n", __FUNCTION__, loaderWarnings.c_str());
+  /* Load up the clip names for the UI.*/
+  for (const auto &clip : mAnimClips) {
+    renderData.rdClipNames.push_back(clip->getClipName());
   }
 
-  if (!loaderErrors.empty()) {
-    Logger::log(
-        1, "%s: errors while loading glTF model:\n%s\n", __FUNCTION__, loaderErrors.c_str());
+  /* Load up nodes names for the UI.*/
+  for (const auto &node : mNodeList) {
+    if (node) {
+      renderData.rdSkelNodeNames.push_back(node->getNodeName());
+    }
+    else {
+      renderData.rdSkelNodeNames.push_back("(Invalid)");
+    }
+  }
+
+  renderData.rdGltfTriangleCount = getMeshLodTriangleCount(0);
+
+  return true;
+}
+
+bool GltfModel::importModel(OGLRenderData &renderData, std::string modelFilename) {
+  /* .glb files are mapped, the binary chunk is not copied. The images are decoded
+   * in parallel while the file loads.
+   */
+  Timer loadTimer{};
+  Timer stageTimer{};
+  auto logStage = [&](const char *stage) {
+    Logger::log(1, "%s: %s took %.2f ms\n", __FUNCTION__, stage, stageTimer.stop());
+    stageTimer.start();
+  };
+  loadTimer.start();
+  mGltfFile = std::make_shared<GltfFile>();
+  if (!mGltfFile->load(modelFilename)) {
+    Logger::log(1, "%s error: could not load file '%s'\n", __FUNCTION__, modelFilename.c_str());
+    return false;
+  }
+  mModel = mGltfFile->getModel();
+
+  struct rusage usage {};
+  getrusage(RUSAGE_SELF, &usage);
+  Logger::log(1,
+              "%s: %s file '%s' loaded in %.2f ms, peak resident memory %li KiB\n",
+              __FUNCTION__,
+              mGltfFile->isBinary() ? "binary" : "text",
+              modelFilename.c_str(),
+              loadTimer.stop(),
+              usage.ru_maxrss);
+
+  /* build model tree, rigid meshes are bound to the rest pose of their node */
+  getSkeleton();
+  Logger::log(1,
+              "%s: model has %i nodes, root node is %i\n",
+              __FUNCTION__,
+              mSkeleton.size(),
+              mRootNodeNum);
+
+  mRootNode = createNodeTree(mNodeList);
+  mRootNode->printTree();
+
+  mNodeHeights.resize(mNodeList.size());
+  getNodeHeights(mRootNode);
+
+  /* the clips are read while the meshes are extracted, both only read the glTF data */
+  stageTimer.start();
+  std::future<float> animationsFuture = std::async(std::launch::async, [this]() {
+    Timer animationTimer{};
+    animationTimer.start();
+    getAnimations();
+    return animationTimer.stop();
+  });
+  bool meshesRead = getSkins() && getPrimitives();
+  float meshTime = stageTimer.stop();
+  float animationTime = animationsFuture.get();
+  Logger::log(1,
+              "%s: mesh extraction took %.2f ms, clip extraction %.2f ms\n",
+              __FUNCTION__,
+              meshTime,
+              animationTime);
+  stageTimer.start();
+  if (!meshesRead) {
+    Logger::log(1, "%s error: could not read the meshes\n", __FUNCTION__);
+    return false;
+  }
+
+  /* the clip poses measure the error of the weight pruning */
+  renderData.rdGltfPruneError = pruneJointInfluences(renderData.rdGltfMaxJointInfluences);
+  compactJointPalette();
+  logStage("weight pruning");
+
+  /* reorder triangles and vertices for the vertex cache, overdraw and vertex fetch */
+  std::vector<uint32_t> exportedIndices = mIndices;
+  std::vector<GltfPrimitive> exportedPrimitives = mPrimitives;
+  createMeshLods();
+  logStage("mesh LODs");
+  splitInfluenceBuckets();
+  splitJointPalettes();
+  optimizePrimitives();
+  createDrawGroups();
+  logStage("mesh optimization");
+
+  /* the draws read the compact interleaved vertices, with the joints of the sub-mesh palettes */
+  std::vector<glm::tvec4<uint16_t>> paletteJoints = mJointVec;
+  std::vector<glm::tvec4<uint16_t>> paletteJoints1 = mJointVec1;
+  getPaletteJoints(paletteJoints, paletteJoints1);
+  if (!VertexPacker::pack(mPositions,
+                          mNormals,
+                          mTexCoords,
+                          paletteJoints,
+                          mWeightVec,
+                          paletteJoints1,
+                          mWeightVec1,
+                          mPalettes.empty() ? getJointMatrixSize() : maxPaletteJoints,
+                          mPackedVertexData))
+  {
+    Logger::log(1, "%s error: could not pack vertex data\n", __FUNCTION__);
+    return false;
+  }
+  logStage("vertex packing");
+
+  MeshStats exportedStats = getMeshStats(exportedPrimitives, exportedIndices);
+  MeshStats optimizedStats = getMeshStats(mPrimitives, mIndices);
+  Logger::log(1,
+              "%s: vertex cache ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, vertex fetch overfetch "
+              "%.3f -> %.3f, %i bit indices\n",
+              __FUNCTION__,
+              exportedStats.getACMR(),
+              optimizedStats.getACMR(),
+              exportedStats.getATVR(),
+              optimizedStats.getATVR(),
+              exportedStats.getOverfetch(),
+              optimizedStats.getOverfetch(),
+              mIndexType == GL_UNSIGNED_SHORT ? 16 : 32);
+  renderData.rdGltfExportedACMR = exportedStats.getACMR();
+  renderData.rdGltfACMR = optimizedStats.getACMR();
+  renderData.rdGltfTransformedVertices = optimizedStats.transformedVertices;
+  calculateBoundingSphere();
+  calculateJointBounds();
+  logStage("bounds");
+
+  /* everything needed later has been copied out of the glTF data */
+  mModel.reset();
+  mGltfFile.reset();
+  return true;
+}
+
+/* Everything the renderer needs after the import, laid out as in memory. */
+bool GltfModel::writeBakedModel(const OGLRenderData &renderData, std::string bakedFilename) {
+  BakedModelFile bakedFile{};
+  std::vector<char> names{};
+  auto addName = [&](const std::string &name) {
+    BakedRange range = makeRange(names.size(), name.size());
+    names.insert(names.end(), name.begin(), name.end());
+    return range;
+  };
+
+  BakedModelInfo info{};
+  info.rootNode = mRootNodeNum;
+  info.indexType = mIndexType;
+  info.maxJointInfluences = renderData.rdGltfMaxJointInfluences;
+  info.pruneError = renderData.rdGltfPruneError;
+  info.exportedACMR = renderData.rdGltfExportedACMR;
+  info.acmr = renderData.rdGltfACMR;
+  info.transformedVertices = renderData.rdGltfTransformedVertices;
+  info.boundingSphere = mBoundingSphere;
+  info.stride = mPackedVertexData.stride;
+  info.quantizedPositions = mPackedVertexData.quantizedPositions;
+  info.positionOffset = mPackedVertexData.positionOffset;
+  info.positionScale = mPackedVertexData.positionScale;
+  info.packedNormals = mPackedVertexData.packedNormals;
+  info.packedTexCoords = mPackedVertexData.packedTexCoords;
+  info.packedWeights = mPackedVertexData.packedWeights;
+  info.jointType = mPackedVertexData.jointType;
+  info.normalOffset = mPackedVertexData.normalOffset;
+  info.texCoordOffset = mPackedVertexData.texCoordOffset;
+  info.jointOffset = mPackedVertexData.jointOffset;
+  info.weightOffset = mPackedVertexData.weightOffset;
+  info.secondJointSet = mPackedVertexData.secondJointSet;
+  info.joint1Offset = mPackedVertexData.joint1Offset;
+  info.weight1Offset = mPackedVertexData.weight1Offset;
+  info.maxPositionError = mPackedVertexData.maxPositionError;
+  info.maxNormalError = mPackedVertexData.maxNormalError;
+  info.maxTexCoordError = mPackedVertexData.maxTexCoordError;
+  info.maxWeightError = mPackedVertexData.maxWeightError;
+  bakedFile.addSection(BakedSection::INFO, std::vector<BakedModelInfo>{info});
+
+  std::vector<BakedNode> nodes{};
+  std::vector<int32_t> nodeChildren{};
+  for (const auto &skeletonNode : mSkeleton) {
+    BakedNode node{};
+    node.name = addName(skeletonNode.name);
+    node.children = makeRange(nodeChildren.size(), skeletonNode.children.size());
+    nodeChildren.insert(
+        nodeChildren.end(), skeletonNode.children.begin(), skeletonNode.children.end());
+    node.translation = skeletonNode.translation;
+    node.rotation = glm::vec4(skeletonNode.rotation.x,
+                              skeletonNode.rotation.y,
+                              skeletonNode.rotation.z,
+                              skeletonNode.rotation.w);
+    node.scale = skeletonNode.scale;
+    nodes.push_back(node);
+  }
+  bakedFile.addSection(BakedSection::NODES, nodes);
+  bakedFile.addSection(BakedSection::NODE_CHILDREN, nodeChildren);
+
+  bakedFile.addSection(BakedSection::POSITIONS, mPositions);
+  bakedFile.addSection(BakedSection::NORMALS, mNormals);
+  bakedFile.addSection(BakedSection::TEX_COORDS, mTexCoords);
+  bakedFile.addSection(BakedSection::JOINTS, mJointVec);
+  bakedFile.addSection(BakedSection::WEIGHTS, mWeightVec);
+  bakedFile.addSection(BakedSection::JOINTS_1, mJointVec1);
+  bakedFile.addSection(BakedSection::WEIGHTS_1, mWeightVec1);
+  bakedFile.addSection(BakedSection::PACKED_VERTICES, mPackedVertexData.vertices);
+  bakedFile.addSection(BakedSection::INDICES, mIndices);
+
+  std::vector<BakedPrimitive> primitives{};
+  for (const auto &gltfPrimitive : mPrimitives) {
+    BakedPrimitive primitive{};
+    primitive.meshNum = gltfPrimitive.meshNum;
+    primitive.textureNum = gltfPrimitive.textureNum;
+    primitive.firstIndex = gltfPrimitive.firstIndex;
+    primitive.indexCount = gltfPrimitive.indexCount;
+    primitive.baseVertex = gltfPrimitive.baseVertex;
+    primitive.vertexCount = gltfPrimitive.vertexCount;
+    primitive.lod = gltfPrimitive.lod;
+    primitive.jointInfluences = gltfPrimitive.jointInfluences;
+    primitive.paletteNum = gltfPrimitive.paletteNum;
+    primitives.push_back(primitive);
+  }
+  bakedFile.addSection(BakedSection::PRIMITIVES, primitives);
+
+  std::vector<BakedDrawGroup> drawGroups{};
+  std::vector<OGLDrawCommand> drawCommands{};
+  std::vector<int32_t> drawCommandLods{};
+  for (const auto &gltfDrawGroup : mDrawGroups) {
+    BakedDrawGroup drawGroup{};
+    drawGroup.textureNum = gltfDrawGroup.textureNum;
+    drawGroup.jointInfluences = gltfDrawGroup.jointInfluences;
+    drawGroup.paletteNum = gltfDrawGroup.paletteNum;
+    drawGroup.commands = makeRange(drawCommands.size(), gltfDrawGroup.drawCommands.size());
+    drawCommands.insert(
+        drawCommands.end(), gltfDrawGroup.drawCommands.begin(), gltfDrawGroup.drawCommands.end());
+    drawCommandLods.insert(drawCommandLods.end(),
+                           gltfDrawGroup.drawCommandLods.begin(),
+                           gltfDrawGroup.drawCommandLods.end());
+    drawGroups.push_back(drawGroup);
+  }
+  bakedFile.addSection(BakedSection::DRAW_GROUPS, drawGroups);
+  bakedFile.addSection(BakedSection::DRAW_COMMANDS, drawCommands);
+  bakedFile.addSection(BakedSection::DRAW_COMMAND_LODS, drawCommandLods);
+  bakedFile.addSection(BakedSection::MESH_LOD_TRIANGLES,
+                       std::vector<int32_t>(mMeshLodTriangleCounts.begin(),
+                                            mMeshLodTriangleCounts.end()));
+  bakedFile.addSection(BakedSection::INFLUENCE_BUCKETS,
+                       std::vector<int32_t>(mJointInfluenceBuckets.begin(),
+                                            mJointInfluenceBuckets.end()));
+
+  std::vector<BakedRange> palettes{};
+  std::vector<int32_t> paletteJoints{};
+  for (const auto &palette : mPalettes) {
+    palettes.push_back(makeRange(paletteJoints.size(), palette.size()));
+    paletteJoints.insert(paletteJoints.end(), palette.begin(), palette.end());
+  }
+  bakedFile.addSection(BakedSection::PALETTES, palettes);
+  bakedFile.addSection(BakedSection::PALETTE_JOINTS, paletteJoints);
+
+  bakedFile.addSection(BakedSection::INVERSE_BIND_MATRICES, mInverseBindMatrices);
+  bakedFile.addSection(BakedSection::BIND_MATRICES, mBindMatrices);
+  bakedFile.addSection(BakedSection::JOINT_BOUNDS, mJointBounds);
+  bakedFile.addSection(BakedSection::NODE_TO_JOINT,
+                       std::vector<int32_t>(mNodeToJoint.begin(), mNodeToJoint.end()));
+
+  std::vector<BakedClip> clips{};
+  std::vector<BakedChannel> channels{};
+  std::vector<float> keyTimes{};
+  std::vector<glm::vec4> keyValues{};
+  for (const auto &animClip : mAnimClips) {
+    BakedClip clip{};
+    clip.name = addName(animClip->getClipName());
+    clip.channels = makeRange(channels.size(), animClip->getChannels().size());
+    for (const auto &animChannel : animClip->getChannels()) {
+      const std::vector<float> &timings = animChannel->getTimings();
+      std::vector<glm::vec4> values = animChannel->getPackedValues();
+
+      BakedChannel channel{};
+      channel.targetNode = animChannel->getTargetNode();
+      channel.targetPath = static_cast<uint32_t>(animChannel->getTargetPath());
+      channel.interpolation = static_cast<uint32_t>(animChannel->getInterpolationType());
+      channel.keyTimes = makeRange(keyTimes.size(), timings.size());
+      channel.keyValues = makeRange(keyValues.size(), values.size());
+      keyTimes.insert(keyTimes.end(), timings.begin(), timings.end());
+      keyValues.insert(keyValues.end(), values.begin(), values.end());
+      channels.push_back(channel);
+    }
+    clips.push_back(clip);
+  }
+  bakedFile.addSection(BakedSection::CLIPS, clips);
+  bakedFile.addSection(BakedSection::CHANNELS, channels);
+  bakedFile.addSection(BakedSection::KEY_TIMES, keyTimes);
+  bakedFile.addSection(BakedSection::KEY_VALUES, keyValues);
+
+  std::vector<BakedImage> images{};
+  std::vector<unsigned char> imagePixels{};
+  for (const auto &gltfImage : mImages) {
+    BakedImage image{};
+    image.width = gltfImage.width;
+    image.height = gltfImage.height;
+    image.components = gltfImage.components;
+    image.pixels = makeRange(imagePixels.size(), gltfImage.pixels.size());
+    imagePixels.insert(imagePixels.end(), gltfImage.pixels.begin(), gltfImage.pixels.end());
+    images.push_back(image);
+  }
+  bakedFile.addSection(BakedSection::IMAGES, images);
+  bakedFile.addSection(BakedSection::IMAGE_PIXELS, imagePixels);
+
+  bakedFile.addSection(BakedSection::NAMES, names);
+  return bakedFile.save(bakedFilename);
+}
+
+/* The sections are checked against each other before anything is used, a broken
+ * file fails to load instead of being read out of bounds.
+ */
+bool GltfModel::readBakedModel(OGLRenderData &renderData, std::string bakedFilename) {
+  /* the clips keep the mapping, their keys are decoded from it on first use */
+  std::shared_ptr<BakedModelFile> bakedFile = std::make_shared<BakedModelFile>();
+  if (!bakedFile->load(bakedFilename)) {
+    return false;
+  }
+
+  const BakedModelInfo *info = nullptr;
+  const BakedNode *nodes = nullptr;
+  const int32_t *nodeChildren = nullptr;
+  const char *names = nullptr;
+  const BakedPrimitive *primitives = nullptr;
+  const BakedDrawGroup *drawGroups = nullptr;
+  const OGLDrawCommand *drawCommands = nullptr;
+  const int32_t *drawCommandLods = nullptr;
+  const BakedRange *palettes = nullptr;
+  const int32_t *paletteJoints = nullptr;
+  const BakedClip *clips = nullptr;
+  const BakedChannel *channels = nullptr;
+  const float *keyTimes = nullptr;
+  const glm::vec4 *keyValues = nullptr;
+  const BakedImage *images = nullptr;
+  const unsigned char *imagePixels = nullptr;
+  size_t infoCount = 0;
+  size_t nodeCount = 0;
+  size_t nodeChildCount = 0;
+  size_t nameSize = 0;
+  size_t primitiveCount = 0;
+  size_t drawGroupCount = 0;
+  size_t drawCommandCount = 0;
+  size_t drawCommandLodCount = 0;
+  size_t paletteCount = 0;
+  size_t paletteJointCount = 0;
+  size_t clipCount = 0;
+  size_t channelCount = 0;
+  size_t keyTimeCount = 0;
+  size_t keyValueCount = 0;
+  size_t imageCount = 0;
+  size_t imagePixelCount = 0;
+  std::vector<int32_t> meshLodTriangleCounts{};
+  std::vector<int32_t> jointInfluenceBuckets{};
+  std::vector<int32_t> nodeToJoint{};
+
+  if (!bakedFile->getSection(BakedSection::INFO, info, infoCount) ||
+      !bakedFile->getSection(BakedSection::NODES, nodes, nodeCount) ||
+      !bakedFile->getSection(BakedSection::NODE_CHILDREN, nodeChildren, nodeChildCount) ||
+      !bakedFile->getSection(BakedSection::NAMES, names, nameSize) ||
+      !bakedFile->readSection(BakedSection::POSITIONS, mPositions) ||
+      !bakedFile->readSection(BakedSection::NORMALS, mNormals) ||
+      !bakedFile->readSection(BakedSection::TEX_COORDS, mTexCoords) ||
+      !bakedFile->readSection(BakedSection::JOINTS, mJointVec) ||
+      !bakedFile->readSection(BakedSection::WEIGHTS, mWeightVec) ||
+      !bakedFile->readSection(BakedSection::JOINTS_1, mJointVec1) ||
+      !bakedFile->readSection(BakedSection::WEIGHTS_1, mWeightVec1) ||
+      !bakedFile->readSection(BakedSection::PACKED_VERTICES, mPackedVertexData.vertices) ||
+      !bakedFile->readSection(BakedSection::INDICES, mIndices) ||
+      !bakedFile->getSection(BakedSection::PRIMITIVES, primitives, primitiveCount) ||
+      !bakedFile->getSection(BakedSection::DRAW_GROUPS, drawGroups, drawGroupCount) ||
+      !bakedFile->getSection(BakedSection::DRAW_COMMANDS, drawCommands, drawCommandCount) ||
+      !bakedFile->getSection(
+          BakedSection::DRAW_COMMAND_LODS, drawCommandLods, drawCommandLodCount) ||
+      !bakedFile->readSection(BakedSection::MESH_LOD_TRIANGLES, meshLodTriangleCounts) ||
+      !bakedFile->readSection(BakedSection::INFLUENCE_BUCKETS, jointInfluenceBuckets) ||
+      !bakedFile->getSection(BakedSection::PALETTES, palettes, paletteCount) ||
+      !bakedFile->getSection(BakedSection::PALETTE_JOINTS, paletteJoints, paletteJointCount) ||
+      !bakedFile->readSection(BakedSection::INVERSE_BIND_MATRICES, mInverseBindMatrices) ||
+      !bakedFile->readSection(BakedSection::BIND_MATRICES, mBindMatrices) ||
+      !bakedFile->readSection(BakedSection::JOINT_BOUNDS, mJointBounds) ||
+      !bakedFile->readSection(BakedSection::NODE_TO_JOINT, nodeToJoint) ||
+      !bakedFile->getSection(BakedSection::CLIPS, clips, clipCount) ||
+      !bakedFile->getSection(BakedSection::CHANNELS, channels, channelCount) ||
+      !bakedFile->getSection(BakedSection::KEY_TIMES, keyTimes, keyTimeCount) ||
+      !bakedFile->getSection(BakedSection::KEY_VALUES, keyValues, keyValueCount) ||
+      !bakedFile->getSection(BakedSection::IMAGES, images, imageCount) ||
+      !bakedFile->getSection(BakedSection::IMAGE_PIXELS, imagePixels, imagePixelCount))
+  {
+    Logger::log(1,
+                "%s error: file '%s' has sections of another layout\n",
+                __FUNCTION__,
+                bakedFilename.c_str());
+    return false;
+  }
+
+  auto invalidFile = [&](const char *reason) {
+    Logger::log(1,
+                "%s error: file '%s' has invalid %s\n",
+                __FUNCTION__,
+                bakedFilename.c_str(),
+                reason);
+    return false;
+  };
+
+  /* every node has at most one parent and the root has none, the tree has no cycles */
+  if (infoCount != 1 || nodeCount == 0 || info->rootNode < 0 || info->rootNode >= nodeCount) {
+    return invalidFile("model info");
+  }
+  std::vector<bool> hasParent(nodeCount, false);
+  for (size_t nodeNum = 0; nodeNum < nodeCount; ++nodeNum) {
+    const BakedNode &node = nodes[nodeNum];
+    if (!rangeInside(node.name, nameSize) || !rangeInside(node.children, nodeChildCount)) {
+      return invalidFile("nodes");
+    }
+    for (uint32_t i = 0; i < node.children.count; ++i) {
+      int32_t child = nodeChildren[node.children.first + i];
+      if (child < 0 || child >= nodeCount || child == info->rootNode || hasParent.at(child)) {
+        return invalidFile("nodes");
+      }
+      hasParent.at(child) = true;
+    }
+  }
+
+  size_t vertexCount = mPositions.size();
+  size_t jointCount = mInverseBindMatrices.size();
+  if (mNormals.size() != vertexCount || mTexCoords.size() != vertexCount ||
+      mJointVec.size() != vertexCount || mWeightVec.size() != vertexCount ||
+      mJointVec1.size() != vertexCount || mWeightVec1.size() != vertexCount ||
+      info->stride <= 0 || mPackedVertexData.vertices.size() != vertexCount * info->stride ||
+      info->normalOffset >= info->stride || info->texCoordOffset >= info->stride ||
+      info->jointOffset >= info->stride || info->weightOffset >= info->stride ||
+      info->joint1Offset >= info->stride || info->weight1Offset >= info->stride)
+  {
+    return invalidFile("vertices");
+  }
+  for (size_t i = 0; i < vertexCount; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      if (mJointVec.at(i)[j] >= jointCount || mJointVec1.at(i)[j] >= jointCount) {
+        return invalidFile("joints");
+      }
+    }
+  }
+  if (mBindMatrices.size() != jointCount || mJointBounds.size() != jointCount ||
+      nodeToJoint.size() != nodeCount)
+  {
+    return invalidFile("skin");
+  }
+  for (int32_t joint : nodeToJoint) {
+    if (joint < -1 || joint >= static_cast<int32_t>(jointCount)) {
+      return invalidFile("skin");
+    }
+  }
+
+  for (size_t i = 0; i < paletteCount; ++i) {
+    if (!rangeInside(palettes[i], paletteJointCount) || palettes[i].count > maxPaletteJoints) {
+      return invalidFile("palettes");
+    }
+  }
+  for (size_t i = 0; i < paletteJointCount; ++i) {
+    if (paletteJoints[i] < 0 || paletteJoints[i] >= jointCount) {
+      return invalidFile("palettes");
+    }
   }
 
-  if (!result) {
-    Logger::log(1, "%s error: could not load file '%s'\n", __FUNCTION__, modelFilename.c_str());
-    return false;
+  for (size_t i = 0; i < primitiveCount; ++i) {
+    const BakedPrimitive &primitive = primitives[i];
+    if (!rangeInside(makeRange(primitive.firstIndex, primitive.indexCount), mIndices.size()) ||
+        primitive.baseVertex < 0 ||
+        !rangeInside(makeRange(primitive.baseVertex, primitive.vertexCount), vertexCount) ||
+        primitive.textureNum < 0 || primitive.textureNum > imageCount ||
+        primitive.paletteNum < -1 || primitive.paletteNum >= static_cast<int32_t>(paletteCount))
+    {
+      return invalidFile("primitives");
+    }
+    for (uint32_t j = 0; j < primitive.indexCount; ++j) {
+      if (mIndices.at(primitive.firstIndex + j) >= primitive.vertexCount) {
+        return invalidFile("indices");
+      }
+    }
+  }
+  /* the compute skinning and the vertex animation texture only use the LOD 0 prefix */
+  int32_t fullResolutionVertexCount = 0;
+  for (size_t i = 0; i < primitiveCount; ++i) {
+    if (primitives[i].lod == 0) {
+      fullResolutionVertexCount = std::max(
+          fullResolutionVertexCount,
+          static_cast<int32_t>(primitives[i].baseVertex + primitives[i].vertexCount));
+    }
+  }
+  for (size_t i = 0; i < primitiveCount; ++i) {
+    if (primitives[i].lod > 0 && primitives[i].baseVertex < fullResolutionVertexCount) {
+      return invalidFile("primitives");
+    }
+  }
+
+  if (drawCommandLodCount != drawCommandCount || meshLodTriangleCounts.empty()) {
+    return invalidFile("draw groups");
+  }
+  for (size_t i = 0; i < drawGroupCount; ++i) {
+    const BakedDrawGroup &drawGroup = drawGroups[i];
+    if (!rangeInside(drawGroup.commands, drawCommandCount) || drawGroup.textureNum < 0 ||
+        drawGroup.textureNum > imageCount || drawGroup.paletteNum < -1 ||
+        drawGroup.paletteNum >= static_cast<int32_t>(paletteCount))
+    {
+      return invalidFile("draw groups");
+    }
+  }
+  for (size_t i = 0; i < drawCommandCount; ++i) {
+    if (!rangeInside(makeRange(drawCommands[i].firstIndex, drawCommands[i].count),
+                     mIndices.size()) ||
+        drawCommandLods[i] < 0 || drawCommandLods[i] >= meshLodTriangleCounts.size())
+    {
+      return invalidFile("draw commands");
+    }
+  }
+
+  /* cubic splines store in-tangent, value and out-tangent for every key */
+  for (size_t i = 0; i < clipCount; ++i) {
+    if (!rangeInside(clips[i].name, nameSize) || !rangeInside(clips[i].channels, channelCount)) {
+      return invalidFile("clips");
+    }
+  }
+  for (size_t i = 0; i < channelCount; ++i) {
+    const BakedChannel &channel = channels[i];
+    uint32_t valuesPerKey =
+        channel.interpolation == static_cast<uint32_t>(EInterpolationType::CUBICSPLINE) ? 3 : 1;
+    if (channel.targetNode < 0 || channel.targetNode >= nodeCount ||
+        channel.targetPath > static_cast<uint32_t>(ETargetPath::SCALE) ||
+        channel.interpolation > static_cast<uint32_t>(EInterpolationType::CUBICSPLINE) ||
+        channel.keyTimes.count == 0 || !rangeInside(channel.keyTimes, keyTimeCount) ||
+        !rangeInside(channel.keyValues, keyValueCount) ||
+        channel.keyValues.count != channel.keyTimes.count * valuesPerKey)
+    {
+      return invalidFile("channels");
+    }
+  }
+
+  for (size_t i = 0; i < imageCount; ++i) {
+    const BakedImage &image = images[i];
+    if ((image.components != 3 && image.components != 4) || image.width <= 0 ||
+        image.height <= 0 || !rangeInside(image.pixels, imagePixelCount) ||
+        image.pixels.count !=
+            static_cast<size_t>(image.width) * image.height * image.components)
+    {
+      return invalidFile("images");
+    }
+  }
+
+  /* the file is consistent, take over the records */
+  mRootNodeNum = info->rootNode;
+  mSkeleton.resize(nodeCount);
+  for (size_t nodeNum = 0; nodeNum < nodeCount; ++nodeNum) {
+    const BakedNode &node = nodes[nodeNum];
+    GltfSkeletonNode &skeletonNode = mSkeleton.at(nodeNum);
+    skeletonNode.name.assign(names + node.name.first, node.name.count);
+    skeletonNode.children.assign(nodeChildren + node.children.first,
+                                 nodeChildren + node.children.first + node.children.count);
+    skeletonNode.translation = node.translation;
+    skeletonNode.rotation = glm::quat(node.rotation.w, node.rotation.x, node.rotation.y,
+                                      node.rotation.z);
+    skeletonNode.scale = node.scale;
+  }
+  mRootNode = createNodeTree(mNodeList);
+  mNodeHeights.resize(mNodeList.size());
+  getNodeHeights(mRootNode);
+  mNodeToJoint.assign(nodeToJoint.begin(), nodeToJoint.end());
+
+  mPackedVertexData.stride = info->stride;
+  mPackedVertexData.quantizedPositions = info->quantizedPositions;
+  mPackedVertexData.positionOffset = info->positionOffset;
+  mPackedVertexData.positionScale = info->positionScale;
+  mPackedVertexData.packedNormals = info->packedNormals;
+  mPackedVertexData.packedTexCoords = info->packedTexCoords;
+  mPackedVertexData.packedWeights = info->packedWeights;
+  mPackedVertexData.jointType = info->jointType;
+  mPackedVertexData.normalOffset = info->normalOffset;
+  mPackedVertexData.texCoordOffset = info->texCoordOffset;
+  mPackedVertexData.jointOffset = info->jointOffset;
+  mPackedVertexData.weightOffset = info->weightOffset;
+  mPackedVertexData.secondJointSet = info->secondJointSet;
+  mPackedVertexData.joint1Offset = info->joint1Offset;
+  mPackedVertexData.weight1Offset = info->weight1Offset;
+  mPackedVertexData.maxPositionError = info->maxPositionError;
+  mPackedVertexData.maxNormalError = info->maxNormalError;
+  mPackedVertexData.maxTexCoordError = info->maxTexCoordError;
+  mPackedVertexData.maxWeightError = info->maxWeightError;
+  mIndexType = info->indexType;
+  mBoundingSphere = info->boundingSphere;
+
+  mPrimitives.resize(primitiveCount);
+  for (size_t i = 0; i < primitiveCount; ++i) {
+    const BakedPrimitive &primitive = primitives[i];
+    GltfPrimitive &gltfPrimitive = mPrimitives.at(i);
+    gltfPrimitive.meshNum = primitive.meshNum;
+    gltfPrimitive.textureNum = primitive.textureNum;
+    gltfPrimitive.firstIndex = primitive.firstIndex;
+    gltfPrimitive.indexCount = primitive.indexCount;
+    gltfPrimitive.baseVertex = primitive.baseVertex;
+    gltfPrimitive.vertexCount = primitive.vertexCount;
+    gltfPrimitive.lod = primitive.lod;
+    gltfPrimitive.jointInfluences = primitive.jointInfluences;
+    gltfPrimitive.paletteNum = primitive.paletteNum;
+  }
+
+  mDrawGroups.resize(drawGroupCount);
+  for (size_t i = 0; i < drawGroupCount; ++i) {
+    const BakedDrawGroup &drawGroup = drawGroups[i];
+    GltfDrawGroup &gltfDrawGroup = mDrawGroups.at(i);
+    gltfDrawGroup.textureNum = drawGroup.textureNum;
+    gltfDrawGroup.jointInfluences = drawGroup.jointInfluences;
+    gltfDrawGroup.paletteNum = drawGroup.paletteNum;
+    gltfDrawGroup.drawCommands.assign(
+        drawCommands + drawGroup.commands.first,
+        drawCommands + drawGroup.commands.first + drawGroup.commands.count);
+    gltfDrawGroup.drawCommandLods.assign(
+        drawCommandLods + drawGroup.commands.first,
+        drawCommandLods + drawGroup.commands.first + drawGroup.commands.count);
+  }
+  mMeshLodTriangleCounts.assign(meshLodTriangleCounts.begin(), meshLodTriangleCounts.end());
+  mJointInfluenceBuckets.assign(jointInfluenceBuckets.begin(), jointInfluenceBuckets.end());
+
+  mPalettes.resize(paletteCount);
+  for (size_t i = 0; i < paletteCount; ++i) {
+    mPalettes.at(i).assign(paletteJoints + palettes[i].first,
+                           paletteJoints + palettes[i].first + palettes[i].count);
+  }
+
+  /* only the names and lengths of the clips are read here */
+  for (size_t i = 0; i < clipCount; ++i) {
+    const BakedClip &clip = clips[i];
+    float clipEndTime = 0.0f;
+    if (clip.channels.count > 0) {
+      const BakedRange &firstKeyTimes = channels[clip.channels.first].keyTimes;
+      clipEndTime = keyTimes[firstKeyTimes.first + firstKeyTimes.count - 1];
+    }
+
+    auto channelLoader = [bakedFile, clip, channels, keyTimes, keyValues]() {
+      std::vector<std::shared_ptr<GltfAnimationChannel>> animChannels{};
+      for (uint32_t j = 0; j < clip.channels.count; ++j) {
+        const BakedChannel &channel = channels[clip.channels.first + j];
+        std::shared_ptr<GltfAnimationChannel> animChannel =
+            std::make_shared<GltfAnimationChannel>();
+        animChannel->loadPackedChannelData(
+            channel.targetNode,
+            static_cast<ETargetPath>(channel.targetPath),
+            static_cast<EInterpolationType>(channel.interpolation),
+            std::vector<float>(keyTimes + channel.keyTimes.first,
+                               keyTimes + channel.keyTimes.first + channel.keyTimes.count),
+            std::vector<glm::vec4>(
+                keyValues + channel.keyValues.first,
+                keyValues + channel.keyValues.first + channel.keyValues.count));
+        animChannels.push_back(animChannel);
+      }
+      return animChannels;
+    };
+    mAnimClips.push_back(std::make_shared<GltfAnimationClip>(
+        std::string(names + clip.name.first, clip.name.count), clipEndTime, channelLoader));
+  }
+
+  mImages.resize(imageCount);
+  for (size_t i = 0; i < imageCount; ++i) {
+    const BakedImage &image = images[i];
+    mImages.at(i).width = image.width;
+    mImages.at(i).height = image.height;
+    mImages.at(i).components = image.components;
+    mImages.at(i).pixels.assign(imagePixels + image.pixels.first,
+                                imagePixels + image.pixels.first + image.pixels.count);
+  }
+
+  renderData.rdGltfMaxJointInfluences = info->maxJointInfluences;
+  renderData.rdGltfPruneError = info->pruneError;
+  renderData.rdGltfExportedACMR = info->exportedACMR;
+  renderData.rdGltfACMR = info->acmr;
+  renderData.rdGltfTransformedVertices = info->transformedVertices;
+
+  Logger::log(1,
+              "%s: baked model '%s' has %i nodes, %i vertices and %i clips in %i bytes\n",
+              __FUNCTION__,
+              bakedFilename.c_str(),
+              nodeCount,
+              vertexCount,
+              clipCount,
+              bakedFile->getFileSize());
+  return true;
+}
+
+/* Depth first walk over the scene. The nodes of skinned meshes are not part of the
+ * node tree, their transform is ignored as the joints place the vertices.
+ */
+bool GltfModel::getPrimitives() {
+  mPrimitives.clear();
+  mPositions.clear();
+  mNormals.clear();
+  mTexCoords.clear();
+  mJointVec.clear();
+  mWeightVec.clear();
+  mJointVec1.clear();
+  mWeightVec1.clear();
+  mIndices.clear();
+
+  const std::vector<int> &sceneNodes = mModel->scenes.at(0).nodes;
+  std::vector<int> nodeStack(sceneNodes.rbegin(), sceneNodes.rend());
+  std::vector<std::pair<int, const tinygltf::Primitive *>> scenePrimitives{};
+  while (!nodeStack.empty()) {
+    int nodeNum = nodeStack.back();
+    nodeStack.pop_back();
+
+    const tinygltf::Node &node = mModel->nodes.at(nodeNum);
+    nodeStack.insert(nodeStack.end(), node.children.rbegin(), node.children.rend());
+    if (node.mesh < 0) {
+      continue;
+    }
+
+    for (const auto &primitive : mModel->meshes.at(node.mesh).primitives) {
+      if (primitive.mode != TINYGLTF_MODE_TRIANGLES) {
+        Logger::log(1,
+                    "%s: skipping primitive of mesh %i with draw mode %i\n",
+                    __FUNCTION__,
+                    node.mesh,
+                    primitive.mode);
+        continue;
+      }
+      if (primitive.attributes.count("POSITION") == 0) {
+        Logger::log(
+            1, "%s: skipping primitive of mesh %i without positions\n", __FUNCTION__, node.mesh);
+        continue;
+      }
+
+      /* rigid meshes follow their node with the full weight, joints are added in scene order */
+      if (node.skin < 0) {
+        if (nodeNum >= mNodeList.size() || !mNodeList.at(nodeNum)) {
+          Logger::log(1,
+                      "%s: skipping mesh %i, node %i is not in the node tree\n",
+                      __FUNCTION__,
+                      node.mesh,
+                      nodeNum);
+          continue;
+        }
+        if (mNodeToJoint.at(nodeNum) < 0) {
+          mNodeToJoint.at(nodeNum) = mInverseBindMatrices.size();
+          mInverseBindMatrices.push_back(glm::inverse(mNodeList.at(nodeNum)->getNodeMatrix()));
+        }
+      }
+      scenePrimitives.push_back({nodeNum, &primitive});
+    }
+  }
+
+  /* the primitives are read in parallel, the results are appended in scene order */
+  std::vector<GltfPrimitiveData> primitiveDatas(scenePrimitives.size());
+  std::vector<char> primitivesRead(scenePrimitives.size(), false);
+  parallelFor(scenePrimitives.size(), [&](size_t i) {
+    int nodeNum = scenePrimitives.at(i).first;
+    primitivesRead.at(i) = readPrimitive(nodeNum,
+                                         mModel->nodes.at(nodeNum).mesh,
+                                         *scenePrimitives.at(i).second,
+                                         primitiveDatas.at(i));
+  });
+  for (size_t i = 0; i < primitiveDatas.size(); ++i) {
+    if (!primitivesRead.at(i)) {
+      return false;
+    }
+    appendPrimitive(primitiveDatas.at(i));
+    primitiveDatas.at(i) = GltfPrimitiveData{};
+  }
+
+  if (mPrimitives.empty()) {
+    Logger::log(1, "%s error: model has no triangles\n", __FUNCTION__);
+    return false;
+  }
+
+  /* the indices are relative to the base vertex, 16 bit are enough for most primitives */
+  mIndexType = GL_UNSIGNED_SHORT;
+  for (const auto &primitive : mPrimitives) {
+    if (primitive.vertexCount > std::numeric_limits<uint16_t>::max() + 1) {
+      mIndexType = GL_UNSIGNED_INT;
+    }
+  }
+
+  Logger::log(1,
+              "%s: loaded %i primitives of %i meshes, %i vertices and %i triangles\n",
+              __FUNCTION__,
+              mPrimitives.size(),
+              mModel->meshes.size(),
+              mPositions.size(),
+              mIndices.size() / 3);
+  return true;
+}
+
+/* Every primitive gets simplified copies for the mesh LODs. The copies have their
+ * own vertices, with fewer joint influences per vertex for every LOD.
+ */
+void GltfModel::createMeshLods() {
+  size_t primitiveCount = mPrimitives.size();
+  mMeshLodTriangleCounts.assign(meshLodTriangleRatios.size() + 1, 0);
+
+  /* the primitives are simplified in parallel, the copies are appended in order */
+  std::vector<std::vector<std::vector<uint32_t>>> primitiveLodIndices(primitiveCount);
+  parallelFor(primitiveCount, [&](size_t primitiveNum) {
+    const GltfPrimitive &primitive = mPrimitives.at(primitiveNum);
+    auto vertexRange = [&](const auto &vertices) {
+      return std::vector<typename std::decay_t<decltype(vertices)>::value_type>(
+          vertices.begin() + primitive.baseVertex,
+          vertices.begin() + primitive.baseVertex + primitive.vertexCount);
+    };
+    std::vector<uint32_t> indices(mIndices.begin() + primitive.firstIndex,
+                                  mIndices.begin() + primitive.firstIndex + primitive.indexCount);
+    std::vector<size_t> targetTriangleCounts{};
+    for (float ratio : meshLodTriangleRatios) {
+      targetTriangleCounts.push_back(static_cast<size_t>(primitive.indexCount / 3 * ratio));
+    }
+
+    primitiveLodIndices.at(primitiveNum) =
+        MeshSimplifier::simplify(indices,
+                                 vertexRange(mPositions),
+                                 vertexRange(mNormals),
+                                 vertexRange(mTexCoords),
+                                 vertexRange(mJointVec),
+                                 vertexRange(mWeightVec),
+                                 targetTriangleCounts,
+                                 meshLodMaxError);
+  });
+
+  for (size_t primitiveNum = 0; primitiveNum < primitiveCount; ++primitiveNum) {
+    GltfPrimitive primitive = mPrimitives.at(primitiveNum);
+    mMeshLodTriangleCounts.at(0) += primitive.indexCount / 3;
+    std::vector<std::vector<uint32_t>> &lodIndices = primitiveLodIndices.at(primitiveNum);
+
+    for (int lod = 1; lod <= lodIndices.size(); ++lod) {
+      /* the used vertices are copied, the indices are relative to the copy */
+      std::vector<uint32_t> &lodPrimitiveIndices = lodIndices.at(lod - 1);
+      std::vector<int> lodVertices(primitive.vertexCount, -1);
+      GltfPrimitive lodPrimitive = primitive;
+      lodPrimitive.lod = lod;
+      lodPrimitive.firstIndex = mIndices.size();
+      lodPrimitive.indexCount = lodPrimitiveIndices.size();
+      lodPrimitive.baseVertex = mPositions.size();
+      lodPrimitive.vertexCount = 0;
+
+      int maxInfluences = std::max(4 - lod, 1);
+      for (uint32_t &index : lodPrimitiveIndices) {
+        if (lodVertices.at(index) < 0) {
+          uint32_t vertex = primitive.baseVertex + index;
+          lodVertices.at(index) = lodPrimitive.vertexCount++;
+          mPositions.push_back(mPositions.at(vertex));
+          mNormals.push_back(mNormals.at(vertex));
+          mTexCoords.push_back(mTexCoords.at(vertex));
+          glm::tvec4<uint16_t> joints0 = mJointVec.at(vertex);
+          glm::vec4 weights0 = mWeightVec.at(vertex);
+          glm::tvec4<uint16_t> joints1 = mJointVec1.at(vertex);
+          glm::vec4 weights1 = mWeightVec1.at(vertex);
+          pruneInfluences(joints0, weights0, joints1, weights1, maxInfluences, 0.0f);
+          mJointVec.push_back(joints0);
+          mWeightVec.push_back(weights0);
+          mJointVec1.push_back(joints1);
+          mWeightVec1.push_back(weights1);
+        }
+        index = lodVertices.at(index);
+      }
+      mIndices.insert(mIndices.end(), lodPrimitiveIndices.begin(), lodPrimitiveIndices.end());
+      mPrimitives.push_back(lodPrimitive);
+      mMeshLodTriangleCounts.at(lod) += lodPrimitive.indexCount / 3;
+    }
+  }
+
+  for (int lod = 0; lod < mMeshLodTriangleCounts.size(); ++lod) {
+    Logger::log(1,
+                "%s: mesh LOD %i has %i triangles\n",
+                __FUNCTION__,
+                lod,
+                mMeshLodTriangleCounts.at(lod));
+  }
+}
+
+/* Influences below the threshold and after the maximum count are dropped, the
+ * rest is sorted by weight. The error is the largest distance between the pruned
+ * and the exported skinning of a vertex over all sample poses.
+ */
+float GltfModel::pruneJointInfluences(int maxInfluences) {
+  std::vector<glm::tvec4<uint16_t>> exportedJoints0 = mJointVec;
+  std::vector<glm::vec4> exportedWeights0 = mWeightVec;
+  std::vector<glm::tvec4<uint16_t>> exportedJoints1 = mJointVec1;
+  std::vector<glm::vec4> exportedWeights1 = mWeightVec1;
+
+  int maxExportedInfluences = 0;
+  std::vector<size_t> prunedVertices{};
+  for (size_t i = 0; i < mWeightVec.size(); ++i) {
+    maxExportedInfluences = std::max(maxExportedInfluences,
+                                     getInfluenceCount(mWeightVec.at(i), mWeightVec1.at(i)));
+    pruneInfluences(mJointVec.at(i),
+                    mWeightVec.at(i),
+                    mJointVec1.at(i),
+                    mWeightVec1.at(i),
+                    maxInfluences,
+                    minInfluenceWeight);
+    if (getInfluenceCount(mWeightVec.at(i), mWeightVec1.at(i)) <
+        getInfluenceCount(exportedWeights0.at(i), exportedWeights1.at(i)))
+    {
+      prunedVertices.push_back(i);
+    }
+  }
+
+  /* only the vertices that lost influences can move */
+  float maxError = 0.0f;
+  if (!prunedVertices.empty()) {
+    for (const auto &palette : getSamplePalettes()) {
+      for (size_t i : prunedVertices) {
+        glm::vec4 position = glm::vec4(mPositions.at(i), 1.0f);
+        glm::mat4 exportedSkin = getSkinMatrix(palette,
+                                               exportedJoints0.at(i),
+                                               exportedWeights0.at(i),
+                                               exportedJoints1.at(i),
+                                               exportedWeights1.at(i));
+        glm::mat4 prunedSkin = getSkinMatrix(
+            palette, mJointVec.at(i), mWeightVec.at(i), mJointVec1.at(i), mWeightVec1.at(i));
+        maxError = std::max(maxError, glm::length(glm::vec3(exportedSkin * position) -
+                                                  glm::vec3(prunedSkin * position)));
+      }
+    }
+  }
+
+  Logger::log(1,
+              "%s: up to %i influences, %i of %i vertices pruned to at most %i, max position "
+              "error %f\n",
+              __FUNCTION__,
+              maxExportedInfluences,
+              prunedVertices.size(),
+              mWeightVec.size(),
+              maxInfluences,
+              maxError);
+  return maxError;
+}
+
+/* The clips are sampled in parallel, every clip poses its own copy of the node
+ * tree starting from the rest pose.
+ */
+std::vector<std::vector<glm::mat4>> GltfModel::getSamplePalettes() {
+  auto getPalette = [&](const std::vector<std::shared_ptr<GltfNode>> &nodeList) {
+    std::vector<glm::mat4> palette(mInverseBindMatrices.size(), glm::mat4(1.0f));
+    for (size_t nodeNum = 0; nodeNum < nodeList.size(); ++nodeNum) {
+      int joint = mNodeToJoint.at(nodeNum);
+      if (joint >= 0 && nodeList.at(nodeNum)) {
+        palette.at(joint) = nodeList.at(nodeNum)->getNodeMatrix() *
+                            mInverseBindMatrices.at(joint);
+      }
+    }
+    return palette;
+  };
+
+  /* a copy of the node tree, the template keeps its rest pose */
+  std::vector<std::shared_ptr<GltfNode>> restNodeList{};
+  std::shared_ptr<GltfNode> restRootNode = createNodeTree(restNodeList);
+  restRootNode->updateNodeAndChildMatrices();
+
+  std::vector<std::vector<std::vector<glm::mat4>>> clipPalettes(mAnimClips.size());
+  parallelFor(mAnimClips.size(), [&](size_t clipNum) {
+    std::vector<std::shared_ptr<GltfNode>> nodeList{};
+    std::shared_ptr<GltfNode> rootNode = createNodeTree(nodeList);
+    std::vector<bool> allNodes(nodeList.size(), true);
+    const std::shared_ptr<GltfAnimationClip> &clip = mAnimClips.at(clipNum);
+    for (int i = 0; i < pruneErrorSamplesPerClip; ++i) {
+      float time = clip->getClipEndTime() * i / (pruneErrorSamplesPerClip - 1);
+      clip->setAnimationFrame(nodeList, allNodes, time);
+      rootNode->updateNodeAndChildMatrices();
+      clipPalettes.at(clipNum).push_back(getPalette(nodeList));
+    }
+  });
+
+  std::vector<std::vector<glm::mat4>> palettes{getPalette(restNodeList)};
+  for (auto &clipPalette : clipPalettes) {
+    palettes.insert(palettes.end(), clipPalette.begin(), clipPalette.end());
+  }
+  return palettes;
+}
+
+/* Only the joints with a weight on a vertex keep their place in the palette, the
+ * others lose their joint number. Their nodes are still animated, e.g. as the
+ * effector of the inverse kinematics, but no joint matrix is calculated for them.
+ */
+void GltfModel::compactJointPalette() {
+  std::vector<bool> usedJoints(mInverseBindMatrices.size(), false);
+  for (size_t i = 0; i < mWeightVec.size(); ++i) {
+    for (int j = 0; j < 4; ++j) {
+      if (mWeightVec.at(i)[j] > 0.0f) {
+        usedJoints.at(mJointVec.at(i)[j]) = true;
+      }
+      if (mWeightVec1.at(i)[j] > 0.0f) {
+        usedJoints.at(mJointVec1.at(i)[j]) = true;
+      }
+    }
+  }
+
+  std::vector<int> jointRemap(mInverseBindMatrices.size(), -1);
+  std::vector<glm::mat4> inverseBindMatrices{};
+  for (int joint = 0; joint < usedJoints.size(); ++joint) {
+    if (usedJoints.at(joint)) {
+      jointRemap.at(joint) = inverseBindMatrices.size();
+      inverseBindMatrices.push_back(mInverseBindMatrices.at(joint));
+    }
+  }
+  if (inverseBindMatrices.empty() || inverseBindMatrices.size() == mInverseBindMatrices.size()) {
+    return;
+  }
+
+  /* the joints without weight point to the first joint of the palette */
+  for (size_t i = 0; i < mWeightVec.size(); ++i) {
+    for (int j = 0; j < 4; ++j) {
+      mJointVec.at(i)[j] = mWeightVec.at(i)[j] > 0.0f ? jointRemap.at(mJointVec.at(i)[j]) : 0;
+      mJointVec1.at(i)[j] = mWeightVec1.at(i)[j] > 0.0f ? jointRemap.at(mJointVec1.at(i)[j])
+                                                        : 0;
+    }
+  }
+  for (int &joint : mNodeToJoint) {
+    if (joint >= 0) {
+      joint = jointRemap.at(joint);
+    }
+  }
+
+  Logger::log(1,
+              "%s: palette compacted from %i to %i joints\n",
+              __FUNCTION__,
+              mInverseBindMatrices.size(),
+              inverseBindMatrices.size());
+  mInverseBindMatrices = inverseBindMatrices;
+}
+
+/* Rebuilds the vertex data with the triangles of every primitive split into parts,
+ * numbered from 0 per primitive. Vertices shared by several parts are copied, empty
+ * parts are dropped. Returns the source primitive and the part of every new primitive.
+ */
+std::vector<std::pair<int, int>> GltfModel::splitPrimitives(
+    const std::vector<std::vector<int>> &triangleParts) {
+  std::vector<glm::vec3> positions{};
+  std::vector<glm::vec3> normals{};
+  std::vector<glm::vec2> texCoords{};
+  std::vector<glm::tvec4<uint16_t>> joints{};
+  std::vector<glm::vec4> weights{};
+  std::vector<glm::tvec4<uint16_t>> joints1{};
+  std::vector<glm::vec4> weights1{};
+  std::vector<uint32_t> indices{};
+  std::vector<GltfPrimitive> primitives{};
+  std::vector<std::pair<int, int>> primitiveParts{};
+
+  /* the full resolution primitives go first, their vertices are a prefix of the vertex data */
+  std::vector<int> primitiveOrder(mPrimitives.size());
+  std::iota(primitiveOrder.begin(), primitiveOrder.end(), 0);
+  std::stable_sort(primitiveOrder.begin(), primitiveOrder.end(), [&](int a, int b) {
+    return mPrimitives.at(a).lod < mPrimitives.at(b).lod;
+  });
+
+  for (int primitiveNum : primitiveOrder) {
+    const GltfPrimitive &primitive = mPrimitives.at(primitiveNum);
+    const std::vector<int> &parts = triangleParts.at(primitiveNum);
+    int partCount = parts.empty() ? 0 : *std::max_element(parts.begin(), parts.end()) + 1;
+
+    for (int part = 0; part < partCount; ++part) {
+      GltfPrimitive partPrimitive = primitive;
+      partPrimitive.firstIndex = indices.size();
+      partPrimitive.baseVertex = positions.size();
+      partPrimitive.vertexCount = 0;
+
+      std::vector<int> partVertices(primitive.vertexCount, -1);
+      for (size_t triangle = 0; triangle < parts.size(); ++triangle) {
+        if (parts.at(triangle) != part) {
+          continue;
+        }
+        for (int i = 0; i < 3; ++i) {
+          uint32_t index = mIndices.at(primitive.firstIndex + triangle * 3 + i);
+          if (partVertices.at(index) < 0) {
+            uint32_t vertex = primitive.baseVertex + index;
+            partVertices.at(index) = partPrimitive.vertexCount++;
+            positions.push_back(mPositions.at(vertex));
+            normals.push_back(mNormals.at(vertex));
+            texCoords.push_back(mTexCoords.at(vertex));
+            joints.push_back(mJointVec.at(vertex));
+            weights.push_back(mWeightVec.at(vertex));
+            joints1.push_back(mJointVec1.at(vertex));
+            weights1.push_back(mWeightVec1.at(vertex));
+          }
+          indices.push_back(partVertices.at(index));
+        }
+      }
+
+      partPrimitive.indexCount = indices.size() - partPrimitive.firstIndex;
+      if (partPrimitive.indexCount > 0) {
+        primitives.push_back(partPrimitive);
+        primitiveParts.emplace_back(primitiveNum, part);
+      }
+    }
+  }
+
+  mPositions = positions;
+  mNormals = normals;
+  mTexCoords = texCoords;
+  mJointVec = joints;
+  mWeightVec = weights;
+  mJointVec1 = joints1;
+  mWeightVec1 = weights1;
+  mIndices = indices;
+  mPrimitives = primitives;
+  return primitiveParts;
+}
+
+/* A triangle is skinned with the most influences of its vertices. */
+void GltfModel::splitInfluenceBuckets() {
+  std::vector<std::vector<int>> triangleBuckets(mPrimitives.size());
+  for (int primitiveNum = 0; primitiveNum < mPrimitives.size(); ++primitiveNum) {
+    const GltfPrimitive &primitive = mPrimitives.at(primitiveNum);
+    std::vector<int> &buckets = triangleBuckets.at(primitiveNum);
+    buckets.resize(primitive.indexCount / 3, 0);
+    for (size_t triangle = 0; triangle < buckets.size(); ++triangle) {
+      int influences = 1;
+      for (int i = 0; i < 3; ++i) {
+        size_t index = primitive.firstIndex + triangle * 3 + i;
+        uint32_t vertex = primitive.baseVertex + mIndices.at(index);
+        influences = std::max(influences,
+                              getInfluenceCount(mWeightVec.at(vertex), mWeightVec1.at(vertex)));
+      }
+      /* the index into jointInfluenceBuckets */
+      buckets.at(triangle) = influences <= 1 ? 0 : influences <= 2 ? 1 : influences <= 4 ? 2 : 3;
+    }
+  }
+
+  std::vector<std::pair<int, int>> primitiveParts = splitPrimitives(triangleBuckets);
+  for (int i = 0; i < mPrimitives.size(); ++i) {
+    mPrimitives.at(i).jointInfluences = jointInfluenceBuckets.at(primitiveParts.at(i).second);
+  }
+
+  mJointInfluenceBuckets.clear();
+  for (int bucket : jointInfluenceBuckets) {
+    int vertexCount = 0;
+    for (const auto &primitive : mPrimitives) {
+      if (primitive.lod == 0 && primitive.jointInfluences == bucket) {
+        vertexCount += primitive.vertexCount;
+      }
+    }
+    bool used = std::any_of(mPrimitives.begin(), mPrimitives.end(), [&](const auto &primitive) {
+      return primitive.jointInfluences == bucket;
+    });
+    if (used) {
+      mJointInfluenceBuckets.push_back(bucket);
+    }
+    Logger::log(1,
+                "%s: %i vertices of LOD 0 skinned with %i joints\n",
+                __FUNCTION__,
+                vertexCount,
+                bucket);
+  }
+}
+
+/* Primitives are split into sub-meshes of at most maxPaletteJoints joints if the
+ * palette is larger. The triangles are added in order, a sub-mesh is closed when
+ * the joints of the next triangle do not fit anymore.
+ */
+void GltfModel::splitJointPalettes() {
+  mPalettes.clear();
+  if (getJointMatrixSize() <= maxPaletteJoints) {
+    return;
+  }
+
+  std::vector<std::vector<int>> triangleParts(mPrimitives.size());
+  /* the joints of every part of every primitive */
+  std::vector<std::vector<std::vector<int>>> partJoints(mPrimitives.size());
+  for (int primitiveNum = 0; primitiveNum < mPrimitives.size(); ++primitiveNum) {
+    const GltfPrimitive &primitive = mPrimitives.at(primitiveNum);
+    std::vector<int> &parts = triangleParts.at(primitiveNum);
+    std::vector<std::vector<int>> &palettes = partJoints.at(primitiveNum);
+    std::vector<bool> inPalette(getJointMatrixSize(), false);
+
+    for (size_t triangle = 0; triangle < primitive.indexCount / 3; ++triangle) {
+      std::vector<int> triangleJoints{};
+      for (int i = 0; i < 3; ++i) {
+        uint32_t vertex =
+            primitive.baseVertex + mIndices.at(primitive.firstIndex + triangle * 3 + i);
+        for (int j = 0; j < 4; ++j) {
+          if (mWeightVec.at(vertex)[j] > 0.0f) {
+            triangleJoints.push_back(mJointVec.at(vertex)[j]);
+          }
+          if (mWeightVec1.at(vertex)[j] > 0.0f) {
+            triangleJoints.push_back(mJointVec1.at(vertex)[j]);
+          }
+        }
+      }
+      std::sort(triangleJoints.begin(), triangleJoints.end());
+      triangleJoints.erase(std::unique(triangleJoints.begin(), triangleJoints.end()),
+                           triangleJoints.end());
+
+      int newJoints = std::count_if(triangleJoints.begin(),
+                                    triangleJoints.end(),
+                                    [&](int joint) { return !inPalette.at(joint); });
+      if (palettes.empty() || palettes.back().size() + newJoints > maxPaletteJoints) {
+        palettes.emplace_back();
+        std::fill(inPalette.begin(), inPalette.end(), false);
+      }
+      for (int joint : triangleJoints) {
+        if (!inPalette.at(joint)) {
+          inPalette.at(joint) = true;
+          palettes.back().push_back(joint);
+        }
+      }
+      parts.push_back(palettes.size() - 1);
+    }
+  }
+
+  std::vector<std::pair<int, int>> primitiveParts = splitPrimitives(triangleParts);
+  std::vector<std::vector<int>> primitiveJoints{};
+  for (const auto &primitivePart : primitiveParts) {
+    primitiveJoints.push_back(partJoints.at(primitivePart.first).at(primitivePart.second));
+  }
+  std::vector<int> paletteNums = mergePalettes(primitiveJoints, getJointMatrixSize(), mPalettes);
+  for (int i = 0; i < mPrimitives.size(); ++i) {
+    mPrimitives.at(i).paletteNum = paletteNums.at(i);
+  }
+
+  Logger::log(1,
+              "%s: %i joints split into %i sub-mesh palettes, merged into %i\n",
+              __FUNCTION__,
+              getJointMatrixSize(),
+              primitiveJoints.size(),
+              mPalettes.size());
+}
+
+/* Joint numbers in the palette of the sub-mesh, the ones without weight are 0. */
+void GltfModel::getPaletteJoints(std::vector<glm::tvec4<uint16_t>> &joints,
+                                 std::vector<glm::tvec4<uint16_t>> &joints1) {
+  if (mPalettes.empty()) {
+    return;
   }
 
-  glGenVertexArrays(1, &mVAO);
-  glBindVertexArray(mVAO);
-
-  /* extract position, normal, texture coords, and indices */
-  createVertexBuffers();
-  createIndexBuffer();
+  std::vector<int> paletteIndices(getJointMatrixSize(), 0);
+  for (const auto &primitive : mPrimitives) {
+    const std::vector<int> &palette = mPalettes.at(primitive.paletteNum);
+    for (int i = 0; i < palette.size(); ++i) {
+      paletteIndices.at(palette.at(i)) = i;
+    }
 
-  glBindVertexArray(0);
+    for (GLuint i = 0; i < primitive.vertexCount; ++i) {
+      size_t vertex = primitive.baseVertex + i;
+      for (int j = 0; j < 4; ++j) {
+        joints.at(vertex)[j] =
+            mWeightVec.at(vertex)[j] > 0.0f ? paletteIndices.at(joints.at(vertex)[j]) : 0;
+        joints1.at(vertex)[j] =
+            mWeightVec1.at(vertex)[j] > 0.0f ? paletteIndices.at(joints1.at(vertex)[j]) : 0;
+      }
+    }
+  }
+}
 
-  /* extract joints, weights, and invers bind matrices*/
-  getJointData();
-  getWeightData();
-  getInvBindMatrices();
+/* The primitives are optimized one by one, the vertices stay in the range of their primitive. */
+void GltfModel::optimizePrimitives() {
+  for (const auto &primitive : mPrimitives) {
+    std::vector<uint32_t> indices(mIndices.begin() + primitive.firstIndex,
+                                  mIndices.begin() + primitive.firstIndex + primitive.indexCount);
+    std::vector<glm::vec3> positions(
+        mPositions.begin() + primitive.baseVertex,
+        mPositions.begin() + primitive.baseVertex + primitive.vertexCount);
+
+    std::vector<size_t> clusters =
+        MeshOptimizer::optimizeVertexCache(indices, primitive.vertexCount);
+    MeshOptimizer::optimizeOverdraw(indices, positions, clusters);
+    std::vector<uint32_t> remap =
+        MeshOptimizer::optimizeVertexFetch(indices, primitive.vertexCount);
+
+    MeshOptimizer::remapVertices(mPositions, primitive.baseVertex, remap);
+    MeshOptimizer::remapVertices(mNormals, primitive.baseVertex, remap);
+    MeshOptimizer::remapVertices(mTexCoords, primitive.baseVertex, remap);
+    MeshOptimizer::remapVertices(mJointVec, primitive.baseVertex, remap);
+    MeshOptimizer::remapVertices(mWeightVec, primitive.baseVertex, remap);
+    MeshOptimizer::remapVertices(mJointVec1, primitive.baseVertex, remap);
+    MeshOptimizer::remapVertices(mWeightVec1, primitive.baseVertex, remap);
+    std::copy(indices.begin(), indices.end(), mIndices.begin() + primitive.firstIndex);
 
-  /* build model tree */
-  renderData.rdModelNodeCount = mModel->nodes.size();
-  int rootNode = mModel->scenes.at(0).nodes.at(0);
+    Logger::log(1,
+                "%s: primitive of mesh %i split into %i clusters\n",
+                __FUNCTION__,
+                primitive.meshNum,
+                clusters.size());
+  }
+}
 
-  Logger::log(1,
-              "%s: model has %i nodes, root node is %i\n",
-              __FUNCTION__,
-              renderData.rdModelNodeCount,
-              rootNode);
+/* Simulated cost of the full resolution primitives with the packed vertex size. */
+MeshStats GltfModel::getMeshStats(const std::vector<GltfPrimitive> &primitives,
+                                  const std::vector<uint32_t> &indices) {
+  MeshStats stats{};
+  for (const auto &primitive : primitives) {
+    if (primitive.lod > 0) {
+      continue;
+    }
+    std::vector<uint32_t> primitiveIndices(
+        indices.begin() + primitive.firstIndex,
+        indices.begin() + primitive.firstIndex + primitive.indexCount);
+    stats.add(MeshOptimizer::analyze(
+        primitiveIndices, primitive.vertexCount, mPackedVertexData.stride));
+  }
+  return stats;
+}
 
-  mNodeList.resize(renderData.rdModelNodeCount);
+bool GltfModel::readPrimitive(int nodeNum,
+                              int meshNum,
+                              const tinygltf::Primitive &primitive,
+                              GltfPrimitiveData &primitiveData) {
+  auto positionAttrib = primitive.attributes.find("POSITION");
+  int vertexCount = mModel->accessors.at(positionAttrib->second).count;
+  std::vector<glm::vec3> &positions = primitiveData.positions;
+  std::vector<glm::vec3> &normals = primitiveData.normals;
+  std::vector<glm::vec2> &texCoords = primitiveData.texCoords;
+  std::vector<glm::tvec4<uint16_t>> &joints = primitiveData.joints;
+  std::vector<glm::vec4> &weights = primitiveData.weights;
+  std::vector<glm::tvec4<uint16_t>> &joints1 = primitiveData.joints1;
+  std::vector<glm::vec4> &weights1 = primitiveData.weights1;
+  std::vector<uint32_t> &indices = primitiveData.indices;
+  positions.assign(vertexCount, glm::vec3(0.0f));
+  normals.assign(vertexCount, glm::vec3(0.0f, 0.0f, 1.0f));
+  texCoords.assign(vertexCount, glm::vec2(0.0f));
+  joints.assign(vertexCount, glm::tvec4<uint16_t>(0));
+  weights.assign(vertexCount, glm::vec4(1.0f, 0.0f, 0.0f, 0.0f));
+  /* the second set holds influences five to eight */
+  joints1.assign(vertexCount, glm::tvec4<uint16_t>(0));
+  weights1.assign(vertexCount, glm::vec4(0.0f));
+  primitiveData.meshNum = meshNum;
+  primitiveData.materialNum = primitive.material;
+
+  if (!readPrimitiveAttribute(*mGltfFile, primitive, "POSITION", positions) ||
+      !readPrimitiveAttribute(*mGltfFile, primitive, "NORMAL", normals) ||
+      !readPrimitiveAttribute(*mGltfFile, primitive, "TEXCOORD_0", texCoords) ||
+      !readPrimitiveAttribute(*mGltfFile, primitive, "JOINTS_0", joints) ||
+      !readPrimitiveAttribute(*mGltfFile, primitive, "WEIGHTS_0", weights) ||
+      !readPrimitiveAttribute(*mGltfFile, primitive, "JOINTS_1", joints1) ||
+      !readPrimitiveAttribute(*mGltfFile, primitive, "WEIGHTS_1", weights1))
+  {
+    Logger::log(1, "%s error: could not read the vertices of mesh %i\n", __FUNCTION__, meshNum);
+    return false;
+  }
 
-  mRootNode = GltfNode::createRoot(rootNode);
-  mNodeList.at(rootNode) = mRootNode;
-  getNodeData(mRootNode);
-  getNodes(mRootNode);
+  /* move the vertices into the bind space of the joints in the palette */
+  const tinygltf::Node &node = mModel->nodes.at(nodeNum);
+  glm::mat4 vertexTransform = glm::mat4(1.0f);
+  if (node.skin >= 0) {
+    const std::vector<int> &skinJoints = mModel->skins.at(node.skin).joints;
+    if (primitive.attributes.count("JOINTS_0") == 0 ||
+        primitive.attributes.count("WEIGHTS_0") == 0)
+    {
+      Logger::log(
+          1, "%s error: skinned mesh %i has no joints or weights\n", __FUNCTION__, meshNum);
+      return false;
+    }
 
-  /* init skeleton */
-  mSkeletonMesh = std::make_shared<OGLMesh>();
-  mSkeletonMesh->vertices.resize(mModel->nodes.size() * 2);
+    for (auto *jointSet : {&joints, &joints1}) {
+      for (auto &joint : *jointSet) {
+        for (int i = 0; i < 4; ++i) {
+          if (joint[i] >= skinJoints.size()) {
+            Logger::log(
+                1, "%s error: invalid joint %i in mesh %i\n", __FUNCTION__, joint[i], meshNum);
+            return false;
+          }
+          joint[i] = mNodeToJoint.at(skinJoints.at(joint[i]));
+        }
+      }
+    }
+    vertexTransform = mSkinBindShapes.at(node.skin);
+  }
+  else {
+    /* the joint of the node was added by getPrimitives() */
+    int joint = mNodeToJoint.at(nodeNum);
+    std::fill(joints.begin(), joints.end(), glm::tvec4<uint16_t>(joint, 0, 0, 0));
+    std::fill(weights.begin(), weights.end(), glm::vec4(1.0f, 0.0f, 0.0f, 0.0f));
+    std::fill(joints1.begin(), joints1.end(), glm::tvec4<uint16_t>(0));
+    std::fill(weights1.begin(), weights1.end(), glm::vec4(0.0f));
+    vertexTransform = glm::inverse(mInverseBindMatrices.at(joint));
+  }
 
-  mRootNode->printTree();
+  if (!matricesEqual(vertexTransform, glm::mat4(1.0f))) {
+    glm::mat3 normalTransform = glm::transpose(glm::inverse(glm::mat3(vertexTransform)));
+    for (int i = 0; i < vertexCount; ++i) {
+      positions.at(i) = glm::vec3(vertexTransform * glm::vec4(positions.at(i), 1.0f));
+      normals.at(i) = glm::normalize(normalTransform * normals.at(i));
+    }
+  }
 
-  /* extract animation data */
-  getAnimations();
-  renderData.rdAnimClipSize = mAnimClips.size();
+  indices.resize(vertexCount);
+  if (primitive.indices >= 0) {
+    indices = readAccessor<uint32_t>(*mGltfFile, primitive.indices, 1);
+  }
+  else {
+    std::iota(indices.begin(), indices.end(), 0);
+  }
+  if (indices.empty() ||
+      *std::max_element(indices.begin(), indices.end()) >= static_cast<uint32_t>(vertexCount))
+  {
+    Logger::log(1, "%s error: invalid indices in mesh %i\n", __FUNCTION__, meshNum);
+    return false;
+  }
 
-  renderData.rdGltfTriangleCount = getTriangleCount();
+  /* exporters often write shared vertices once per triangle */
+  std::vector<std::string> vertexKeys(vertexCount);
+  for (int i = 0; i < vertexCount; ++i) {
+    vertexKeys.at(i) = getVertexKey(positions.at(i),
+                                    normals.at(i),
+                                    texCoords.at(i),
+                                    joints.at(i),
+                                    weights.at(i),
+                                    joints1.at(i),
+                                    weights1.at(i));
+  }
+  std::vector<uint32_t> weldRemap = MeshOptimizer::weldVertices(indices, vertexKeys);
+  int weldedVertexCount = *std::max_element(weldRemap.begin(), weldRemap.end()) + 1;
+  if (weldedVertexCount < vertexCount) {
+    MeshOptimizer::remapVertices(positions, 0, weldRemap);
+    MeshOptimizer::remapVertices(normals, 0, weldRemap);
+    MeshOptimizer::remapVertices(texCoords, 0, weldRemap);
+    MeshOptimizer::remapVertices(joints, 0, weldRemap);
+    MeshOptimizer::remapVertices(weights, 0, weldRemap);
+    MeshOptimizer::remapVertices(joints1, 0, weldRemap);
+    MeshOptimizer::remapVertices(weights1, 0, weldRemap);
+    Logger::log(1,
+                "%s: merged %i of %i vertices of mesh %i\n",
+                __FUNCTION__,
+                vertexCount - weldedVertexCount,
+                vertexCount,
+                meshNum);
+    vertexCount = weldedVertexCount;
+    positions.resize(vertexCount);
+    normals.resize(vertexCount);
+    texCoords.resize(vertexCount);
+    joints.resize(vertexCount);
+    weights.resize(vertexCount);
+    joints1.resize(vertexCount);
+    weights1.resize(vertexCount);
+  }
 
-  mAdditiveAnimationMask.resize(renderData.rdModelNodeCount);
-  mInvertedAdditiveAnimationMask.resize(renderData.rdModelNodeCount);
+  return true;
+}
 
-  std::fill(mAdditiveAnimationMask.begin(), mAdditiveAnimationMask.end(), true);
-  mInvertedAdditiveAnimationMask = mAdditiveAnimationMask;
-  mInvertedAdditiveAnimationMask.flip();
+void GltfModel::appendPrimitive(const GltfPrimitiveData &primitiveData) {
+  GltfPrimitive gltfPrimitive{};
+  gltfPrimitive.meshNum = primitiveData.meshNum;
+  gltfPrimitive.textureNum = getMaterialTexture(primitiveData.materialNum);
+  gltfPrimitive.firstIndex = mIndices.size();
+  gltfPrimitive.indexCount = primitiveData.indices.size();
+  gltfPrimitive.baseVertex = mPositions.size();
+  gltfPrimitive.vertexCount = primitiveData.positions.size();
+  mPrimitives.push_back(gltfPrimitive);
+
+  mPositions.insert(
+      mPositions.end(), primitiveData.positions.begin(), primitiveData.positions.end());
+  mNormals.insert(mNormals.end(), primitiveData.normals.begin(), primitiveData.normals.end());
+  mTexCoords.insert(
+      mTexCoords.end(), primitiveData.texCoords.begin(), primitiveData.texCoords.end());
+  mJointVec.insert(mJointVec.end(), primitiveData.joints.begin(), primitiveData.joints.end());
+  mWeightVec.insert(mWeightVec.end(), primitiveData.weights.begin(), primitiveData.weights.end());
+  mJointVec1.insert(mJointVec1.end(), primitiveData.joints1.begin(), primitiveData.joints1.end());
+  mWeightVec1.insert(
+      mWeightVec1.end(), primitiveData.weights1.begin(), primitiveData.weights1.end());
+  mIndices.insert(mIndices.end(), primitiveData.indices.begin(), primitiveData.indices.end());
+}
 
-  /* Load up the clip names for the UI.*/
-  for (const auto &clip : mAnimClips) {
-    renderData.rdClipNames.push_back(clip->getClipName());
+/* Base color texture of the material, the images are decoded by the glTF loader. The
+ * textures are created after loading, texture n shows image n - 1.
+ */
+int GltfModel::getMaterialTexture(int materialNum) {
+  if (materialNum < 0) {
+    return 0;
+  }
+  int textureNum = mModel->materials.at(materialNum).pbrMetallicRoughness.baseColorTexture.index;
+  if (textureNum < 0 || mModel->textures.at(textureNum).source < 0) {
+    return 0;
   }
 
-  /* Load up nodes names for the UI.*/
-  for (const auto &node : mNodeList) {
-    if (node) {
-      renderData.rdSkelNodeNames.push_back(node->getNodeName());
-    }
-    else {
-      renderData.rdSkelNodeNames.push_back("(Invalid)");
-    }
+  int imageNum = mModel->textures.at(textureNum).source;
+  auto imageTexture = mImageTextures.find(imageNum);
+  if (imageTexture != mImageTextures.end()) {
+    return imageTexture->second;
   }
 
-  renderData.rdGltfTriangleCount = getTriangleCount();
+  const tinygltf::Image &image = mModel->images.at(imageNum);
+  if (image.bits != 8 || image.image.empty() || (image.component != 3 && image.component != 4))
+  {
+    Logger::log(
+        1, "%s: could not load image %i, using the default texture\n", __FUNCTION__, imageNum);
+    mImageTextures[imageNum] = 0;
+    return 0;
+  }
 
-  return true;
+  GltfImage gltfImage{};
+  gltfImage.width = image.width;
+  gltfImage.height = image.height;
+  gltfImage.components = image.component;
+  gltfImage.pixels = image.image;
+  mImages.push_back(gltfImage);
+  mImageTextures[imageNum] = mImages.size();
+  Logger::log(1,
+              "%s: material %i uses image '%s'\n",
+              __FUNCTION__,
+              materialNum,
+              image.name.empty() ? image.uri.c_str() : image.name.c_str());
+  return mImages.size();
 }
 
-void GltfModel::createVertexBuffers() {
-  // Model assumes only 1 mesh.
-  const tinygltf::Primitive &primitives = mModel->meshes.at(0).primitives.at(0);
-  mVertexVBO.resize(primitives.attributes.size());
-  mAttribAccessors.resize(primitives.attributes.size());
-
-  for (const auto &attrib : primitives.attributes) {
-    const std::string attribType = attrib.first;
-    const int accessorNum = attrib.second;
-
-    const tinygltf::Accessor &accessor = mModel->accessors.at(accessorNum);
-    const tinygltf::BufferView &bufferView = mModel->bufferViews.at(accessor.bufferView);
-    const tinygltf::Buffer &buffer = mModel->buffers.at(bufferView.buffer);
-
-    if ((attribType.compare("POSITION") != 0) && (attribType.compare("NORMAL") != 0) &&
-        (attribType.compare("TEXCOORD_0") != 0) &&
-        (attribType.compare("JOINTS_0") != 0 && (attribType.compare("WEIGHTS_0") != 0)))
+/* An image that fails to upload leaves its primitives without texture. */
+void GltfModel::createTextures() {
+  mTextures.resize(mImages.size() + 1);
+  if (!mTextures.at(0).loadTexture(mDefaultImage.pixels.data(),
+                                   mDefaultImage.width,
+                                   mDefaultImage.height,
+                                   mDefaultImage.components))
+  {
+    Logger::log(1, "%s error: could not create the default texture\n", __FUNCTION__);
+  }
+  mDefaultImage = GltfImage{};
+  for (size_t i = 0; i < mImages.size(); ++i) {
+    const GltfImage &image = mImages.at(i);
+    if (!mTextures.at(i + 1).loadTexture(
+            image.pixels.data(), image.width, image.height, image.components))
     {
-      Logger::log(1, "%s: skipping attribute type %s\n", __FUNCTION__, attribType.c_str());
-      continue;
+      Logger::log(1, "%s error: could not create the texture of image %i\n", __FUNCTION__, i);
     }
+  }
+}
 
-    Logger::log(
-        1, "%s: data for %s uses accessor %i\n", __FUNCTION__, attribType.c_str(), accessorNum);
-    if (attribType.compare("POSITION") == 0) {
-      int numPositionEntries = accessor.count;
-      Logger::log(1, "%s: loaded %i vertices from glTF file\n", __FUNCTION__, numPositionEntries);
-    }
-
-    mAttribAccessors.at(attributes.at(attribType)) = accessorNum;
-
-    int dataSize = 1;
-    switch (accessor.type) {
-      case TINYGLTF_TYPE_SCALAR:
-        dataSize = 1;
-        break;
-      case TINYGLTF_TYPE_VEC2:
-        dataSize = 2;
-        break;
-      case TINYGLTF_TYPE_VEC3:
-        dataSize = 3;
-        break;
-      case TINYGLTF_TYPE_VEC4:
-        dataSize = 4;
-        break;
-      default:
-        Logger::log(1,
-                    "%s error: accessor %i uses data size %i\n",
-                    __FUNCTION__,
-                    accessorNum,
-                    accessor.type);
-        break;
-    }
-
-    GLuint dataType = GL_FLOAT;
-    switch (accessor.componentType) {
-      case TINYGLTF_COMPONENT_TYPE_FLOAT:
-        dataType = GL_FLOAT;
-        break;
-      case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
-        dataType = GL_UNSIGNED_SHORT;
-        break;
-      default:
-        Logger::log(1,
-                    "%s error: accessor %i uses unknown data type %i\n",
-                    __FUNCTION__,
-                    accessorNum,
-                    accessor.componentType);
-        break;
+/* The shaders only differ in the texture, all primitives sharing it are drawn together. */
+void GltfModel::createDrawGroups() {
+  mDrawGroups.clear();
+  for (const auto &primitive : mPrimitives) {
+    auto group = std::find_if(
+        mDrawGroups.begin(), mDrawGroups.end(), [&](const GltfDrawGroup &drawGroup) {
+          return drawGroup.textureNum == primitive.textureNum &&
+                 drawGroup.jointInfluences == primitive.jointInfluences &&
+                 drawGroup.paletteNum == primitive.paletteNum;
+        });
+    if (group == mDrawGroups.end()) {
+      mDrawGroups.emplace_back();
+      group = std::prev(mDrawGroups.end());
+      group->textureNum = primitive.textureNum;
+      group->jointInfluences = primitive.jointInfluences;
+      group->paletteNum = primitive.paletteNum;
     }
 
-    /* buffers for position, normal and tex coordinates */
-    glGenBuffers(1, &mVertexVBO.at(attributes.at(attribType)));
-    glBindBuffer(GL_ARRAY_BUFFER, mVertexVBO.at(attributes.at(attribType)));
-
-    glVertexAttribPointer(attributes.at(attribType), dataSize, dataType, GL_FALSE, 0, (void *)0);
-    glEnableVertexAttribArray(attributes.at(attribType));
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    OGLDrawCommand drawCommand{};
+    drawCommand.count = primitive.indexCount;
+    drawCommand.firstIndex = primitive.firstIndex;
+    drawCommand.baseVertex = primitive.baseVertex;
+    group->drawCommands.push_back(drawCommand);
+    group->drawCommandLods.push_back(primitive.lod);
   }
+
+  Logger::log(1,
+              "%s: %i primitives in %i draw groups\n",
+              __FUNCTION__,
+              mPrimitives.size(),
+              mDrawGroups.size());
 }
 
-void GltfModel::createIndexBuffer() {
-  glGenBuffers(1, &mIndexVBO);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndexVBO);
-  /* Note, we need to keep the buffer bound durring the
-   * vertex array object creation, else it will crash on draw()
-   */
+void GltfModel::createVertexBuffers() {
+  /* the raw buffers are read by the compute skinning, the draws use the packed buffer */
+  mVertexVBO.resize(attributes.size());
+  glGenBuffers(mVertexVBO.size(), mVertexVBO.data());
+  if (!mPalettes.empty()) {
+    glGenBuffers(1, &mPaletteJointBuffer);
+  }
 }
 
 void GltfModel::uploadVertexBuffers() {
-  /*
-   * accessor 0 = buffer with vertex position
-   * accessor 1 = normal data
-   * accessor 2 = texture coordinates
-   */
-  for (int i = 0; i < 5; ++i) {
-    const tinygltf::Accessor &accessor = mModel->accessors.at(mAttribAccessors.at(i));
-    const tinygltf::BufferView &bufferView = mModel->bufferViews.at(accessor.bufferView);
-    const tinygltf::Buffer &buffer = mModel->buffers.at(bufferView.buffer);
-
-    glBindBuffer(GL_ARRAY_BUFFER, mVertexVBO.at(i));
-    glBufferData(GL_ARRAY_BUFFER,
-                 bufferView.byteLength,
-                 &buffer.data.at(0) + bufferView.byteOffset,
-                 GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  uploadBufferData(GL_ARRAY_BUFFER, mVertexVBO.at(attributes.at("POSITION")), mPositions);
+  uploadBufferData(GL_ARRAY_BUFFER, mVertexVBO.at(attributes.at("NORMAL")), mNormals);
+  uploadBufferData(GL_ARRAY_BUFFER, mVertexVBO.at(attributes.at("TEXCOORD_0")), mTexCoords);
+  uploadBufferData(GL_ARRAY_BUFFER, mVertexVBO.at(attributes.at("JOINTS_0")), mJointVec);
+  uploadBufferData(GL_ARRAY_BUFFER, mVertexVBO.at(attributes.at("WEIGHTS_0")), mWeightVec);
+  uploadBufferData(GL_ARRAY_BUFFER, mVertexVBO.at(attributes.at("JOINTS_1")), mJointVec1);
+  uploadBufferData(GL_ARRAY_BUFFER, mVertexVBO.at(attributes.at("WEIGHTS_1")), mWeightVec1);
+
+  if (!mPalettes.empty()) {
+    /* every palette is bound as a range, the ranges start at the SSBO offset alignment */
+    GLint alignment = 1;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    size_t alignedInts = std::max<size_t>(alignment / sizeof(int32_t), 1);
+
+    std::vector<int32_t> paletteJoints{};
+    mPaletteJointOffsets.clear();
+    for (const auto &palette : mPalettes) {
+      paletteJoints.resize((paletteJoints.size() + alignedInts - 1) / alignedInts * alignedInts);
+      mPaletteJointOffsets.push_back(paletteJoints.size() * sizeof(int32_t));
+      paletteJoints.insert(paletteJoints.end(), palette.begin(), palette.end());
+    }
+    uploadBufferData(GL_SHADER_STORAGE_BUFFER, mPaletteJointBuffer, paletteJoints);
   }
 }
 
-void GltfModel::uploadIndexBuffer() {
-  const tinygltf::Primitive &primitives = mModel->meshes.at(0).primitives.at(0);
-  const tinygltf::Accessor &indexAccessor = mModel->accessors.at(primitives.indices);
-  const tinygltf::BufferView &indexBufferView = mModel->bufferViews[indexAccessor.bufferView];
-  const tinygltf::Buffer &indexBuffer = mModel->buffers[indexBufferView.buffer];
-
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndexVBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-               indexBufferView.byteLength,
-               &indexBuffer.data.at(0) + indexBufferView.byteOffset,
-               GL_STATIC_DRAW);
+/* The packed vertices and the indices are stored in the shared arena. */
+bool GltfModel::uploadGeometry(std::shared_ptr<GeometryArena> geometryArena) {
+  mGeometryArena = geometryArena;
+  return mGeometryArena->allocate(mPackedVertexData, mIndices, mIndexType, mGeometry);
 }
 
-void GltfModel::updateNodeMatrices(std::shared_ptr<GltfNode> treeNode) {
-  treeNode->calculateNodeMatrix();
-  updateJointMatricesAndQuats(treeNode);
+/* Getters. */
 
-  glm::mat4 treeNodeMatrix = treeNode->getNodeMatrix();
+GLuint GltfModel::getVertexBuffer(std::string attribType) {
+  return mVertexVBO.at(attributes.at(attribType));
+}
 
-  for (auto &childNode : treeNode->getChilds()) {
-    updateNodeMatrices(childNode);
-  }
-}
-
-void GltfModel::updateJointMatricesAndQuats(std::shared_ptr<GltfNode> treeNode) {
-  int nodeNum = treeNode->getNodeNum();
-  mJointMatrices.at(mNodeToJoint.at(nodeNum)) = treeNode->getNodeMatrix() *
-                                                mInverseBindMatrices.at(mNodeToJoint.at(nodeNum));
-
-  // Components of node matrix
-  glm::quat orientation;
-  glm::vec3 scale;
-  glm::vec3 translation;
-  glm::vec3 skew;
-  glm::vec4 perspective;
-  glm::dualquat dq;
-
-  /* Create dual quaternion */
-  if (glm::decompose(mJointMatrices.at(mNodeToJoint.at(nodeNum)),
-                     scale,
-                     orientation,
-                     translation,
-                     skew,
-                     perspective))
-  {
-    dq[0] = orientation;
-    dq[1] = glm::quat(0.0, translation.x, translation.y, translation.z) * orientation * 0.5f;
-    mJointDualQuats.at(mNodeToJoint.at(nodeNum)) = glm::mat2x4_cast(dq);
-  }
-  else {
-    Logger::log(1, "%s error: could not decompose matrix for node %i\n", __FUNCTION__, nodeNum);
-  }
+const std::vector<glm::vec3> &GltfModel::getPositionVec() {
+  return mPositions;
 }
 
-void GltfModel::resetNodeData() {
-  getNodeData(mRootNode);
-  resetNodeData(mRootNode);
+const std::vector<glm::vec3> &GltfModel::getNormalVec() {
+  return mNormals;
 }
 
-void GltfModel::resetNodeData(std::shared_ptr<GltfNode> treeNode) {
-  glm::mat4 treeNodeMatrix = treeNode->getNodeMatrix();
-  for (auto &childNode : treeNode->getChilds()) {
-    getNodeData(childNode);
-    resetNodeData(childNode);
-  }
+const std::vector<glm::vec2> &GltfModel::getTexCoordVec() {
+  return mTexCoords;
 }
 
-void GltfModel::updateAdditiveMask(std::shared_ptr<GltfNode> treeNode, int splitNodeNum) {
-  if (treeNode->getNodeNum() == splitNodeNum) {
-    return;
-  }
-  mAdditiveAnimationMask.at(treeNode->getNodeNum()) = false;
-  for (auto &childNode : treeNode->getChilds()) {
-    updateAdditiveMask(childNode, splitNodeNum);
-  }
+glm::vec3 GltfModel::getPositionOffset() {
+  return mPackedVertexData.positionOffset;
 }
 
-void GltfModel::setSkeletonSplitNode(int nodeNum) {
-  std::fill(mAdditiveAnimationMask.begin(), mAdditiveAnimationMask.end(), true);
-  updateAdditiveMask(mRootNode, nodeNum);
-  mInvertedAdditiveAnimationMask = mAdditiveAnimationMask;
-  mInvertedAdditiveAnimationMask.flip();
+glm::vec3 GltfModel::getPositionScale() {
+  return mPackedVertexData.positionScale;
 }
 
-/* Getters. */
+int GltfModel::getArenaBaseVertex() {
+  return mGeometry.baseVertex;
+}
 
-int GltfModel::getTriangleCount() {
-  const tinygltf::Primitive &primitives = mModel->meshes.at(0).primitives.at(0);
-  const tinygltf::Accessor &indexAccessor = mModel->accessors.at(primitives.indices);
-  return indexAccessor.count;
+const std::vector<glm::tvec4<uint16_t>> &GltfModel::getJointVec() {
+  return mJointVec;
 }
 
-void GltfModel::getJointData() {
-  std::string jointsAccessorAttrib = "JOINTS_0";
-  int jointsAccessor = mModel->meshes.at(0).primitives.at(0).attributes.at(jointsAccessorAttrib);
-  Logger::log(1,
-              "%s: using accessor %i to get %s\n",
-              __FUNCTION__,
-              jointsAccessor,
-              jointsAccessorAttrib.c_str());
+const std::vector<glm::vec4> &GltfModel::getWeightVec() {
+  return mWeightVec;
+}
 
-  const tinygltf::Accessor &accessor = mModel->accessors.at(jointsAccessor);
-  const tinygltf::BufferView &bufferView = mModel->bufferViews.at(accessor.bufferView);
-  const tinygltf::Buffer &buffer = mModel->buffers.at(bufferView.buffer);
+const std::vector<glm::tvec4<uint16_t>> &GltfModel::getJointVec1() {
+  return mJointVec1;
+}
 
-  int jointVecSize = accessor.count;
-  Logger::log(1, "%s: %i short vec4 in JOINTS_0\n", __FUNCTION__, jointVecSize);
-  mJointVec.resize(jointVecSize);
+const std::vector<glm::vec4> &GltfModel::getWeightVec1() {
+  return mWeightVec1;
+}
 
-  std::memcpy(mJointVec.data(), &buffer.data.at(0) + bufferView.byteOffset, bufferView.byteLength);
+bool GltfModel::hasSecondJointSet() {
+  return std::find(mJointInfluenceBuckets.begin(), mJointInfluenceBuckets.end(), 8) !=
+         mJointInfluenceBuckets.end();
+}
 
-  mNodeToJoint.resize(mModel->nodes.size());
+const std::vector<int> &GltfModel::getJointInfluenceBuckets() {
+  return mJointInfluenceBuckets;
+}
 
-  const tinygltf::Skin &skin = mModel->skins.at(0);
-  for (int i = 0; i < skin.joints.size(); ++i) {
-    int destinationNode = skin.joints.at(i);
-    mNodeToJoint.at(destinationNode) = i;
-    Logger::log(2, "%s: joint %i affects node %i\n", __FUNCTION__, i, destinationNode);
-  }
+bool GltfModel::hasLocalPalettes() {
+  return !mPalettes.empty();
 }
 
-void GltfModel::getWeightData() {
-  std::string weightsAccessorAttrib = "WEIGHTS_0";
-  int weightAccessor = mModel->meshes.at(0).primitives.at(0).attributes.at(weightsAccessorAttrib);
-  Logger::log(1,
-              "%s: using accessor %i to get %s\n",
-              __FUNCTION__,
-              weightAccessor,
-              weightsAccessorAttrib.c_str());
+int GltfModel::getVertexCount() {
+  return mPositions.size();
+}
 
-  const tinygltf::Accessor &accessor = mModel->accessors.at(weightAccessor);
-  const tinygltf::BufferView &bufferView = mModel->bufferViews.at(accessor.bufferView);
-  const tinygltf::Buffer &buffer = mModel->buffers.at(bufferView.buffer);
+int GltfModel::getFullResolutionVertexCount() {
+  int vertexCount = 0;
+  for (const auto &primitive : mPrimitives) {
+    if (primitive.lod == 0) {
+      vertexCount =
+          std::max(vertexCount, static_cast<int>(primitive.baseVertex + primitive.vertexCount));
+    }
+  }
+  return vertexCount;
+}
 
-  int weightVecSize = accessor.count;
-  Logger::log(1, "%s: %i vec4 in WEIGHTS_0\n", __FUNCTION__, weightVecSize);
-  mWeightVec.resize(weightVecSize);
+int GltfModel::getMeshLodCount() {
+  return mMeshLodTriangleCounts.size();
+}
 
-  std::memcpy(
-      mWeightVec.data(), &buffer.data.at(0) + bufferView.byteOffset, bufferView.byteLength);
+int GltfModel::getMeshLodTriangleCount(int lod) {
+  return mMeshLodTriangleCounts.at(lod);
 }
 
-void GltfModel::getInvBindMatrices() {
-  const tinygltf::Skin &skin = mModel->skins.at(0);
-  int invBindMatAccessor = skin.inverseBindMatrices;
+/* All skins are merged into a single palette, a node used by several skins is a
+ * single joint. Skins can differ by the bind transform of their mesh, the
+ * difference must be the same for all shared joints and is applied to the
+ * vertices of the skin instead.
+ */
+bool GltfModel::getSkins() {
+  mNodeToJoint.assign(mModel->nodes.size(), -1);
+  mInverseBindMatrices.clear();
+  mSkinBindShapes.clear();
+
+  for (int skinNum = 0; skinNum < mModel->skins.size(); ++skinNum) {
+    const tinygltf::Skin &skin = mModel->skins.at(skinNum);
+
+    /* identity matrices if the skin has none */
+    std::vector<glm::mat4> inverseBindMatrices(skin.joints.size(), glm::mat4(1.0f));
+    if (skin.inverseBindMatrices >= 0) {
+      std::vector<float> matrixData = readAccessor<float>(
+          *mGltfFile, skin.inverseBindMatrices, 16);
+      if (matrixData.size() != skin.joints.size() * 16) {
+        Logger::log(
+            1, "%s error: invalid inverse bind matrices in skin %i\n", __FUNCTION__, skinNum);
+        return false;
+      }
+      for (int i = 0; i < skin.joints.size(); ++i) {
+        inverseBindMatrices.at(i) = glm::make_mat4(matrixData.data() + i * 16);
+      }
+    }
 
-  const tinygltf::Accessor &accessor = mModel->accessors.at(invBindMatAccessor);
-  const tinygltf::BufferView &bufferView = mModel->bufferViews.at(accessor.bufferView);
-  const tinygltf::Buffer &buffer = mModel->buffers.at(bufferView.buffer);
+    glm::mat4 bindShape = glm::mat4(1.0f);
+    bool sharesJoints = false;
+    for (int i = 0; i < skin.joints.size(); ++i) {
+      int joint = mNodeToJoint.at(skin.joints.at(i));
+      if (joint < 0) {
+        continue;
+      }
 
-  mInverseBindMatrices.resize(skin.joints.size());
-  mJointMatrices.resize(skin.joints.size());
-  mJointDualQuats.resize(skin.joints.size());
+      glm::mat4 jointBindShape = glm::inverse(mInverseBindMatrices.at(joint)) *
+                                 inverseBindMatrices.at(i);
+      if (!sharesJoints) {
+        bindShape = jointBindShape;
+        sharesJoints = true;
+      }
+      else if (!matricesEqual(bindShape, jointBindShape)) {
+        Logger::log(1,
+                    "%s error: skin %i is bound differently than the joints shared with other "
+                    "skins\n",
+                    __FUNCTION__,
+                    skinNum);
+        return false;
+      }
+    }
+    mSkinBindShapes.push_back(bindShape);
+
+    glm::mat4 inverseBindShape = glm::inverse(bindShape);
+    int newJoints = 0;
+    for (int i = 0; i < skin.joints.size(); ++i) {
+      int destinationNode = skin.joints.at(i);
+      if (mNodeToJoint.at(destinationNode) >= 0) {
+        continue;
+      }
+      mNodeToJoint.at(destinationNode) = mInverseBindMatrices.size();
+      mInverseBindMatrices.push_back(inverseBindMatrices.at(i) * inverseBindShape);
+      Logger::log(2,
+                  "%s: joint %i affects node %i\n",
+                  __FUNCTION__,
+                  mNodeToJoint.at(destinationNode),
+                  destinationNode);
+      ++newJoints;
+    }
 
-  std::memcpy(mInverseBindMatrices.data(),
-              &buffer.data.at(0) + bufferView.byteOffset,
-              bufferView.byteLength);
+    Logger::log(1,
+                "%s: skin %i has %i joints, %i shared with other skins\n",
+                __FUNCTION__,
+                skinNum,
+                skin.joints.size(),
+                skin.joints.size() - newJoints);
+  }
+  return true;
 }
 
 int GltfModel::getJointMatrixSize() {
-  return mJointMatrices.size();
+  return mInverseBindMatrices.size();
 }
 
-std::vector<glm::mat4> GltfModel::getJointMatrices() {
-  return mJointMatrices;
+int GltfModel::getJointDualQuatsSize() {
+  return mInverseBindMatrices.size();
 }
 
-int GltfModel::getJointDualQuatsSize() {
-  return mJointDualQuats.size();
+const std::vector<glm::mat4> &GltfModel::getInverseBindMatrices() {
+  return mInverseBindMatrices;
 }
 
-std::vector<glm::mat2x4> GltfModel::getJointDualQuats() {
-  return mJointDualQuats;
+const std::vector<int> &GltfModel::getNodeToJoint() {
+  return mNodeToJoint;
 }
 
-void GltfModel::getNodes(std::shared_ptr<GltfNode> treeNode) {
-  int nodeNum = treeNode->getNodeNum();
-  std::vector<int> childNodes = mModel->nodes.at(nodeNum).children;
 
-  /* remove the child node with skin/mesh metadata, confuses skeleton */
-  auto removeIt = std::remove_if(childNodes.begin(), childNodes.end(), [&](int num) {
-    return mModel->nodes.at(num).skin != -1;
-  });
-  childNodes.erase(removeIt, childNodes.end());
+std::shared_ptr<GltfNode> GltfModel::createNodeTree(
+    std::vector<std::shared_ptr<GltfNode>> &nodeList) {
+  nodeList.clear();
+  nodeList.resize(mSkeleton.size());
+
+  std::shared_ptr<GltfNode> root = GltfNode::createRoot(mRootNodeNum);
+  nodeList.at(mRootNodeNum) = root;
+  getNodeData(root);
+  getNodes(root, nodeList);
+  return root;
+}
 
-  treeNode->addChilds(childNodes);
+void GltfModel::getNodes(std::shared_ptr<GltfNode> treeNode,
+                         std::vector<std::shared_ptr<GltfNode>> &nodeList) {
+  treeNode->addChilds(mSkeleton.at(treeNode->getNodeNum()).children);
 
   for (auto &childNode : treeNode->getChilds()) {
-    mNodeList.at(childNode->getNodeNum()) = childNode;
+    nodeList.at(childNode->getNodeNum()) = childNode;
     getNodeData(childNode);
-    getNodes(childNode);
+    getNodes(childNode, nodeList);
   }
 }
 
-void GltfModel::getNodeData(std::shared_ptr<GltfNode> treeNode) {
-  int nodeNum = treeNode->getNodeNum();
-  const tinygltf::Node &node = mModel->nodes.at(nodeNum);
-  treeNode->setNodeName(node.name);
-
-  if (node.translation.size()) {
-    treeNode->setTranslation(glm::make_vec3(node.translation.data()));
-  }
-  else {
-    treeNode->setTranslation(glm::vec3(0.0f));
-  }
-
-  if (node.rotation.size()) {
-    treeNode->setRotation(glm::make_quat(node.rotation.data()));
-  }
-  else {
-    treeNode->setRotation(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
-  }
-
-  if (node.scale.size()) {
-    treeNode->setScale(glm::make_vec3(node.scale.data()));
-  }
-  else {
-    treeNode->setScale(glm::vec3(1.0f));
+int GltfModel::getNodeHeights(std::shared_ptr<GltfNode> treeNode) {
+  int height = 0;
+  for (auto &childNode : treeNode->getChilds()) {
+    height = std::max(height, getNodeHeights(childNode) + 1);
   }
-
-  treeNode->calculateNodeMatrix();
-
-  updateJointMatricesAndQuats(treeNode);
+  mNodeHeights.at(treeNode->getNodeNum()) = height;
+  return height;
 }
 
-std::shared_ptr<OGLMesh> GltfModel::getSkeleton() {
-  mSkeletonMesh->vertices.resize(mModel->nodes.size() * 2);
-  mSkeletonMesh->vertices.clear();
-
-  /* start from Armature child */
-  getSkeletonPerNode(mRootNode->getChilds().at(0));
-  return mSkeletonMesh;
+int GltfModel::getNodeCount() {
+  return mNodeList.size();
 }
 
-void GltfModel::getSkeletonPerNode(std::shared_ptr<GltfNode> treeNode) {
-  glm::vec3 parentPos = glm::vec3(0.0f);
-  parentPos = glm::vec3(treeNode->getNodeMatrix() * glm::vec4(1.0f));
-  OGLVertex parentVertex;
-  parentVertex.position = parentPos;
-  parentVertex.color = glm::vec3(0.0f, 1.0f, 1.0f);
+void GltfModel::getNodeData(std::shared_ptr<GltfNode> treeNode) {
+  const GltfSkeletonNode &node = mSkeleton.at(treeNode->getNodeNum());
+  treeNode->setNodeName(node.name);
+  treeNode->setTranslation(node.translation);
+  treeNode->setRotation(node.rotation);
+  treeNode->setScale(node.scale);
+  treeNode->calculateNodeMatrix();
+}
 
-  for (const auto &childNode : treeNode->getChilds()) {
-    glm::vec3 childPos = glm::vec3(0.0f);
-    childPos = glm::vec3(childNode->getNodeMatrix() * glm::vec4(1.0f));
-    OGLVertex childVertex;
-    childVertex.position = childPos;
-    childVertex.color = glm::vec3(0.0f, 0.0f, 1.0f);
-    mSkeletonMesh->vertices.emplace_back(parentVertex);
-    mSkeletonMesh->vertices.emplace_back(childVertex);
+/* The nodes with skin/mesh metadata are removed from the children, they confuse
+ * the skeleton.
+ */
+void GltfModel::getSkeleton() {
+  mRootNodeNum = mModel->scenes.at(0).nodes.at(0);
+  mSkeleton.clear();
+  mSkeleton.resize(mModel->nodes.size());
+  for (size_t nodeNum = 0; nodeNum < mModel->nodes.size(); ++nodeNum) {
+    const tinygltf::Node &node = mModel->nodes.at(nodeNum);
+    GltfSkeletonNode &skeletonNode = mSkeleton.at(nodeNum);
+    skeletonNode.name = node.name;
+    for (int child : node.children) {
+      if (mModel->nodes.at(child).skin == -1) {
+        skeletonNode.children.push_back(child);
+      }
+    }
 
-    getSkeletonPerNode(childNode);
+    if (node.translation.size()) {
+      skeletonNode.translation = glm::make_vec3(node.translation.data());
+    }
+    if (node.rotation.size()) {
+      skeletonNode.rotation = glm::make_quat(node.rotation.data());
+    }
+    if (node.scale.size()) {
+      skeletonNode.scale = glm::make_vec3(node.scale.data());
+    }
   }
 }
 
+/* One clip per job, the channels of a clip are read by a single thread. */
 void GltfModel::getAnimations() {
-  for (const auto &anim : mModel->animations) {
+  const std::vector<tinygltf::Animation> &animations = mModel->animations;
+  mAnimClips.resize(animations.size());
+  parallelFor(animations.size(), [&](size_t animNum) {
+    const tinygltf::Animation &anim = animations.at(animNum);
+    std::shared_ptr<GltfAnimationClip> clip = std::make_shared<GltfAnimationClip>(anim.name);
+    for (const auto &channel : anim.channels) {
+      clip->addChannel(mGltfFile, anim, channel);
+    }
+    mAnimClips.at(animNum) = clip;
+  });
+
+  for (const auto &anim : animations) {
     Logger::log(1,
-                "%s: loading animation '%s' with %i channels\n",
+                "%s: loaded animation '%s' with %i channels\n",
                 __FUNCTION__,
                 anim.name.c_str(),
                 anim.channels.size());
-    std::shared_ptr<GltfAnimationClip> clip = std::make_shared<GltfAnimationClip>(anim.name);
-    for (const auto &channel : anim.channels) {
-      clip->addChannel(mModel, anim, channel);
+  }
+}
+
+/* Runs between frames. A clip used in this frame is kept, the others are evicted
+ * least recently used first until the decoded clips fit into the budget.
+ */
+void GltfModel::evictAnimClips(size_t memoryBudget) {
+  ++mClipUseFrame;
+  mClipLastUseFrames.resize(mAnimClips.size(), 0);
+
+  mResidentClipBytes = 0;
+  std::vector<int> evictableClips{};
+  for (int i = 0; i < mAnimClips.size(); ++i) {
+    const std::shared_ptr<GltfAnimationClip> &clip = mAnimClips.at(i);
+    if (clip->checkAndResetUsed()) {
+      mClipLastUseFrames.at(i) = mClipUseFrame;
+    }
+    if (!clip->isLoaded()) {
+      continue;
+    }
+    mResidentClipBytes += clip->getDataSize();
+    if (clip->isEvictable() && mClipLastUseFrames.at(i) != mClipUseFrame) {
+      evictableClips.push_back(i);
+    }
+  }
+
+  std::stable_sort(evictableClips.begin(), evictableClips.end(), [&](int a, int b) {
+    return mClipLastUseFrames.at(a) < mClipLastUseFrames.at(b);
+  });
+  for (int clipNum : evictableClips) {
+    if (mResidentClipBytes <= memoryBudget) {
+      break;
+    }
+    const std::shared_ptr<GltfAnimationClip> &clip = mAnimClips.at(clipNum);
+    mResidentClipBytes -= clip->getDataSize();
+    clip->evictChannels();
+    Logger::log(2, "%s: evicted clip '%s'\n", __FUNCTION__, clip->getClipName().c_str());
+  }
+
+  mResidentClipCount = 0;
+  for (const auto &clip : mAnimClips) {
+    if (clip->isLoaded()) {
+      ++mResidentClipCount;
     }
-    mAnimClips.push_back(clip);
   }
 }
 
+int GltfModel::getResidentClipCount() {
+  return mResidentClipCount;
+}
+
+size_t GltfModel::getResidentClipBytes() {
+  return mResidentClipBytes;
+}
+
+const std::vector<std::shared_ptr<GltfAnimationClip>> &GltfModel::getAnimClips() {
+  return mAnimClips;
+}
+
 float GltfModel::getAnimationEndTime(int animNum) {
   return mAnimClips.at(animNum)->getClipEndTime();
 }
 
+void GltfModel::setClipBounds(std::vector<BoundingBox> clipBounds) {
+  mClipBounds = clipBounds;
+}
+
+const BoundingBox &GltfModel::getClipBounds(int animNum) {
+  return mClipBounds.at(animNum);
+}
+
 std::string GltfModel::getClipName(int animNum) {
   return mAnimClips.at(animNum)->getClipName();
 }
@@ -511,160 +2311,223 @@ std::string GltfModel::getNodeName(int nodeNum) {
   return "(Invalid)";
 }
 
-void GltfModel::setInverseKinematicsNodes(int effectorNodeNum, int ikChainRootNodeNum) {
-  if (effectorNodeNum < 0 || effectorNodeNum > (mNodeList.size() - 1)) {
-    Logger::log(1, "%s error: effector node %i is out of range\n", __FUNCTION__, effectorNodeNum);
-    return;
-  }
+/* Animation level of detail */
 
-  if (ikChainRootNodeNum < 0 || ikChainRootNodeNum > (mNodeList.size() - 1)) {
-    Logger::log(
-        1, "%s error: IK chaine root node %i is out of range\n", __FUNCTION__, ikChainRootNodeNum);
-    return;
-  }
+void GltfModel::setAnimationLodTiers(std::vector<AnimationLodTier> tiers) {
+  mAnimationLodTiers = tiers;
+  updateLodNodeMasks();
+}
 
-  std::vector<std::shared_ptr<GltfNode>> ikNodes{};
-  int currentNodeNum = effectorNodeNum;
+const std::vector<AnimationLodTier> &GltfModel::getAnimationLodTiers() {
+  return mAnimationLodTiers;
+}
 
-  ikNodes.insert(ikNodes.begin(), mNodeList.at(effectorNodeNum));
-  while (currentNodeNum != ikChainRootNodeNum) {
-    std::shared_ptr<GltfNode> node = mNodeList.at(currentNodeNum);
-    if (node) {
-      std::shared_ptr<GltfNode> parentNode = node->getParentNode();
-      if (parentNode) {
-        currentNodeNum = parentNode->getNodeNum();
-        ikNodes.push_back(parentNode);
-      }
-      else {
-        break;
-      }
+const std::vector<bool> &GltfModel::getLodNodeMask(int tierNum) {
+  return mLodNodeMasks.at(tierNum);
+}
+
+/* Joints closer to a leaf than the skip level of the tier are not animated,
+ * they follow their parent joint instead (fingers, toes, head end sites).
+ */
+void GltfModel::updateLodNodeMasks() {
+  mLodNodeMasks.resize(mAnimationLodTiers.size());
+  for (int i = 0; i < mAnimationLodTiers.size(); ++i) {
+    mLodNodeMasks.at(i).resize(mNodeHeights.size());
+    for (int node = 0; node < mNodeHeights.size(); ++node) {
+      mLodNodeMasks.at(i).at(node) = mNodeHeights.at(node) >=
+                                     mAnimationLodTiers.at(i).skipLeafLevels;
     }
+    /* never skip the root */
+    mLodNodeMasks.at(i).at(mRootNode->getNodeNum()) = true;
   }
-  mIKSolver.setNodes(ikNodes);
 }
 
-void GltfModel::setNumIKIterations(int iterations) {
-  mIKSolver.setNumIterations(iterations);
+glm::vec4 GltfModel::getBoundingSphere() {
+  return mBoundingSphere;
 }
 
-void GltfModel::solveIKByCCD(glm::vec3 target) {
-  mIKSolver.solveCCD(target);
-  updateNodeMatrices(mIKSolver.getIkChainRootNode());
+const std::vector<BoundingBox> &GltfModel::getJointBounds() {
+  return mJointBounds;
 }
 
-void GltfModel::solveIKByFABRIK(glm::vec3 target) {
-  mIKSolver.solveFABRIK(target);
-  updateNodeMatrices(mIKSolver.getIkChainRootNode());
+const std::vector<glm::mat4> &GltfModel::getBindMatrices() {
+  return mBindMatrices;
 }
 
-/* Animation */
-
-void GltfModel::playAnimation(int animNum,
-                              float speedDivider,
-                              float blendFactor,
-                              replayDirection direction) {
-  double currentTime = std::chrono::duration_cast<std::chrono::milliseconds>(
-                           std::chrono::steady_clock::now().time_since_epoch())
-                           .count();
-  if (direction == replayDirection::backward) {
-    blendAnimationFrame(animNum,
-                        mAnimClips.at(animNum)->getClipEndTime() -
-                            std::fmod(currentTime / 1000.0 * speedDivider,
-                                      mAnimClips.at(animNum)->getClipEndTime()),
-                        blendFactor);
-  }
-  else {
-    blendAnimationFrame(
-        animNum,
-        std::fmod(currentTime / 1000.0 * speedDivider, mAnimClips.at(animNum)->getClipEndTime()),
-        blendFactor);
+/* Every vertex extends the box of each joint with a weight on it. The boxes are
+ * stored in joint space, so they follow the joint rigidly in any pose.
+ */
+void GltfModel::calculateJointBounds() {
+  mBindMatrices.resize(mInverseBindMatrices.size());
+  for (int i = 0; i < mInverseBindMatrices.size(); ++i) {
+    mBindMatrices.at(i) = glm::inverse(mInverseBindMatrices.at(i));
   }
-}
 
-void GltfModel::playAnimation(int sourceAnimNumber,
-                              int destAnimNumber,
-                              float speedDivider,
-                              float blendFactor,
-                              replayDirection direction) {
-
-  double currentTime = std::chrono::duration_cast<std::chrono::milliseconds>(
-                           std::chrono::steady_clock::now().time_since_epoch())
-                           .count();
-
-  if (direction == replayDirection::backward) {
-    crossBlendAnimationFrame(sourceAnimNumber,
-                             destAnimNumber,
-                             mAnimClips.at(sourceAnimNumber)->getClipEndTime() -
-                                 std::fmod(currentTime / 1000.0 * speedDivider,
-                                           mAnimClips.at(sourceAnimNumber)->getClipEndTime()),
-                             blendFactor);
-  }
-  else {
-    crossBlendAnimationFrame(sourceAnimNumber,
-                             destAnimNumber,
-                             std::fmod(currentTime / 1000.0 * speedDivider,
-                                       mAnimClips.at(sourceAnimNumber)->getClipEndTime()),
-                             blendFactor);
+  mJointBounds.clear();
+  mJointBounds.resize(mInverseBindMatrices.size());
+  for (int i = 0; i < mPositions.size(); ++i) {
+    for (int j = 0; j < 8; ++j) {
+      const glm::vec4 &weights = j < 4 ? mWeightVec.at(i) : mWeightVec1.at(i);
+      if (weights[j % 4] <= 0.0f) {
+        continue;
+      }
+      int joint = j < 4 ? mJointVec.at(i)[j] : mJointVec1.at(i)[j % 4];
+      mJointBounds.at(joint).addPoint(
+          glm::vec3(mInverseBindMatrices.at(joint) * glm::vec4(mPositions.at(i), 1.0f)));
+    }
   }
+
+  int usedJoints = std::count_if(mJointBounds.begin(), mJointBounds.end(), [](const auto &box) {
+    return !box.isEmpty();
+  });
+  Logger::log(1,
+              "%s: %i of %i joints influence vertices\n",
+              __FUNCTION__,
+              usedJoints,
+              mJointBounds.size());
 }
 
-void GltfModel::blendAnimationFrame(int animNum, float time, float blendFactor) {
-  mAnimClips.at(animNum)->blendAnimationFrame(
-      mNodeList, mAdditiveAnimationMask, time, blendFactor);
-  updateNodeMatrices(mRootNode);
+void GltfModel::calculateBoundingSphere() {
+  BoundingBox bounds{};
+  for (const auto &position : mPositions) {
+    bounds.addPoint(position);
+  }
+  mBoundingSphere = glm::vec4((bounds.min + bounds.max) * 0.5f,
+                              glm::length(bounds.max - bounds.min) * 0.5f);
 }
 
-void GltfModel::crossBlendAnimationFrame(int sourceAnimNumber,
-                                         int destAnimNumber,
-                                         float time,
-                                         float blendFactor) {
-  float sourceAnimDuration = mAnimClips.at(sourceAnimNumber)->getClipEndTime();
-  float destAnimDuration = mAnimClips.at(destAnimNumber)->getClipEndTime();
+/* ------ */
 
-  float scaledTime = time * (destAnimDuration / sourceAnimDuration);
+void GltfModel::drawInstanced(RingBuffer &ringBuffer,
+                              const std::vector<int> &lodInstanceCounts,
+                              int jointInfluences) {
+  /* the base instance is the first instance of the LOD */
+  std::vector<int> lodFirstInstances(lodInstanceCounts.size(), 0);
+  for (int lod = 1; lod < lodInstanceCounts.size(); ++lod) {
+    lodFirstInstances.at(lod) = lodFirstInstances.at(lod - 1) + lodInstanceCounts.at(lod - 1);
+  }
 
-  mAnimClips.at(sourceAnimNumber)->setAnimationFrame(mNodeList, mAdditiveAnimationMask, time);
-  mAnimClips.at(destAnimNumber)
-      ->blendAnimationFrame(mNodeList, mAdditiveAnimationMask, scaledTime, blendFactor);
+  mDrawCommands.clear();
+  mDrawGroupCommandCounts.clear();
+  for (const auto &group : mDrawGroups) {
+    /* the groups of other skinning variants stay empty */
+    GLsizei commandCount = 0;
+    for (int i = 0; i < group.drawCommands.size(); ++i) {
+      if (jointInfluences > 0 && group.jointInfluences != jointInfluences) {
+        continue;
+      }
+      int lod = group.drawCommandLods.at(i);
+      if (lod >= lodInstanceCounts.size() || lodInstanceCounts.at(lod) == 0) {
+        continue;
+      }
 
-  mAnimClips.at(destAnimNumber)
-      ->setAnimationFrame(mNodeList, mInvertedAdditiveAnimationMask, scaledTime);
-  mAnimClips.at(sourceAnimNumber)
-      ->blendAnimationFrame(mNodeList, mInvertedAdditiveAnimationMask, time, blendFactor);
+      OGLDrawCommand drawCommand = group.drawCommands.at(i);
+      drawCommand.instanceCount = lodInstanceCounts.at(lod);
+      drawCommand.baseInstance = lodFirstInstances.at(lod);
+      drawCommand.firstIndex += mGeometry.firstIndex;
+      drawCommand.baseVertex += mGeometry.baseVertex;
+      mDrawCommands.push_back(drawCommand);
+      ++commandCount;
+    }
+    mDrawGroupCommandCounts.push_back(commandCount);
+  }
 
-  updateNodeMatrices(mRootNode);
+  drawCommandGroups(ringBuffer, mGeometryArena->getVertexArray(mGeometry));
 }
 
-/* ------ */
+void GltfModel::drawPreSkinned(RingBuffer &ringBuffer, GLuint vertexArray, int instanceCount) {
+  /* same indices for every instance, the base vertex is the one in the pre-skinned buffer */
+  int vertexCount = getFullResolutionVertexCount();
+  mDrawCommands.clear();
+  mDrawGroupCommandCounts.clear();
+  for (const auto &group : mDrawGroups) {
+    GLsizei commandCount = 0;
+    for (int i = 0; i < instanceCount; ++i) {
+      for (int j = 0; j < group.drawCommands.size(); ++j) {
+        if (group.drawCommandLods.at(j) > 0) {
+          continue;
+        }
+
+        OGLDrawCommand drawCommand = group.drawCommands.at(j);
+        drawCommand.instanceCount = 1;
+        drawCommand.firstIndex += mGeometry.firstIndex;
+        drawCommand.baseVertex += i * vertexCount;
+        mDrawCommands.push_back(drawCommand);
+        ++commandCount;
+      }
+    }
+    mDrawGroupCommandCounts.push_back(commandCount);
+  }
 
-void GltfModel::draw() {
-  const tinygltf::Primitive &primitives = mModel->meshes.at(0).primitives.at(0);
-  const tinygltf::Accessor &indexAccessor = mModel->accessors.at(primitives.indices);
+  drawCommandGroups(ringBuffer, vertexArray);
+}
 
-  GLuint drawMode = GL_TRIANGLES;
-  switch (primitives.mode) {
-    case TINYGLTF_MODE_TRIANGLES:
-      drawMode = GL_TRIANGLES;
-      break;
-    default:
-      Logger::log(1, "%s error: unknown draw mode %i\n", __FUNCTION__, drawMode);
-      break;
+/* The commands of the groups follow each other in mDrawCommands, the number of
+ * commands of every group is in mDrawGroupCommandCounts.
+ */
+void GltfModel::drawCommandGroups(RingBuffer &ringBuffer, GLuint vertexArray) {
+  if (mDrawCommands.empty()) {
+    return;
+  }
+
+  RingBufferRange range = ringBuffer.allocate(mDrawCommands.size() * sizeof(OGLDrawCommand));
+  if (!range.data) {
+    return;
   }
+  ringBuffer.writeRange(range, 0, mDrawCommands);
 
-  mTex.bind();
-  glBindVertexArray(mVAO);
-  // We have indexed geometry, instead of array data
-  glDrawElements(drawMode, indexAccessor.count, indexAccessor.componentType, nullptr);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, range.buffer);
+  glBindVertexArray(vertexArray);
+  /* the index buffer of the arena may have been replaced by a larger one */
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mGeometryArena->getIndexBuffer());
+
+  size_t firstCommand = 0;
+  for (int i = 0; i < mDrawGroups.size(); ++i) {
+    GLsizei commandCount = mDrawGroupCommandCounts.at(i);
+    if (commandCount == 0) {
+      continue;
+    }
+    mTextures.at(mDrawGroups.at(i).textureNum).bind();
+    int paletteNum = mDrawGroups.at(i).paletteNum;
+    if (paletteNum >= 0) {
+      glBindBufferRange(GL_SHADER_STORAGE_BUFFER,
+                        paletteJointBinding,
+                        mPaletteJointBuffer,
+                        mPaletteJointOffsets.at(paletteNum),
+                        mPalettes.at(paletteNum).size() * sizeof(int32_t));
+    }
+    glMultiDrawElementsIndirect(
+        GL_TRIANGLES,
+        mIndexType,
+        (const void *)(range.offset + firstCommand * sizeof(OGLDrawCommand)),
+        commandCount,
+        0);
+    firstCommand += commandCount;
+  }
 
   glBindVertexArray(0);
-  mTex.unbind();
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  mTextures.at(0).unbind();
 }
 
 void GltfModel::cleanup() {
   glDeleteBuffers(mVertexVBO.size(), mVertexVBO.data());
-  glDeleteBuffers(1, &mVAO);
-  glDeleteBuffers(1, &mIndexVBO);
-  mTex.cleanup();
+  if (mPaletteJointBuffer) {
+    glDeleteBuffers(1, &mPaletteJointBuffer);
+  }
+  if (mGeometryArena) {
+    mGeometryArena->release(mGeometry);
+  }
+  for (auto &texture : mTextures) {
+    texture.cleanup();
+  }
+  mTextures.clear();
+  mImages.clear();
+  mImageTextures.clear();
   mModel.reset();
+  mGltfFile.reset();
   mNodeList.clear();
+  mSkeleton.clear();
+  mAnimClips.clear();
+  mClipLastUseFrames.clear();
 }
@@ -6,119 +6,312 @@
 #include <tiny_gltf.h>
 #include <vector>
 
+#include "GeometryArena.h"
+#include "RingBuffer.h"
 #include "Texture.h"
 
-#include "IKSolver.h"
-
+#include "BakedModelFile.h"
 #include "GltfAnimationClip.h"
+#include "GltfFile.h"
 #include "GltfNode.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "VertexPacker.h"
 
 #include "OGLRenderData.h"
 
+/* A node of the flat skeleton, the node trees are created from it. The nodes of
+ * skinned meshes are not among the children.
+ */
+struct GltfSkeletonNode {
+  std::string name{};
+  std::vector<int> children{};
+  glm::vec3 translation = glm::vec3(0.0f);
+  glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+  glm::vec3 scale = glm::vec3(1.0f);
+};
+
+/* Decoded 8 bit pixels of a material texture, uploaded after loading. */
+struct GltfImage {
+  int width = 0;
+  int height = 0;
+  int components = 0;
+  std::vector<unsigned char> pixels{};
+};
+
+/* A primitive of one of the meshes, stored in the shared vertex and index buffers. */
+struct GltfPrimitive {
+  int meshNum = 0;
+  int textureNum = 0;
+  GLuint firstIndex = 0;
+  GLuint indexCount = 0;
+  GLint baseVertex = 0;
+  GLuint vertexCount = 0;
+  /* the simplified copies of a primitive have their own vertices */
+  int lod = 0;
+  /* joints skinning every vertex, the primitives are split by it */
+  int jointInfluences = 4;
+  /* sub-mesh palette of the packed joint numbers, -1 for the shared palette */
+  int paletteNum = -1;
+};
+
+/* Vertices and indices of a primitive, read on a worker thread and appended to the
+ * shared vertex data in scene order.
+ */
+struct GltfPrimitiveData {
+  int meshNum = 0;
+  int materialNum = -1;
+  std::vector<glm::vec3> positions{};
+  std::vector<glm::vec3> normals{};
+  std::vector<glm::vec2> texCoords{};
+  std::vector<glm::tvec4<uint16_t>> joints{};
+  std::vector<glm::vec4> weights{};
+  std::vector<glm::tvec4<uint16_t>> joints1{};
+  std::vector<glm::vec4> weights1{};
+  std::vector<uint32_t> indices{};
+};
+
+/* All primitives using the same texture, skinning variant and sub-mesh palette,
+ * drawn by a single indirect call.
+ */
+struct GltfDrawGroup {
+  int textureNum = 0;
+  int jointInfluences = 4;
+  int paletteNum = -1;
+  std::vector<OGLDrawCommand> drawCommands{};
+  /* mesh LOD of every command */
+  std::vector<int> drawCommandLods{};
+};
+
+/* The model holds the data shared by all instances: vertex data, skin,
+ * animation clips and the default node transforms. The pose of a
+ * character lives in GltfInstance.
+ */
 class GltfModel {
  public:
+  /* The model file is a glTF file or a model baked by janus-bake. */
   bool loadModel(OGLRenderData &renderData,
                  std::string modelFilename,
                  std::string textureFilename);
-  void draw();
+  /* The CPU side of the loading, without GL calls. janus-bake writes the result of
+   * the import, reading it back replaces the import at startup.
+   */
+  bool importModel(OGLRenderData &renderData, std::string modelFilename);
+  bool readBakedModel(OGLRenderData &renderData, std::string bakedFilename);
+  bool writeBakedModel(const OGLRenderData &renderData, std::string bakedFilename);
+  /* One indirect draw per texture, the commands are written to the ring buffer. The
+   * instances are sorted by mesh LOD, the counts are given per LOD. A joint count
+   * draws only the primitives of that skinning variant, 0 draws all.
+   */
+  void drawInstanced(RingBuffer &ringBuffer,
+                     const std::vector<int> &lodInstanceCounts,
+                     int jointInfluences = 0);
+  /* Draws the full resolution pre-skinned vertices, instance i starts at vertex
+   * i * getFullResolutionVertexCount().
+   */
+  void drawPreSkinned(RingBuffer &ringBuffer, GLuint vertexArray, int instanceCount);
   void cleanup();
   void uploadVertexBuffers();
-  void uploadIndexBuffer();
+  bool uploadGeometry(std::shared_ptr<GeometryArena> geometryArena);
 
-  std::shared_ptr<OGLMesh> getSkeleton();
-  void setSkeletonSplitNode(int nodeNum);
-  int getJointMatrixSize();
+  /* Mesh LODs, simplified at load time. */
+  int getMeshLodCount();
+  int getMeshLodTriangleCount(int lod);
 
-  std::vector<glm::mat4> getJointMatrices();
-  int getJointDualQuatsSize();
-  std::vector<glm::mat2x4> getJointDualQuats();
-  std::string getNodeName(int nodeNum);
+  /* Raw vertex data, e.g. for the compute skinning. */
+  GLuint getVertexBuffer(std::string attribType);
+  int getVertexCount();
+  /* The vertices of the LOD 0 primitives come first, the mesh LOD copies follow. */
+  int getFullResolutionVertexCount();
+
+  /* CPU copies of the vertex data of all primitives, e.g. for baking. */
+  const std::vector<glm::vec3> &getPositionVec();
+  const std::vector<glm::vec3> &getNormalVec();
+  const std::vector<glm::vec2> &getTexCoordVec();
+  /* The second set holds influences 5 to 8, its weights are 0 for most models. */
+  const std::vector<glm::tvec4<uint16_t>> &getJointVec();
+  const std::vector<glm::vec4> &getWeightVec();
+  const std::vector<glm::tvec4<uint16_t>> &getJointVec1();
+  const std::vector<glm::vec4> &getWeightVec1();
+  bool hasSecondJointSet();
+  /* Joint counts of the primitives, the skinning shader is specialized to each.
+   * The influences of every vertex are sorted by weight, the ones after the
+   * count of its primitive have no weight.
+   */
+  const std::vector<int> &getJointInfluenceBuckets();
+  /* Skeletons with more joints than the packed vertices can address are split into
+   * sub-meshes. The draw binds the joints of the sub-mesh palette to SSBO 12, the
+   * shaders map the packed joint numbers through it.
+   */
+  bool hasLocalPalettes();
 
-  /* Inverse Kinematics */
-  void setInverseKinematicsNodes(int effectorNodeNum, int ikChainRootNodeNum);
+  /* The draw shaders decode the packed positions with offset + position * scale. */
+  glm::vec3 getPositionOffset();
+  glm::vec3 getPositionScale();
+  /* First vertex of the model in the geometry arena, gl_VertexID of the instanced
+   * draws includes it.
+   */
+  int getArenaBaseVertex();
 
-  void setNumIKIterations(int iterations);
+  /* Node tree, every instance creates its own copy. */
+  std::shared_ptr<GltfNode> createNodeTree(std::vector<std::shared_ptr<GltfNode>> &nodeList);
+  void getNodeData(std::shared_ptr<GltfNode> treeNode);
+  int getNodeCount();
+  std::string getNodeName(int nodeNum);
 
-  // CCD - Cyclic Coordinate Descent
-  void solveIKByCCD(glm::vec3 target);
+  /* Skin */
+  int getJointMatrixSize();
+  int getJointDualQuatsSize();
+  const std::vector<glm::mat4> &getInverseBindMatrices();
+  const std::vector<int> &getNodeToJoint();
 
-  // FABRIK - Forwards And Backwards Reaching Inverse Kinematics
-  void solveIKByFABRIK(glm::vec3 target);
+  /* Bounds of the vertices influenced by every joint, in the space of the joint. */
+  const std::vector<BoundingBox> &getJointBounds();
+  const std::vector<glm::mat4> &getBindMatrices();
 
   /* Animations */
-  void playAnimation(int animNum,
-                     float speedDivider,
-                     float blendFactor,
-                     replayDirection direction);
-
-  void playAnimation(int sourceAnimNum,
-                     int destAnimNum,
-                     float speedDivider,
-                     float blendFactor,
-                     replayDirection direction);
-
-  void blendAnimationFrame(int animNumber, float time, float blendFactor);
-  void crossBlendAnimationFrame(int sourceAnimNumber,
-                                int destAnimNumber,
-                                float time,
-                                float blendFactor);
+  const std::vector<std::shared_ptr<GltfAnimationClip>> &getAnimClips();
   float getAnimationEndTime(int animNum);
+  /* Bounds of the baked frames of a clip in model space, set by the animation bake. */
+  void setClipBounds(std::vector<BoundingBox> clipBounds);
+  const BoundingBox &getClipBounds(int animNum);
   std::string getClipName(int animNum);
   void getAnimations();
+  /* Clips of a baked model are decoded on first use, unused ones are evicted over the budget. */
+  void evictAnimClips(size_t memoryBudget);
+  int getResidentClipCount();
+  size_t getResidentClipBytes();
+
+  /* Animation level of detail, the tiers are configured per asset. */
+  void setAnimationLodTiers(std::vector<AnimationLodTier> tiers);
+  const std::vector<AnimationLodTier> &getAnimationLodTiers();
+  const std::vector<bool> &getLodNodeMask(int tierNum);
 
-  void resetNodeData();
+  /* Bounding sphere of the rest pose, xyz is the center and w the radius. */
+  glm::vec4 getBoundingSphere();
 
  private:
   void createVertexBuffers();
-  void createIndexBuffer();
-  int getTriangleCount();
-  void getSkeletonPerNode(std::shared_ptr<GltfNode> treeNode);
-
-  /* Armature. */
-  void getJointData();
-  void getWeightData();
-  void getInvBindMatrices();
-  void getNodes(std::shared_ptr<GltfNode> treeNode);
-  void getNodeData(std::shared_ptr<GltfNode> treeNode);
-  void resetNodeData(std::shared_ptr<GltfNode> treeNode);
-  void updateNodeMatrices(std::shared_ptr<GltfNode> treeNode);
-  void updateJointMatricesAndQuats(std::shared_ptr<GltfNode> treeNode);
-  void updateAdditiveMask(std::shared_ptr<GltfNode> treeNode, int splitNodeNum);
-
-  // Joint data is hardcoded to the test model.
-  // Will need to check componentType field to convert
-  // the joint data to the data type used in the shader during model creation.
+  void createTextures();
+  void calculateBoundingSphere();
+
+  /* Meshes, every primitive of the scene is appended to the shared vertex data. */
+  bool getPrimitives();
+  /* Reads the glTF data only, safe to call for several primitives in parallel. */
+  bool readPrimitive(int nodeNum,
+                     int meshNum,
+                     const tinygltf::Primitive &primitive,
+                     GltfPrimitiveData &primitiveData);
+  void appendPrimitive(const GltfPrimitiveData &primitiveData);
+  void createMeshLods();
+  /* Returns the largest position error of the pruning, see getSamplePalettes(). */
+  float pruneJointInfluences(int maxInfluences);
+  void compactJointPalette();
+  std::vector<std::pair<int, int>> splitPrimitives(
+      const std::vector<std::vector<int>> &triangleParts);
+  void splitInfluenceBuckets();
+  void splitJointPalettes();
+  void getPaletteJoints(std::vector<glm::tvec4<uint16_t>> &joints,
+                        std::vector<glm::tvec4<uint16_t>> &joints1);
+  void optimizePrimitives();
+  MeshStats getMeshStats(const std::vector<GltfPrimitive> &primitives,
+                         const std::vector<uint32_t> &indices);
+  int getMaterialTexture(int materialNum);
+  void createDrawGroups();
+  void drawCommandGroups(RingBuffer &ringBuffer, GLuint vertexArray);
+
+  /* Nodes of the scene without the meshes, every node tree is created from it. */
+  void getSkeleton();
+
+  /* Armature, all skins share a single joint palette with the joints used by the vertices. */
+  bool getSkins();
+  void calculateJointBounds();
+  /* Joint matrices of the rest pose and of some frames of every clip. */
+  std::vector<std::vector<glm::mat4>> getSamplePalettes();
+  void getNodes(std::shared_ptr<GltfNode> treeNode,
+                std::vector<std::shared_ptr<GltfNode>> &nodeList);
+  int getNodeHeights(std::shared_ptr<GltfNode> treeNode);
+  void updateLodNodeMasks();
+
+  /* Vertex data of all primitives, the joints are numbers in the shared palette. */
+  std::vector<glm::vec3> mPositions{};
+  std::vector<glm::vec3> mNormals{};
+  std::vector<glm::vec2> mTexCoords{};
   std::vector<glm::tvec4<uint16_t>> mJointVec{};
   std::vector<glm::vec4> mWeightVec{};
+  std::vector<glm::tvec4<uint16_t>> mJointVec1{};
+  std::vector<glm::vec4> mWeightVec1{};
+  /* relative to the base vertex of the primitive */
+  std::vector<uint32_t> mIndices{};
+  GLenum mIndexType = GL_UNSIGNED_SHORT;
+
+  std::vector<GltfPrimitive> mPrimitives{};
+  std::vector<GltfDrawGroup> mDrawGroups{};
+  /* commands of all groups, updated with the instance count of the draw */
+  std::vector<OGLDrawCommand> mDrawCommands{};
+  std::vector<GLsizei> mDrawGroupCommandCounts{};
+  std::vector<int> mMeshLodTriangleCounts{};
+  std::vector<int> mJointInfluenceBuckets{};
+  /* joints of the sub-mesh palettes, stored at aligned offsets in one buffer */
+  std::vector<std::vector<int>> mPalettes{};
+  GLuint mPaletteJointBuffer = 0;
+  std::vector<GLintptr> mPaletteJointOffsets{};
+
   std::vector<glm::mat4> mInverseBindMatrices{};
-  std::vector<glm::mat4> mJointMatrices{};
-  std::vector<glm::mat2x4> mJointDualQuats{};
+  std::vector<glm::mat4> mBindMatrices{};
+  std::vector<BoundingBox> mJointBounds{};
 
-  std::vector<int> mAttribAccessors{};
+  /* -1 for nodes that are not part of a skin */
   std::vector<int> mNodeToJoint{};
+  /* Transforms the vertices of a skin into the bind space of the shared palette. */
+  std::vector<glm::mat4> mSkinBindShapes{};
 
-  std::vector<glm::vec3> mAlteredPositions{};
+  std::vector<GltfSkeletonNode> mSkeleton{};
+  int mRootNodeNum = 0;
 
+  /* Template tree, used for the node names and the joint heights. */
   std::shared_ptr<GltfNode> mRootNode = nullptr;
+  /* only set during the import, the mapping of a .glb file is read by the accessors */
   std::shared_ptr<tinygltf::Model> mModel = nullptr;
-
-  std::shared_ptr<OGLMesh> mSkeletonMesh = nullptr;
+  std::shared_ptr<GltfFile> mGltfFile = nullptr;
 
   std::vector<std::shared_ptr<GltfNode>> mNodeList;
 
-  std::vector<bool> mAdditiveAnimationMask{};
-  std::vector<bool> mInvertedAdditiveAnimationMask{};
+  /* Number of levels between a node and the deepest leaf below it. */
+  std::vector<int> mNodeHeights{};
+
+  std::vector<AnimationLodTier> mAnimationLodTiers{};
+  std::vector<std::vector<bool>> mLodNodeMasks{};
+
+  glm::vec4 mBoundingSphere = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
 
   // Animation
   std::vector<std::shared_ptr<GltfAnimationClip>> mAnimClips{};
+  std::vector<BoundingBox> mClipBounds{};
+  unsigned int mClipUseFrame = 0;
+  std::vector<unsigned int> mClipLastUseFrames{};
+  int mResidentClipCount = 0;
+  size_t mResidentClipBytes = 0;
 
-  GLuint mVAO = 0;
   std::vector<GLuint> mVertexVBO{};
-  GLuint mIndexVBO = 0;
+  PackedVertexData mPackedVertexData{};
+  std::shared_ptr<GeometryArena> mGeometryArena = nullptr;
+  GeometryAllocation mGeometry{};
 
   std::map<std::string, GLint> attributes = {
-      {"POSITION", 0}, {"NORMAL", 1}, {"TEXCOORD_0", 2}, {"JOINTS_0", 3}, {"WEIGHTS_0", 4}};
-  Texture mTex{};
-
-  IKSolver mIKSolver{};
-};
\ No newline at end of file
+      {"POSITION", 0},
+      {"NORMAL", 1},
+      {"TEXCOORD_0", 2},
+      {"JOINTS_0", 3},
+      {"WEIGHTS_0", 4},
+      {"JOINTS_1", 5},
+      {"WEIGHTS_1", 6}};
+  /* texture 0 is the one given to loadModel, used by all primitives without an own texture,
+   * texture n is created from image n - 1
+   */
+  std::vector<Texture> mTextures{};
+  /* pixels of texture 0, decoded while the model loads */
+  GltfImage mDefaultImage{};
+  std::vector<GltfImage> mImages{};
+  std::map<int, int> mImageTextures{};
+};
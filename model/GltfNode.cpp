@@ -22,7 +22,7 @@ void GltfNode::addChilds(std::vector<int> childNodes) {
   }
 }
 
-std::vector<std::shared_ptr<GltfNode>> GltfNode::getChilds() {
+const std::vector<std::shared_ptr<GltfNode>> &GltfNode::getChilds() {
   return mChildNodes;
 }
 
@@ -93,6 +93,10 @@ glm::mat4 GltfNode::getNodeMatrix() {
   return mNodeMatrix;
 }
 
+void GltfNode::setNodeMatrix(const glm::mat4 &nodeMatrix) {
+  mNodeMatrix = nodeMatrix;
+}
+
 std::string GltfNode::getNodeName() {
   return mNodeName;
 }
@@ -110,6 +114,14 @@ glm::quat GltfNode::getLocalRotation() {
   return mBlendRotation;
 }
 
+glm::vec3 GltfNode::getLocalTranslation() {
+  return mBlendTranslation;
+}
+
+glm::vec3 GltfNode::getLocalScale() {
+  return mBlendScale;
+}
+
 glm::quat GltfNode::getGlobalRotation() {
   glm::quat orientation;
   glm::vec3 scale;
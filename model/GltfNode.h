@@ -15,11 +15,13 @@ class GltfNode : public std::enable_shared_from_this<GltfNode> {
   static std::shared_ptr<GltfNode> createRoot(int rootNodeNum);
   void addChilds(std::vector<int> childNodes);
 
-  std::vector<std::shared_ptr<GltfNode>> getChilds();
+  const std::vector<std::shared_ptr<GltfNode>> &getChilds();
   int getNodeNum();
   std::string getNodeName();
   std::shared_ptr<GltfNode> getParentNode();
   glm::quat getLocalRotation();
+  glm::vec3 getLocalTranslation();
+  glm::vec3 getLocalScale();
   glm::quat getGlobalRotation();
   glm::vec3 getGlobalPosition();
 
@@ -37,6 +39,8 @@ class GltfNode : public std::enable_shared_from_this<GltfNode> {
   void calculateLocalTRSMatrix();
   void calculateNodeMatrix();
   glm::mat4 getNodeMatrix();
+  /* Takes over a node matrix evaluated elsewhere, e.g. from the pose cache. */
+  void setNodeMatrix(const glm::mat4 &nodeMatrix);
 
   void printTree();
 
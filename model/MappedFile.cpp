@@ -0,0 +1,55 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Logger.h"
+#include "MappedFile.h"
+
+MappedFile::~MappedFile() {
+  unmap();
+}
+
+bool MappedFile::map(std::string fileName) {
+  unmap();
+
+  int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) {
+    Logger::log(1, "%s error: could not open file '%s'\n", __FUNCTION__, fileName.c_str());
+    return false;
+  }
+
+  struct stat fileStat {};
+  if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+    Logger::log(1, "%s error: file '%s' is empty\n", __FUNCTION__, fileName.c_str());
+    close(fd);
+    return false;
+  }
+
+  void *mapping = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    Logger::log(1, "%s error: could not map file '%s'\n", __FUNCTION__, fileName.c_str());
+    return false;
+  }
+
+  mMapping = mapping;
+  mSize = fileStat.st_size;
+  return true;
+}
+
+void MappedFile::unmap() {
+  if (mMapping) {
+    munmap(mMapping, mSize);
+  }
+  mMapping = nullptr;
+  mSize = 0;
+}
+
+const unsigned char *MappedFile::getData() const {
+  return static_cast<const unsigned char *>(mMapping);
+}
+
+size_t MappedFile::getSize() const {
+  return mSize;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/* A read-only memory mapping of a whole file. The pages are read on first
+ * access, nothing is copied.
+ */
+class MappedFile {
+ public:
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile();
+
+  bool map(std::string fileName);
+  void unmap();
+
+  const unsigned char *getData() const;
+  size_t getSize() const;
+
+ private:
+  void *mMapping = nullptr;
+  size_t mSize = 0;
+};
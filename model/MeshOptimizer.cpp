@@ -0,0 +1,277 @@
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+#include "MeshOptimizer.h"
+
+namespace {
+/* cache of the vertex fetch, 64 lines of 64 bytes */
+const size_t fetchLineSize = 64;
+const size_t fetchCacheLines = 64;
+}  // namespace
+
+void MeshStats::add(const MeshStats &stats) {
+  triangleCount += stats.triangleCount;
+  vertexCount += stats.vertexCount;
+  transformedVertices += stats.transformedVertices;
+  fetchedBytes += stats.fetchedBytes;
+  vertexBufferSize += stats.vertexBufferSize;
+}
+
+float MeshStats::getACMR() const {
+  return triangleCount > 0 ? static_cast<float>(transformedVertices) / triangleCount : 0.0f;
+}
+
+float MeshStats::getATVR() const {
+  return vertexCount > 0 ? static_cast<float>(transformedVertices) / vertexCount : 0.0f;
+}
+
+float MeshStats::getOverfetch() const {
+  return vertexBufferSize > 0 ? static_cast<float>(fetchedBytes) / vertexBufferSize : 0.0f;
+}
+
+/* FIFO caches for both the transformed vertices and the fetched cache lines, a
+ * vertex is only fetched if it misses the post-transform cache.
+ */
+MeshStats MeshOptimizer::analyze(const std::vector<uint32_t> &indices,
+                                 size_t vertexCount,
+                                 size_t vertexSize) {
+  MeshStats stats{};
+  stats.triangleCount = indices.size() / 3;
+  stats.vertexCount = vertexCount;
+  stats.vertexBufferSize = vertexCount * vertexSize;
+
+  std::deque<uint32_t> vertexCache{};
+  std::deque<size_t> lineCache{};
+  for (uint32_t index : indices) {
+    if (std::find(vertexCache.begin(), vertexCache.end(), index) != vertexCache.end()) {
+      continue;
+    }
+    vertexCache.push_back(index);
+    if (vertexCache.size() > mCacheSize) {
+      vertexCache.pop_front();
+    }
+    ++stats.transformedVertices;
+
+    size_t firstLine = index * vertexSize / fetchLineSize;
+    size_t lastLine = ((index + 1) * vertexSize - 1) / fetchLineSize;
+    for (size_t line = firstLine; line <= lastLine; ++line) {
+      if (std::find(lineCache.begin(), lineCache.end(), line) != lineCache.end()) {
+        continue;
+      }
+      lineCache.push_back(line);
+      if (lineCache.size() > fetchCacheLines) {
+        lineCache.pop_front();
+      }
+      stats.fetchedBytes += fetchLineSize;
+    }
+  }
+  return stats;
+}
+
+std::vector<uint32_t> MeshOptimizer::weldVertices(std::vector<uint32_t> &indices,
+                                                  const std::vector<std::string> &vertexKeys) {
+  std::vector<uint32_t> remap(vertexKeys.size());
+  std::unordered_map<std::string, uint32_t> uniqueVertices{};
+  for (size_t i = 0; i < vertexKeys.size(); ++i) {
+    remap.at(i) = uniqueVertices.emplace(vertexKeys.at(i), uniqueVertices.size()).first->second;
+  }
+  for (uint32_t &index : indices) {
+    index = remap.at(index);
+  }
+  return remap;
+}
+
+/* Tipsify, from Sander et al., "Fast Triangle Reordering for Vertex Locality and
+ * Reduced Overdraw". All triangles around a fanning vertex are emitted, the next
+ * fanning vertex is a recently used one that will still be in the cache after
+ * its remaining triangles are emitted. A dead end, i.e. no such vertex, starts a
+ * new cluster.
+ */
+std::vector<size_t> MeshOptimizer::optimizeVertexCache(std::vector<uint32_t> &indices,
+                                                       size_t vertexCount) {
+  size_t triangleCount = indices.size() / 3;
+  std::vector<size_t> clusters{};
+  if (triangleCount == 0) {
+    return clusters;
+  }
+
+  /* triangles using a vertex, as offsets into a single list */
+  std::vector<uint32_t> liveTriangles(vertexCount, 0);
+  for (uint32_t index : indices) {
+    ++liveTriangles.at(index);
+  }
+  std::vector<size_t> adjacencyOffsets(vertexCount + 1, 0);
+  for (size_t i = 0; i < vertexCount; ++i) {
+    adjacencyOffsets.at(i + 1) = adjacencyOffsets.at(i) + liveTriangles.at(i);
+  }
+  std::vector<uint32_t> adjacency(indices.size());
+  std::vector<size_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+  for (size_t i = 0; i < indices.size(); ++i) {
+    adjacency.at(adjacencyFill.at(indices.at(i))++) = i / 3;
+  }
+
+  std::vector<int> cacheTime(vertexCount, 0);
+  std::vector<bool> emitted(triangleCount, false);
+  std::vector<uint32_t> deadEnds{};
+  std::vector<uint32_t> candidates{};
+  std::vector<uint32_t> output{};
+  output.reserve(indices.size());
+
+  int time = mCacheSize + 1;
+  size_t cursor = 0;
+  int fanningVertex = 0;
+  clusters.push_back(0);
+
+  while (fanningVertex >= 0) {
+    candidates.clear();
+    for (size_t i = adjacencyOffsets.at(fanningVertex); i < adjacencyOffsets.at(fanningVertex + 1);
+         ++i)
+    {
+      uint32_t triangle = adjacency.at(i);
+      if (emitted.at(triangle)) {
+        continue;
+      }
+      for (int j = 0; j < 3; ++j) {
+        uint32_t vertex = indices.at(triangle * 3 + j);
+        output.push_back(vertex);
+        deadEnds.push_back(vertex);
+        candidates.push_back(vertex);
+        --liveTriangles.at(vertex);
+        if (time - cacheTime.at(vertex) > mCacheSize) {
+          cacheTime.at(vertex) = time++;
+        }
+      }
+      emitted.at(triangle) = true;
+    }
+
+    /* the candidate staying longest in the cache, if all its triangles still fit */
+    fanningVertex = -1;
+    int bestPriority = -1;
+    for (uint32_t vertex : candidates) {
+      if (liveTriangles.at(vertex) == 0) {
+        continue;
+      }
+      int priority = 0;
+      if (time - cacheTime.at(vertex) + 2 * static_cast<int>(liveTriangles.at(vertex)) <=
+          mCacheSize)
+      {
+        priority = time - cacheTime.at(vertex);
+      }
+      if (priority > bestPriority) {
+        bestPriority = priority;
+        fanningVertex = vertex;
+      }
+    }
+    if (fanningVertex >= 0) {
+      continue;
+    }
+
+    /* dead end: the latest vertex with triangles left, or the next one in input order */
+    while (!deadEnds.empty() && fanningVertex < 0) {
+      uint32_t vertex = deadEnds.back();
+      deadEnds.pop_back();
+      if (liveTriangles.at(vertex) > 0) {
+        fanningVertex = vertex;
+      }
+    }
+    while (cursor < vertexCount && fanningVertex < 0) {
+      if (liveTriangles.at(cursor) > 0) {
+        fanningVertex = cursor;
+      }
+      ++cursor;
+    }
+    if (fanningVertex >= 0 && output.size() / 3 > clusters.back()) {
+      clusters.push_back(output.size() / 3);
+    }
+  }
+
+  indices = output;
+  return clusters;
+}
+
+/* Clusters facing away from the center of the mesh are likely in front of the
+ * others, they are drawn first so the depth test rejects more of the rest.
+ */
+void MeshOptimizer::optimizeOverdraw(std::vector<uint32_t> &indices,
+                                     const std::vector<glm::vec3> &positions,
+                                     const std::vector<size_t> &clusters) {
+  size_t triangleCount = indices.size() / 3;
+  if (clusters.size() < 2) {
+    return;
+  }
+
+  glm::vec3 meshCenter = glm::vec3(0.0f);
+  for (const auto &position : positions) {
+    meshCenter += position;
+  }
+  meshCenter /= static_cast<float>(std::max<size_t>(positions.size(), 1));
+
+  std::vector<float> clusterSortKeys(clusters.size());
+  for (size_t i = 0; i < clusters.size(); ++i) {
+    size_t lastTriangle = i + 1 < clusters.size() ? clusters.at(i + 1) : triangleCount;
+
+    /* area weighted, the length of the cross product is twice the area */
+    glm::vec3 clusterCenter = glm::vec3(0.0f);
+    glm::vec3 clusterNormal = glm::vec3(0.0f);
+    float clusterArea = 0.0f;
+    for (size_t triangle = clusters.at(i); triangle < lastTriangle; ++triangle) {
+      glm::vec3 p0 = positions.at(indices.at(triangle * 3));
+      glm::vec3 p1 = positions.at(indices.at(triangle * 3 + 1));
+      glm::vec3 p2 = positions.at(indices.at(triangle * 3 + 2));
+      glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+      float area = glm::length(normal);
+      clusterCenter += (p0 + p1 + p2) * (area / 3.0f);
+      clusterNormal += normal;
+      clusterArea += area;
+    }
+    if (clusterArea > 0.0f) {
+      clusterCenter /= clusterArea;
+    }
+    if (glm::length(clusterNormal) > 0.0f) {
+      clusterNormal = glm::normalize(clusterNormal);
+    }
+    clusterSortKeys.at(i) = glm::dot(clusterCenter - meshCenter, clusterNormal);
+  }
+
+  std::vector<size_t> clusterOrder(clusters.size());
+  std::iota(clusterOrder.begin(), clusterOrder.end(), 0);
+  std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&](size_t a, size_t b) {
+    return clusterSortKeys.at(a) > clusterSortKeys.at(b);
+  });
+
+  std::vector<uint32_t> sortedIndices{};
+  sortedIndices.reserve(indices.size());
+  for (size_t cluster : clusterOrder) {
+    size_t lastTriangle = cluster + 1 < clusters.size() ? clusters.at(cluster + 1)
+                                                        : triangleCount;
+    sortedIndices.insert(sortedIndices.end(),
+                         indices.begin() + clusters.at(cluster) * 3,
+                         indices.begin() + lastTriangle * 3);
+  }
+  indices = sortedIndices;
+}
+
+std::vector<uint32_t> MeshOptimizer::optimizeVertexFetch(std::vector<uint32_t> &indices,
+                                                         size_t vertexCount) {
+  const uint32_t unused = std::numeric_limits<uint32_t>::max();
+  std::vector<uint32_t> remap(vertexCount, unused);
+
+  uint32_t nextVertex = 0;
+  for (uint32_t &index : indices) {
+    if (remap.at(index) == unused) {
+      remap.at(index) = nextVertex++;
+    }
+    index = remap.at(index);
+  }
+
+  /* vertices without triangles are moved to the end */
+  for (uint32_t &vertex : remap) {
+    if (vertex == unused) {
+      vertex = nextVertex++;
+    }
+  }
+  return remap;
+}
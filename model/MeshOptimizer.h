@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/* Simulated cost of drawing a triangle list. */
+struct MeshStats {
+  size_t triangleCount = 0;
+  size_t vertexCount = 0;
+  /* vertices missing the post-transform cache, i.e. vertex shader invocations */
+  size_t transformedVertices = 0;
+  /* bytes read from the vertex buffer, in cache lines */
+  size_t fetchedBytes = 0;
+  size_t vertexBufferSize = 0;
+
+  void add(const MeshStats &stats);
+  /* average cache miss ratio, transformed vertices per triangle */
+  float getACMR() const;
+  /* transformed vertices per vertex, 1.0 is the optimum */
+  float getATVR() const;
+  /* fetched bytes per byte of the vertex buffer, 1.0 is the optimum */
+  float getOverfetch() const;
+};
+
+/* Load-time reordering of indexed triangle lists, the indices are relative to the
+ * first vertex of the primitive:
+ * - vertices with identical attributes are merged
+ * - triangles are reordered for the post-transform vertex cache (Tipsify)
+ * - the clusters found on the way are sorted outside-in against overdraw
+ * - vertices are renumbered in the order of their first use for the vertex fetch
+ */
+class MeshOptimizer {
+ public:
+  static const int mCacheSize = 16;
+
+  static MeshStats analyze(const std::vector<uint32_t> &indices,
+                           size_t vertexCount,
+                           size_t vertexSize);
+
+  /* Merges the vertices with equal keys, the result maps the old vertex numbers to
+   * the new ones and the number of unique vertices is one more than its maximum.
+   */
+  static std::vector<uint32_t> weldVertices(std::vector<uint32_t> &indices,
+                                            const std::vector<std::string> &vertexKeys);
+  /* Returns the first triangle of every cluster. */
+  static std::vector<size_t> optimizeVertexCache(std::vector<uint32_t> &indices,
+                                                 size_t vertexCount);
+  static void optimizeOverdraw(std::vector<uint32_t> &indices,
+                               const std::vector<glm::vec3> &positions,
+                               const std::vector<size_t> &clusters);
+  /* Renumbers the vertices, the result maps the old vertex numbers to the new ones. */
+  static std::vector<uint32_t> optimizeVertexFetch(std::vector<uint32_t> &indices,
+                                                   size_t vertexCount);
+
+  /* Reorders a vertex stream with the result of weldVertices() or optimizeVertexFetch(). */
+  template <typename T>
+  static void remapVertices(std::vector<T> &vertices,
+                            size_t firstVertex,
+                            const std::vector<uint32_t> &remap) {
+    std::vector<T> source(vertices.begin() + firstVertex,
+                          vertices.begin() + firstVertex + remap.size());
+    for (size_t i = 0; i < remap.size(); ++i) {
+      vertices.at(firstVertex + remap.at(i)) = source.at(i);
+    }
+  }
+};
@@ -0,0 +1,408 @@
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <queue>
+#include <tuple>
+
+#include "MeshSimplifier.h"
+
+namespace {
+/* collapses between different skins are charged like a move, a completely
+ * different skin costs as much as a move by 6% of the mesh radius
+ */
+const float skinError = 0.03f;
+/* triangles turning further than this, as the cosine of the angle, are flips */
+const float minNormalDot = 0.25f;
+
+/* Sum of the squared distances to a set of planes, as a symmetric 4x4 matrix. */
+struct Quadric {
+  double values[10] = {};
+
+  void addPlane(const glm::vec3 &normal, float distance) {
+    double plane[4] = {normal.x, normal.y, normal.z, distance};
+    int k = 0;
+    for (int i = 0; i < 4; ++i) {
+      for (int j = i; j < 4; ++j) {
+        values[k++] += plane[i] * plane[j];
+      }
+    }
+  }
+  void add(const Quadric &other) {
+    for (int k = 0; k < 10; ++k) {
+      values[k] += other.values[k];
+    }
+  }
+  double evaluate(const glm::vec3 &point) const {
+    double vector[4] = {point.x, point.y, point.z, 1.0};
+    double error = 0.0;
+    int k = 0;
+    for (int i = 0; i < 4; ++i) {
+      for (int j = i; j < 4; ++j) {
+        error += (i == j ? 1.0 : 2.0) * values[k++] * vector[i] * vector[j];
+      }
+    }
+    return std::max(error, 0.0);
+  }
+};
+
+struct Collapse {
+  double cost = 0.0;
+  uint32_t fromGroup = 0;
+  uint32_t toGroup = 0;
+
+  /* the priority queue returns the cheapest collapse first */
+  bool operator<(const Collapse &other) const {
+    return cost > other.cost;
+  }
+};
+
+/* Vertices at the same position form a group, the vertices of a group with the
+ * same UV form a wedge. Collapses move whole groups, every wedge follows the
+ * wedge of the target group it shares an edge with.
+ */
+struct SimplifierMesh {
+  std::vector<uint32_t> vertexGroups{};
+  std::vector<uint32_t> vertexWedges{};
+  std::vector<std::vector<uint32_t>> wedgeVertices{};
+
+  std::vector<glm::vec3> groupPositions{};
+  /* the skin of the first vertex stands for the group */
+  std::vector<uint32_t> groupFirstVertex{};
+  std::vector<Quadric> groupQuadrics{};
+  /* may contain removed triangles, all others use the group */
+  std::vector<std::vector<uint32_t>> groupTriangles{};
+  std::vector<bool> groupLocked{};
+  std::vector<bool> groupRemoved{};
+
+  /* the current vertex of every triangle corner */
+  std::vector<uint32_t> corners{};
+  std::vector<bool> triangleRemoved{};
+  size_t triangleCount = 0;
+  float radius = 0.0f;
+};
+
+float getSkinDistance(const glm::tvec4<uint16_t> &jointsA,
+                      const glm::vec4 &weightsA,
+                      const glm::tvec4<uint16_t> &jointsB,
+                      const glm::vec4 &weightsB) {
+  /* the same joint may be stored in another slot, or in several */
+  std::vector<uint16_t> skinJoints{};
+  for (int i = 0; i < 4; ++i) {
+    for (uint16_t joint : {jointsA[i], jointsB[i]}) {
+      if (std::find(skinJoints.begin(), skinJoints.end(), joint) == skinJoints.end()) {
+        skinJoints.push_back(joint);
+      }
+    }
+  }
+
+  float distance = 0.0f;
+  for (uint16_t joint : skinJoints) {
+    float weightA = 0.0f;
+    float weightB = 0.0f;
+    for (int i = 0; i < 4; ++i) {
+      weightA += jointsA[i] == joint ? weightsA[i] : 0.0f;
+      weightB += jointsB[i] == joint ? weightsB[i] : 0.0f;
+    }
+    distance += std::abs(weightA - weightB);
+  }
+  return distance;
+}
+
+glm::vec3 getTriangleNormal(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2) {
+  return glm::cross(p1 - p0, p2 - p0);
+}
+
+/* Checks a collapse and returns its cost, the wedges of the source group are mapped
+ * to the wedges of the target group.
+ */
+bool evaluateCollapse(const SimplifierMesh &mesh,
+                      const std::vector<glm::tvec4<uint16_t>> &joints,
+                      const std::vector<glm::vec4> &weights,
+                      uint32_t fromGroup,
+                      uint32_t toGroup,
+                      Collapse &collapse,
+                      std::map<uint32_t, uint32_t> &wedgeMap) {
+  if (fromGroup == toGroup || mesh.groupLocked.at(fromGroup) ||
+      mesh.groupRemoved.at(fromGroup) || mesh.groupRemoved.at(toGroup))
+  {
+    return false;
+  }
+
+  /* every wedge must share an edge with exactly one wedge of the target */
+  wedgeMap.clear();
+  std::vector<uint32_t> usedWedges{};
+  const glm::vec3 &toPosition = mesh.groupPositions.at(toGroup);
+  for (uint32_t triangle : mesh.groupTriangles.at(fromGroup)) {
+    if (mesh.triangleRemoved.at(triangle)) {
+      continue;
+    }
+
+    int fromCorner = -1;
+    int toCorner = -1;
+    for (int k = 0; k < 3; ++k) {
+      uint32_t group = mesh.vertexGroups.at(mesh.corners.at(triangle * 3 + k));
+      if (group == fromGroup) {
+        fromCorner = k;
+      }
+      else if (group == toGroup) {
+        toCorner = k;
+      }
+    }
+    uint32_t fromWedge = mesh.vertexWedges.at(mesh.corners.at(triangle * 3 + fromCorner));
+    usedWedges.push_back(fromWedge);
+
+    if (toCorner >= 0) {
+      uint32_t toWedge = mesh.vertexWedges.at(mesh.corners.at(triangle * 3 + toCorner));
+      auto mapping = wedgeMap.emplace(fromWedge, toWedge).first;
+      if (mapping->second != toWedge) {
+        return false;
+      }
+      continue;
+    }
+
+    /* the remaining triangles must not flip */
+    glm::vec3 oldPositions[3];
+    glm::vec3 newPositions[3];
+    for (int k = 0; k < 3; ++k) {
+      oldPositions[k] =
+          mesh.groupPositions.at(mesh.vertexGroups.at(mesh.corners.at(triangle * 3 + k)));
+      newPositions[k] = k == fromCorner ? toPosition : oldPositions[k];
+    }
+    glm::vec3 oldNormal = getTriangleNormal(oldPositions[0], oldPositions[1], oldPositions[2]);
+    glm::vec3 newNormal = getTriangleNormal(newPositions[0], newPositions[1], newPositions[2]);
+    float oldLength = glm::length(oldNormal);
+    float newLength = glm::length(newNormal);
+    if (newLength <= 0.0f || (oldLength > 0.0f && glm::dot(oldNormal, newNormal) <
+                                                      minNormalDot * oldLength * newLength))
+    {
+      return false;
+    }
+  }
+
+  if (wedgeMap.empty()) {
+    return false;
+  }
+  for (uint32_t wedge : usedWedges) {
+    if (wedgeMap.count(wedge) == 0) {
+      return false;
+    }
+  }
+
+  uint32_t fromVertex = mesh.groupFirstVertex.at(fromGroup);
+  uint32_t toVertex = mesh.groupFirstVertex.at(toGroup);
+  double skinCost = skinError * mesh.radius *
+                    getSkinDistance(joints.at(fromVertex),
+                                    weights.at(fromVertex),
+                                    joints.at(toVertex),
+                                    weights.at(toVertex));
+
+  Quadric quadric = mesh.groupQuadrics.at(fromGroup);
+  quadric.add(mesh.groupQuadrics.at(toGroup));
+  collapse.cost = quadric.evaluate(toPosition) + skinCost * skinCost;
+  collapse.fromGroup = fromGroup;
+  collapse.toGroup = toGroup;
+  return true;
+}
+
+void applyCollapse(SimplifierMesh &mesh,
+                   const std::vector<glm::vec3> &normals,
+                   const Collapse &collapse,
+                   const std::map<uint32_t, uint32_t> &wedgeMap) {
+  std::vector<uint32_t> &toTriangles = mesh.groupTriangles.at(collapse.toGroup);
+  for (uint32_t triangle : mesh.groupTriangles.at(collapse.fromGroup)) {
+    if (mesh.triangleRemoved.at(triangle)) {
+      continue;
+    }
+
+    bool hasToGroup = false;
+    for (int k = 0; k < 3; ++k) {
+      uint32_t group = mesh.vertexGroups.at(mesh.corners.at(triangle * 3 + k));
+      hasToGroup = hasToGroup || group == collapse.toGroup;
+    }
+    if (hasToGroup) {
+      mesh.triangleRemoved.at(triangle) = true;
+      --mesh.triangleCount;
+      continue;
+    }
+
+    /* the vertex of the target wedge with the closest normal keeps flat shading intact */
+    for (int k = 0; k < 3; ++k) {
+      uint32_t &vertex = mesh.corners.at(triangle * 3 + k);
+      if (mesh.vertexGroups.at(vertex) != collapse.fromGroup) {
+        continue;
+      }
+      const std::vector<uint32_t> &targets =
+          mesh.wedgeVertices.at(wedgeMap.at(mesh.vertexWedges.at(vertex)));
+      uint32_t bestVertex = targets.front();
+      float bestDot = -2.0f;
+      for (uint32_t target : targets) {
+        float dot = glm::dot(normals.at(vertex), normals.at(target));
+        if (dot > bestDot) {
+          bestDot = dot;
+          bestVertex = target;
+        }
+      }
+      vertex = bestVertex;
+    }
+    toTriangles.push_back(triangle);
+  }
+
+  mesh.groupQuadrics.at(collapse.toGroup).add(mesh.groupQuadrics.at(collapse.fromGroup));
+  mesh.groupRemoved.at(collapse.fromGroup) = true;
+  mesh.groupTriangles.at(collapse.fromGroup).clear();
+}
+}  // namespace
+
+std::vector<std::vector<uint32_t>> MeshSimplifier::simplify(
+    const std::vector<uint32_t> &indices,
+    const std::vector<glm::vec3> &positions,
+    const std::vector<glm::vec3> &normals,
+    const std::vector<glm::vec2> &texCoords,
+    const std::vector<glm::tvec4<uint16_t>> &joints,
+    const std::vector<glm::vec4> &weights,
+    const std::vector<size_t> &targetTriangleCounts,
+    float maxError) {
+  SimplifierMesh mesh{};
+  size_t vertexCount = positions.size();
+
+  /* groups and wedges of bit-equal positions and UVs */
+  std::map<std::tuple<float, float, float>, uint32_t> groupsByPosition{};
+  std::map<std::tuple<uint32_t, float, float>, uint32_t> wedgesByTexCoord{};
+  mesh.vertexGroups.resize(vertexCount);
+  mesh.vertexWedges.resize(vertexCount);
+  for (uint32_t i = 0; i < vertexCount; ++i) {
+    const glm::vec3 &position = positions.at(i);
+    auto group = groupsByPosition.emplace(std::make_tuple(position.x, position.y, position.z),
+                                          mesh.groupPositions.size());
+    if (group.second) {
+      mesh.groupPositions.push_back(position);
+      mesh.groupFirstVertex.push_back(i);
+    }
+    mesh.vertexGroups.at(i) = group.first->second;
+
+    const glm::vec2 &texCoord = texCoords.at(i);
+    auto wedge = wedgesByTexCoord.emplace(
+        std::make_tuple(group.first->second, texCoord.x, texCoord.y), mesh.wedgeVertices.size());
+    if (wedge.second) {
+      mesh.wedgeVertices.emplace_back();
+    }
+    mesh.vertexWedges.at(i) = wedge.first->second;
+    mesh.wedgeVertices.at(wedge.first->second).push_back(i);
+  }
+
+  size_t groupCount = mesh.groupPositions.size();
+  mesh.groupQuadrics.resize(groupCount);
+  mesh.groupTriangles.resize(groupCount);
+  mesh.groupLocked.assign(groupCount, false);
+  mesh.groupRemoved.assign(groupCount, false);
+
+  glm::vec3 center = glm::vec3(0.0f);
+  for (const auto &position : mesh.groupPositions) {
+    center += position;
+  }
+  center /= static_cast<float>(std::max<size_t>(groupCount, 1));
+  for (const auto &position : mesh.groupPositions) {
+    mesh.radius = std::max(mesh.radius, glm::length(position - center));
+  }
+  double maxCost = static_cast<double>(maxError) * mesh.radius * maxError * mesh.radius;
+
+  /* the planes of the triangles, edges without exactly two triangles are borders */
+  mesh.corners = indices;
+  mesh.triangleRemoved.assign(indices.size() / 3, false);
+  std::map<std::pair<uint32_t, uint32_t>, int> edgeTriangles{};
+  for (uint32_t triangle = 0; triangle < indices.size() / 3; ++triangle) {
+    uint32_t groups[3];
+    glm::vec3 points[3];
+    for (int k = 0; k < 3; ++k) {
+      groups[k] = mesh.vertexGroups.at(indices.at(triangle * 3 + k));
+      points[k] = mesh.groupPositions.at(groups[k]);
+    }
+    if (groups[0] == groups[1] || groups[1] == groups[2] || groups[0] == groups[2]) {
+      mesh.triangleRemoved.at(triangle) = true;
+      continue;
+    }
+    ++mesh.triangleCount;
+
+    glm::vec3 normal = getTriangleNormal(points[0], points[1], points[2]);
+    if (glm::length(normal) > 0.0f) {
+      normal = glm::normalize(normal);
+    }
+    for (int k = 0; k < 3; ++k) {
+      mesh.groupQuadrics.at(groups[k]).addPlane(normal, -glm::dot(normal, points[0]));
+      mesh.groupTriangles.at(groups[k]).push_back(triangle);
+      ++edgeTriangles[std::minmax(groups[k], groups[(k + 1) % 3])];
+    }
+  }
+  for (const auto &edge : edgeTriangles) {
+    if (edge.second != 2) {
+      mesh.groupLocked.at(edge.first.first) = true;
+      mesh.groupLocked.at(edge.first.second) = true;
+    }
+  }
+
+  std::priority_queue<Collapse> collapses{};
+  std::map<uint32_t, uint32_t> wedgeMap{};
+  auto addCollapses = [&](uint32_t group) {
+    for (uint32_t triangle : mesh.groupTriangles.at(group)) {
+      if (mesh.triangleRemoved.at(triangle)) {
+        continue;
+      }
+      for (int k = 0; k < 3; ++k) {
+        uint32_t neighbour = mesh.vertexGroups.at(mesh.corners.at(triangle * 3 + k));
+        Collapse collapse{};
+        if (evaluateCollapse(mesh, joints, weights, group, neighbour, collapse, wedgeMap)) {
+          collapses.push(collapse);
+        }
+        if (evaluateCollapse(mesh, joints, weights, neighbour, group, collapse, wedgeMap)) {
+          collapses.push(collapse);
+        }
+      }
+    }
+  };
+  for (uint32_t group = 0; group < groupCount; ++group) {
+    addCollapses(group);
+  }
+
+  std::vector<std::vector<uint32_t>> results{};
+  for (size_t targetTriangleCount : targetTriangleCounts) {
+    while (mesh.triangleCount > targetTriangleCount && !collapses.empty()) {
+      Collapse collapse = collapses.top();
+      collapses.pop();
+
+      /* the queue holds outdated entries, the cost is checked again */
+      Collapse current{};
+      if (!evaluateCollapse(mesh,
+                            joints,
+                            weights,
+                            collapse.fromGroup,
+                            collapse.toGroup,
+                            current,
+                            wedgeMap))
+      {
+        continue;
+      }
+      if (current.cost > collapse.cost * 1.0001 + 1e-12) {
+        collapses.push(current);
+        continue;
+      }
+      if (current.cost > maxCost) {
+        collapses.push(current);
+        break;
+      }
+
+      applyCollapse(mesh, normals, current, wedgeMap);
+      addCollapses(current.toGroup);
+    }
+
+    std::vector<uint32_t> result{};
+    for (uint32_t triangle = 0; triangle < mesh.triangleRemoved.size(); ++triangle) {
+      if (!mesh.triangleRemoved.at(triangle)) {
+        result.insert(result.end(),
+                      mesh.corners.begin() + triangle * 3,
+                      mesh.corners.begin() + triangle * 3 + 3);
+      }
+    }
+    results.push_back(result);
+  }
+  return results;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/* Quadric error edge collapse (Garland and Heckbert), a vertex is moved onto a
+ * neighbour and the triangles between both disappear. The vertices are kept, the
+ * results are index lists of the input vertices:
+ * - vertices at the same position collapse together, flat shaded meshes included
+ * - UV seams only collapse along the seam, open borders are locked
+ * - differences of the skin weights add to the error, skin borders collapse last
+ */
+class MeshSimplifier {
+ public:
+  /* Collapses down to every target triangle count in turn, the error is a distance
+   * relative to the radius of the mesh. A target that is not reached without
+   * exceeding the error returns the triangles left at that point.
+   */
+  static std::vector<std::vector<uint32_t>> simplify(
+      const std::vector<uint32_t> &indices,
+      const std::vector<glm::vec3> &positions,
+      const std::vector<glm::vec3> &normals,
+      const std::vector<glm::vec2> &texCoords,
+      const std::vector<glm::tvec4<uint16_t>> &joints,
+      const std::vector<glm::vec4> &weights,
+      const std::vector<size_t> &targetTriangleCounts,
+      float maxError);
+};
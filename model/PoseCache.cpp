@@ -0,0 +1,37 @@
+#include "PoseCache.h"
+
+void PoseCache::newFrame() {
+  std::lock_guard<std::mutex> lock(mCacheMutex);
+  mEntries.clear();
+  mLookups = 0;
+  mHits = 0;
+}
+
+std::shared_ptr<PoseCacheEntry> PoseCache::getEntry(const PoseCacheKey &key) {
+  std::lock_guard<std::mutex> lock(mCacheMutex);
+  std::shared_ptr<PoseCacheEntry> &entry = mEntries[key];
+  if (!entry) {
+    entry = std::make_shared<PoseCacheEntry>();
+  }
+  return entry;
+}
+
+void PoseCache::countLookup(bool hit) {
+  ++mLookups;
+  if (hit) {
+    ++mHits;
+  }
+}
+
+int PoseCache::getLookups() {
+  return mLookups;
+}
+
+int PoseCache::getHits() {
+  return mHits;
+}
+
+int PoseCache::getEntryCount() {
+  std::lock_guard<std::mutex> lock(mCacheMutex);
+  return mEntries.size();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/* Identifies a pose: instances playing the same clips at the same quantized
+ * time with the same joint mask (LOD tier) and IK state share the result.
+ */
+struct PoseCacheKey {
+  int clip = 0;
+  int destClip = 0;
+  int timeStep = 0;
+  int lodTier = 0;
+  bool ikEnabled = false;
+
+  bool operator<(const PoseCacheKey &other) const {
+    return std::tie(clip, destClip, timeStep, lodTier, ikEnabled) <
+           std::tie(other.clip, other.destClip, other.timeStep, other.lodTier, other.ikEnabled);
+  }
+};
+
+/* The first instance that requests an entry evaluates the pose inside
+ * std::call_once, all others wait for it and copy the result.
+ */
+struct PoseCacheEntry {
+  std::once_flag evaluated{};
+  std::vector<glm::mat4> jointMatrices{};
+  std::vector<glm::mat2x4> jointDualQuats{};
+  /* needed to draw the skeleton of instances that use the cached pose */
+  std::vector<glm::mat4> nodeMatrices{};
+};
+
+/* Poses evaluated during one frame of the animation update. Thread safe,
+ * but newFrame() must not be called while instances are updated.
+ */
+class PoseCache {
+ public:
+  void newFrame();
+  std::shared_ptr<PoseCacheEntry> getEntry(const PoseCacheKey &key);
+  void countLookup(bool hit);
+
+  int getLookups();
+  int getHits();
+  int getEntryCount();
+
+ private:
+  std::mutex mCacheMutex{};
+  std::map<PoseCacheKey, std::shared_ptr<PoseCacheEntry>> mEntries{};
+
+  std::atomic<int> mLookups{0};
+  std::atomic<int> mHits{0};
+};
@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+#include <glm/gtc/packing.hpp>
+
+#include "Logger.h"
+#include "VertexPacker.h"
+
+namespace {
+/* error bounds, relative to the size of the model for the positions */
+const float maxRelativePositionError = 1.0f / 16384.0f;
+const float maxNormalErrorDegrees = 0.5f;
+/* half a texel of a 1024x1024 texture */
+const float maxTexCoordError = 1.0f / 2048.0f;
+const float maxWeightError = 3.0f / 255.0f;
+
+template <typename T>
+void writeVertexData(std::vector<uint8_t> &vertices, size_t offset, const T &data) {
+  std::memcpy(vertices.data() + offset, &data, sizeof(T));
+}
+}  // namespace
+
+bool VertexPacker::pack(const std::vector<glm::vec3> &positions,
+                        const std::vector<glm::vec3> &normals,
+                        const std::vector<glm::vec2> &texCoords,
+                        const std::vector<glm::tvec4<uint16_t>> &joints,
+                        const std::vector<glm::vec4> &weights,
+                        const std::vector<glm::tvec4<uint16_t>> &joints1,
+                        const std::vector<glm::vec4> &weights1,
+                        int jointCount,
+                        PackedVertexData &packedData) {
+  size_t vertexCount = positions.size();
+  if (normals.size() != vertexCount || texCoords.size() != vertexCount ||
+      joints.size() != vertexCount || weights.size() != vertexCount ||
+      joints1.size() != vertexCount || weights1.size() != vertexCount)
+  {
+    Logger::log(1, "%s error: vertex attributes differ in size\n", __FUNCTION__);
+    return false;
+  }
+
+  /* positions: quantize first, keep the floats if the result is not exact enough */
+  glm::vec3 minPos = glm::vec3(std::numeric_limits<float>::max());
+  glm::vec3 maxPos = glm::vec3(std::numeric_limits<float>::lowest());
+  for (const glm::vec3 &position : positions) {
+    minPos = glm::min(minPos, position);
+    maxPos = glm::max(maxPos, position);
+  }
+  glm::vec3 extents = glm::max(maxPos - minPos, glm::vec3(1e-6f));
+
+  std::vector<glm::tvec4<uint16_t>> quantizedPositions(vertexCount);
+  float maxPositionError = 0.0f;
+  for (size_t i = 0; i < vertexCount; ++i) {
+    glm::vec3 unorm = glm::round((positions.at(i) - minPos) / extents * 65535.0f);
+    quantizedPositions.at(i) = glm::tvec4<uint16_t>(glm::tvec3<uint16_t>(unorm), 0);
+    glm::vec3 decoded = minPos + unorm / 65535.0f * extents;
+    maxPositionError = std::max(maxPositionError, glm::length(decoded - positions.at(i)));
+  }
+
+  float positionErrorBound = glm::length(extents) * maxRelativePositionError;
+  packedData.quantizedPositions = maxPositionError <= positionErrorBound;
+  if (packedData.quantizedPositions) {
+    packedData.positionOffset = minPos;
+    packedData.positionScale = extents;
+    packedData.maxPositionError = maxPositionError;
+  }
+  else {
+    Logger::log(1,
+                "%s: position error %f exceeds %f, keeping float positions\n",
+                __FUNCTION__,
+                maxPositionError,
+                positionErrorBound);
+    packedData.positionOffset = glm::vec3(0.0f);
+    packedData.positionScale = glm::vec3(1.0f);
+    packedData.maxPositionError = 0.0f;
+  }
+
+  packedData.secondJointSet =
+      std::any_of(weights1.begin(), weights1.end(), [](const glm::vec4 &vertexWeights) {
+        return glm::dot(vertexWeights, glm::vec4(1.0f)) > 0.0f;
+      });
+  int jointSets = packedData.secondJointSet ? 2 : 1;
+
+  /* normals, texture coordinates and weights: measure the compact formats first */
+  float normalError = 0.0f;
+  float texCoordError = 0.0f;
+  float weightError = 0.0f;
+  for (size_t i = 0; i < vertexCount; ++i) {
+    glm::vec3 normal = glm::normalize(normals.at(i));
+    float cosAngle = glm::clamp(
+        glm::dot(normal, glm::normalize(unpackNormal(packNormal(normal)))), -1.0f, 1.0f);
+    normalError = std::max(normalError, glm::degrees(std::acos(cosAngle)));
+
+    glm::vec2 halfError = glm::abs(
+        glm::unpackHalf2x16(glm::packHalf2x16(texCoords.at(i))) - texCoords.at(i));
+    texCoordError = std::max({texCoordError, halfError.x, halfError.y});
+
+    std::array<int, 8> unorm = packWeights(weights.at(i), weights1.at(i), 255);
+    for (int j = 0; j < jointSets * 4; ++j) {
+      float weight = j < 4 ? weights.at(i)[j] : weights1.at(i)[j - 4];
+      weightError = std::max(weightError, std::abs(unorm.at(j) / 255.0f - weight));
+    }
+  }
+
+  packedData.packedNormals = normalError <= maxNormalErrorDegrees;
+  packedData.maxNormalError = packedData.packedNormals ? normalError : 0.0f;
+  if (!packedData.packedNormals) {
+    Logger::log(1,
+                "%s: normal error of %f degrees exceeds %f, keeping float normals\n",
+                __FUNCTION__,
+                normalError,
+                maxNormalErrorDegrees);
+  }
+  packedData.packedTexCoords = texCoordError <= maxTexCoordError;
+  packedData.maxTexCoordError = packedData.packedTexCoords ? texCoordError : 0.0f;
+  if (!packedData.packedTexCoords) {
+    Logger::log(1,
+                "%s: texture coordinate error of %f exceeds %f, keeping float texture "
+                "coordinates\n",
+                __FUNCTION__,
+                texCoordError,
+                maxTexCoordError);
+  }
+  packedData.packedWeights = weightError <= maxWeightError;
+  if (!packedData.packedWeights) {
+    Logger::log(1,
+                "%s: weight error of %f exceeds %f, using unorm16 weights\n",
+                __FUNCTION__,
+                weightError,
+                maxWeightError);
+  }
+  int maxWeightValue = packedData.packedWeights ? 255 : 65535;
+
+  packedData.jointType = jointCount <= 256 ? GL_UNSIGNED_BYTE : GL_UNSIGNED_SHORT;
+  GLsizei jointSize = packedData.jointType == GL_UNSIGNED_BYTE ? 4 : 8;
+
+  GLsizei positionSize = packedData.quantizedPositions ? sizeof(glm::tvec4<uint16_t>)
+                                                       : sizeof(glm::vec3);
+  GLsizei normalSize = packedData.packedNormals ? sizeof(uint32_t) : sizeof(glm::vec3);
+  GLsizei texCoordSize = packedData.packedTexCoords ? sizeof(uint32_t) : sizeof(glm::vec2);
+  GLsizei weightSize = packedData.packedWeights ? sizeof(glm::tvec4<uint8_t>)
+                                                : sizeof(glm::tvec4<uint16_t>);
+  packedData.normalOffset = positionSize;
+  packedData.texCoordOffset = packedData.normalOffset + normalSize;
+  packedData.jointOffset = packedData.texCoordOffset + texCoordSize;
+  packedData.weightOffset = packedData.jointOffset + jointSize;
+  packedData.stride = packedData.weightOffset + weightSize;
+
+  if (packedData.secondJointSet) {
+    packedData.joint1Offset = packedData.stride;
+    packedData.weight1Offset = packedData.joint1Offset + jointSize;
+    packedData.stride = packedData.weight1Offset + weightSize;
+  }
+
+  packedData.vertices.assign(vertexCount * packedData.stride, 0);
+  packedData.maxWeightError = 0.0f;
+
+  for (size_t i = 0; i < vertexCount; ++i) {
+    size_t vertexOffset = i * packedData.stride;
+
+    if (packedData.quantizedPositions) {
+      writeVertexData(packedData.vertices, vertexOffset, quantizedPositions.at(i));
+    }
+    else {
+      writeVertexData(packedData.vertices, vertexOffset, positions.at(i));
+    }
+
+    glm::vec3 normal = glm::normalize(normals.at(i));
+    if (packedData.packedNormals) {
+      writeVertexData(
+          packedData.vertices, vertexOffset + packedData.normalOffset, packNormal(normal));
+    }
+    else {
+      writeVertexData(packedData.vertices, vertexOffset + packedData.normalOffset, normal);
+    }
+
+    if (packedData.packedTexCoords) {
+      writeVertexData(packedData.vertices,
+                      vertexOffset + packedData.texCoordOffset,
+                      glm::packHalf2x16(texCoords.at(i)));
+    }
+    else {
+      writeVertexData(
+          packedData.vertices, vertexOffset + packedData.texCoordOffset, texCoords.at(i));
+    }
+
+    std::array<int, 8> unormWeights = packWeights(weights.at(i), weights1.at(i), maxWeightValue);
+    for (int set = 0; set < jointSets; ++set) {
+      const glm::tvec4<uint16_t> &setJoints = set == 0 ? joints.at(i) : joints1.at(i);
+      const glm::vec4 &setWeights = set == 0 ? weights.at(i) : weights1.at(i);
+      glm::tvec4<uint16_t> packedWeights(unormWeights.at(set * 4),
+                                         unormWeights.at(set * 4 + 1),
+                                         unormWeights.at(set * 4 + 2),
+                                         unormWeights.at(set * 4 + 3));
+      size_t jointOffset =
+          vertexOffset + (set == 0 ? packedData.jointOffset : packedData.joint1Offset);
+      size_t weightOffset =
+          vertexOffset + (set == 0 ? packedData.weightOffset : packedData.weight1Offset);
+
+      if (packedData.jointType == GL_UNSIGNED_BYTE) {
+        writeVertexData(packedData.vertices, jointOffset, glm::tvec4<uint8_t>(setJoints));
+      }
+      else {
+        writeVertexData(packedData.vertices, jointOffset, setJoints);
+      }
+
+      if (packedData.packedWeights) {
+        writeVertexData(packedData.vertices, weightOffset, glm::tvec4<uint8_t>(packedWeights));
+      }
+      else {
+        writeVertexData(packedData.vertices, weightOffset, packedWeights);
+      }
+      glm::vec4 setWeightError =
+          glm::abs(glm::vec4(packedWeights) / static_cast<float>(maxWeightValue) - setWeights);
+      packedData.maxWeightError = std::max({packedData.maxWeightError,
+                                            setWeightError.x,
+                                            setWeightError.y,
+                                            setWeightError.z,
+                                            setWeightError.w});
+    }
+  }
+
+  size_t floatSize = sizeof(glm::vec3) * 2 + sizeof(glm::vec2) + sizeof(glm::tvec4<uint16_t>) +
+                     sizeof(glm::vec4);
+  if (packedData.secondJointSet) {
+    floatSize += sizeof(glm::tvec4<uint16_t>) + sizeof(glm::vec4);
+  }
+  Logger::log(1,
+              "%s: packed %i vertices into %i bytes per vertex instead of %i (%.2fx)\n",
+              __FUNCTION__,
+              vertexCount,
+              packedData.stride,
+              floatSize,
+              static_cast<float>(floatSize) / packedData.stride);
+  Logger::log(1,
+              "%s: max errors: position %f, normal %f degrees, texture coordinate %f, weight %f\n",
+              __FUNCTION__,
+              packedData.maxPositionError,
+              packedData.maxNormalError,
+              packedData.maxTexCoordError,
+              packedData.maxWeightError);
+  return true;
+}
+
+/* signed normalized 10 bit values, matching GL_INT_2_10_10_10_REV */
+uint32_t VertexPacker::packNormal(glm::vec3 normal) {
+  glm::ivec3 snorm = glm::ivec3(glm::round(glm::clamp(normal, -1.0f, 1.0f) * 511.0f));
+  uint32_t packedNormal = 0;
+  for (int i = 0; i < 3; ++i) {
+    packedNormal |= (static_cast<uint32_t>(snorm[i]) & 0x3ff) << (i * 10);
+  }
+  return packedNormal;
+}
+
+glm::vec3 VertexPacker::unpackNormal(uint32_t packedNormal) {
+  glm::vec3 normal{};
+  for (int i = 0; i < 3; ++i) {
+    int value = static_cast<int>((packedNormal >> (i * 10)) & 0x3ff);
+    /* sign extension of the 10 bit value */
+    if (value & 0x200) {
+      value -= 0x400;
+    }
+    normal[i] = std::max(value / 511.0f, -1.0f);
+  }
+  return normal;
+}
+
+/* Rounds every weight of both sets to maxValue, the rounding error is moved to the largest
+ * weight so the sum stays exact.
+ */
+std::array<int, 8> VertexPacker::packWeights(glm::vec4 weights0,
+                                             glm::vec4 weights1,
+                                             int maxValue) {
+  std::array<int, 8> unorm{};
+  float weightSum = weights0.x + weights0.y + weights0.z + weights0.w + weights1.x + weights1.y +
+                    weights1.z + weights1.w;
+  if (weightSum <= 0.0f) {
+    unorm.at(0) = maxValue;
+    return unorm;
+  }
+
+  for (int i = 0; i < 4; ++i) {
+    unorm.at(i) = static_cast<int>(std::round(weights0[i] / weightSum * maxValue));
+    unorm.at(i + 4) = static_cast<int>(std::round(weights1[i] / weightSum * maxValue));
+  }
+  auto largest = std::max_element(unorm.begin(), unorm.end());
+  int unormSum = 0;
+  for (int value : unorm) {
+    unormSum += value;
+  }
+  *largest += maxValue - unormSum;
+
+  for (int &value : unorm) {
+    value = std::clamp(value, 0, maxValue);
+  }
+  return unorm;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+/* Interleaved vertex buffer in the compact format, together with the layout
+ * and the largest errors of the quantization.
+ */
+struct PackedVertexData {
+  std::vector<uint8_t> vertices{};
+  GLsizei stride = 0;
+
+  /* unorm16 positions relative to the bounds, or plain floats if the error is too large */
+  bool quantizedPositions = true;
+  glm::vec3 positionOffset = glm::vec3(0.0f);
+  glm::vec3 positionScale = glm::vec3(1.0f);
+
+  /* GL_UNSIGNED_BYTE for up to 256 joints, GL_UNSIGNED_SHORT otherwise */
+  GLenum jointType = GL_UNSIGNED_BYTE;
+
+  /* 10_10_10_2 normals, half float texture coordinates and unorm8 weights, replaced by float
+   * normals, float texture coordinates or unorm16 weights if their error is too large */
+  bool packedNormals = true;
+  bool packedTexCoords = true;
+  bool packedWeights = true;
+
+  GLsizei normalOffset = 0;
+  GLsizei texCoordOffset = 0;
+  GLsizei jointOffset = 0;
+  GLsizei weightOffset = 0;
+  /* joints and weights five to eight, only stored if a vertex uses them */
+  bool secondJointSet = false;
+  GLsizei joint1Offset = 0;
+  GLsizei weight1Offset = 0;
+
+  float maxPositionError = 0.0f;
+  /* in degrees */
+  float maxNormalError = 0.0f;
+  float maxTexCoordError = 0.0f;
+  float maxWeightError = 0.0f;
+};
+
+/* Packs the float vertex attributes into a single interleaved buffer:
+ * unorm16 positions, 10_10_10_2 normals, half float texture coordinates,
+ * uint8 joints and unorm8 weights that sum up to 255 over both joint sets.
+ * An attribute that exceeds its error bound keeps a wider format instead.
+ */
+class VertexPacker {
+ public:
+  static bool pack(const std::vector<glm::vec3> &positions,
+                   const std::vector<glm::vec3> &normals,
+                   const std::vector<glm::vec2> &texCoords,
+                   const std::vector<glm::tvec4<uint16_t>> &joints,
+                   const std::vector<glm::vec4> &weights,
+                   const std::vector<glm::tvec4<uint16_t>> &joints1,
+                   const std::vector<glm::vec4> &weights1,
+                   int jointCount,
+                   PackedVertexData &packedData);
+
+ private:
+  static uint32_t packNormal(glm::vec3 normal);
+  static glm::vec3 unpackNormal(uint32_t packedNormal);
+  static std::array<int, 8> packWeights(glm::vec4 weights0, glm::vec4 weights1, int maxValue);
+};
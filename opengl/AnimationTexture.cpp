@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <cmath>
+
+#include "AnimationTexture.h"
+#include "GltfInstance.h"
+#include "Logger.h"
+
+namespace {
+/* three rows of the joint matrix, the last row is always (0, 0, 0, 1) */
+const int texelsPerJoint = 3;
+}  // namespace
+
+bool AnimationTexture::bake(std::shared_ptr<GltfModel> model, float sampleRate) {
+  const std::vector<std::shared_ptr<GltfAnimationClip>> &clips = model->getAnimClips();
+  int jointCount = model->getJointMatrixSize();
+
+  /* the bake instance stands at the origin, its bounds are in model space */
+  GltfInstance bakeInstance(model, glm::vec3(0.0f), 0.0f);
+
+  std::vector<glm::vec4> texels{};
+  std::vector<BoundingBox> clipBounds{};
+  mClipData.clear();
+
+  int frameRows = 0;
+  for (int clipNum = 0; clipNum < clips.size(); ++clipNum) {
+    float clipEndTime = clips.at(clipNum)->getClipEndTime();
+    int frameCount = static_cast<int>(std::ceil(clipEndTime * sampleRate)) + 1;
+    mClipData.emplace_back(frameRows, frameCount, clipEndTime, sampleRate);
+
+    BoundingBox bounds{};
+    for (int frame = 0; frame < frameCount; ++frame) {
+      bakeInstance.samplePose(clipNum, std::min(frame / sampleRate, clipEndTime));
+      for (const glm::mat4 &jointMatrix : bakeInstance.getJointMatrices()) {
+        glm::mat4 rows = glm::transpose(jointMatrix);
+        for (int row = 0; row < texelsPerJoint; ++row) {
+          texels.emplace_back(rows[row]);
+        }
+      }
+      bounds.addBox(bakeInstance.getBounds());
+    }
+    clipBounds.emplace_back(bounds);
+    frameRows += frameCount;
+  }
+
+  GLint maxTextureSize = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+  if (frameRows > maxTextureSize || jointCount * texelsPerJoint > maxTextureSize) {
+    Logger::log(1,
+                "%s error: %i frames of %i joints exceed the maximum texture size of %i\n",
+                __FUNCTION__,
+                frameRows,
+                jointCount,
+                maxTextureSize);
+    return false;
+  }
+
+  glGenTextures(1, &mTexture);
+  glBindTexture(GL_TEXTURE_2D, mTexture);
+
+  /* fetched with texelFetch, the frames are interpolated in the shader */
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+  glTexImage2D(GL_TEXTURE_2D,
+               0,
+               GL_RGBA32F,
+               jointCount * texelsPerJoint,
+               frameRows,
+               0,
+               GL_RGBA,
+               GL_FLOAT,
+               texels.data());
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  mClipBuffer.init(mClipData.size() * sizeof(glm::vec4));
+  mClipBuffer.uploadSsboData(mClipData, 0);
+
+  model->setClipBounds(clipBounds);
+
+  Logger::log(1,
+              "%s: baked %i frames of %i clips at %.0f fps (%i bytes)\n",
+              __FUNCTION__,
+              frameRows,
+              clips.size(),
+              sampleRate,
+              texels.size() * sizeof(glm::vec4));
+  return true;
+}
+
+void AnimationTexture::bind(int textureUnit, int clipBindingPoint) {
+  glActiveTexture(GL_TEXTURE0 + textureUnit);
+  glBindTexture(GL_TEXTURE_2D, mTexture);
+  glActiveTexture(GL_TEXTURE0);
+
+  mClipBuffer.bind(clipBindingPoint);
+}
+
+void AnimationTexture::cleanup() {
+  glDeleteTextures(1, &mTexture);
+  mClipBuffer.cleanup();
+}
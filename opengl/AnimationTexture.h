@@ -0,0 +1,31 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "GltfModel.h"
+#include "ShaderStorageBuffer.h"
+
+#include "OGLRenderData.h"
+
+/* Joint palettes of all clips, sampled at a fixed rate when the model is
+ * loaded. Every texture row holds one frame, a joint uses three RGBA32F
+ * texels with the first three rows of its (affine) joint matrix.
+ */
+class AnimationTexture {
+ public:
+  bool bake(std::shared_ptr<GltfModel> model, float sampleRate);
+  /* the clip table is a SSBO, one vec4 per clip */
+  void bind(int textureUnit, int clipBindingPoint);
+  void cleanup();
+
+ private:
+  GLuint mTexture = 0;
+
+  /* x: first frame row, y: frame count, z: clip length, w: sample rate */
+  std::vector<glm::vec4> mClipData{};
+  ShaderStorageBuffer mClipBuffer{};
+};
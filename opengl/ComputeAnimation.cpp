@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <cmath>
+
+#include "ComputeAnimation.h"
+#include "Logger.h"
+
+/* binding points of the compute shaders, 1 and 2 are the joint palettes */
+namespace {
+const int keyTimeBinding = 4;
+const int keyValueBinding = 5;
+const int trackBinding = 6;
+const int restPoseBinding = 7;
+const int hierarchyBinding = 8;
+const int inverseBindMatrixBinding = 9;
+const int instanceTimeBinding = 10;
+const int nodeMatrixBinding = 11;
+const int jointMatrixBinding = 1;
+const int jointDualQuatBinding = 2;
+
+const int workGroupSize = 64;
+
+int getWorkGroupCount(int invocations) {
+  return (invocations + workGroupSize - 1) / workGroupSize;
+}
+}  // namespace
+
+bool ComputeAnimation::init(std::shared_ptr<GltfModel> model) {
+  mGltfModel = model;
+
+  if (!mSampleShader.loadComputeShader("shader/anim_sample.comp")) {
+    Logger::log(1, "%s: animation sampling compute shader loading failed\n", __FUNCTION__);
+    return false;
+  }
+  if (!mHierarchyShader.loadComputeShader("shader/anim_hierarchy.comp")) {
+    Logger::log(1, "%s: hierarchy compute shader loading failed\n", __FUNCTION__);
+    return false;
+  }
+  if (!mPaletteShader.loadComputeShader("shader/anim_palette.comp")) {
+    Logger::log(1, "%s: joint palette compute shader loading failed\n", __FUNCTION__);
+    return false;
+  }
+
+  mRootNode = mGltfModel->createNodeTree(mNodeList);
+
+  mKeyTimeBuffer.init(0);
+  mKeyValueBuffer.init(0);
+  mTrackBuffer.init(0);
+  mRestPoseBuffer.init(0);
+  mHierarchyBuffer.init(0);
+  mInverseBindMatrixBuffer.init(0);
+  mInstanceTimeBuffer.init(0);
+  mNodeMatrixBuffer.init(0);
+
+  createHierarchyData();
+  mInverseBindMatrixBuffer.uploadSsboData(mGltfModel->getInverseBindMatrices(),
+                                          inverseBindMatrixBinding);
+
+  Logger::log(1,
+              "%s: compute animation uses %i nodes in %i levels\n",
+              __FUNCTION__,
+              mHierarchy.size(),
+              mHierarchyLevels.size());
+  return true;
+}
+
+/* The tracks are stored per clip, node and path (translation, rotation, scale) as
+ * offset into the key times, offset into the key values, key count and interpolation.
+ */
+void ComputeAnimation::createTrackData() {
+  const std::vector<std::shared_ptr<GltfAnimationClip>> &clips = mGltfModel->getAnimClips();
+  int nodeCount = mGltfModel->getNodeCount();
+
+  std::vector<float> keyTimes{};
+  std::vector<glm::vec4> keyValues{};
+  std::vector<glm::ivec4> tracks(clips.size() * nodeCount * 3, glm::ivec4(0));
+
+  for (int clipNum = 0; clipNum < clips.size(); ++clipNum) {
+    for (const auto &channel : clips.at(clipNum)->getChannels()) {
+      int path = 0;
+      switch (channel->getTargetPath()) {
+        case ETargetPath::TRANSLATION:
+          path = 0;
+          break;
+        case ETargetPath::ROTATION:
+          path = 1;
+          break;
+        case ETargetPath::SCALE:
+          path = 2;
+          break;
+      }
+
+      const std::vector<float> &timings = channel->getTimings();
+      std::vector<glm::vec4> values = channel->getPackedValues();
+
+      tracks.at((clipNum * nodeCount + channel->getTargetNode()) * 3 + path) = glm::ivec4(
+          keyTimes.size(),
+          keyValues.size(),
+          timings.size(),
+          static_cast<int>(channel->getInterpolationType()));
+
+      keyTimes.insert(keyTimes.end(), timings.begin(), timings.end());
+      keyValues.insert(keyValues.end(), values.begin(), values.end());
+    }
+  }
+
+  /* nodes without a channel keep the rest pose */
+  std::vector<glm::vec4> restPose(nodeCount * 3, glm::vec4(0.0f));
+  for (int i = 0; i < nodeCount; ++i) {
+    if (!mNodeList.at(i)) {
+      continue;
+    }
+    glm::quat rotation = mNodeList.at(i)->getLocalRotation();
+    restPose.at(i * 3) = glm::vec4(mNodeList.at(i)->getLocalTranslation(), 0.0f);
+    restPose.at(i * 3 + 1) = glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+    restPose.at(i * 3 + 2) = glm::vec4(mNodeList.at(i)->getLocalScale(), 0.0f);
+  }
+
+  mKeyTimeBuffer.uploadSsboData(keyTimes, keyTimeBinding);
+  mKeyValueBuffer.uploadSsboData(keyValues, keyValueBinding);
+  mTrackBuffer.uploadSsboData(tracks, trackBinding);
+  mRestPoseBuffer.uploadSsboData(restPose, restPoseBinding);
+
+  Logger::log(1,
+              "%s: uploaded %i keys and %i values for %i clips\n",
+              __FUNCTION__,
+              keyTimes.size(),
+              keyValues.size(),
+              clips.size());
+}
+
+/* Breadth first walk, all parents are in an earlier level than their children. */
+void ComputeAnimation::createHierarchyData() {
+  const std::vector<int> &nodeToJoint = mGltfModel->getNodeToJoint();
+
+  mHierarchy.clear();
+  mHierarchyLevels.clear();
+
+  std::vector<std::shared_ptr<GltfNode>> currentLevel{mRootNode};
+  while (!currentLevel.empty()) {
+    mHierarchyLevels.emplace_back(mHierarchy.size(), currentLevel.size());
+
+    std::vector<std::shared_ptr<GltfNode>> nextLevel{};
+    for (const auto &node : currentLevel) {
+      std::shared_ptr<GltfNode> parentNode = node->getParentNode();
+      int nodeNum = node->getNodeNum();
+      mHierarchy.emplace_back(
+          nodeNum, parentNode ? parentNode->getNodeNum() : -1, nodeToJoint.at(nodeNum), 1);
+
+      const std::vector<std::shared_ptr<GltfNode>> &childs = node->getChilds();
+      nextLevel.insert(nextLevel.end(), childs.begin(), childs.end());
+    }
+    currentLevel = nextLevel;
+  }
+
+  mAdditiveMask.resize(mNodeList.size());
+  setSkeletonSplitNode(mNodeList.size() - 1);
+}
+
+void ComputeAnimation::updateAdditiveMask(std::shared_ptr<GltfNode> treeNode, int splitNodeNum) {
+  if (treeNode->getNodeNum() == splitNodeNum) {
+    return;
+  }
+  mAdditiveMask.at(treeNode->getNodeNum()) = false;
+  for (auto &childNode : treeNode->getChilds()) {
+    updateAdditiveMask(childNode, splitNodeNum);
+  }
+}
+
+/* Same mask as the CPU path: nodes in the subtree of the split node blend from the
+ * source to the destination clip, all other nodes the other way around.
+ */
+void ComputeAnimation::setSkeletonSplitNode(int nodeNum) {
+  std::fill(mAdditiveMask.begin(), mAdditiveMask.end(), true);
+  updateAdditiveMask(mRootNode, nodeNum);
+
+  for (auto &entry : mHierarchy) {
+    entry.w = mAdditiveMask.at(entry.x) ? 1 : 0;
+  }
+  mHierarchyBuffer.uploadSsboData(mHierarchy, hierarchyBinding);
+}
+
+void ComputeAnimation::update(const AnimationSettings &settings,
+                              const std::vector<std::shared_ptr<GltfInstance>> &instances,
+                              ShaderStorageBuffer &jointMatrixBuffer,
+                              ShaderStorageBuffer &jointDualQuatBuffer) {
+  int instanceCount = instances.size();
+  if (instanceCount == 0) {
+    return;
+  }
+
+  if (!mTracksUploaded) {
+    createTrackData();
+    mTracksUploaded = true;
+  }
+
+  int nodeCount = mGltfModel->getNodeCount();
+  int jointCount = mGltfModel->getJointMatrixSize();
+  bool crossBlend = settings.asBlendingMode == blendMode::crossFade ||
+                    settings.asBlendingMode == blendMode::additive;
+
+  /* the clip times are the only per-frame upload */
+  const std::vector<std::shared_ptr<GltfAnimationClip>> &clips = mGltfModel->getAnimClips();
+  float sourceEndTime = clips.at(settings.asAnimClip)->getClipEndTime();
+  float destEndTime = clips.at(settings.asCrossBlendDestAnimClip)->getClipEndTime();
+
+  mInstanceTimes.resize(instanceCount);
+  for (int i = 0; i < instanceCount; ++i) {
+    float time = instances.at(i)->getClipTime(settings, settings.asAnimTime);
+    if (settings.asPlayAnimation &&
+        settings.asAnimationPlayDirection == replayDirection::backward)
+    {
+      time = sourceEndTime - time;
+    }
+    mInstanceTimes.at(i) = glm::vec4(time, time * (destEndTime / sourceEndTime), 0.0f, 0.0f);
+  }
+  mInstanceTimeBuffer.uploadSsboData(mInstanceTimes, instanceTimeBinding);
+
+  mNodeMatrixBuffer.checkForResize(instanceCount * nodeCount * sizeof(glm::mat4));
+  mNodeMatrixBuffer.bind(nodeMatrixBinding);
+  jointMatrixBuffer.checkForResize(instanceCount * jointCount * sizeof(glm::mat4));
+  jointMatrixBuffer.bind(jointMatrixBinding);
+  jointDualQuatBuffer.checkForResize(instanceCount * jointCount * sizeof(glm::mat2x4));
+  jointDualQuatBuffer.bind(jointDualQuatBinding);
+
+  /* bindings may have been changed by other buffers since the last frame */
+  mKeyTimeBuffer.bind(keyTimeBinding);
+  mKeyValueBuffer.bind(keyValueBinding);
+  mTrackBuffer.bind(trackBinding);
+  mRestPoseBuffer.bind(restPoseBinding);
+  mHierarchyBuffer.bind(hierarchyBinding);
+  mInverseBindMatrixBuffer.bind(inverseBindMatrixBinding);
+
+  /* local transforms of all nodes */
+  mSampleShader.use();
+  mSampleShader.setUniformValue("hierarchySize", static_cast<int>(mHierarchy.size()));
+  mSampleShader.setUniformValue("nodeCount", nodeCount);
+  mSampleShader.setUniformValue("instanceCount", instanceCount);
+  mSampleShader.setUniformValue("sourceClip", settings.asAnimClip);
+  mSampleShader.setUniformValue("destClip", settings.asCrossBlendDestAnimClip);
+  mSampleShader.setUniformValue(
+      "blendFactor",
+      crossBlend ? settings.asAnimCrossBlendFactor : settings.asAnimBlendFactor);
+  mSampleShader.setUniformValue("crossBlend", crossBlend ? 1 : 0);
+  glDispatchCompute(getWorkGroupCount(instanceCount * mHierarchy.size()), 1, 1);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+  /* the root level has no parent, all other levels depend on the previous one */
+  mHierarchyShader.use();
+  mHierarchyShader.setUniformValue("nodeCount", nodeCount);
+  mHierarchyShader.setUniformValue("instanceCount", instanceCount);
+  for (int level = 1; level < mHierarchyLevels.size(); ++level) {
+    glm::ivec2 levelRange = mHierarchyLevels.at(level);
+    mHierarchyShader.setUniformValue("levelStart", levelRange.x);
+    mHierarchyShader.setUniformValue("levelSize", levelRange.y);
+    glDispatchCompute(getWorkGroupCount(instanceCount * levelRange.y), 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+  }
+
+  mPaletteShader.use();
+  mPaletteShader.setUniformValue("hierarchySize", static_cast<int>(mHierarchy.size()));
+  mPaletteShader.setUniformValue("nodeCount", nodeCount);
+  mPaletteShader.setUniformValue("jointCount", jointCount);
+  mPaletteShader.setUniformValue("instanceCount", instanceCount);
+  glDispatchCompute(getWorkGroupCount(instanceCount * mHierarchy.size()), 1, 1);
+
+  /* the skinning shaders read the palettes as SSBOs */
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void ComputeAnimation::cleanup() {
+  mSampleShader.cleanup();
+  mHierarchyShader.cleanup();
+  mPaletteShader.cleanup();
+
+  mKeyTimeBuffer.cleanup();
+  mKeyValueBuffer.cleanup();
+  mTrackBuffer.cleanup();
+  mRestPoseBuffer.cleanup();
+  mHierarchyBuffer.cleanup();
+  mInverseBindMatrixBuffer.cleanup();
+  mInstanceTimeBuffer.cleanup();
+  mNodeMatrixBuffer.cleanup();
+}
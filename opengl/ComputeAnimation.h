@@ -0,0 +1,64 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "GltfInstance.h"
+#include "GltfModel.h"
+#include "GltfNode.h"
+#include "Shader.h"
+#include "ShaderStorageBuffer.h"
+
+#include "OGLRenderData.h"
+
+/* Animates all instances on the GPU. The clip tracks are uploaded by the first
+ * update, then every frame a compute shader samples the local node transforms,
+ * the hierarchy is evaluated level by level, and the joint palettes are written
+ * directly into the SSBOs of the skinning shaders. Instance i uses palette slot i.
+ */
+class ComputeAnimation {
+ public:
+  bool init(std::shared_ptr<GltfModel> model);
+  void setSkeletonSplitNode(int nodeNum);
+  void update(const AnimationSettings &settings,
+              const std::vector<std::shared_ptr<GltfInstance>> &instances,
+              ShaderStorageBuffer &jointMatrixBuffer,
+              ShaderStorageBuffer &jointDualQuatBuffer);
+  void cleanup();
+
+ private:
+  void createTrackData();
+  void createHierarchyData();
+  void updateAdditiveMask(std::shared_ptr<GltfNode> treeNode, int splitNodeNum);
+
+  std::shared_ptr<GltfModel> mGltfModel = nullptr;
+
+  /* private node tree, only used for the rest pose and the hierarchy */
+  std::shared_ptr<GltfNode> mRootNode = nullptr;
+  std::vector<std::shared_ptr<GltfNode>> mNodeList{};
+
+  /* depth sorted nodes: node number, parent node number, joint and additive mask */
+  std::vector<glm::ivec4> mHierarchy{};
+  /* first entry and number of entries of every level in mHierarchy */
+  std::vector<glm::ivec2> mHierarchyLevels{};
+  std::vector<bool> mAdditiveMask{};
+
+  std::vector<glm::vec4> mInstanceTimes{};
+  /* the tracks decode every clip, they wait until the GPU animation is used */
+  bool mTracksUploaded = false;
+
+  Shader mSampleShader{};
+  Shader mHierarchyShader{};
+  Shader mPaletteShader{};
+
+  ShaderStorageBuffer mKeyTimeBuffer{};
+  ShaderStorageBuffer mKeyValueBuffer{};
+  ShaderStorageBuffer mTrackBuffer{};
+  ShaderStorageBuffer mRestPoseBuffer{};
+  ShaderStorageBuffer mHierarchyBuffer{};
+  ShaderStorageBuffer mInverseBindMatrixBuffer{};
+  ShaderStorageBuffer mInstanceTimeBuffer{};
+  ShaderStorageBuffer mNodeMatrixBuffer{};
+};
@@ -0,0 +1,105 @@
+#include "ComputeSkinning.h"
+#include "Logger.h"
+
+namespace {
+const int positionBinding = 4;
+const int normalBinding = 5;
+const int texCoordBinding = 6;
+const int jointBinding = 7;
+const int weightBinding = 8;
+const int skinnedVertexBinding = 9;
+const int joint1Binding = 10;
+const int weight1Binding = 11;
+
+const int workGroupSize = 64;
+
+/* position + u, normal + v */
+const GLsizei skinnedVertexSize = 2 * sizeof(glm::vec4);
+}  // namespace
+
+bool ComputeSkinning::init(std::shared_ptr<GltfModel> model) {
+  mGltfModel = model;
+
+  std::vector<std::string> defines{};
+  if (mGltfModel->hasSecondJointSet()) {
+    defines.push_back("SECOND_JOINT_SET");
+  }
+  if (!mSkinningShader.loadComputeShader("shader/gltf_skinning.comp", defines)) {
+    Logger::log(1, "%s: skinning compute shader loading failed\n", __FUNCTION__);
+    return false;
+  }
+  if (!mSkinnedShader.loadShaders("shader/gltf_skinned.vert", "shader/gltf_skinned.frag")) {
+    Logger::log(1, "%s: pre-skinned glTF shader loading failed\n", __FUNCTION__);
+    return false;
+  }
+
+  mSkinnedVertexBuffer.init(mGltfModel->getFullResolutionVertexCount() * skinnedVertexSize);
+
+  glGenVertexArrays(1, &mSkinnedVAO);
+  glBindVertexArray(mSkinnedVAO);
+
+  glBindBuffer(GL_ARRAY_BUFFER, mSkinnedVertexBuffer.getBufferId());
+  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, skinnedVertexSize, (void *)0);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(
+      1, 4, GL_FLOAT, GL_FALSE, skinnedVertexSize, (void *)sizeof(glm::vec4));
+  glEnableVertexAttribArray(1);
+
+  /* the index buffer of the geometry arena is bound by the draw */
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  Logger::log(1, "%s: compute skinning initialized\n", __FUNCTION__);
+  return true;
+}
+
+void ComputeSkinning::skinInstances(int instanceCount, skinningMode mode) {
+  if (instanceCount == 0) {
+    return;
+  }
+
+  int vertexCount = mGltfModel->getFullResolutionVertexCount();
+  mSkinnedVertexBuffer.checkForResize(instanceCount * vertexCount * skinnedVertexSize);
+  mSkinnedVertexBuffer.bind(skinnedVertexBinding);
+
+  glBindBufferBase(
+      GL_SHADER_STORAGE_BUFFER, positionBinding, mGltfModel->getVertexBuffer("POSITION"));
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, normalBinding, mGltfModel->getVertexBuffer("NORMAL"));
+  glBindBufferBase(
+      GL_SHADER_STORAGE_BUFFER, texCoordBinding, mGltfModel->getVertexBuffer("TEXCOORD_0"));
+  glBindBufferBase(
+      GL_SHADER_STORAGE_BUFFER, jointBinding, mGltfModel->getVertexBuffer("JOINTS_0"));
+  glBindBufferBase(
+      GL_SHADER_STORAGE_BUFFER, weightBinding, mGltfModel->getVertexBuffer("WEIGHTS_0"));
+  if (mGltfModel->hasSecondJointSet()) {
+    glBindBufferBase(
+        GL_SHADER_STORAGE_BUFFER, joint1Binding, mGltfModel->getVertexBuffer("JOINTS_1"));
+    glBindBufferBase(
+        GL_SHADER_STORAGE_BUFFER, weight1Binding, mGltfModel->getVertexBuffer("WEIGHTS_1"));
+  }
+
+  mSkinningShader.use();
+  mSkinningShader.setUniformValue("vertexCount", vertexCount);
+  mSkinningShader.setUniformValue("instanceCount", instanceCount);
+  mSkinningShader.setUniformValue("dualQuatSkinning", mode == skinningMode::dualQuat ? 1 : 0);
+  glDispatchCompute((instanceCount * vertexCount + workGroupSize - 1) / workGroupSize, 1, 1);
+
+  /* the output is read as vertex attributes */
+  glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void ComputeSkinning::draw(RingBuffer &ringBuffer, int instanceCount) {
+  if (instanceCount == 0) {
+    return;
+  }
+  mSkinnedShader.use();
+  mGltfModel->drawPreSkinned(ringBuffer, mSkinnedVAO, instanceCount);
+}
+
+void ComputeSkinning::cleanup() {
+  mSkinningShader.cleanup();
+  mSkinnedShader.cleanup();
+  mSkinnedVertexBuffer.cleanup();
+  glDeleteVertexArrays(1, &mSkinnedVAO);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <memory>
+
+#include <glad/glad.h>
+
+#include "GltfModel.h"
+#include "RingBuffer.h"
+#include "Shader.h"
+#include "ShaderStorageBuffer.h"
+
+#include "OGLRenderData.h"
+
+/* Skins the vertices of all visible instances once per frame in a compute
+ * shader. The output buffer is used as a plain vertex buffer afterwards, the
+ * palettes and the instance data are read from the bound SSBOs 1, 2 and 3.
+ */
+class ComputeSkinning {
+ public:
+  bool init(std::shared_ptr<GltfModel> model);
+  void skinInstances(int instanceCount, skinningMode mode);
+  void draw(RingBuffer &ringBuffer, int instanceCount);
+  void cleanup();
+
+ private:
+  std::shared_ptr<GltfModel> mGltfModel = nullptr;
+
+  Shader mSkinningShader{};
+  Shader mSkinnedShader{};
+
+  /* interleaved vec4 position + u, vec4 normal + v */
+  ShaderStorageBuffer mSkinnedVertexBuffer{};
+  GLuint mSkinnedVAO = 0;
+};
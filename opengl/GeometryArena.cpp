@@ -0,0 +1,327 @@
+#include <algorithm>
+
+#include "GeometryArena.h"
+#include "Logger.h"
+
+namespace {
+/* attribute locations of the glTF shaders */
+const GLuint positionLocation = 0;
+const GLuint normalLocation = 1;
+const GLuint texCoordLocation = 2;
+const GLuint jointLocation = 3;
+const GLuint weightLocation = 4;
+const GLuint joint1Location = 5;
+const GLuint weight1Location = 6;
+
+/* index ranges start at a multiple of the largest index type */
+const size_t indexAlignment = sizeof(uint32_t);
+
+size_t getIndexSize(GLenum indexType) {
+  return indexType == GL_UNSIGNED_INT ? sizeof(uint32_t) : sizeof(uint16_t);
+}
+}  // namespace
+
+void ArenaFreeList::addRange(size_t offset, size_t size) {
+  if (size == 0) {
+    return;
+  }
+
+  auto range = mFreeRanges.emplace(offset, size).first;
+
+  /* merge with the following and the preceding range */
+  auto next = std::next(range);
+  if (next != mFreeRanges.end() && range->first + range->second == next->first) {
+    range->second += next->second;
+    mFreeRanges.erase(next);
+  }
+  if (range != mFreeRanges.begin()) {
+    auto prev = std::prev(range);
+    if (prev->first + prev->second == range->first) {
+      prev->second += range->second;
+      mFreeRanges.erase(range);
+    }
+  }
+}
+
+bool ArenaFreeList::allocate(size_t size, size_t alignment, size_t &offset) {
+  for (auto range = mFreeRanges.begin(); range != mFreeRanges.end(); ++range) {
+    size_t rangeStart = range->first;
+    size_t rangeEnd = range->first + range->second;
+    size_t alignedStart = (rangeStart + alignment - 1) / alignment * alignment;
+    if (alignedStart + size > rangeEnd) {
+      continue;
+    }
+
+    /* the padding before and the rest after the allocation stay free */
+    mFreeRanges.erase(range);
+    addRange(rangeStart, alignedStart - rangeStart);
+    addRange(alignedStart + size, rangeEnd - alignedStart - size);
+    offset = alignedStart;
+    return true;
+  }
+  return false;
+}
+
+size_t ArenaFreeList::getFreeSize() {
+  size_t freeSize = 0;
+  for (const auto &range : mFreeRanges) {
+    freeSize += range.second;
+  }
+  return freeSize;
+}
+
+bool GeometryArena::init(size_t vertexBufferSize, size_t indexBufferSize) {
+  mVertexBufferSize = vertexBufferSize;
+  mIndexBufferSize = indexBufferSize;
+
+  glGenBuffers(1, &mIndexBuffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, mIndexBuffer);
+  glBufferStorage(GL_COPY_WRITE_BUFFER, mIndexBufferSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  mIndexFreeList.addRange(0, mIndexBufferSize);
+
+  Logger::log(1,
+              "%s: geometry arena with %i bytes of vertices per pool and %i bytes of indices "
+              "created\n",
+              __FUNCTION__,
+              mVertexBufferSize,
+              mIndexBufferSize);
+  return true;
+}
+
+/* Copies the used data into a larger buffer, the draws of this frame are
+ * already queued with the old buffer, so it can be deleted right away.
+ */
+GLuint GeometryArena::growBuffer(GLuint buffer, size_t oldSize, size_t newSize) {
+  GLuint newBuffer = 0;
+  glGenBuffers(1, &newBuffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+  glBufferStorage(GL_COPY_WRITE_BUFFER, newSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+  glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  glDeleteBuffers(1, &buffer);
+  return newBuffer;
+}
+
+/* Models with the same layout share a pool, the layout follows from the formats and the stride. */
+int GeometryArena::getVertexPool(const PackedVertexData &vertexData) {
+  for (int i = 0; i < mVertexPools.size(); ++i) {
+    const VertexPool &pool = mVertexPools.at(i);
+    if (pool.stride == vertexData.stride &&
+        pool.quantizedPositions == vertexData.quantizedPositions &&
+        pool.packedNormals == vertexData.packedNormals &&
+        pool.packedTexCoords == vertexData.packedTexCoords &&
+        pool.packedWeights == vertexData.packedWeights &&
+        pool.jointType == vertexData.jointType &&
+        pool.secondJointSet == vertexData.secondJointSet)
+    {
+      return i;
+    }
+  }
+
+  VertexPool pool{};
+  pool.stride = vertexData.stride;
+  pool.quantizedPositions = vertexData.quantizedPositions;
+  pool.packedNormals = vertexData.packedNormals;
+  pool.packedTexCoords = vertexData.packedTexCoords;
+  pool.packedWeights = vertexData.packedWeights;
+  pool.jointType = vertexData.jointType;
+  pool.secondJointSet = vertexData.secondJointSet;
+  pool.capacity = mVertexBufferSize / pool.stride;
+  pool.freeList.addRange(0, pool.capacity);
+
+  glGenBuffers(1, &pool.buffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, pool.buffer);
+  glBufferStorage(
+      GL_COPY_WRITE_BUFFER, pool.capacity * pool.stride, nullptr, GL_DYNAMIC_STORAGE_BIT);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  /* the format is separate from the buffer, a grown buffer only needs a new binding */
+  glGenVertexArrays(1, &pool.vertexArray);
+  glBindVertexArray(pool.vertexArray);
+
+  if (pool.quantizedPositions) {
+    glVertexAttribFormat(positionLocation, 3, GL_UNSIGNED_SHORT, GL_TRUE, 0);
+  }
+  else {
+    glVertexAttribFormat(positionLocation, 3, GL_FLOAT, GL_FALSE, 0);
+  }
+  if (pool.packedNormals) {
+    glVertexAttribFormat(
+        normalLocation, 4, GL_INT_2_10_10_10_REV, GL_TRUE, vertexData.normalOffset);
+  }
+  else {
+    glVertexAttribFormat(normalLocation, 3, GL_FLOAT, GL_FALSE, vertexData.normalOffset);
+  }
+  if (pool.packedTexCoords) {
+    glVertexAttribFormat(
+        texCoordLocation, 2, GL_HALF_FLOAT, GL_FALSE, vertexData.texCoordOffset);
+  }
+  else {
+    glVertexAttribFormat(texCoordLocation, 2, GL_FLOAT, GL_FALSE, vertexData.texCoordOffset);
+  }
+  GLenum weightType = pool.packedWeights ? GL_UNSIGNED_BYTE : GL_UNSIGNED_SHORT;
+  glVertexAttribFormat(jointLocation, 4, pool.jointType, GL_FALSE, vertexData.jointOffset);
+  glVertexAttribFormat(weightLocation, 4, weightType, GL_TRUE, vertexData.weightOffset);
+
+  for (GLuint location :
+       {positionLocation, normalLocation, texCoordLocation, jointLocation, weightLocation})
+  {
+    glVertexAttribBinding(location, 0);
+    glEnableVertexAttribArray(location);
+  }
+  if (pool.secondJointSet) {
+    glVertexAttribFormat(joint1Location, 4, pool.jointType, GL_FALSE, vertexData.joint1Offset);
+    glVertexAttribFormat(weight1Location, 4, weightType, GL_TRUE, vertexData.weight1Offset);
+    for (GLuint location : {joint1Location, weight1Location}) {
+      glVertexAttribBinding(location, 0);
+      glEnableVertexAttribArray(location);
+    }
+  }
+  glBindVertexBuffer(0, pool.buffer, 0, pool.stride);
+  glBindVertexArray(0);
+
+  mVertexPools.push_back(pool);
+  Logger::log(1,
+              "%s: created vertex pool %i with a stride of %i bytes\n",
+              __FUNCTION__,
+              mVertexPools.size() - 1,
+              pool.stride);
+  return mVertexPools.size() - 1;
+}
+
+bool GeometryArena::allocate(const PackedVertexData &vertexData,
+                             const std::vector<uint32_t> &indices,
+                             GLenum indexType,
+                             GeometryAllocation &allocation) {
+  if (vertexData.stride == 0 || vertexData.vertices.empty() || indices.empty()) {
+    Logger::log(1, "%s error: no geometry to allocate\n", __FUNCTION__);
+    return false;
+  }
+
+  int poolNum = getVertexPool(vertexData);
+  VertexPool &pool = mVertexPools.at(poolNum);
+
+  size_t vertexCount = vertexData.vertices.size() / vertexData.stride;
+  size_t vertexOffset = 0;
+  if (!pool.freeList.allocate(vertexCount, 1, vertexOffset)) {
+    size_t newCapacity = std::max(pool.capacity * 2, pool.capacity + vertexCount);
+    pool.buffer = growBuffer(pool.buffer, pool.capacity * pool.stride, newCapacity * pool.stride);
+    pool.freeList.addRange(pool.capacity, newCapacity - pool.capacity);
+    pool.capacity = newCapacity;
+
+    glBindVertexArray(pool.vertexArray);
+    glBindVertexBuffer(0, pool.buffer, 0, pool.stride);
+    glBindVertexArray(0);
+
+    pool.freeList.allocate(vertexCount, 1, vertexOffset);
+    Logger::log(1,
+                "%s: grew vertex pool %i to %i vertices\n",
+                __FUNCTION__,
+                poolNum,
+                pool.capacity);
+  }
+
+  size_t indexSize = getIndexSize(indexType);
+  size_t indexBytes = indices.size() * indexSize;
+  size_t indexOffset = 0;
+  if (!mIndexFreeList.allocate(indexBytes, indexAlignment, indexOffset)) {
+    size_t newSize = std::max(mIndexBufferSize * 2, mIndexBufferSize + indexBytes);
+    mIndexBuffer = growBuffer(mIndexBuffer, mIndexBufferSize, newSize);
+    mIndexFreeList.addRange(mIndexBufferSize, newSize - mIndexBufferSize);
+    mIndexBufferSize = newSize;
+
+    mIndexFreeList.allocate(indexBytes, indexAlignment, indexOffset);
+    Logger::log(1, "%s: grew index buffer to %i bytes\n", __FUNCTION__, mIndexBufferSize);
+  }
+
+  glBindBuffer(GL_COPY_WRITE_BUFFER, pool.buffer);
+  glBufferSubData(GL_COPY_WRITE_BUFFER,
+                  vertexOffset * pool.stride,
+                  vertexData.vertices.size(),
+                  vertexData.vertices.data());
+
+  glBindBuffer(GL_COPY_WRITE_BUFFER, mIndexBuffer);
+  if (indexType == GL_UNSIGNED_SHORT) {
+    std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+    glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset, indexBytes, shortIndices.data());
+  }
+  else {
+    glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset, indexBytes, indices.data());
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  allocation.pool = poolNum;
+  allocation.baseVertex = vertexOffset;
+  allocation.vertexCount = vertexCount;
+  allocation.firstIndex = indexOffset / indexSize;
+  allocation.indexCount = indices.size();
+  allocation.indexType = indexType;
+
+  Logger::log(1,
+              "%s: %i vertices at vertex %i of pool %i, %i indices at index %i\n",
+              __FUNCTION__,
+              allocation.vertexCount,
+              allocation.baseVertex,
+              allocation.pool,
+              allocation.indexCount,
+              allocation.firstIndex);
+  logUsage();
+  return true;
+}
+
+void GeometryArena::release(GeometryAllocation &allocation) {
+  if (allocation.pool < 0) {
+    return;
+  }
+
+  mVertexPools.at(allocation.pool).freeList.addRange(allocation.baseVertex,
+                                                     allocation.vertexCount);
+  size_t indexSize = getIndexSize(allocation.indexType);
+  mIndexFreeList.addRange(allocation.firstIndex * indexSize, allocation.indexCount * indexSize);
+
+  allocation = GeometryAllocation{};
+  logUsage();
+}
+
+void GeometryArena::logUsage() {
+  for (int i = 0; i < mVertexPools.size(); ++i) {
+    VertexPool &pool = mVertexPools.at(i);
+    Logger::log(1,
+                "%s: vertex pool %i uses %i of %i vertices\n",
+                __FUNCTION__,
+                i,
+                pool.capacity - pool.freeList.getFreeSize(),
+                pool.capacity);
+  }
+  Logger::log(1,
+              "%s: index buffer uses %i of %i bytes\n",
+              __FUNCTION__,
+              mIndexBufferSize - mIndexFreeList.getFreeSize(),
+              mIndexBufferSize);
+}
+
+GLuint GeometryArena::getVertexArray(const GeometryAllocation &allocation) {
+  return mVertexPools.at(allocation.pool).vertexArray;
+}
+
+GLuint GeometryArena::getIndexBuffer() {
+  return mIndexBuffer;
+}
+
+void GeometryArena::cleanup() {
+  for (auto &pool : mVertexPools) {
+    glDeleteVertexArrays(1, &pool.vertexArray);
+    glDeleteBuffers(1, &pool.buffer);
+  }
+  mVertexPools.clear();
+
+  glDeleteBuffers(1, &mIndexBuffer);
+  mIndexBuffer = 0;
+  mIndexBufferSize = 0;
+  mIndexFreeList = ArenaFreeList{};
+}
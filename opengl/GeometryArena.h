@@ -0,0 +1,80 @@
+#pragma once
+#include <map>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "VertexPacker.h"
+
+/* Ranges of a model in the arena, the draw commands add the base vertex and the first index. */
+struct GeometryAllocation {
+  int pool = -1;
+  GLint baseVertex = 0;
+  GLuint vertexCount = 0;
+  /* in elements of the index type */
+  GLuint firstIndex = 0;
+  GLuint indexCount = 0;
+  GLenum indexType = GL_UNSIGNED_SHORT;
+};
+
+/* Free ranges of a buffer, first fit with merging of neighbouring ranges. */
+class ArenaFreeList {
+ public:
+  void addRange(size_t offset, size_t size);
+  /* Returns false if no free range is large enough. */
+  bool allocate(size_t size, size_t alignment, size_t &offset);
+  size_t getFreeSize();
+
+ private:
+  /* offset -> size */
+  std::map<size_t, size_t> mFreeRanges{};
+};
+
+/* Few large buffers for the vertices and indices of all models. Models with the
+ * same packed vertex layout share a vertex pool and its VAO, every model is a
+ * range addressed by the base vertex. All pools share a single index buffer.
+ * The buffers grow by copying when a range does not fit anymore.
+ */
+class GeometryArena {
+ public:
+  bool init(size_t vertexBufferSize, size_t indexBufferSize);
+  bool allocate(const PackedVertexData &vertexData,
+                const std::vector<uint32_t> &indices,
+                GLenum indexType,
+                GeometryAllocation &allocation);
+  /* The ranges are reused by the next allocation. */
+  void release(GeometryAllocation &allocation);
+
+  GLuint getVertexArray(const GeometryAllocation &allocation);
+  GLuint getIndexBuffer();
+
+  void cleanup();
+
+ private:
+  struct VertexPool {
+    GLsizei stride = 0;
+    bool quantizedPositions = true;
+    bool packedNormals = true;
+    bool packedTexCoords = true;
+    bool packedWeights = true;
+    GLenum jointType = GL_UNSIGNED_BYTE;
+    bool secondJointSet = false;
+
+    GLuint vertexArray = 0;
+    GLuint buffer = 0;
+    /* in vertices */
+    size_t capacity = 0;
+    ArenaFreeList freeList{};
+  };
+
+  int getVertexPool(const PackedVertexData &vertexData);
+  GLuint growBuffer(GLuint buffer, size_t oldSize, size_t newSize);
+  void logUsage();
+
+  size_t mVertexBufferSize = 0;
+  std::vector<VertexPool> mVertexPools{};
+
+  GLuint mIndexBuffer = 0;
+  size_t mIndexBufferSize = 0;
+  ArenaFreeList mIndexFreeList{};
+};
@@ -0,0 +1,60 @@
+#include "GpuTimer.h"
+
+void GpuTimer::init() {
+  glGenQueries(mQueryCount, mQueries);
+}
+
+void GpuTimer::start() {
+  if (mRunning) {
+    return;
+  }
+
+  /* all queries in flight, only happens if the GPU is several frames behind */
+  if (mQueryPending[mQueryNum]) {
+    readResults(true);
+  }
+  glBeginQuery(GL_TIME_ELAPSED, mQueries[mQueryNum]);
+  mRunning = true;
+}
+
+float GpuTimer::stop() {
+  if (!mRunning) {
+    return mLastResult;
+  }
+  mRunning = false;
+
+  glEndQuery(GL_TIME_ELAPSED);
+  mQueryPending[mQueryNum] = true;
+  mQueryNum = (mQueryNum + 1) % mQueryCount;
+
+  readResults(false);
+  return mLastResult;
+}
+
+/* The queries finish in order, the oldest one is the next query to start. */
+void GpuTimer::readResults(bool wait) {
+  for (int i = 0; i < mQueryCount; ++i) {
+    int queryNum = (mQueryNum + i) % mQueryCount;
+    if (!mQueryPending[queryNum]) {
+      continue;
+    }
+
+    if (!wait) {
+      GLint available = 0;
+      glGetQueryObjectiv(mQueries[queryNum], GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available) {
+        return;
+      }
+    }
+
+    GLuint64 elapsedTime = 0;
+    glGetQueryObjectui64v(mQueries[queryNum], GL_QUERY_RESULT, &elapsedTime);
+    mQueryPending[queryNum] = false;
+    mLastResult = elapsedTime / 1000000.0f;
+    wait = false;
+  }
+}
+
+void GpuTimer::cleanup() {
+  glDeleteQueries(mQueryCount, mQueries);
+}
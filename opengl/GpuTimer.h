@@ -0,0 +1,26 @@
+#pragma once
+
+#include <glad/glad.h>
+
+/* GPU time of the commands between start() and stop(). The results of earlier
+ * frames are read once they are available, stop() returns the latest one and
+ * never waits for the GPU.
+ */
+class GpuTimer {
+ public:
+  void init();
+  void start();
+  /* in milliseconds, a few frames late */
+  float stop();
+  void cleanup();
+
+ private:
+  void readResults(bool wait);
+
+  static const int mQueryCount = 4;
+  GLuint mQueries[mQueryCount] = {};
+  bool mQueryPending[mQueryCount] = {};
+  int mQueryNum = 0;
+  bool mRunning = false;
+  float mLastResult = 0.0f;
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -21,6 +22,47 @@ struct OGLMesh {
   std::vector<OGLVertex> vertices;
 };
 
+/* Per-instance data for the skinning shaders, laid out as the std430 struct in the shader. */
+struct OGLInstanceData {
+  glm::mat4 worldMatrix = glm::mat4(1.0f);
+  /* x: offset of the first joint of the instance in the joint palette */
+  glm::ivec4 paletteOffset = glm::ivec4(0);
+};
+
+/* Instances with a baked animation only need the clip and their time offset. */
+struct OGLBakedInstanceData {
+  glm::mat4 worldMatrix = glm::mat4(1.0f);
+  /* x: clip number, y: time offset in seconds */
+  glm::vec4 animation = glm::vec4(0.0f);
+};
+
+/* Layout of a command in the buffer read by glMultiDrawElementsIndirect. */
+struct OGLDrawCommand {
+  GLuint count = 0;
+  GLuint instanceCount = 0;
+  GLuint firstIndex = 0;
+  GLint baseVertex = 0;
+  GLuint baseInstance = 0;
+};
+
+/* Axis aligned box, an empty box has min > max. */
+struct BoundingBox {
+  glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+  glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+  bool isEmpty() const {
+    return min.x > max.x;
+  }
+  void addPoint(glm::vec3 point) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+  }
+  void addBox(const BoundingBox &box) {
+    min = glm::min(min, box.min);
+    max = glm::max(max, box.max);
+  }
+};
+
 /* UI Ratio button enums*/
 enum class skinningMode { linear = 0, dualQuat };
 
@@ -31,6 +73,58 @@ enum class replayDirection { forward = 0, backward };
 /* Inverse Kinematics. */
 enum class ikMode { off = 0, ccd, fabrik };
 
+/* Source of the pose of far away instances, the baked modes skip the CPU animation. */
+enum class bakedAnimMode { off = 0, palettes, vertices };
+
+/* Animation level of detail. An instance uses the first tier whose minimum
+ * screen size (projected bounding sphere radius in pixels) it reaches.
+ */
+struct AnimationLodTier {
+  float minScreenSize = 0.0f;
+  /* poses are sampled every n-th frame and interpolated in between */
+  int updateInterval = 1;
+  /* joints less than this number of levels above a leaf follow their parent */
+  int skipLeafLevels = 0;
+  bool ikEnabled = true;
+  /* the pose is read from a baked texture, no CPU animation, blending or IK */
+  bakedAnimMode bakedAnimation = bakedAnimMode::off;
+
+  bool operator==(const AnimationLodTier &other) const {
+    return minScreenSize == other.minScreenSize && updateInterval == other.updateInterval &&
+           skipLeafLevels == other.skipLeafLevels && ikEnabled == other.ikEnabled &&
+           bakedAnimation == other.bakedAnimation;
+  }
+  bool operator!=(const AnimationLodTier &other) const {
+    return !(*this == other);
+  }
+};
+
+/* Snapshot of the animation controls, taken on the render thread before
+ * the animation of the next frame is started on a worker thread.
+ */
+struct AnimationSettings {
+  bool asPlayAnimation = true;
+  int asAnimClip = 0;
+  float asAnimSpeed = 1.0f;
+  float asAnimTimePosition = 0.0f;
+  float asAnimBlendFactor = 1.0f;
+  int asCrossBlendDestAnimClip = 0;
+  float asAnimCrossBlendFactor = 0.0f;
+  blendMode asBlendingMode = blendMode::fadeInOut;
+  replayDirection asAnimationPlayDirection = replayDirection::forward;
+  ikMode asIkMode = ikMode::off;
+  glm::vec3 asIkTargetPos = glm::vec3(0.0f);
+  /* global animation clock and the expected frame duration, both in seconds */
+  double asAnimTime = 0.0;
+  float asFrameDuration = 0.0f;
+  unsigned int asFrameNum = 0;
+  /* instances share poses sampled at multiples of the time step */
+  bool asPoseCacheEnabled = true;
+  float asPoseCacheTimeStep = 1.0f / 30.0f;
+  /* clips not decoded yet are decoded in the background instead of by the instance */
+  bool asAsyncClipLoading = false;
+};
+
 struct OGLRenderData {
   GLFWwindow *rdWindow = nullptr;
 
@@ -38,15 +132,31 @@ struct OGLRenderData {
   int rdWidth = 0;
 
   unsigned int rdTriangleCount = 0;
+  /* drawn in the last frame, summed over the mesh LODs */
   unsigned int rdGltfTriangleCount = 0;
+  /* simulated vertex cache of the glTF model, transformed vertices per triangle */
+  float rdGltfExportedACMR = 0.0f;
+  float rdGltfACMR = 0.0f;
+  /* vertex shader invocations for one instance */
+  unsigned int rdGltfTransformedVertices = 0;
+  /* joint influences kept per vertex at load time, at most eight */
+  int rdGltfMaxJointInfluences = 8;
+  /* largest position change of a vertex caused by the pruned influences */
+  float rdGltfPruneError = 0.0f;
 
   float rdFrameTime = 0.0f;
   float rdMatrixGenerateTime = 0.0f;
+  float rdAnimationTime = 0.0f;
+  float rdAnimationWaitTime = 0.0f;
   float rdIKTime = 0.0f;
   float rdUploadToVBOTime = 0.0f;
   float rdUploadToUBOTime = 0.0f;
   float rdUIGenerateTime = 0.0f;
   float rdUIDrawTime = 0.0f;
+  /* GPU time of the skinning and the draws of the glTF model */
+  float rdGltfDrawGPUTime = 0.0f;
+  /* CPU copies of per-frame data into GL buffers, in bytes */
+  size_t rdBytesCopied = 0;
 
   // Camera info
   float rdViewAzimuth = 0.0f;
@@ -64,7 +174,34 @@ struct OGLRenderData {
   bool rdDrawGltfModel = true;
   bool rdDrawSkeleton = true;
 
+  /* Instances */
+  int rdNumberOfInstances = 1;
+  std::vector<AnimationLodTier> rdAnimationLodTiers{};
+  bool rdAnimationLodEnabled = true;
+  std::vector<int> rdLodInstanceCounts{};
+  bool rdFrustumCulling = true;
+  /* culled instances are animated with the last LOD tier */
+  bool rdCulledInstancesLowestLod = true;
+  int rdVisibleInstances = 0;
+
+  /* Mesh LOD, chosen by the same screen size as the animation LOD */
+  bool rdMeshLodEnabled = true;
+  std::vector<float> rdMeshLodMinScreenSizes{};
+  std::vector<int> rdMeshLodInstanceCounts{};
+  /* triangles of a single instance */
+  std::vector<int> rdGltfLodTriangleCounts{};
+
+  /* Pose cache */
+  bool rdPoseCacheEnabled = true;
+  float rdPoseCacheTimeStep = 1.0f / 30.0f;
+  int rdPoseCacheLookups = 0;
+  int rdPoseCacheHits = 0;
+  int rdPoseCacheEntries = 0;
+
   /* Animation */
+  bool rdAnimationThreaded = true;
+  /* sample clips and evaluate the hierarchy in compute shaders, no IK and LOD */
+  bool rdGPUAnimation = false;
   bool rdPlayAnimation = true;
   float rdAnimBlendFactor = 1.0f;
   std::vector<std::string> rdClipNames{};
@@ -77,6 +214,12 @@ struct OGLRenderData {
   int rdCrossBlendDestAnimClip = 0;
   float rdAnimCrossBlendFactor = 0.0f;
 
+  /* Clips of a baked model are decoded on first playback, unused ones are evicted */
+  bool rdAsyncClipLoading = false;
+  int rdClipMemoryBudget = 16;
+  int rdResidentClipCount = 0;
+  size_t rdResidentClipBytes = 0;
+
   /* Inverse Kinematics.*/
   ikMode rdIkMode = ikMode::off;
   int rdIkIterations = 10;
@@ -89,6 +232,10 @@ struct OGLRenderData {
   std::vector<std::string> rdSkelNodeNames{};
 
   skinningMode rdGPUDualQuatVertexSkinning = skinningMode::linear;
+  /* linear skinning of CPU palettes only, the joint matrices are uploaded as 3x4 rows */
+  bool rdPalette3x4 = false;
+  /* skin the visible instances once in a compute pass, the draw reads static vertices */
+  bool rdComputeSkinning = false;
   blendMode rdBlendingMode = blendMode::fadeInOut;
   replayDirection rdAnimationPlayDirection = replayDirection::forward;
 };
\ No newline at end of file
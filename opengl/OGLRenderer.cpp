@@ -1,10 +1,15 @@
 #include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <random>
+#include <thread>
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <imgui_impl_glfw.h>
 
 #include "Logger.h"
 #include "OGLRenderer.h"
+#include "ProgramCache.h"
 
 #include <iostream>
 
@@ -42,25 +47,30 @@ bool OGLRenderer::init(unsigned int width, unsigned int height) {
   mVertexBuffer.init();
   Logger::log(1, "%s: vertex buffer successfully created\n", __FUNCTION__);
 
-  size_t uniformMatrixBufferSize = 2 * sizeof(glm::mat4);
-  mUniformBuffer.init(uniformMatrixBufferSize);
-  Logger::log(1,
-              "%s: matrix uniform buffer (size %i bytes) successfully created\n",
-              __FUNCTION__,
-              uniformMatrixBufferSize);
+  /* per frame data: matrices, instance data and palettes, grows with the instances */
+  const size_t ringBufferRegionSize = 1024 * 1024;
+  if (!mRingBuffer.init(ringBufferRegionSize)) {
+    Logger::log(1, "%s error: could not init ring buffer\n", __FUNCTION__);
+    return false;
+  }
 
-  if (!mLineShader.loadShaders("shader/line.vert", "shader/line.frag")) {
-    Logger::log(1, "%s: line shader loading failed\n", __FUNCTION__);
+  /* static geometry of all models, the buffers grow if a model does not fit */
+  const size_t arenaVertexBufferSize = 16 * 1024 * 1024;
+  const size_t arenaIndexBufferSize = 4 * 1024 * 1024;
+  mGeometryArena = std::make_shared<GeometryArena>();
+  if (!mGeometryArena->init(arenaVertexBufferSize, arenaIndexBufferSize)) {
+    Logger::log(1, "%s error: could not init geometry arena\n", __FUNCTION__);
     return false;
   }
-  if (!mGltfGPUShader.loadShaders("shader/gltf_gpu.vert", "shader/gltf_gpu.frag")) {
-    Logger::log(1, "%s: gltTF GPU shader loading failed\n", __FUNCTION__);
+
+  if (!mLineShader.loadShaders("shader/line.vert", "shader/line.frag")) {
+    Logger::log(1, "%s: line shader loading failed\n", __FUNCTION__);
     return false;
   }
-  if (!mGltfGPUDualQuatShader.loadShaders("shader/gltf_gpu_dquat.vert",
-                                          "shader/gltf_gpu_dquat.frag"))
-  {
-    Logger::log(1, "%s: glTF GPU dual quat shader loading failed\n", __FUNCTION__);
+  /* the skinning variants depend on the model, they are built after loading it */
+  mGltfGPUShaders.init("shader/gltf_gpu.vert", "shader/gltf_gpu.frag");
+  if (!mGltfVATShader.loadShaders("shader/gltf_vat.vert", "shader/gltf_gpu.frag")) {
+    Logger::log(1, "%s: glTF vertex animation texture shader loading failed\n", __FUNCTION__);
     return false;
   }
   Logger::log(1, "%s: shaders succesfully loaded\n", __FUNCTION__);
@@ -73,17 +83,89 @@ bool OGLRenderer::init(unsigned int width, unsigned int height) {
   glEnable(GL_DEPTH_TEST);
   glLineWidth(3.0);
 
+  /* a model baked by janus-bake is read without processing, the glTF file is the fallback */
   mGltfModel = std::make_shared<GltfModel>();
   std::string modelFilename = "assets/Woman.gltf";
+  std::string bakedModelFilename = "assets/Woman.janus";
   std::string modelTexFilename = "textures/Woman.png";
-  if (!mGltfModel->loadModel(mRenderData, modelFilename, modelTexFilename)) {
+  bool modelLoaded = false;
+  if (std::filesystem::exists(bakedModelFilename)) {
+    modelLoaded = mGltfModel->loadModel(mRenderData, bakedModelFilename, modelTexFilename);
+    if (modelLoaded) {
+      modelFilename = bakedModelFilename;
+    }
+    else {
+      Logger::log(1,
+                  "%s: could not read baked model '%s', importing '%s'\n",
+                  __FUNCTION__,
+                  bakedModelFilename.c_str(),
+                  modelFilename.c_str());
+      mGltfModel->cleanup();
+      mGltfModel = std::make_shared<GltfModel>();
+    }
+  }
+  if (!modelLoaded && !mGltfModel->loadModel(mRenderData, modelFilename, modelTexFilename)) {
     Logger::log(1, "%s: loading glTF model '%s' failed\n", __FUNCTION__, modelFilename.c_str());
     return false;
   }
 
-  mGltfModel->uploadIndexBuffer();
+  if (!mGltfModel->uploadGeometry(mGeometryArena)) {
+    Logger::log(1, "%s: uploading glTF model '%s' failed\n", __FUNCTION__, modelFilename.c_str());
+    return false;
+  }
   Logger::log(1, "%s: glTF model '%s' succesfully loaded\n", __FUNCTION__, modelFilename.c_str());
 
+  std::vector<std::string> bakedDefines{};
+  if (mGltfModel->hasSecondJointSet()) {
+    bakedDefines.push_back("SECOND_JOINT_SET");
+  }
+  if (mGltfModel->hasLocalPalettes()) {
+    bakedDefines.push_back("LOCAL_PALETTES");
+  }
+  if (!mGltfBakedShader.loadShaders(
+          "shader/gltf_baked.vert", "shader/gltf_gpu.frag", bakedDefines))
+  {
+    Logger::log(1, "%s: glTF baked animation shader loading failed\n", __FUNCTION__);
+    return false;
+  }
+
+  /* every skinning variant the settings can select, the 3x4 palette is linear only */
+  std::vector<Shader *> gltfShaders = {&mGltfBakedShader};
+  for (skinningMode mode : {skinningMode::linear, skinningMode::dualQuat}) {
+    for (bool palette3x4 : {false, true}) {
+      if (mode == skinningMode::dualQuat && palette3x4) {
+        continue;
+      }
+      for (int jointInfluences : mGltfModel->getJointInfluenceBuckets()) {
+        Shader *shader = mGltfGPUShaders.getShader(
+            getGltfGPUShaderDefines(mode, palette3x4, jointInfluences));
+        if (!shader) {
+          Logger::log(1, "%s: glTF GPU shader loading failed\n", __FUNCTION__);
+          return false;
+        }
+        gltfShaders.push_back(shader);
+      }
+    }
+  }
+
+  /* the decoding of the packed positions is fixed for the model */
+  for (Shader *shader : gltfShaders) {
+    shader->use();
+    shader->setUniformValue("positionOffset", mGltfModel->getPositionOffset());
+    shader->setUniformValue("positionScale", mGltfModel->getPositionScale());
+  }
+
+  /* reset skeleton split */
+  mRenderData.rdSkelSplitNode = mRenderData.rdModelNodeCount - 1;
+
+  /* set values for inverse kinematics */
+  /* hard-code right arm here for startup */
+  mRenderData.rdIkEffectorNode = 19;
+  mRenderData.rdIkRootNode = 26;
+
+  mPoseCache = std::make_shared<PoseCache>();
+  createInstances(mRenderData.rdNumberOfInstances);
+
   size_t modelJointMatrixBufferSize = mGltfModel->getJointMatrixSize() * sizeof(glm::mat4);
   mGltfShaderStorageBuffer.init(modelJointMatrixBufferSize);
   Logger::log(1,
@@ -99,20 +181,38 @@ bool OGLRenderer::init(unsigned int width, unsigned int height) {
               __FUNCTION__,
               modelJointDualQuatBufferSize);
 
+  if (!mComputeAnimation.init(mGltfModel)) {
+    Logger::log(1, "%s: compute animation init failed\n", __FUNCTION__);
+    return false;
+  }
+  if (!mComputeSkinning.init(mGltfModel)) {
+    Logger::log(1, "%s: compute skinning init failed\n", __FUNCTION__);
+    return false;
+  }
+  if (!mSkeletonOverlay.init(mGltfModel)) {
+    Logger::log(1, "%s: skeleton overlay init failed\n", __FUNCTION__);
+    return false;
+  }
+
+  /* the GPU tracks and the baked textures are created on first use, the clips stay encoded */
+  Logger::log(1,
+              "%s: %i of %i animation clips decoded at startup (%i bytes)\n",
+              __FUNCTION__,
+              mGltfModel->getResidentClipCount(),
+              mGltfModel->getAnimClips().size(),
+              mGltfModel->getResidentClipBytes());
+
   /* valid, but emtpy */
   mLineMesh = std::make_shared<OGLMesh>();
   Logger::log(1, "%s: line mesh storage initialized\n", __FUNCTION__);
 
-  /* reset skeleton split */
-  mRenderData.rdSkelSplitNode = mRenderData.rdModelNodeCount - 1;
-
-  /* set values for inverse kinematics */
-  /* hard-code right arm here for startup */
-  mRenderData.rdIkEffectorNode = 19;
-  mRenderData.rdIkRootNode = 26;
-  mGltfModel->setInverseKinematicsNodes(mRenderData.rdIkEffectorNode, mRenderData.rdIkRootNode);
-  mGltfModel->setNumIKIterations(mRenderData.rdIkIterations);
+  Logger::log(1,
+              "%s: %i shader programs loaded from the binary cache, %i compiled\n",
+              __FUNCTION__,
+              ProgramCache::getLoadedPrograms(),
+              ProgramCache::getSavedPrograms());
 
+  mGltfDrawGPUTimer.init();
   mFrameTimer.start();
 
   return true;
@@ -133,7 +233,7 @@ void OGLRenderer::setSize(unsigned int width, unsigned int height) {
   Logger::log(1, "%s: resized window to %dx%d\n", __FUNCTION__, width, height);
 }
 
-void OGLRenderer::uploadData(OGLMesh vertexData) {
+void OGLRenderer::uploadData(const OGLMesh &vertexData) {
   mVertexBuffer.uploadData(vertexData);
 }
 
@@ -169,26 +269,55 @@ void OGLRenderer::draw() {
 
   mViewMatrix = mCamera.getViewMatrix(mRenderData);
 
+  /* hand over the poses generated by the worker during the last frame */
+  if (waitForAnimation()) {
+    for (auto &instance : mGltfInstances) {
+      instance->swapPoseBuffers();
+    }
+  }
+
+  /* no worker uses the clips until the next update, the budget is given in MiB */
+  mGltfModel->evictAnimClips(static_cast<size_t>(mRenderData.rdClipMemoryBudget) * 1024 * 1024);
+  mRenderData.rdResidentClipCount = mGltfModel->getResidentClipCount();
+  mRenderData.rdResidentClipBytes = mGltfModel->getResidentClipBytes();
+
+  if (mRenderData.rdNumberOfInstances != mGltfInstances.size()) {
+    createInstances(mRenderData.rdNumberOfInstances);
+  }
+
+  if (mRenderData.rdAnimationLodTiers != mGltfModel->getAnimationLodTiers()) {
+    mGltfModel->setAnimationLodTiers(mRenderData.rdAnimationLodTiers);
+    for (auto &instance : mGltfInstances) {
+      instance->updateLodMasks();
+      instance->resetNodeData();
+    }
+  }
+  updateBakedAnimation();
+
   /* check values and reset model nodes if required */
+  bool resetNodes = false;
   static blendMode lastBlendMode = mRenderData.rdBlendingMode;
   if (lastBlendMode != mRenderData.rdBlendingMode) {
     lastBlendMode = mRenderData.rdBlendingMode;
     if (mRenderData.rdBlendingMode != blendMode::additive) {
       mRenderData.rdSkelSplitNode = mRenderData.rdModelNodeCount - 1;
     }
-    mGltfModel->resetNodeData();
+    resetNodes = true;
   }
 
   static int skelSplitNode = mRenderData.rdSkelSplitNode;
   if (skelSplitNode != mRenderData.rdSkelSplitNode) {
-    mGltfModel->setSkeletonSplitNode(mRenderData.rdSkelSplitNode);
+    for (auto &instance : mGltfInstances) {
+      instance->setSkeletonSplitNode(mRenderData.rdSkelSplitNode);
+    }
+    mComputeAnimation.setSkeletonSplitNode(mRenderData.rdSkelSplitNode);
     skelSplitNode = mRenderData.rdSkelSplitNode;
-    mGltfModel->resetNodeData();
+    resetNodes = true;
   }
 
   static ikMode lastIkMode = mRenderData.rdIkMode;
   if (lastIkMode != mRenderData.rdIkMode) {
-    mGltfModel->resetNodeData();
+    resetNodes = true;
     lastIkMode = mRenderData.rdIkMode;
     /* clear timer */
     if (mRenderData.rdIkMode == ikMode::off) {
@@ -198,80 +327,64 @@ void OGLRenderer::draw() {
 
   static int numIKIterations = mRenderData.rdIkIterations;
   if (numIKIterations != mRenderData.rdIkIterations) {
-    mGltfModel->setNumIKIterations(mRenderData.rdIkIterations);
-    mGltfModel->resetNodeData();
+    for (auto &instance : mGltfInstances) {
+      instance->setNumIKIterations(mRenderData.rdIkIterations);
+    }
+    resetNodes = true;
     numIKIterations = mRenderData.rdIkIterations;
   }
 
   static int ikEffectorNode = mRenderData.rdIkEffectorNode;
   static int ikRootNode = mRenderData.rdIkRootNode;
   if (ikEffectorNode != mRenderData.rdIkEffectorNode || ikRootNode != mRenderData.rdIkRootNode) {
-    mGltfModel->setInverseKinematicsNodes(mRenderData.rdIkEffectorNode, mRenderData.rdIkRootNode);
-    mGltfModel->resetNodeData();
+    for (auto &instance : mGltfInstances) {
+      instance->setInverseKinematicsNodes(mRenderData.rdIkEffectorNode, mRenderData.rdIkRootNode);
+    }
+    resetNodes = true;
     ikEffectorNode = mRenderData.rdIkEffectorNode;
     ikRootNode = mRenderData.rdIkRootNode;
   }
 
-  /* animate */
-  if (mRenderData.rdPlayAnimation) {
-    if (mRenderData.rdBlendingMode == blendMode::crossFade ||
-        mRenderData.rdBlendingMode == blendMode::additive)
-    {
-      mGltfModel->playAnimation(mRenderData.rdAnimClip,
-                                mRenderData.rdCrossBlendDestAnimClip,
-                                mRenderData.rdAnimSpeed,
-                                mRenderData.rdAnimCrossBlendFactor,
-                                mRenderData.rdAnimationPlayDirection);
-    }
-    else {
-      mGltfModel->playAnimation(mRenderData.rdAnimClip,
-                                mRenderData.rdAnimSpeed,
-                                mRenderData.rdAnimBlendFactor,
-                                mRenderData.rdAnimationPlayDirection);
+  if (resetNodes) {
+    for (auto &instance : mGltfInstances) {
+      instance->resetNodeData();
     }
   }
-  else {
+
+  if (!mRenderData.rdPlayAnimation) {
     mRenderData.rdAnimEndTime = mGltfModel->getAnimationEndTime(mRenderData.rdAnimClip);
-    if (mRenderData.rdBlendingMode == blendMode::crossFade ||
-        mRenderData.rdBlendingMode == blendMode::additive)
-    {
-      mGltfModel->crossBlendAnimationFrame(mRenderData.rdAnimClip,
-                                           mRenderData.rdCrossBlendDestAnimClip,
-                                           mRenderData.rdAnimTimePosition,
-                                           mRenderData.rdAnimCrossBlendFactor);
-    }
-    else {
-      mGltfModel->blendAnimationFrame(
-          mRenderData.rdAnimClip, mRenderData.rdAnimTimePosition, mRenderData.rdAnimBlendFactor);
-    }
   }
 
-  /* solve IK */
-  if (mRenderData.rdIkMode != ikMode::off) {
-    mIKTimer.start();
-    switch (mRenderData.rdIkMode) {
-      case ikMode::ccd:
-        mGltfModel->solveIKByCCD(mRenderData.rdIkTargetPos);
-        break;
-      case ikMode::fabrik:
-        mGltfModel->solveIKByFABRIK(mRenderData.rdIkTargetPos);
-      default:
-        break;
+  cullInstances();
+  updateAnimationLodTiers();
+  updateMeshLods();
+
+  /* animate, the worker generates the poses of the next frame while this frame is drawn */
+  AnimationSettings animSettings = getAnimationSettings();
+  if (mRenderData.rdGPUAnimation) {
+    /* the compute shaders write the palettes of this frame, no upload needed */
+    mAnimationTimer.start();
+    mComputeAnimation.update(
+        animSettings, mGltfInstances, mGltfShaderStorageBuffer, mGltfDualQuatSSBuffer);
+    mRenderData.rdAnimationTime = mAnimationTimer.stop();
+    mRenderData.rdAnimationWaitTime = 0.0f;
+    mRenderData.rdIKTime = 0.0f;
+  }
+  else if (mRenderData.rdAnimationThreaded) {
+    mAnimationFuture = std::async(
+        std::launch::async, [this, animSettings]() { updateAnimation(animSettings); });
+  }
+  else {
+    updateAnimation(animSettings);
+    for (auto &instance : mGltfInstances) {
+      instance->swapPoseBuffers();
     }
-    mRenderData.rdIKTime = mIKTimer.stop();
+    mRenderData.rdAnimationWaitTime = 0.0f;
+    collectAnimationStats();
   }
 
   mLineMesh->vertices.clear();
 
-  /* get gltTF skeleton */
-  mSkeletonLineIndexCount = 0;
-  if (mRenderData.rdDrawSkeleton) {
-    std::shared_ptr<OGLMesh> mesh = mGltfModel->getSkeleton();
-    mSkeletonLineIndexCount += mesh->vertices.size();
-    mLineMesh->vertices.insert(
-        mLineMesh->vertices.begin(), mesh->vertices.begin(), mesh->vertices.end());
-  }
-
   /* draw coordiante arrows on target position */
   mCoordArrowsLineIndexCount = 0;
   if (mRenderData.rdIkMode == ikMode::ccd || mRenderData.rdIkMode == ikMode::fabrik) {
@@ -291,26 +404,127 @@ void OGLRenderer::draw() {
   mRenderData.rdMatrixGenerateTime = mMatrixGenerateTimer.stop();
 
   mUploadToUBOTimer.start();
+  mRingBuffer.beginFrame();
+  mRenderData.rdBytesCopied = 0;
+
   std::vector<glm::mat4> matrixData;
   matrixData.push_back(mViewMatrix);
   matrixData.push_back(mProjectionMatrix);
-  mUniformBuffer.uploadUboData(matrixData, 0);
+  mRingBuffer.uploadUboData(matrixData, 0);
+
+  /* collect the palettes of all instances */
+  int jointCount = mGltfModel->getJointMatrixSize();
+  mInstanceData.clear();
+  mBakedInstanceData.clear();
+  mVATInstanceData.clear();
+  mPaletteInstances.clear();
+  int meshLodCount = mMeshLodInstances.size();
+  mInstanceLodCounts.assign(meshLodCount, 0);
+  mBakedInstanceLodCounts.assign(meshLodCount, 0);
+  mVATInstanceLodCounts.assign(meshLodCount, 0);
+  for (int lod = 0; lod < meshLodCount; ++lod) {
+    for (int instanceNum : mMeshLodInstances.at(lod)) {
+      std::shared_ptr<GltfInstance> instance = mGltfInstances.at(instanceNum);
+
+      /* baked instances only need the clip and the clock, no palette */
+      if (!mRenderData.rdGPUAnimation && instance->isBaked()) {
+        OGLBakedInstanceData bakedData{};
+        bakedData.worldMatrix = instance->getWorldTransformMatrix();
+        bakedData.animation.x = animSettings.asAnimClip;
+        bakedData.animation.y = instance->getTimeOffset();
+        if (instance->getBakedAnimation() == bakedAnimMode::vertices) {
+          mVATInstanceData.emplace_back(bakedData);
+          ++mVATInstanceLodCounts.at(lod);
+        }
+        else {
+          mBakedInstanceData.emplace_back(bakedData);
+          ++mBakedInstanceLodCounts.at(lod);
+        }
+        continue;
+      }
+
+      OGLInstanceData instanceData{};
+      instanceData.worldMatrix = instance->getWorldTransformMatrix();
+      ++mInstanceLodCounts.at(lod);
 
-  if (mRenderData.rdGPUDualQuatVertexSkinning == skinningMode::dualQuat) {
-    mGltfDualQuatSSBuffer.uploadSsboData(mGltfModel->getJointDualQuats(), 2);
+      /* the GPU animation writes the palettes of all instances in instance order */
+      if (mRenderData.rdGPUAnimation) {
+        instanceData.paletteOffset.x = instanceNum * jointCount;
+        mInstanceData.emplace_back(instanceData);
+        continue;
+      }
+      instanceData.paletteOffset.x = mInstanceData.size() * jointCount;
+      mInstanceData.emplace_back(instanceData);
+      mPaletteInstances.emplace_back(instanceNum);
+    }
   }
-  else {
-    mGltfShaderStorageBuffer.uploadSsboData(mGltfModel->getJointMatrices(), 1);
+
+  /* the pre-skinned vertices are always drawn with the full mesh */
+  mRenderData.rdGltfTriangleCount = 0;
+  for (int lod = 0; lod < meshLodCount; ++lod) {
+    int instanceCount = mBakedInstanceLodCounts.at(lod) + mVATInstanceLodCounts.at(lod);
+    instanceCount += mRenderData.rdComputeSkinning ? 0 : mInstanceLodCounts.at(lod);
+    mRenderData.rdGltfTriangleCount += instanceCount * mGltfModel->getMeshLodTriangleCount(lod);
+  }
+  if (mRenderData.rdComputeSkinning) {
+    mRenderData.rdGltfTriangleCount +=
+        mInstanceData.size() * mGltfModel->getMeshLodTriangleCount(0);
+  }
+
+  /* kept for the skeleton, the baked instances replace the instance data before */
+  RingBufferRange instanceDataRange{};
+  if (!mInstanceData.empty()) {
+    instanceDataRange = mRingBuffer.allocate(mInstanceData.size() * sizeof(OGLInstanceData));
+    if (instanceDataRange.data) {
+      mRingBuffer.writeRange(instanceDataRange, 0, mInstanceData);
+      mRingBuffer.bindRange(GL_SHADER_STORAGE_BUFFER, 3, instanceDataRange);
+    }
+  }
+
+  /* the palettes are copied from the instances straight into the mapped buffer */
+  if (!mPaletteInstances.empty()) {
+    bool dualQuats = mRenderData.rdGPUDualQuatVertexSkinning == skinningMode::dualQuat;
+    /* the last row of a joint matrix is constant, the 3x4 rows are a quarter less to copy */
+    size_t jointSize = dualQuats ? sizeof(glm::mat2x4)
+                                 : (usePalette3x4() ? sizeof(glm::mat3x4) : sizeof(glm::mat4));
+    RingBufferRange range = mRingBuffer.allocate(mPaletteInstances.size() * jointCount *
+                                                 jointSize);
+    if (range.data && dualQuats) {
+      for (int i = 0; i < mPaletteInstances.size(); ++i) {
+        std::shared_ptr<GltfInstance> instance = mGltfInstances.at(mPaletteInstances.at(i));
+        mRingBuffer.writeRange(range, i * jointCount, instance->getJointDualQuats());
+      }
+      mRingBuffer.bindRange(GL_SHADER_STORAGE_BUFFER, 2, range);
+    }
+    else if (range.data && usePalette3x4()) {
+      /* the rows are transposed straight into the mapped memory */
+      for (int i = 0; i < mPaletteInstances.size(); ++i) {
+        std::shared_ptr<GltfInstance> instance = mGltfInstances.at(mPaletteInstances.at(i));
+        const std::vector<glm::mat4> &jointMatrices = instance->getJointMatrices();
+        for (int joint = 0; joint < jointCount; ++joint) {
+          mRingBuffer.writeElement(range,
+                                   i * jointCount + joint,
+                                   glm::mat3x4(glm::transpose(jointMatrices.at(joint))));
+        }
+      }
+      mRingBuffer.bindRange(GL_SHADER_STORAGE_BUFFER, 1, range);
+    }
+    else if (range.data) {
+      for (int i = 0; i < mPaletteInstances.size(); ++i) {
+        std::shared_ptr<GltfInstance> instance = mGltfInstances.at(mPaletteInstances.at(i));
+        mRingBuffer.writeRange(range, i * jointCount, instance->getJointMatrices());
+      }
+      mRingBuffer.bindRange(GL_SHADER_STORAGE_BUFFER, 1, range);
+    }
   }
   mRenderData.rdUploadToUBOTime = mUploadToUBOTimer.stop();
 
   /* upload vertex data */
   mUploadToVBOTimer.start();
 
-  if (mRenderData.rdDrawSkeleton || mRenderData.rdIkMode == ikMode::ccd ||
-      mRenderData.rdIkMode == ikMode::fabrik)
-  {
+  if (mRenderData.rdIkMode == ikMode::ccd || mRenderData.rdIkMode == ikMode::fabrik) {
     uploadData(*mLineMesh);
+    mRenderData.rdBytesCopied += mVertexBuffer.getBytesCopied();
   }
 
   if (mModelUploadRequired) {
@@ -321,30 +535,61 @@ void OGLRenderer::draw() {
   mRenderData.rdUploadToVBOTime = mUploadToVBOTimer.stop();
 
   /* draw the glTF model */
-  if (mRenderData.rdDrawGltfModel) {
-    if (mRenderData.rdGPUDualQuatVertexSkinning == skinningMode::dualQuat) {
-      mGltfGPUDualQuatShader.use();
-    }
-    else {
-      mGltfGPUShader.use();
+  mGltfDrawGPUTimer.start();
+  if (mRenderData.rdDrawGltfModel && !mInstanceData.empty() && mRenderData.rdComputeSkinning) {
+    mComputeSkinning.skinInstances(mInstanceData.size(), mRenderData.rdGPUDualQuatVertexSkinning);
+    mComputeSkinning.draw(mRingBuffer, mInstanceData.size());
+  }
+  else if (mRenderData.rdDrawGltfModel && !mInstanceData.empty()) {
+    /* one draw per influence bucket, each with the variant skinning that many joints */
+    for (int jointInfluences : mGltfModel->getJointInfluenceBuckets()) {
+      Shader *shader = mGltfGPUShaders.getShader(getGltfGPUShaderDefines(
+          mRenderData.rdGPUDualQuatVertexSkinning, usePalette3x4(), jointInfluences));
+      if (shader) {
+        shader->use();
+        mGltfModel->drawInstanced(mRingBuffer, mInstanceLodCounts, jointInfluences);
+      }
     }
-    mGltfModel->draw();
   }
 
+  /* the baked instances replace the instance data, they are drawn last */
+  if (mRenderData.rdDrawGltfModel && !mBakedInstanceData.empty()) {
+    mRingBuffer.uploadSsboData(mBakedInstanceData, 3);
+    mAnimationTexture.bind(1, 4);
+    mGltfBakedShader.use();
+    setBakedAnimationUniforms(mGltfBakedShader, animSettings);
+    mGltfModel->drawInstanced(mRingBuffer, mBakedInstanceLodCounts);
+  }
+  if (mRenderData.rdDrawGltfModel && !mVATInstanceData.empty()) {
+    mRingBuffer.uploadSsboData(mVATInstanceData, 3);
+    mVertexAnimationTexture.bind(1, 4, 5);
+    mGltfVATShader.use();
+    setBakedAnimationUniforms(mGltfVATShader, animSettings);
+    mGltfVATShader.setUniformValue("rowsPerFrame", mVertexAnimationTexture.getRowsPerFrame());
+    mGltfVATShader.setUniformValue("baseVertex", mGltfModel->getArenaBaseVertex());
+    mGltfModel->drawInstanced(mRingBuffer, mVATInstanceLodCounts);
+  }
+  mRenderData.rdGltfDrawGPUTime = mGltfDrawGPUTimer.stop();
+
   /* draw the coordinate arrow WITH depth buffer */
   if (mCoordArrowsLineIndexCount > 0) {
     mLineShader.use();
-    mVertexBuffer.bindAndDraw(GL_LINES, mSkeletonLineIndexCount, mCoordArrowsLineIndexCount);
+    mVertexBuffer.bindAndDraw(GL_LINES, 0, mCoordArrowsLineIndexCount);
   }
 
-  /* draw the skeleton, disable depth test to overlay */
-  if (mSkeletonLineIndexCount > 0) {
+  /* draw the skeleton from the palettes, disable depth test to overlay */
+  if (mRenderData.rdDrawSkeleton && instanceDataRange.data) {
     glDisable(GL_DEPTH_TEST);
-    mLineShader.use();
-    mVertexBuffer.bindAndDraw(GL_LINES, 0, mSkeletonLineIndexCount);
+    mRingBuffer.bindRange(GL_SHADER_STORAGE_BUFFER, 3, instanceDataRange);
+    mSkeletonOverlay.draw(
+        mInstanceData.size(), mRenderData.rdGPUDualQuatVertexSkinning, usePalette3x4());
     glEnable(GL_DEPTH_TEST);
   }
 
+  /* all draws reading the ring buffer data of this frame are submitted */
+  mRingBuffer.endFrame();
+  mRenderData.rdBytesCopied += mRingBuffer.getBytesCopied();
+
   mFramebuffer.unbind();
 
   /* blit color buffer to screen */
@@ -361,19 +606,378 @@ void OGLRenderer::draw() {
   mLastTickTime = tickTime;
 }
 
+void OGLRenderer::runSkinningBenchmark(int instanceCount, int frameCount) {
+  OGLRenderData savedRenderData = mRenderData;
+
+  /* every instance uses the full mesh and the vertex skinning of its path */
+  mRenderData.rdNumberOfInstances = instanceCount;
+  mRenderData.rdFrustumCulling = false;
+  mRenderData.rdAnimationLodEnabled = false;
+  mRenderData.rdMeshLodEnabled = false;
+  mRenderData.rdGPUAnimation = false;
+  mRenderData.rdDrawSkeleton = false;
+
+  struct SkinningPath {
+    std::string name;
+    skinningMode mode;
+    bool computeSkinning;
+  };
+  std::vector<SkinningPath> skinningPaths = {
+      {"linear, vertex shader", skinningMode::linear, false},
+      {"dual quaternion, vertex shader", skinningMode::dualQuat, false},
+      {"linear, compute shader", skinningMode::linear, true},
+      {"dual quaternion, compute shader", skinningMode::dualQuat, true}};
+
+  /* the GPU timer returns the result of a few frames ago */
+  const int warmupFrameCount = 10;
+  for (const auto &path : skinningPaths) {
+    mRenderData.rdGPUDualQuatVertexSkinning = path.mode;
+    mRenderData.rdComputeSkinning = path.computeSkinning;
+
+    float gpuTime = 0.0f;
+    for (int i = 0; i < warmupFrameCount + frameCount; ++i) {
+      draw();
+      glfwSwapBuffers(mRenderData.rdWindow);
+      glfwPollEvents();
+      if (i >= warmupFrameCount) {
+        gpuTime += mRenderData.rdGltfDrawGPUTime;
+      }
+    }
+    Logger::log(1,
+                "%s: %s, %i instances: %.3f ms GPU time per frame\n",
+                __FUNCTION__,
+                path.name.c_str(),
+                instanceCount,
+                gpuTime / frameCount);
+  }
+
+  mRenderData = savedRenderData;
+}
+
+std::vector<std::string> OGLRenderer::getGltfGPUShaderDefines(skinningMode mode,
+                                                              bool palette3x4,
+                                                              int jointInfluences) {
+  std::vector<std::string> defines = {"INSTANCING",
+                                      "JOINT_INFLUENCES " + std::to_string(jointInfluences)};
+  if (mode == skinningMode::dualQuat) {
+    defines.emplace_back("DUAL_QUAT_SKINNING");
+  }
+  else if (palette3x4) {
+    defines.emplace_back("PALETTE_3X4");
+  }
+  if (mGltfModel->hasLocalPalettes()) {
+    defines.emplace_back("LOCAL_PALETTES");
+  }
+  return defines;
+}
+
+/* The GPU animation and the compute skinning write and read full matrices. */
+bool OGLRenderer::usePalette3x4() {
+  return mRenderData.rdPalette3x4 && !mRenderData.rdGPUAnimation &&
+         !mRenderData.rdComputeSkinning &&
+         mRenderData.rdGPUDualQuatVertexSkinning == skinningMode::linear;
+}
+
+/* The baked shaders run the clock of the CPU animation, per instance only the offset differs. */
+void OGLRenderer::setBakedAnimationUniforms(Shader &shader, const AnimationSettings &settings) {
+  bool playBackward = settings.asAnimationPlayDirection == replayDirection::backward;
+  shader.setUniformValue("animTime", static_cast<float>(settings.asAnimTime));
+  if (settings.asPlayAnimation) {
+    shader.setUniformValue("animTimePosition", 0.0f);
+    shader.setUniformValue("animSpeed", settings.asAnimSpeed);
+    shader.setUniformValue("playBackward", playBackward ? 1 : 0);
+  }
+  else {
+    shader.setUniformValue("animTimePosition", settings.asAnimTimePosition);
+    shader.setUniformValue("animSpeed", 0.0f);
+    shader.setUniformValue("playBackward", 0);
+  }
+}
+
+AnimationSettings OGLRenderer::getAnimationSettings() {
+  AnimationSettings settings{};
+  settings.asPlayAnimation = mRenderData.rdPlayAnimation;
+  settings.asAnimClip = mRenderData.rdAnimClip;
+  settings.asAnimSpeed = mRenderData.rdAnimSpeed;
+  settings.asAnimTimePosition = mRenderData.rdAnimTimePosition;
+  settings.asAnimBlendFactor = mRenderData.rdAnimBlendFactor;
+  settings.asCrossBlendDestAnimClip = mRenderData.rdCrossBlendDestAnimClip;
+  settings.asAnimCrossBlendFactor = mRenderData.rdAnimCrossBlendFactor;
+  settings.asBlendingMode = mRenderData.rdBlendingMode;
+  settings.asAnimationPlayDirection = mRenderData.rdAnimationPlayDirection;
+  settings.asIkMode = mRenderData.rdIkMode;
+  settings.asIkTargetPos = mRenderData.rdIkTargetPos;
+  settings.asAnimTime = glfwGetTime();
+  settings.asFrameDuration = mRenderData.rdFrameTime / 1000.0f;
+  settings.asFrameNum = mAnimationFrameNum++;
+  settings.asPoseCacheEnabled = mRenderData.rdPoseCacheEnabled;
+  settings.asPoseCacheTimeStep = mRenderData.rdPoseCacheTimeStep;
+  settings.asAsyncClipLoading = mRenderData.rdAsyncClipLoading;
+  return settings;
+}
+
+/* Runs on the animation worker, must not touch mRenderData or any GL state. */
+void OGLRenderer::updateAnimation(AnimationSettings settings) {
+  mAnimationTimer.start();
+  mPoseCache->newFrame();
+
+  /* the instances are independent, split them into chunks for the worker threads */
+  const int minInstancesPerThread = 8;
+  int numInstances = mGltfInstances.size();
+  int numThreads = std::clamp(numInstances / minInstancesPerThread,
+                              1,
+                              std::max(static_cast<int>(std::thread::hardware_concurrency()), 1));
+  int instancesPerThread = (numInstances + numThreads - 1) / numThreads;
+
+  std::vector<std::future<void>> chunkFutures{};
+  for (int first = instancesPerThread; first < numInstances; first += instancesPerThread) {
+    int last = std::min(first + instancesPerThread, numInstances);
+    chunkFutures.emplace_back(std::async(std::launch::async, [this, settings, first, last]() {
+      updateInstanceAnimations(settings, first, last);
+    }));
+  }
+  updateInstanceAnimations(settings, 0, std::min(instancesPerThread, numInstances));
+
+  for (auto &chunkFuture : chunkFutures) {
+    chunkFuture.get();
+  }
+
+  mAnimationTime = mAnimationTimer.stop();
+}
+
+void OGLRenderer::updateInstanceAnimations(AnimationSettings settings,
+                                           int firstInstance,
+                                           int lastInstance) {
+  for (int i = firstInstance; i < lastInstance; ++i) {
+    /* baked instances have the bounds of the whole clip, waiting ones keep their pose */
+    if (mGltfInstances.at(i)->updateAnimation(settings, i)) {
+      mGltfInstances.at(i)->updateBounds();
+    }
+  }
+}
+
+/* Chooses the animation LOD tier of every instance from its size on screen. */
+void OGLRenderer::updateAnimationLodTiers() {
+  const std::vector<AnimationLodTier> &tiers = mGltfModel->getAnimationLodTiers();
+  mRenderData.rdLodInstanceCounts.assign(tiers.size(), 0);
+
+  /* the visible list is sorted by instance number */
+  auto visibleIter = mVisibleInstances.begin();
+
+  for (int instanceNum = 0; instanceNum < mGltfInstances.size(); ++instanceNum) {
+    std::shared_ptr<GltfInstance> instance = mGltfInstances.at(instanceNum);
+    bool isVisible = visibleIter != mVisibleInstances.end() && *visibleIter == instanceNum;
+    if (isVisible) {
+      ++visibleIter;
+    }
+
+    int tierNum = 0;
+    if (!isVisible && mRenderData.rdCulledInstancesLowestLod) {
+      /* still animated, the bounds must follow the pose to find the instance again */
+      tierNum = tiers.size() - 1;
+    }
+    else if (mRenderData.rdAnimationLodEnabled) {
+      float screenSize = getScreenSize(instance);
+      tierNum = tiers.size() - 1;
+      for (int i = 0; i < tiers.size(); ++i) {
+        if (screenSize >= tiers.at(i).minScreenSize) {
+          tierNum = i;
+          break;
+        }
+      }
+    }
+    instance->setLodTier(tierNum);
+    ++mRenderData.rdLodInstanceCounts.at(tierNum);
+  }
+}
+
+/* The bakes sample every clip, they run when a LOD tier uses a baked mode for the
+ * first time. A failed bake turns the mode off in the tiers again.
+ */
+void OGLRenderer::updateBakedAnimation() {
+  bool bakedPalettes = false;
+  bool bakedVertices = false;
+  for (const auto &tier : mGltfModel->getAnimationLodTiers()) {
+    bakedPalettes |= tier.bakedAnimation == bakedAnimMode::palettes;
+    bakedVertices |= tier.bakedAnimation == bakedAnimMode::vertices;
+  }
+
+  /* the palette bake also creates the clip bounds, the vertex tiers need them too */
+  bool bakeFailed = false;
+  if ((bakedPalettes || bakedVertices) && !mAnimationTextureBaked) {
+    const float bakeSampleRate = 30.0f;
+    mAnimationTextureBaked = mAnimationTexture.bake(mGltfModel, bakeSampleRate);
+    if (!mAnimationTextureBaked) {
+      Logger::log(1, "%s error: animation bake failed\n", __FUNCTION__);
+      bakeFailed = true;
+    }
+  }
+
+  /* skinned vertices for the farthest tiers, fewer frames are enough there */
+  if (bakedVertices && mAnimationTextureBaked && !mVertexAnimationTextureBaked) {
+    const float vertexBakeSampleRate = 15.0f;
+    mVertexAnimationTextureBaked =
+        mVertexAnimationTexture.bake(mGltfModel, vertexBakeSampleRate);
+    if (!mVertexAnimationTextureBaked) {
+      Logger::log(1, "%s error: vertex animation bake failed\n", __FUNCTION__);
+      bakeFailed = true;
+    }
+  }
+
+  if (!bakeFailed) {
+    return;
+  }
+  for (auto &tier : mRenderData.rdAnimationLodTiers) {
+    if ((tier.bakedAnimation == bakedAnimMode::palettes && !mAnimationTextureBaked) ||
+        (tier.bakedAnimation == bakedAnimMode::vertices && !mVertexAnimationTextureBaked))
+    {
+      tier.bakedAnimation = bakedAnimMode::off;
+    }
+  }
+  mGltfModel->setAnimationLodTiers(mRenderData.rdAnimationLodTiers);
+  for (auto &instance : mGltfInstances) {
+    instance->updateLodMasks();
+    instance->resetNodeData();
+  }
+}
+
+/* Chooses the mesh LOD of every visible instance, the instance data is sorted by LOD. */
+void OGLRenderer::updateMeshLods() {
+  int meshLodCount = mGltfModel->getMeshLodCount();
+  mRenderData.rdMeshLodMinScreenSizes.resize(meshLodCount, 0.0f);
+  mMeshLodInstances.assign(meshLodCount, {});
+
+  for (int instanceNum : mVisibleInstances) {
+    int lod = 0;
+    if (mRenderData.rdMeshLodEnabled) {
+      float screenSize = getScreenSize(mGltfInstances.at(instanceNum));
+      lod = meshLodCount - 1;
+      for (int i = 0; i < meshLodCount; ++i) {
+        if (screenSize >= mRenderData.rdMeshLodMinScreenSizes.at(i)) {
+          lod = i;
+          break;
+        }
+      }
+    }
+    mMeshLodInstances.at(lod).emplace_back(instanceNum);
+  }
+
+  mRenderData.rdMeshLodInstanceCounts.resize(meshLodCount);
+  for (int lod = 0; lod < meshLodCount; ++lod) {
+    mRenderData.rdMeshLodInstanceCounts.at(lod) = mMeshLodInstances.at(lod).size();
+  }
+}
+
+float OGLRenderer::getScreenSize(std::shared_ptr<GltfInstance> instance) {
+  /* projected size of one world unit at distance 1, in pixels */
+  float projScale = static_cast<float>(mRenderData.rdHeight) /
+                    (2.0f * std::tan(glm::radians(mRenderData.rdFieldOfView / 2.0f)));
+  glm::vec4 boundingSphere = mGltfModel->getBoundingSphere();
+
+  glm::vec3 center = instance->getWorldPosition() + glm::vec3(boundingSphere);
+  float distance = std::max(glm::length(center - mRenderData.rdCameraWorldPosition), 0.01f);
+  return boundingSphere.w * projScale / distance;
+}
+
+/* Culls with the bounds of the front pose, the one that is drawn in this frame. */
+void OGLRenderer::cullInstances() {
+  mVisibleInstances.clear();
+  mFrustum.update(mProjectionMatrix * mViewMatrix);
+  for (int i = 0; i < mGltfInstances.size(); ++i) {
+    if (!mRenderData.rdFrustumCulling || mFrustum.isBoxVisible(mGltfInstances.at(i)->getBounds()))
+    {
+      mVisibleInstances.emplace_back(i);
+    }
+  }
+  mRenderData.rdVisibleInstances = mVisibleInstances.size();
+}
+
+void OGLRenderer::createInstances(int numInstances) {
+  mGltfInstances.clear();
+
+  /* square grid with the first instance at the origin, spreading away from the camera */
+  const float instanceSpacing = 4.0f;
+  int gridSize = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(numInstances))));
+
+  /* fixed seed, the crowd looks the same on every start */
+  std::mt19937 randomEngine(42);
+  std::uniform_real_distribution<float> timeOffsetDistribution(0.0f, 10.0f);
+
+  for (int i = 0; i < numInstances; ++i) {
+    int xPos = (i % gridSize) - gridSize / 2;
+    int zPos = i / gridSize;
+    if (i == 0) {
+      xPos = 0;
+    }
+    glm::vec3 worldPos = glm::vec3(xPos * instanceSpacing, 0.0f, -zPos * instanceSpacing);
+    float timeOffset = i == 0 ? 0.0f : timeOffsetDistribution(randomEngine);
+
+    std::shared_ptr<GltfInstance> instance = std::make_shared<GltfInstance>(
+        mGltfModel, worldPos, timeOffset);
+    instance->setSkeletonSplitNode(mRenderData.rdSkelSplitNode);
+    instance->setInverseKinematicsNodes(mRenderData.rdIkEffectorNode, mRenderData.rdIkRootNode);
+    instance->setNumIKIterations(mRenderData.rdIkIterations);
+    instance->setPoseCache(mPoseCache);
+    instance->resetNodeData();
+    mGltfInstances.emplace_back(instance);
+  }
+  Logger::log(1, "%s: created %i glTF instances\n", __FUNCTION__, mGltfInstances.size());
+}
+
+bool OGLRenderer::waitForAnimation() {
+  if (!mAnimationFuture.valid()) {
+    return false;
+  }
+
+  mAnimationWaitTimer.start();
+  mAnimationFuture.get();
+  mRenderData.rdAnimationWaitTime = mAnimationWaitTimer.stop();
+
+  /* the future synchronizes the worker results with the render thread */
+  collectAnimationStats();
+  return true;
+}
+
+void OGLRenderer::collectAnimationStats() {
+  mRenderData.rdAnimationTime = mAnimationTime;
+  mRenderData.rdIKTime = 0.0f;
+  for (auto &instance : mGltfInstances) {
+    mRenderData.rdIKTime += instance->getIKTime();
+  }
+
+  mRenderData.rdPoseCacheLookups = mPoseCache->getLookups();
+  mRenderData.rdPoseCacheHits = mPoseCache->getHits();
+  mRenderData.rdPoseCacheEntries = mPoseCache->getEntryCount();
+}
+
 void OGLRenderer::cleanup() {
+  waitForAnimation();
   mUserInterface.cleanup();
 
   mBasicShader.cleanup();
   mChangedShader.cleanup();
   mGltfShader.cleanup();
-  mGltfGPUShader.cleanup();
+  mGltfGPUShaders.cleanup();
 
   mTex.cleanup();
+  mVisibleInstances.clear();
+  mGltfInstances.clear();
   mGltfModel->cleanup();
   mGltfModel.reset();
+  mComputeAnimation.cleanup();
+  mComputeSkinning.cleanup();
+  mSkeletonOverlay.cleanup();
+  mAnimationTexture.cleanup();
+  mGltfBakedShader.cleanup();
+  mVertexAnimationTexture.cleanup();
+  mGltfVATShader.cleanup();
+  mGltfShaderStorageBuffer.cleanup();
+  mGltfDualQuatSSBuffer.cleanup();
+  mRingBuffer.cleanup();
+  mGeometryArena->cleanup();
   mVertexBuffer.cleanup();
   mFramebuffer.cleanup();
+  mGltfDrawGPUTimer.cleanup();
 }
 
 void OGLRenderer::handleKeyEvents(int key, int scancode, int action, int mods) {}
@@ -8,20 +8,31 @@
 #include <glm/glm.hpp>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/quaternion.hpp>
+#include <future>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "Camera.h"
+#include "AnimationTexture.h"
+#include "ComputeAnimation.h"
+#include "ComputeSkinning.h"
 #include "CoordArrowsModel.h"
 #include "Framebuffer.h"
+#include "Frustum.h"
+#include "GeometryArena.h"
+#include "GltfInstance.h"
 #include "GltfModel.h"
+#include "GpuTimer.h"
+#include "RingBuffer.h"
 #include "Shader.h"
+#include "ShaderPermutations.h"
 #include "ShaderStorageBuffer.h"
+#include "SkeletonOverlay.h"
 #include "Texture.h"
 #include "Timer.h"
-#include "UniformBuffer.h"
 #include "UserInterface.h"
+#include "VertexAnimationTexture.h"
 #include "VertexBuffer.h"
 
 #include "OGLRenderData.h"
@@ -33,8 +44,12 @@ class OGLRenderer {
   bool init(unsigned int width, unsigned int height);
   void setSize(unsigned int width, unsigned int height);
   void cleanup();
-  void uploadData(OGLMesh vertexData);
+  void uploadData(const OGLMesh &vertexData);
   void draw();
+  /* Draws the given number of frames per skinning path and logs the average GPU
+   * time of the glTF draws, the settings of the UI are restored afterwards.
+   */
+  void runSkinningBenchmark(int instanceCount, int frameCount);
 
   /* Key Handlers. */
   void handleKeyEvents(int key, int scancode, int action, int mods);
@@ -46,17 +61,60 @@ class OGLRenderer {
  private:
   void handleMovementKeys();
 
+  /* Animation pipeline, the poses of frame N+1 are generated while frame N is drawn. */
+  AnimationSettings getAnimationSettings();
+  void updateAnimation(AnimationSettings settings);
+  void updateInstanceAnimations(AnimationSettings settings, int firstInstance, int lastInstance);
+  bool waitForAnimation();
+  void setBakedAnimationUniforms(Shader &shader, const AnimationSettings &settings);
+
+  /* The skinning variant of the glTF shader and its palette layout. */
+  std::vector<std::string> getGltfGPUShaderDefines(skinningMode mode,
+                                                   bool palette3x4,
+                                                   int jointInfluences);
+  bool usePalette3x4();
+
+  void createInstances(int numInstances);
+  void updateAnimationLodTiers();
+  /* Bakes the palette and vertex animation textures for the tiers that use them. */
+  void updateBakedAnimation();
+  void updateMeshLods();
+  /* radius of the bounding sphere projected to the screen, in pixels */
+  float getScreenSize(std::shared_ptr<GltfInstance> instance);
+  void cullInstances();
+  /* copies the timers and counters of the last animation update to the render data */
+  void collectAnimationStats();
+
   OGLRenderData mRenderData{};
   UserInterface mUserInterface{};
 
   /* Model. */
   std::shared_ptr<GltfModel> mGltfModel = nullptr;
+  std::vector<std::shared_ptr<GltfInstance>> mGltfInstances{};
+  /* numbers of the instances inside the view frustum, only these are uploaded and drawn */
+  std::vector<int> mVisibleInstances{};
+  /* the visible instances of every mesh LOD */
+  std::vector<std::vector<int>> mMeshLodInstances{};
+  ComputeAnimation mComputeAnimation{};
+  ComputeSkinning mComputeSkinning{};
+  SkeletonOverlay mSkeletonOverlay{};
+  AnimationTexture mAnimationTexture{};
+  VertexAnimationTexture mVertexAnimationTexture{};
+  bool mAnimationTextureBaked = false;
+  bool mVertexAnimationTextureBaked = false;
+  std::shared_ptr<PoseCache> mPoseCache = nullptr;
   bool mModelUploadRequired = true;
 
+  /* Animation worker, only the worker touches the model nodes while running. */
+  std::future<void> mAnimationFuture{};
+  float mAnimationTime = 0.0f;
+  unsigned int mAnimationFrameNum = 0;
+
   /* Shaders. */
   Shader mGltfShader{};
-  Shader mGltfGPUShader{};
-  Shader mGltfGPUDualQuatShader{};
+  ShaderPermutations mGltfGPUShaders{};
+  Shader mGltfBakedShader{};
+  Shader mGltfVATShader{};
 
   Shader mLineShader{};
   Shader mBasicShader{};
@@ -68,10 +126,25 @@ class OGLRenderer {
   /* Buffers. */
   Framebuffer mFramebuffer{};
   VertexBuffer mVertexBuffer{};
-  UniformBuffer mUniformBuffer{};
+  /* matrices, instance data and the CPU palettes of every frame */
+  RingBuffer mRingBuffer{};
+  /* vertices and indices of all models */
+  std::shared_ptr<GeometryArena> mGeometryArena = nullptr;
+  /* palettes written by the GPU animation */
   ShaderStorageBuffer mGltfShaderStorageBuffer{};
   ShaderStorageBuffer mGltfDualQuatSSBuffer{};
 
+  /* Instance data of the visible instances, uploaded in one go. */
+  std::vector<OGLInstanceData> mInstanceData{};
+  /* instances with a CPU palette, in palette order */
+  std::vector<int> mPaletteInstances{};
+  std::vector<OGLBakedInstanceData> mBakedInstanceData{};
+  std::vector<OGLBakedInstanceData> mVATInstanceData{};
+  /* the instance data is sorted by mesh LOD, instances of every LOD */
+  std::vector<int> mInstanceLodCounts{};
+  std::vector<int> mBakedInstanceLodCounts{};
+  std::vector<int> mVATInstanceLodCounts{};
+
   /* UniformBuffer Data. */
   glm::mat4 mViewMatrix = glm::mat4(1.0f);
   glm::mat4 mProjectionMatrix = glm::mat4(1.0f);
@@ -79,18 +152,20 @@ class OGLRenderer {
   /* Timers*/
   Timer mFrameTimer{};
   Timer mMatrixGenerateTimer{};
+  Timer mAnimationTimer{};
+  Timer mAnimationWaitTimer{};
   Timer mUploadToVBOTimer{};
   Timer mUploadToUBOTimer{};
   Timer mUIGenerateTimer{};
   Timer mUIDrawTimer{};
-  Timer mIKTimer{};
+  GpuTimer mGltfDrawGPUTimer{};
 
   Camera mCamera{};
+  Frustum mFrustum{};
 
   CoordArrowsModel mCoordArrowsModel{};
   OGLMesh mCoordArrowsMesh{};
   std::shared_ptr<OGLMesh> mLineMesh = nullptr;
-  unsigned int mSkeletonLineIndexCount = 0;
   unsigned int mCoordArrowsLineIndexCount = 0;
 
   /* Mouse values. */
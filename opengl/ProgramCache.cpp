@@ -0,0 +1,129 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#include "Logger.h"
+#include "ProgramCache.h"
+
+namespace {
+const std::string cacheDirectory = "shader/cache";
+
+/* FNV-1a, 64 bit */
+void hashString(uint64_t &hash, const std::string &text) {
+  for (unsigned char c : text) {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+}
+
+std::string getGLString(GLenum name) {
+  const GLubyte *value = glGetString(name);
+  return value ? reinterpret_cast<const char *>(value) : "";
+}
+}  // namespace
+
+int ProgramCache::mLoadedPrograms = 0;
+int ProgramCache::mSavedPrograms = 0;
+
+std::string ProgramCache::getKey(const std::vector<std::string> &sources) {
+  /* the separators keep "ab" + "c" apart from "a" + "bc" */
+  uint64_t hash = 14695981039346656037ull;
+  for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+    hashString(hash, getGLString(name));
+    hashString(hash, std::string(1, '\0'));
+  }
+  for (const auto &source : sources) {
+    hashString(hash, source);
+    hashString(hash, std::string(1, '\0'));
+  }
+
+  char key[17];
+  std::snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(hash));
+  return key;
+}
+
+GLuint ProgramCache::loadProgram(const std::string &key) {
+  if (!isSupported()) {
+    return 0;
+  }
+
+  std::ifstream inFile(getFileName(key), std::ios::binary);
+  if (!inFile.is_open()) {
+    return 0;
+  }
+
+  uint32_t binaryFormat = 0;
+  uint32_t binarySize = 0;
+  inFile.read(reinterpret_cast<char *>(&binaryFormat), sizeof(binaryFormat));
+  inFile.read(reinterpret_cast<char *>(&binarySize), sizeof(binarySize));
+  std::vector<char> binary(inFile.good() ? binarySize : 0);
+  inFile.read(binary.data(), binary.size());
+  if (inFile.fail() || binary.empty()) {
+    Logger::log(1, "%s: cached program %s is damaged\n", __FUNCTION__, key.c_str());
+    return 0;
+  }
+
+  GLuint program = glCreateProgram();
+  glProgramBinary(program, binaryFormat, binary.data(), binary.size());
+
+  /* a driver update invalidates the binaries, the key covers that too */
+  GLint isProgramLinked;
+  glGetProgramiv(program, GL_LINK_STATUS, &isProgramLinked);
+  if (!isProgramLinked) {
+    Logger::log(1, "%s: cached program %s was rejected\n", __FUNCTION__, key.c_str());
+    glDeleteProgram(program);
+    return 0;
+  }
+
+  ++mLoadedPrograms;
+  return program;
+}
+
+void ProgramCache::saveProgram(const std::string &key, GLuint program) {
+  if (!isSupported()) {
+    return;
+  }
+
+  GLint binarySize = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binarySize);
+  if (binarySize <= 0) {
+    return;
+  }
+
+  std::vector<char> binary(binarySize);
+  GLenum binaryFormat = 0;
+  glGetProgramBinary(program, binarySize, nullptr, &binaryFormat, binary.data());
+
+  std::error_code error;
+  std::filesystem::create_directories(cacheDirectory, error);
+  std::ofstream outFile(getFileName(key), std::ios::binary | std::ios::trunc);
+  if (!outFile.is_open()) {
+    Logger::log(1, "%s: unable to write cached program %s\n", __FUNCTION__, key.c_str());
+    return;
+  }
+
+  uint32_t format = binaryFormat;
+  uint32_t size = binary.size();
+  outFile.write(reinterpret_cast<const char *>(&format), sizeof(format));
+  outFile.write(reinterpret_cast<const char *>(&size), sizeof(size));
+  outFile.write(binary.data(), binary.size());
+  ++mSavedPrograms;
+}
+
+int ProgramCache::getLoadedPrograms() {
+  return mLoadedPrograms;
+}
+
+int ProgramCache::getSavedPrograms() {
+  return mSavedPrograms;
+}
+
+bool ProgramCache::isSupported() {
+  GLint formatCount = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+  return formatCount > 0;
+}
+
+std::string ProgramCache::getFileName(const std::string &key) {
+  return cacheDirectory + "/" + key + ".bin";
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+/* Linked programs on disk, stored with glGetProgramBinary(). The key is a hash
+ * of the driver (vendor, renderer and version) and the final sources, the
+ * #defines of a permutation included. A binary the driver rejects is compiled
+ * again and replaced.
+ */
+class ProgramCache {
+ public:
+  static std::string getKey(const std::vector<std::string> &sources);
+  /* Returns 0 if the program is not cached. */
+  static GLuint loadProgram(const std::string &key);
+  static void saveProgram(const std::string &key, GLuint program);
+
+  static int getLoadedPrograms();
+  static int getSavedPrograms();
+
+ private:
+  static bool isSupported();
+  static std::string getFileName(const std::string &key);
+
+  static int mLoadedPrograms;
+  static int mSavedPrograms;
+};
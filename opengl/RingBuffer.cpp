@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <cstring>
+
+#include "Logger.h"
+#include "RingBuffer.h"
+
+bool RingBuffer::init(size_t regionSize) {
+  /* offsets must match both the uniform and the shader storage buffer alignment */
+  GLint uboAlignment = 1;
+  GLint ssboAlignment = 1;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uboAlignment);
+  glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &ssboAlignment);
+  mOffsetAlignment = std::max({uboAlignment, ssboAlignment, 1});
+
+  return createBuffer(regionSize);
+}
+
+/* The current buffer is only replaced if the new one could be mapped. */
+bool RingBuffer::createBuffer(size_t regionSize) {
+  size_t alignedRegionSize = (regionSize + mOffsetAlignment - 1) / mOffsetAlignment *
+                             mOffsetAlignment;
+  size_t bufferSize = alignedRegionSize * mFramesInFlight;
+
+  GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  GLuint buffer = 0;
+  glGenBuffers(1, &buffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+  glBufferStorage(GL_COPY_WRITE_BUFFER, bufferSize, nullptr, flags);
+  char *mappedData = static_cast<char *>(
+      glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, bufferSize, flags));
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  if (!mappedData) {
+    Logger::log(1, "%s error: could not map ring buffer of %i bytes\n", __FUNCTION__, bufferSize);
+    glDeleteBuffers(1, &buffer);
+    return false;
+  }
+
+  mBuffer = buffer;
+  mMappedData = mappedData;
+  mRegionSize = alignedRegionSize;
+  mRegion = 0;
+  mRegionOffset = 0;
+  mFences.fill(nullptr);
+
+  Logger::log(1,
+              "%s: ring buffer with %i regions of %i bytes created\n",
+              __FUNCTION__,
+              mFramesInFlight,
+              mRegionSize);
+  return true;
+}
+
+void RingBuffer::beginFrame() {
+  mRegion = (mRegion + 1) % mFramesInFlight;
+  mRegionOffset = 0;
+  mBytesCopied = 0;
+
+  if (mFences.at(mRegion)) {
+    waitForFence(mFences.at(mRegion));
+    glDeleteSync(mFences.at(mRegion));
+    mFences.at(mRegion) = nullptr;
+  }
+
+  /* replaced buffers are deleted as soon as the GPU has passed their fence */
+  auto retired = std::remove_if(
+      mRetiredBuffers.begin(), mRetiredBuffers.end(), [](const RetiredBuffer &retiredBuffer) {
+        GLenum result = glClientWaitSync(retiredBuffer.fence, 0, 0);
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+          return false;
+        }
+        glDeleteSync(retiredBuffer.fence);
+        glDeleteBuffers(1, &retiredBuffer.buffer);
+        return true;
+      });
+  mRetiredBuffers.erase(retired, mRetiredBuffers.end());
+}
+
+void RingBuffer::endFrame() {
+  mFences.at(mRegion) = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+RingBufferRange RingBuffer::allocate(size_t size) {
+  size_t alignedSize = (size + mOffsetAlignment - 1) / mOffsetAlignment * mOffsetAlignment;
+
+  if (mRegionOffset + alignedSize > mRegionSize) {
+    /* without a larger buffer the old one stays in use, the caller gets an empty range */
+    GLuint oldBuffer = mBuffer;
+    std::array<GLsync, mFramesInFlight> oldFences = mFences;
+    if (!createBuffer(std::max(mRegionSize * 2, alignedSize))) {
+      Logger::log(1, "%s error: could not allocate %i bytes\n", __FUNCTION__, size);
+      return RingBufferRange{};
+    }
+
+    /* ranges bound earlier in this frame still point into the old buffer, keep it alive */
+    RetiredBuffer retiredBuffer{};
+    retiredBuffer.buffer = oldBuffer;
+    retiredBuffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    mRetiredBuffers.emplace_back(retiredBuffer);
+    for (GLsync fence : oldFences) {
+      if (fence) {
+        glDeleteSync(fence);
+      }
+    }
+  }
+
+  RingBufferRange range{};
+  range.buffer = mBuffer;
+  range.offset = mRegion * mRegionSize + mRegionOffset;
+  range.size = size;
+  range.data = mMappedData + range.offset;
+  mRegionOffset += alignedSize;
+  return range;
+}
+
+void RingBuffer::bindRange(GLenum target, int bindingPoint, const RingBufferRange &range) {
+  glBindBufferRange(target, bindingPoint, range.buffer, range.offset, range.size);
+}
+
+void RingBuffer::uploadData(GLenum target, const void *data, size_t size, int bindingPoint) {
+  if (size == 0) {
+    return;
+  }
+  RingBufferRange range = allocate(size);
+  if (!range.data) {
+    return;
+  }
+  copyData(range.data, data, size);
+  bindRange(target, bindingPoint, range);
+}
+
+void RingBuffer::copyData(void *destination, const void *data, size_t size) {
+  std::memcpy(destination, data, size);
+  mBytesCopied += size;
+}
+
+size_t RingBuffer::getBytesCopied() {
+  return mBytesCopied;
+}
+
+void RingBuffer::waitForFence(GLsync fence) {
+  /* flush once, then wait in 1ms steps */
+  GLbitfield waitFlags = GL_SYNC_FLUSH_COMMANDS_BIT;
+  while (true) {
+    GLenum result = glClientWaitSync(fence, waitFlags, 1000000);
+    if (result != GL_TIMEOUT_EXPIRED) {
+      return;
+    }
+    waitFlags = 0;
+  }
+}
+
+void RingBuffer::cleanup() {
+  for (GLsync fence : mFences) {
+    if (fence) {
+      glDeleteSync(fence);
+    }
+  }
+  mFences.fill(nullptr);
+
+  for (const RetiredBuffer &retiredBuffer : mRetiredBuffers) {
+    glDeleteSync(retiredBuffer.fence);
+    glDeleteBuffers(1, &retiredBuffer.buffer);
+  }
+  mRetiredBuffers.clear();
+
+  /* deleting the buffer also unmaps it */
+  glDeleteBuffers(1, &mBuffer);
+  mMappedData = nullptr;
+}
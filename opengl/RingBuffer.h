@@ -0,0 +1,105 @@
+#pragma once
+#include <array>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+/* Region of the ring buffer, the memory is mapped and written directly. */
+struct RingBufferRange {
+  void *data = nullptr;
+  GLuint buffer = 0;
+  GLintptr offset = 0;
+  GLsizeiptr size = 0;
+};
+
+/* Persistently mapped buffer for the data that changes every frame. The
+ * buffer is split into one region per frame in flight, a fence placed at
+ * the end of the frame guards the region until the GPU is done reading it.
+ * Uniform and shader storage data share the ring, every upload is bound
+ * with its own offset.
+ */
+class RingBuffer {
+ public:
+  bool init(size_t regionSize);
+  /* Waits until the GPU has finished with the region of this frame. */
+  void beginFrame();
+  /* Fences the region, call after the last draw reading the data. */
+  void endFrame();
+
+  /* Reserves memory in the region of this frame, the data must be written before the draw.
+   * The range has no data if the buffer could not grow.
+   */
+  RingBufferRange allocate(size_t size);
+  void bindRange(GLenum target, int bindingPoint, const RingBufferRange &range);
+
+  /* Copies elements into an allocated range, starting at the given element. */
+  template <typename T>
+  void writeRange(const RingBufferRange &range,
+                  size_t firstElement,
+                  const T *bufferData,
+                  size_t elementCount) {
+    copyData(static_cast<T *>(range.data) + firstElement, bufferData, elementCount * sizeof(T));
+  }
+  template <typename T>
+  void writeRange(const RingBufferRange &range,
+                  size_t firstElement,
+                  const std::vector<T> &bufferData) {
+    writeRange(range, firstElement, bufferData.data(), bufferData.size());
+  }
+
+  /* Writes one element, e.g. data converted on the fly, without a staging copy. */
+  template <typename T>
+  void writeElement(const RingBufferRange &range, size_t element, const T &value) {
+    static_cast<T *>(range.data)[element] = value;
+    mBytesCopied += sizeof(T);
+  }
+
+  /* The data is read in place, the only copy is the one into the mapped memory. */
+  template <typename T>
+  void uploadUboData(const T *bufferData, size_t elementCount, int bindingPoint) {
+    uploadData(GL_UNIFORM_BUFFER, bufferData, elementCount * sizeof(T), bindingPoint);
+  }
+  template <typename T>
+  void uploadUboData(const std::vector<T> &bufferData, int bindingPoint) {
+    uploadUboData(bufferData.data(), bufferData.size(), bindingPoint);
+  }
+  template <typename T>
+  void uploadSsboData(const T *bufferData, size_t elementCount, int bindingPoint) {
+    uploadData(GL_SHADER_STORAGE_BUFFER, bufferData, elementCount * sizeof(T), bindingPoint);
+  }
+  template <typename T>
+  void uploadSsboData(const std::vector<T> &bufferData, int bindingPoint) {
+    uploadSsboData(bufferData.data(), bufferData.size(), bindingPoint);
+  }
+
+  /* Bytes written to the mapped memory since the start of the frame. */
+  size_t getBytesCopied();
+
+  void cleanup();
+
+ private:
+  static const int mFramesInFlight = 3;
+
+  bool createBuffer(size_t regionSize);
+  void uploadData(GLenum target, const void *data, size_t size, int bindingPoint);
+  void copyData(void *destination, const void *data, size_t size);
+  void waitForFence(GLsync fence);
+
+  GLuint mBuffer = 0;
+  char *mMappedData = nullptr;
+  size_t mRegionSize = 0;
+  GLint mOffsetAlignment = 1;
+
+  int mRegion = 0;
+  size_t mRegionOffset = 0;
+  size_t mBytesCopied = 0;
+  std::array<GLsync, mFramesInFlight> mFences{};
+
+  /* Buffers replaced by a larger one, deleted after the GPU has used them for the last time. */
+  struct RetiredBuffer {
+    GLuint buffer = 0;
+    GLsync fence = nullptr;
+  };
+  std::vector<RetiredBuffer> mRetiredBuffers{};
+};
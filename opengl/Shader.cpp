@@ -1,37 +1,44 @@
 #include "Shader.h"
 #include "Logger.h"
+#include "ProgramCache.h"
 #include <fstream>
 
-bool Shader::loadShaders(std::string vertexShaderFileName, std::string fragmentShaderFileName) {
-  GLuint vertexShader = readShader(vertexShaderFileName, GL_VERTEX_SHADER);
-  if (!vertexShader) {
+bool Shader::loadShaders(std::string vertexShaderFileName,
+                         std::string fragmentShaderFileName,
+                         const std::vector<std::string> &defines) {
+  std::string vertexShaderSource;
+  if (!readShader(vertexShaderFileName, defines, vertexShaderSource)) {
     Logger::log(1, "%s: Shader: Unable to read vertex shader\n", __FUNCTION__);
     return false;
   }
 
-  GLuint fragmentShader = readShader(fragmentShaderFileName, GL_FRAGMENT_SHADER);
-  if (!fragmentShader) {
+  std::string fragmentShaderSource;
+  if (!readShader(fragmentShaderFileName, defines, fragmentShaderSource)) {
     Logger::log(1, "%s: Shader: Unable to read fragment shader\n", __FUNCTION__);
     return false;
   }
 
-  mShaderProgram = glCreateProgram();
-  glAttachShader(mShaderProgram, vertexShader);
-  glAttachShader(mShaderProgram, fragmentShader);
-  // Link shader to GPU memory
-  glLinkProgram(mShaderProgram);
-
-  GLint isProgramLinked;
-  glGetProgramiv(mShaderProgram, GL_LINK_STATUS, &isProgramLinked);
-
-  if (!isProgramLinked) {
+  if (!loadProgram({vertexShaderSource, fragmentShaderSource},
+                   {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER}))
+  {
     Logger::log(1, "%s: Shader: Error linking shader program\n", __FUNCTION__);
     return false;
   }
+  return true;
+}
 
-  // Cleanup
-  glDeleteShader(vertexShader);
-  glDeleteShader(fragmentShader);
+bool Shader::loadComputeShader(std::string computeShaderFileName,
+                               const std::vector<std::string> &defines) {
+  std::string computeShaderSource;
+  if (!readShader(computeShaderFileName, defines, computeShaderSource)) {
+    Logger::log(1, "%s: Shader: Unable to read compute shader\n", __FUNCTION__);
+    return false;
+  }
+
+  if (!loadProgram({computeShaderSource}, {GL_COMPUTE_SHADER})) {
+    Logger::log(1, "%s: Shader: Error linking compute shader program\n", __FUNCTION__);
+    return false;
+  }
   return true;
 }
 
@@ -41,8 +48,53 @@ void Shader::cleanup() {
   glDeleteProgram(mShaderProgram);
 }
 
-GLuint Shader::readShader(std::string shaderFileName, GLuint shaderType) {
-  // GLuint shader;
+/* A warm start takes the linked binary from the cache, nothing is compiled. */
+bool Shader::loadProgram(const std::vector<std::string> &shaderSources,
+                         const std::vector<GLuint> &shaderTypes) {
+  std::string cacheKey = ProgramCache::getKey(shaderSources);
+  mShaderProgram = ProgramCache::loadProgram(cacheKey);
+  if (mShaderProgram) {
+    return true;
+  }
+
+  std::vector<GLuint> shaders{};
+  for (size_t i = 0; i < shaderSources.size(); ++i) {
+    GLuint shader = compileShader(shaderSources.at(i), shaderTypes.at(i));
+    if (!shader) {
+      for (GLuint compiledShader : shaders) {
+        glDeleteShader(compiledShader);
+      }
+      return false;
+    }
+    shaders.push_back(shader);
+  }
+
+  mShaderProgram = glCreateProgram();
+  glProgramParameteri(mShaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  for (GLuint shader : shaders) {
+    glAttachShader(mShaderProgram, shader);
+  }
+  // Link shader to GPU memory
+  glLinkProgram(mShaderProgram);
+
+  // Cleanup
+  for (GLuint shader : shaders) {
+    glDeleteShader(shader);
+  }
+
+  GLint isProgramLinked;
+  glGetProgramiv(mShaderProgram, GL_LINK_STATUS, &isProgramLinked);
+  if (!isProgramLinked) {
+    return false;
+  }
+
+  ProgramCache::saveProgram(cacheKey, mShaderProgram);
+  return true;
+}
+
+bool Shader::readShader(std::string shaderFileName,
+                        const std::vector<std::string> &defines,
+                        std::string &shaderSource) {
   std::string shaderAsText;
   std::ifstream inFile(shaderFileName);
 
@@ -58,26 +110,43 @@ GLuint Shader::readShader(std::string shaderFileName, GLuint shaderType) {
   }
   else {
     Logger::log(1, "%s: Shader: Error, unable to read shader file\n", __FUNCTION__);
-    return 0;
+    return false;
   }
 
   if (inFile.bad() || inFile.fail()) {
     inFile.close();
     Logger::log(1, "%s: Shader: Error, unable to read shader file\n", __FUNCTION__);
-    return 0;
+    return false;
   }
 
   inFile.close();
-  const char *shaderSource = shaderAsText.c_str();
+
+  /* the #version line must stay the first one */
+  size_t versionEnd = 0;
+  if (shaderAsText.compare(0, 8, "#version") == 0) {
+    versionEnd = shaderAsText.find('\n');
+    versionEnd = versionEnd == std::string::npos ? shaderAsText.size() : versionEnd + 1;
+  }
+  std::string defineLines;
+  for (const auto &define : defines) {
+    defineLines += "#define " + define + "\n";
+  }
+  shaderSource = shaderAsText.insert(versionEnd, defineLines);
+  return true;
+}
+
+GLuint Shader::compileShader(const std::string &shaderSource, GLuint shaderType) {
+  const char *shaderText = shaderSource.c_str();
 
   GLuint shader = glCreateShader(shaderType);
-  glShaderSource(shader, 1, (const GLchar **)&shaderSource, 0);
+  glShaderSource(shader, 1, (const GLchar **)&shaderText, 0);
   glCompileShader(shader);
 
   GLint isShaderCompiled;
   glGetShaderiv(shader, GL_COMPILE_STATUS, &isShaderCompiled);
   if (!isShaderCompiled) {
     Logger::log(1, "%s: Shader: Error, unable to compile shader\n", __FUNCTION__);
+    glDeleteShader(shader);
     return 0;
   }
 
@@ -89,6 +158,18 @@ void Shader::use() {
   glUseProgram(mShaderProgram);
 }
 
+void Shader::setUniformValue(std::string name, int value) {
+  glUniform1i(glGetUniformLocation(mShaderProgram, name.c_str()), value);
+}
+
+void Shader::setUniformValue(std::string name, float value) {
+  glUniform1f(glGetUniformLocation(mShaderProgram, name.c_str()), value);
+}
+
+void Shader::setUniformValue(std::string name, glm::vec3 value) {
+  glUniform3f(glGetUniformLocation(mShaderProgram, name.c_str()), value.x, value.y, value.z);
+}
+
 /* There is no "unuse"  binding, because there always needs
  * to be an active shader to avoid undefined behavior.
  */
\ No newline at end of file
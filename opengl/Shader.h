@@ -2,15 +2,33 @@
 #include <glad/glad.h>
 
 #include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
 #include <string>
+#include <vector>
 
+/* The defines are inserted after the #version line of every stage, e.g.
+ * "JOINT_INFLUENCES 4". Linked programs are kept in the ProgramCache.
+ */
 class Shader {
  public:
-  bool loadShaders(std::string vertexShaderFileName, std::string fragmentShaderFileName);
+  bool loadShaders(std::string vertexShaderFileName,
+                   std::string fragmentShaderFileName,
+                   const std::vector<std::string> &defines = {});
+  bool loadComputeShader(std::string computeShaderFileName,
+                         const std::vector<std::string> &defines = {});
   void use();
+  /* The shader must be in use. */
+  void setUniformValue(std::string name, int value);
+  void setUniformValue(std::string name, float value);
+  void setUniformValue(std::string name, glm::vec3 value);
   void cleanup();
 
  private:
   GLuint mShaderProgram = 0;
-  GLuint readShader(std::string shaderFileName, GLuint shaderType);
+  bool readShader(std::string shaderFileName,
+                  const std::vector<std::string> &defines,
+                  std::string &shaderSource);
+  GLuint compileShader(const std::string &shaderSource, GLuint shaderType);
+  bool loadProgram(const std::vector<std::string> &shaderSources,
+                   const std::vector<GLuint> &shaderTypes);
 };
\ No newline at end of file
@@ -0,0 +1,39 @@
+#include "ShaderPermutations.h"
+#include "Logger.h"
+
+void ShaderPermutations::init(std::string vertexShaderFileName,
+                              std::string fragmentShaderFileName) {
+  mVertexShaderFileName = vertexShaderFileName;
+  mFragmentShaderFileName = fragmentShaderFileName;
+}
+
+Shader *ShaderPermutations::getShader(const std::vector<std::string> &defines) {
+  auto shaderIter = mShaders.find(defines);
+  if (shaderIter != mShaders.end()) {
+    return shaderIter->second.get();
+  }
+
+  std::unique_ptr<Shader> shader = std::make_unique<Shader>();
+  if (!shader->loadShaders(mVertexShaderFileName, mFragmentShaderFileName, defines)) {
+    std::string defineList;
+    for (const auto &define : defines) {
+      defineList += " " + define;
+    }
+    Logger::log(1,
+                "%s: variant of '%s' with%s failed\n",
+                __FUNCTION__,
+                mVertexShaderFileName.c_str(),
+                defineList.c_str());
+    shader.reset();
+  }
+  return mShaders.emplace(defines, std::move(shader)).first->second.get();
+}
+
+void ShaderPermutations::cleanup() {
+  for (auto &shader : mShaders) {
+    if (shader.second) {
+      shader.second->cleanup();
+    }
+  }
+  mShaders.clear();
+}
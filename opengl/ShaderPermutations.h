@@ -0,0 +1,25 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Shader.h"
+
+/* Variants of a shader pair, selected by #defines. A variant is built on the
+ * first request and kept, a failed one is not tried again.
+ */
+class ShaderPermutations {
+ public:
+  void init(std::string vertexShaderFileName, std::string fragmentShaderFileName);
+  /* Returns nullptr if the variant does not build. */
+  Shader *getShader(const std::vector<std::string> &defines);
+  void cleanup();
+
+ private:
+  std::string mVertexShaderFileName;
+  std::string mFragmentShaderFileName;
+
+  std::map<std::vector<std::string>, std::unique_ptr<Shader>> mShaders{};
+};
@@ -4,6 +4,8 @@
 
 #include <glad/glad.h>
 
+#include "OGLRenderData.h"
+
 /* Shader Storage Buffer Objects (SSBOs) are a mix between
  * a uniform buffer and a texture. SSBO's can be much larger,
  * are writable, and can store arrays of arbitrary length.
@@ -11,11 +13,30 @@
 class ShaderStorageBuffer {
  public:
   void init(size_t bufferSize);
-  void uploadSsboData(std::vector<glm::mat4> bufferData, int bindingPoint);
-  void uploadSsboData(std::vector<glm::mat2x4> bufferData, int bindingPoint);
+
+  /* The data is read in place, the only copy is the one into the buffer. */
+  template <typename T>
+  void uploadSsboData(const T *bufferData, size_t elementCount, int bindingPoint) {
+    if (elementCount == 0) {
+      return;
+    }
+    uploadData(bufferData, elementCount * sizeof(T), bindingPoint);
+  }
+  template <typename T>
+  void uploadSsboData(const std::vector<T> &bufferData, int bindingPoint) {
+    uploadSsboData(bufferData.data(), bufferData.size(), bindingPoint);
+  }
+
+  /* Binds the whole buffer, e.g. for buffers written by compute shaders. */
+  void bind(int bindingPoint);
+  /* The buffer is re-created if the data does not fit. */
+  void checkForResize(size_t newBufferSize);
+  GLuint getBufferId();
   void cleanup();
 
  private:
-  size_t mBufferSize;
+  void uploadData(const void *data, size_t bufferSize, int bindingPoint);
+
+  size_t mBufferSize = 0;
   GLuint mShaderStorageBuffer = 0;
 };
\ No newline at end of file
@@ -12,31 +12,34 @@ void ShaderStorageBuffer::init(size_t bufferSize) {
   glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 }
 
-void ShaderStorageBuffer::uploadSsboData(std::vector<glm::mat4> bufferData, int bindingPoint) {
-  if (bufferData.size() == 0) {
-    // No data to upload
-    return;
-  }
-
-  size_t bufferSize = bufferData.size() * sizeof(glm::mat4);
+void ShaderStorageBuffer::uploadData(const void *data, size_t bufferSize, int bindingPoint) {
+  checkForResize(bufferSize);
   glBindBuffer(GL_SHADER_STORAGE_BUFFER, mShaderStorageBuffer);
-  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, bufferSize, bufferData.data());
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, bufferSize, data);
 
   glBindBufferRange(GL_SHADER_STORAGE_BUFFER, bindingPoint, mShaderStorageBuffer, 0, bufferSize);
   glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 }
 
-void ShaderStorageBuffer::uploadSsboData(std::vector<glm::mat2x4> bufferData, int bindingPoint) {
-  if (bufferData.size() == 0) {
+void ShaderStorageBuffer::bind(int bindingPoint) {
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bindingPoint, mShaderStorageBuffer);
+}
+
+void ShaderStorageBuffer::checkForResize(size_t newBufferSize) {
+  if (newBufferSize <= mBufferSize) {
     return;
   }
-  size_t bufferSize = bufferData.size() * sizeof(glm::mat2x4);
+  mBufferSize = newBufferSize;
+
   glBindBuffer(GL_SHADER_STORAGE_BUFFER, mShaderStorageBuffer);
-  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, bufferSize, bufferData.data());
-  glBindBufferRange(GL_SHADER_STORAGE_BUFFER, bindingPoint, mShaderStorageBuffer, 0, bufferSize);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, mBufferSize, NULL, GL_DYNAMIC_DRAW);
   glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 }
 
+GLuint ShaderStorageBuffer::getBufferId() {
+  return mShaderStorageBuffer;
+}
+
 void ShaderStorageBuffer::cleanup() {
   glDeleteBuffers(1, &mShaderStorageBuffer);
 }
\ No newline at end of file
@@ -0,0 +1,75 @@
+#include "SkeletonOverlay.h"
+#include "Logger.h"
+
+namespace {
+const int boneBinding = 4;
+const int bindPositionBinding = 5;
+}  // namespace
+
+bool SkeletonOverlay::init(std::shared_ptr<GltfModel> model) {
+  mGltfModel = model;
+
+  mSkeletonShaders.init("shader/skeleton.vert", "shader/line.frag");
+  if (!mSkeletonShaders.getShader({}) || !mSkeletonShaders.getShader({"PALETTE_3X4"})) {
+    Logger::log(1, "%s: skeleton shader loading failed\n", __FUNCTION__);
+    return false;
+  }
+
+  /* a bone connects a joint to the next joint up in the tree */
+  std::vector<std::shared_ptr<GltfNode>> nodeList{};
+  mBones.clear();
+  addBones(mGltfModel->createNodeTree(nodeList), -1);
+
+  /* the origin of a joint in model space, moved by the joint matrix like a vertex */
+  std::vector<glm::vec4> bindPositions{};
+  for (const auto &bindMatrix : mGltfModel->getBindMatrices()) {
+    bindPositions.emplace_back(bindMatrix[3]);
+  }
+
+  mBoneBuffer.init(mBones.size() * sizeof(glm::ivec2));
+  mBoneBuffer.uploadSsboData(mBones, boneBinding);
+  mBindPositionBuffer.init(bindPositions.size() * sizeof(glm::vec4));
+  mBindPositionBuffer.uploadSsboData(bindPositions, bindPositionBinding);
+
+  glGenVertexArrays(1, &mSkeletonVAO);
+
+  Logger::log(1, "%s: skeleton overlay with %i bones initialized\n", __FUNCTION__, mBones.size());
+  return true;
+}
+
+void SkeletonOverlay::addBones(std::shared_ptr<GltfNode> treeNode, int parentJoint) {
+  int joint = mGltfModel->getNodeToJoint().at(treeNode->getNodeNum());
+  if (joint >= 0 && parentJoint >= 0) {
+    mBones.emplace_back(joint, parentJoint);
+  }
+
+  for (const auto &childNode : treeNode->getChilds()) {
+    addBones(childNode, joint >= 0 ? joint : parentJoint);
+  }
+}
+
+void SkeletonOverlay::draw(int instanceCount, skinningMode mode, bool palette3x4) {
+  Shader *skeletonShader =
+      mSkeletonShaders.getShader(palette3x4 ? std::vector<std::string>{"PALETTE_3X4"}
+                                            : std::vector<std::string>{});
+  if (instanceCount == 0 || mBones.empty() || !skeletonShader) {
+    return;
+  }
+
+  mBoneBuffer.bind(boneBinding);
+  mBindPositionBuffer.bind(bindPositionBinding);
+
+  skeletonShader->use();
+  skeletonShader->setUniformValue("dualQuatSkinning", mode == skinningMode::dualQuat ? 1 : 0);
+
+  glBindVertexArray(mSkeletonVAO);
+  glDrawArraysInstanced(GL_LINES, 0, mBones.size() * 2, instanceCount);
+  glBindVertexArray(0);
+}
+
+void SkeletonOverlay::cleanup() {
+  mSkeletonShaders.cleanup();
+  mBoneBuffer.cleanup();
+  mBindPositionBuffer.cleanup();
+  glDeleteVertexArrays(1, &mSkeletonVAO);
+}
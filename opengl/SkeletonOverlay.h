@@ -0,0 +1,41 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "GltfModel.h"
+#include "GltfNode.h"
+#include "ShaderPermutations.h"
+#include "ShaderStorageBuffer.h"
+
+#include "OGLRenderData.h"
+
+/* Draws the bones of all instances straight from the joint palettes. The
+ * bones and the bind positions of the joints are static, the vertex shader
+ * moves both ends of a bone with the palette of the instance. The palettes
+ * and the instance data are read from the bound SSBOs 1, 2 and 3, the linear
+ * palette may hold the joint matrices as 3x4 rows.
+ */
+class SkeletonOverlay {
+ public:
+  bool init(std::shared_ptr<GltfModel> model);
+  void draw(int instanceCount, skinningMode mode, bool palette3x4);
+  void cleanup();
+
+ private:
+  void addBones(std::shared_ptr<GltfNode> treeNode, int parentJoint);
+
+  std::shared_ptr<GltfModel> mGltfModel = nullptr;
+
+  ShaderPermutations mSkeletonShaders{};
+  /* the vertices are generated from gl_VertexID, the VAO has no attributes */
+  GLuint mSkeletonVAO = 0;
+
+  /* x: joint, y: parent joint */
+  std::vector<glm::ivec2> mBones{};
+  ShaderStorageBuffer mBoneBuffer{};
+  ShaderStorageBuffer mBindPositionBuffer{};
+};
@@ -3,16 +3,46 @@
 #include "Texture.h"
 
 bool Texture::loadTexture(std::string textureFilename, bool flipImage) {
-  int mTexWidth, mTexHeight, mNumberOfChannels;
-  stbi_set_flip_vertically_on_load(flipImage);
-  unsigned char *textureData = stbi_load(
-      textureFilename.c_str(), &mTexWidth, &mTexHeight, &mNumberOfChannels, 0);
-
-  if (!textureData) {
-    // If image doesn't load, free the memory else we create a memory leak.
-    stbi_image_free(textureData);
+  std::vector<unsigned char> pixels{};
+  int width = 0;
+  int height = 0;
+  if (!loadImage(textureFilename, flipImage, pixels, width, height)) {
     return false;
   }
+  return loadTexture(pixels.data(), width, height, 4);
+}
+
+/* The flip setting is per thread, images may be decoded in parallel. */
+bool Texture::loadImage(std::string imageFilename,
+                        bool flipImage,
+                        std::vector<unsigned char> &pixels,
+                        int &width,
+                        int &height) {
+  int numberOfChannels = 0;
+  stbi_set_flip_vertically_on_load_thread(flipImage);
+  unsigned char *imageData = stbi_load(
+      imageFilename.c_str(), &width, &height, &numberOfChannels, STBI_rgb_alpha);
+  if (!imageData) {
+    return false;
+  }
+
+  pixels.assign(imageData, imageData + static_cast<size_t>(width) * height * 4);
+  stbi_image_free(imageData);
+  return true;
+}
+
+bool Texture::loadTexture(const unsigned char *imageData, int width, int height, int components) {
+  GLenum format = GL_RGBA;
+  switch (components) {
+    case 3:
+      format = GL_RGB;
+      break;
+    case 4:
+      format = GL_RGBA;
+      break;
+    default:
+      return false;
+  }
 
   glGenTextures(1, &mTexture);
   glBindTexture(GL_TEXTURE_2D, mTexture);
@@ -23,14 +53,12 @@ bool Texture::loadTexture(std::string textureFilename, bool flipImage) {
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
   //  Load from system memory to GPU
-  glTexImage2D(
-      GL_TEXTURE_2D, 0, GL_RGBA, mTexWidth, mTexHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, textureData);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, format, GL_UNSIGNED_BYTE, imageData);
   glGenerateMipmap(GL_TEXTURE_2D);
 
   // unbind to avoid accidental changes.
   glBindTexture(GL_TEXTURE_2D, 0);
 
-  stbi_image_free(textureData);
   return true;
 }
 
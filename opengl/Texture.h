@@ -1,12 +1,21 @@
 #pragma once
 #include <glad/glad.h>
 #include <string>
+#include <vector>
 
 #include <GLFW/glfw3.h>
 
 class Texture {
  public:
   bool loadTexture(std::string textureFilename, bool flipImage = true);
+  /* Decodes an image file to RGBA pixels without GL calls, e.g. on a worker thread. */
+  static bool loadImage(std::string imageFilename,
+                        bool flipImage,
+                        std::vector<unsigned char> &pixels,
+                        int &width,
+                        int &height);
+  /* Image data already in memory, e.g. decoded by the glTF loader. */
+  bool loadTexture(const unsigned char *imageData, int width, int height, int components);
   void bind();
   void unbind();
   void cleanup();
@@ -8,6 +8,7 @@
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 
+#include <algorithm>
 #include <string>
 
 void UserInterface::init(OGLRenderData &renderData) {
@@ -27,6 +28,8 @@ void UserInterface::init(OGLRenderData &renderData) {
   mFrameTimeValues.resize(mNumFrameTimeValues);
   mModelUploadValues.resize(mNumModelUploadValues);
   mMatrixGenerationValues.resize(mNumMatrixGenerationValues);
+  mAnimationValues.resize(mNumAnimationValues);
+  mAnimationWaitValues.resize(mNumAnimationWaitValues);
   mIKValues.resize(mNumIKValues);
   mMatrixUploadValues.resize(mNumMatrixUploadValues);
   mUiGenValues.resize(mNumUiGenValues);
@@ -64,6 +67,8 @@ void UserInterface::createFrame(OGLRenderData &renderData) {
 
   renderModelControls(renderData);
 
+  renderInstanceControls(renderData);
+
   renderAnimationControls(renderData);
 
   ImGui::End();
@@ -82,6 +87,16 @@ void UserInterface::renderInfo(OGLRenderData &renderData) {
     ImGui::Text(
         "%s", std::to_string(renderData.rdTriangleCount + renderData.rdGltfTriangleCount).c_str());
 
+    ImGui::Text("Vertex Cache ACMR:");
+    ImGui::SameLine();
+    ImGui::Text("%.3f (exported %.3f)", renderData.rdGltfACMR, renderData.rdGltfExportedACMR);
+
+    ImGui::Text("Weight Pruning Error:");
+    ImGui::SameLine();
+    ImGui::Text("%f (max %i joints)",
+                renderData.rdGltfPruneError,
+                renderData.rdGltfMaxJointInfluences);
+
     std::string windowDims = std::to_string(renderData.rdHeight) + "x" +
                              std::to_string(renderData.rdWidth);
     ImGui::Text("Window Dimensions:");
@@ -109,6 +124,8 @@ void UserInterface::renderTimers(OGLRenderData &renderData) {
   static int frameTimeOffset = 0;
   static int modelUploadOffset = 0;
   static int matrixGenOffset = 0;
+  static int animationOffset = 0;
+  static int animationWaitOffset = 0;
   static int ikOffset = 0;
   static int matrixUploadOffset = 0;
   static int uiGenOffset = 0;
@@ -127,6 +144,12 @@ void UserInterface::renderTimers(OGLRenderData &renderData) {
     mMatrixGenerationValues.at(matrixGenOffset) = renderData.rdMatrixGenerateTime;
     matrixGenOffset = ++matrixGenOffset % mNumMatrixGenerationValues;
 
+    mAnimationValues.at(animationOffset) = renderData.rdAnimationTime;
+    animationOffset = ++animationOffset % mNumAnimationValues;
+
+    mAnimationWaitValues.at(animationWaitOffset) = renderData.rdAnimationWaitTime;
+    animationWaitOffset = ++animationWaitOffset % mNumAnimationWaitValues;
+
     mIKValues.at(ikOffset) = renderData.rdIKTime;
     ikOffset = ++ikOffset % mNumIKValues;
 
@@ -263,6 +286,81 @@ void UserInterface::renderTimers(OGLRenderData &renderData) {
       ImGui::EndTooltip();
     }
 
+    ImGui::BeginGroup();
+    ImGui::Text("Animation Time (Worker):");
+    ImGui::SameLine();
+    ImGui::Text("%s", std::to_string(renderData.rdAnimationTime).c_str());
+    ImGui::SameLine();
+    ImGui::Text("ms");
+    ImGui::EndGroup();
+
+    if (ImGui::IsItemHovered()) {
+      ImGui::BeginTooltip();
+      float averageAnimation = 0.0f;
+      for (const auto value : mAnimationValues) {
+        averageAnimation += value;
+      }
+      averageAnimation /= static_cast<float>(mNumAnimationValues);
+      std::string animationOverlay = "now:     " + std::to_string(renderData.rdAnimationTime) +
+                                     " ms\n30s avg: " + std::to_string(averageAnimation) + " ms";
+      ImGui::Text("Animation");
+      ImGui::SameLine();
+      ImGui::PlotLines("##AnimationTimes",
+                       mAnimationValues.data(),
+                       mAnimationValues.size(),
+                       animationOffset,
+                       animationOverlay.c_str(),
+                       0.0f,
+                       FLT_MAX,
+                       ImVec2(0, 80));
+      ImGui::EndTooltip();
+    }
+
+    ImGui::BeginGroup();
+    ImGui::Text("Animation Wait Time:");
+    ImGui::SameLine();
+    ImGui::Text("%s", std::to_string(renderData.rdAnimationWaitTime).c_str());
+    ImGui::SameLine();
+    ImGui::Text("ms");
+    ImGui::EndGroup();
+
+    if (ImGui::IsItemHovered()) {
+      ImGui::BeginTooltip();
+      float averageAnimationWait = 0.0f;
+      for (const auto value : mAnimationWaitValues) {
+        averageAnimationWait += value;
+      }
+      averageAnimationWait /= static_cast<float>(mNumAnimationWaitValues);
+      std::string animationWaitOverlay = "now:     " +
+                                         std::to_string(renderData.rdAnimationWaitTime) +
+                                         " ms\n30s avg: " + std::to_string(averageAnimationWait) +
+                                         " ms";
+      ImGui::Text("Animation Wait");
+      ImGui::SameLine();
+      ImGui::PlotLines("##AnimationWaitTimes",
+                       mAnimationWaitValues.data(),
+                       mAnimationWaitValues.size(),
+                       animationWaitOffset,
+                       animationWaitOverlay.c_str(),
+                       0.0f,
+                       FLT_MAX,
+                       ImVec2(0, 80));
+      ImGui::EndTooltip();
+    }
+
+    /* the part of the animation time hidden behind the render thread */
+    float animationOverlap = 0.0f;
+    if (renderData.rdAnimationTime > 0.0f) {
+      animationOverlap = std::max(renderData.rdAnimationTime - renderData.rdAnimationWaitTime,
+                                  0.0f) /
+                         renderData.rdAnimationTime * 100.0f;
+    }
+    ImGui::Text("Animation Overlap:");
+    ImGui::SameLine();
+    ImGui::Text("%s", std::to_string(animationOverlap).c_str());
+    ImGui::SameLine();
+    ImGui::Text("%%");
+
     ImGui::BeginGroup();
     ImGui::Text("(IK Generation Time)  :");
     ImGui::SameLine();
@@ -325,6 +423,8 @@ void UserInterface::renderTimers(OGLRenderData &renderData) {
       ImGui::EndTooltip();
     }
 
+    ImGui::Text("Bytes Copied to Buffers: %zu", renderData.rdBytesCopied);
+
     ImGui::BeginGroup();
     ImGui::Text("UI Generation Time:");
     ImGui::SameLine();
@@ -384,6 +484,12 @@ void UserInterface::renderTimers(OGLRenderData &renderData) {
                        ImVec2(0, 80));
       ImGui::EndTooltip();
     }
+
+    ImGui::Text("glTF Draw Time (GPU):");
+    ImGui::SameLine();
+    ImGui::Text("%s", std::to_string(renderData.rdGltfDrawGPUTime).c_str());
+    ImGui::SameLine();
+    ImGui::Text("ms");
   }
 }
 
@@ -424,6 +530,126 @@ void UserInterface::renderModelControls(OGLRenderData &renderData) {
   {
     renderData.rdGPUDualQuatVertexSkinning = skinningMode::dualQuat;
   }
+
+  ImGui::Checkbox("Pre-Skin Vertices (Compute Shader)", &renderData.rdComputeSkinning);
+
+  /* the GPU animation and the compute skinning need the full matrices */
+  bool palette3x4Usable = renderData.rdGPUDualQuatVertexSkinning == skinningMode::linear &&
+                          !renderData.rdGPUAnimation && !renderData.rdComputeSkinning;
+  if (!palette3x4Usable) {
+    ImGui::BeginDisabled();
+  }
+  ImGui::Checkbox("3x4 Joint Matrices", &renderData.rdPalette3x4);
+  if (!palette3x4Usable) {
+    ImGui::EndDisabled();
+  }
+}
+
+void UserInterface::renderInstanceControls(OGLRenderData &renderData) {
+  if (ImGui::CollapsingHeader("Instances")) {
+    ImGui::Text("Instances:");
+    ImGui::SameLine();
+    ImGui::SliderInt("##Instances", &renderData.rdNumberOfInstances, 1, 1024);
+
+    ImGui::Text("Visible Instances: %i", renderData.rdVisibleInstances);
+    ImGui::Text("Vertex Shader Invocations (LOD 0): %i",
+                renderData.rdGltfTransformedVertices * renderData.rdVisibleInstances);
+    ImGui::Checkbox("Frustum Culling", &renderData.rdFrustumCulling);
+    if (!renderData.rdFrustumCulling) {
+      ImGui::BeginDisabled();
+    }
+    ImGui::Checkbox("Lowest LOD for Culled Instances", &renderData.rdCulledInstancesLowestLod);
+    if (!renderData.rdFrustumCulling) {
+      ImGui::EndDisabled();
+    }
+
+    ImGui::Checkbox("Mesh LOD", &renderData.rdMeshLodEnabled);
+    if (!renderData.rdMeshLodEnabled) {
+      ImGui::BeginDisabled();
+    }
+    for (int i = 0; i < renderData.rdMeshLodMinScreenSizes.size(); ++i) {
+      int instanceCount = i < renderData.rdMeshLodInstanceCounts.size()
+                              ? renderData.rdMeshLodInstanceCounts.at(i)
+                              : 0;
+      int triangleCount = i < renderData.rdGltfLodTriangleCounts.size()
+                              ? renderData.rdGltfLodTriangleCounts.at(i)
+                              : 0;
+
+      ImGui::PushID(i);
+      ImGui::Text("LOD %i: %i triangles x %i instances = %i",
+                  i,
+                  triangleCount,
+                  instanceCount,
+                  triangleCount * instanceCount);
+      ImGui::Text("Min Screen Size :");
+      ImGui::SameLine();
+      ImGui::SliderFloat(
+          "##MeshLodMinSize", &renderData.rdMeshLodMinScreenSizes.at(i), 0.0f, 500.0f, "%.0f px");
+      ImGui::PopID();
+    }
+    if (!renderData.rdMeshLodEnabled) {
+      ImGui::EndDisabled();
+    }
+
+    ImGui::Checkbox("Pose Cache", &renderData.rdPoseCacheEnabled);
+    if (!renderData.rdPoseCacheEnabled) {
+      ImGui::BeginDisabled();
+    }
+    ImGui::Text("Cache Time Step:");
+    ImGui::SameLine();
+    ImGui::SliderFloat(
+        "##PoseCacheStep", &renderData.rdPoseCacheTimeStep, 0.001f, 0.25f, "%.3f s");
+    float hitRate = renderData.rdPoseCacheLookups > 0
+                        ? 100.0f * renderData.rdPoseCacheHits / renderData.rdPoseCacheLookups
+                        : 0.0f;
+    ImGui::Text(
+        "Cache Hit Rate: %.1f%% (%i unique poses)", hitRate, renderData.rdPoseCacheEntries);
+    if (!renderData.rdPoseCacheEnabled) {
+      ImGui::EndDisabled();
+    }
+
+    ImGui::Checkbox("Animation LOD", &renderData.rdAnimationLodEnabled);
+
+    if (!renderData.rdAnimationLodEnabled) {
+      ImGui::BeginDisabled();
+    }
+    for (int i = 0; i < renderData.rdAnimationLodTiers.size(); ++i) {
+      AnimationLodTier &tier = renderData.rdAnimationLodTiers.at(i);
+      int instanceCount = i < renderData.rdLodInstanceCounts.size()
+                              ? renderData.rdLodInstanceCounts.at(i)
+                              : 0;
+
+      ImGui::PushID(i);
+      ImGui::Text("Tier %i (%i instances)", i, instanceCount);
+      ImGui::Text("Min Screen Size :");
+      ImGui::SameLine();
+      ImGui::SliderFloat("##LodMinSize", &tier.minScreenSize, 0.0f, 500.0f, "%.0f px");
+      ImGui::Text("Update Interval :");
+      ImGui::SameLine();
+      ImGui::SliderInt("##LodInterval", &tier.updateInterval, 1, 16);
+      ImGui::Text("Skip Leaf Levels:");
+      ImGui::SameLine();
+      ImGui::SliderInt("##LodSkipLevels", &tier.skipLeafLevels, 0, 8);
+      ImGui::Checkbox("Inverse Kinematics", &tier.ikEnabled);
+      ImGui::Text("Baked Animation :");
+      ImGui::SameLine();
+      if (ImGui::RadioButton("Off", tier.bakedAnimation == bakedAnimMode::off)) {
+        tier.bakedAnimation = bakedAnimMode::off;
+      }
+      ImGui::SameLine();
+      if (ImGui::RadioButton("Palettes", tier.bakedAnimation == bakedAnimMode::palettes)) {
+        tier.bakedAnimation = bakedAnimMode::palettes;
+      }
+      ImGui::SameLine();
+      if (ImGui::RadioButton("Vertices", tier.bakedAnimation == bakedAnimMode::vertices)) {
+        tier.bakedAnimation = bakedAnimMode::vertices;
+      }
+      ImGui::PopID();
+    }
+    if (!renderData.rdAnimationLodEnabled) {
+      ImGui::EndDisabled();
+    }
+  }
 }
 
 void UserInterface::renderAnimationControls(OGLRenderData &renderData) {
@@ -447,6 +673,16 @@ void UserInterface::renderAnimationControls(OGLRenderData &renderData) {
     }
 
     ImGui::Checkbox("Play Animation", &renderData.rdPlayAnimation);
+    ImGui::Checkbox("Animate on Worker Thread", &renderData.rdAnimationThreaded);
+    ImGui::Checkbox("Animate on GPU (Compute Shader)", &renderData.rdGPUAnimation);
+    ImGui::Checkbox("Decode Clips in Background", &renderData.rdAsyncClipLoading);
+    ImGui::Text("Clip Memory:");
+    ImGui::SameLine();
+    ImGui::SliderInt("##ClipMemoryBudget", &renderData.rdClipMemoryBudget, 0, 256, "%d MiB");
+    ImGui::Text("Decoded Clips: %i of %i (%.2f MiB)",
+                renderData.rdResidentClipCount,
+                renderData.rdAnimClipSize,
+                renderData.rdResidentClipBytes / (1024.0f * 1024.0f));
 
     renderAnimationBlendingControls(renderData);
 
@@ -15,6 +15,7 @@ class UserInterface {
   void renderTimers(OGLRenderData &renderData);
   void renderCamera(OGLRenderData &renderData);
   void renderModelControls(OGLRenderData &renderData);
+  void renderInstanceControls(OGLRenderData &renderData);
   void renderAnimationControls(OGLRenderData &renderData);
   void renderAnimationBlendingControls(OGLRenderData &renderData);
   void renderIKControls(OGLRenderData &renderData);
@@ -35,6 +36,12 @@ class UserInterface {
   std::vector<float> mMatrixGenerationValues{};
   int mNumMatrixGenerationValues = 90;
 
+  std::vector<float> mAnimationValues{};
+  int mNumAnimationValues = 90;
+
+  std::vector<float> mAnimationWaitValues{};
+  int mNumAnimationWaitValues = 90;
+
   std::vector<float> mIKValues{};
   int mNumIKValues = 90;
 
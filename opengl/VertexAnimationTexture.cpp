@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <map>
+
+#include "GltfInstance.h"
+#include "Logger.h"
+#include "VertexAnimationTexture.h"
+
+namespace {
+/* the mesh LOD copies keep position, normal and texture coordinate of their source vertex */
+std::array<float, 8> getVertexKey(glm::vec3 position, glm::vec3 normal, glm::vec2 texCoord) {
+  return {position.x, position.y, position.z, normal.x, normal.y, normal.z, texCoord.x,
+          texCoord.y};
+}
+}  // namespace
+
+bool VertexAnimationTexture::bake(std::shared_ptr<GltfModel> model, float sampleRate) {
+  const std::vector<std::shared_ptr<GltfAnimationClip>> &clips = model->getAnimClips();
+  const std::vector<glm::vec3> &positions = model->getPositionVec();
+  const std::vector<glm::vec3> &normals = model->getNormalVec();
+  const std::vector<glm::tvec4<uint16_t>> &joints = model->getJointVec();
+  const std::vector<glm::vec4> &weights = model->getWeightVec();
+  const std::vector<glm::tvec4<uint16_t>> &joints1 = model->getJointVec1();
+  const std::vector<glm::vec4> &weights1 = model->getWeightVec1();
+  const std::vector<glm::vec2> &texCoords = model->getTexCoordVec();
+  /* only the full resolution vertices are baked, the mesh LOD copies use their texels */
+  int vertexCount = model->getFullResolutionVertexCount();
+  if (!createVertexMap(positions, normals, texCoords, vertexCount)) {
+    return false;
+  }
+
+  GLint maxTextureSize = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+  int textureWidth = std::min(vertexCount, static_cast<int>(maxTextureSize));
+  mRowsPerFrame = (vertexCount + textureWidth - 1) / textureWidth;
+  int texelsPerFrame = textureWidth * mRowsPerFrame;
+
+  GltfInstance bakeInstance(model, glm::vec3(0.0f), 0.0f);
+
+  std::vector<glm::tvec4<uint16_t>> positionTexels{};
+  std::vector<glm::tvec4<int16_t>> normalTexels{};
+  std::vector<glm::vec3> skinnedPositions(vertexCount);
+  std::vector<glm::vec3> skinnedNormals(vertexCount);
+  mClipData.clear();
+
+  int frameNum = 0;
+  for (int clipNum = 0; clipNum < clips.size(); ++clipNum) {
+    float clipEndTime = clips.at(clipNum)->getClipEndTime();
+    int frameCount = static_cast<int>(std::ceil(clipEndTime * sampleRate)) + 1;
+
+    /* skin all frames first, the quantization needs the bounds of the whole clip */
+    std::vector<glm::vec3> clipPositions{};
+    std::vector<glm::vec3> clipNormals{};
+    BoundingBox bounds{};
+    for (int frame = 0; frame < frameCount; ++frame) {
+      bakeInstance.samplePose(clipNum, std::min(frame / sampleRate, clipEndTime));
+      const std::vector<glm::mat4> &jointMatrices = bakeInstance.getJointMatrices();
+
+      for (int i = 0; i < vertexCount; ++i) {
+        glm::mat4 skinMat = jointMatrices.at(joints.at(i).x) * weights.at(i).x +
+                            jointMatrices.at(joints.at(i).y) * weights.at(i).y +
+                            jointMatrices.at(joints.at(i).z) * weights.at(i).z +
+                            jointMatrices.at(joints.at(i).w) * weights.at(i).w;
+        for (int j = 0; j < 4; ++j) {
+          if (weights1.at(i)[j] > 0.0f) {
+            skinMat += jointMatrices.at(joints1.at(i)[j]) * weights1.at(i)[j];
+          }
+        }
+        glm::vec3 position = glm::vec3(skinMat * glm::vec4(positions.at(i), 1.0f));
+        bounds.addPoint(position);
+        clipPositions.emplace_back(position);
+        clipNormals.emplace_back(glm::normalize(glm::mat3(skinMat) * normals.at(i)));
+      }
+    }
+
+    glm::vec3 extents = glm::max(bounds.max - bounds.min, glm::vec3(1e-6f));
+    for (int i = 0; i < clipPositions.size(); ++i) {
+      glm::vec3 unorm = glm::round((clipPositions.at(i) - bounds.min) / extents * 65535.0f);
+      glm::vec3 snorm = glm::round(glm::clamp(clipNormals.at(i), -1.0f, 1.0f) * 32767.0f);
+      positionTexels.emplace_back(glm::tvec4<uint16_t>(glm::tvec3<uint16_t>(unorm), 0));
+      normalTexels.emplace_back(glm::tvec4<int16_t>(glm::tvec3<int16_t>(snorm), 0));
+
+      /* pad the last row of the frame */
+      if ((i + 1) % vertexCount == 0) {
+        positionTexels.resize(positionTexels.size() + texelsPerFrame - vertexCount);
+        normalTexels.resize(normalTexels.size() + texelsPerFrame - vertexCount);
+      }
+    }
+
+    mClipData.emplace_back(frameNum, frameCount, clipEndTime, sampleRate);
+    mClipData.emplace_back(bounds.min, 0.0f);
+    mClipData.emplace_back(extents, 0.0f);
+    frameNum += frameCount;
+
+    Logger::log(1,
+                "%s: clip %i '%s': %i frames, %i bytes\n",
+                __FUNCTION__,
+                clipNum,
+                model->getClipName(clipNum).c_str(),
+                frameCount,
+                frameCount * texelsPerFrame *
+                    (sizeof(glm::tvec4<uint16_t>) + sizeof(glm::tvec4<int16_t>)));
+  }
+
+  int textureHeight = frameNum * mRowsPerFrame;
+  if (textureHeight > maxTextureSize) {
+    Logger::log(1,
+                "%s error: %i frames of %i vertices exceed the maximum texture size of %i\n",
+                __FUNCTION__,
+                frameNum,
+                vertexCount,
+                maxTextureSize);
+    return false;
+  }
+
+  glGenTextures(1, &mPositionTexture);
+  glBindTexture(GL_TEXTURE_2D, mPositionTexture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D,
+               0,
+               GL_RGBA16,
+               textureWidth,
+               textureHeight,
+               0,
+               GL_RGBA,
+               GL_UNSIGNED_SHORT,
+               positionTexels.data());
+
+  glGenTextures(1, &mNormalTexture);
+  glBindTexture(GL_TEXTURE_2D, mNormalTexture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D,
+               0,
+               GL_RGBA16_SNORM,
+               textureWidth,
+               textureHeight,
+               0,
+               GL_RGBA,
+               GL_SHORT,
+               normalTexels.data());
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  mClipBuffer.init(mClipData.size() * sizeof(glm::vec4));
+  mClipBuffer.uploadSsboData(mClipData, 0);
+  mVertexMapBuffer.init(mVertexMap.size() * sizeof(int32_t));
+  mVertexMapBuffer.uploadSsboData(mVertexMap, 0);
+
+  Logger::log(1,
+              "%s: baked %i frames of %i clips at %.0f fps into %ix%i textures (%i bytes)\n",
+              __FUNCTION__,
+              frameNum,
+              clips.size(),
+              sampleRate,
+              textureWidth,
+              textureHeight,
+              positionTexels.size() * sizeof(glm::tvec4<uint16_t>) +
+                  normalTexels.size() * sizeof(glm::tvec4<int16_t>));
+  return true;
+}
+
+/* Maps every vertex of the model to its texel column, the full resolution vertices are
+ * the prefix and map to themselves.
+ */
+bool VertexAnimationTexture::createVertexMap(const std::vector<glm::vec3> &positions,
+                                             const std::vector<glm::vec3> &normals,
+                                             const std::vector<glm::vec2> &texCoords,
+                                             int fullResolutionVertexCount) {
+  std::map<std::array<float, 8>, int32_t> sourceVertices{};
+  for (int i = 0; i < fullResolutionVertexCount; ++i) {
+    sourceVertices.emplace(getVertexKey(positions.at(i), normals.at(i), texCoords.at(i)), i);
+  }
+
+  mVertexMap.resize(positions.size());
+  for (int i = 0; i < positions.size(); ++i) {
+    if (i < fullResolutionVertexCount) {
+      mVertexMap.at(i) = i;
+      continue;
+    }
+    auto source =
+        sourceVertices.find(getVertexKey(positions.at(i), normals.at(i), texCoords.at(i)));
+    if (source == sourceVertices.end()) {
+      Logger::log(1, "%s error: vertex %i has no full resolution vertex\n", __FUNCTION__, i);
+      return false;
+    }
+    mVertexMap.at(i) = source->second;
+  }
+  return true;
+}
+
+void VertexAnimationTexture::bind(int textureUnit, int clipBindingPoint, int vertexBindingPoint) {
+  glActiveTexture(GL_TEXTURE0 + textureUnit);
+  glBindTexture(GL_TEXTURE_2D, mPositionTexture);
+  glActiveTexture(GL_TEXTURE0 + textureUnit + 1);
+  glBindTexture(GL_TEXTURE_2D, mNormalTexture);
+  glActiveTexture(GL_TEXTURE0);
+
+  mClipBuffer.bind(clipBindingPoint);
+  mVertexMapBuffer.bind(vertexBindingPoint);
+}
+
+int VertexAnimationTexture::getRowsPerFrame() {
+  return mRowsPerFrame;
+}
+
+void VertexAnimationTexture::cleanup() {
+  glDeleteTextures(1, &mPositionTexture);
+  glDeleteTextures(1, &mNormalTexture);
+  mClipBuffer.cleanup();
+  mVertexMapBuffer.cleanup();
+}
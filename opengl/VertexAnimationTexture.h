@@ -0,0 +1,47 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "GltfModel.h"
+#include "ShaderStorageBuffer.h"
+
+#include "OGLRenderData.h"
+
+/* Skinned vertex positions and normals of all clips, sampled at a fixed rate
+ * when the model is loaded. A frame uses one or more texture rows with one
+ * texel per full resolution vertex, the mesh LOD vertices are mapped to the
+ * texel of their source vertex. Positions are stored as 16 bit unorm relative
+ * to the bounds of the clip, normals as 16 bit snorm.
+ */
+class VertexAnimationTexture {
+ public:
+  bool bake(std::shared_ptr<GltfModel> model, float sampleRate);
+  /* positions and normals use two consecutive texture units */
+  void bind(int textureUnit, int clipBindingPoint, int vertexBindingPoint);
+  int getRowsPerFrame();
+  void cleanup();
+
+ private:
+  bool createVertexMap(const std::vector<glm::vec3> &positions,
+                       const std::vector<glm::vec3> &normals,
+                       const std::vector<glm::vec2> &texCoords,
+                       int fullResolutionVertexCount);
+
+  GLuint mPositionTexture = 0;
+  GLuint mNormalTexture = 0;
+  int mRowsPerFrame = 1;
+
+  /* three vec4 per clip: first frame, frame count, clip length, sample rate;
+   * minimum of the bounds; extents of the bounds
+   */
+  std::vector<glm::vec4> mClipData{};
+  ShaderStorageBuffer mClipBuffer{};
+
+  /* texel column of every vertex of the model */
+  std::vector<int32_t> mVertexMap{};
+  ShaderStorageBuffer mVertexMapBuffer{};
+};
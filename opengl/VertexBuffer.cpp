@@ -33,17 +33,20 @@ void VertexBuffer::cleanup() {
   glDeleteVertexArrays(1, &mVAO);
 }
 
-void VertexBuffer::uploadData(OGLMesh vertexData) {
+void VertexBuffer::uploadData(const OGLMesh &vertexData) {
+  mBytesCopied = vertexData.vertices.size() * sizeof(OGLVertex);
+
   glBindVertexArray(mVAO);
   glBindBuffer(GL_ARRAY_BUFFER, mVertexVBO);
-  glBufferData(GL_ARRAY_BUFFER,
-               vertexData.vertices.size() * sizeof(OGLVertex),
-               &vertexData.vertices.at(0),
-               GL_DYNAMIC_DRAW);
+  glBufferData(GL_ARRAY_BUFFER, mBytesCopied, vertexData.vertices.data(), GL_DYNAMIC_DRAW);
   glBindBuffer(GL_ARRAY_BUFFER, 0);
   glBindVertexArray(0);
 }
 
+size_t VertexBuffer::getBytesCopied() {
+  return mBytesCopied;
+}
+
 void VertexBuffer::bind() {
   glBindVertexArray(mVAO);
 }
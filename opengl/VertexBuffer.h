@@ -9,7 +9,9 @@
 class VertexBuffer {
  public:
   void init();
-  void uploadData(OGLMesh vertexData);
+  void uploadData(const OGLMesh &vertexData);
+  /* Bytes copied by the last upload. */
+  size_t getBytesCopied();
   void bind();
   void unbind();
   void draw(GLuint mode, unsigned int start, unsigned int num);
@@ -19,4 +21,5 @@ class VertexBuffer {
  private:
   GLuint mVAO = 0;
   GLuint mVertexVBO = 0;
+  size_t mBytesCopied = 0;
 };
\ No newline at end of file
@@ -0,0 +1,113 @@
+#version 460 core
+/* Permutations, set by the renderer:
+ * SECOND_JOINT_SET  adds joints and weights five to eight
+ * LOCAL_PALETTES    the joint numbers index the palette of the drawn sub-mesh
+ */
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoord;
+layout (location = 3) in vec4 aJointNum;
+layout (location = 4) in vec4 aJointWeight;
+#ifdef SECOND_JOINT_SET
+layout (location = 5) in vec4 aJointNum1;
+layout (location = 6) in vec4 aJointWeight1;
+#endif
+
+layout (location = 0) out vec3 normal;
+layout (location = 1) out vec2 texCoord;
+
+/* the positions are stored as unorm16 inside the bounds of the model */
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+layout (std140, binding = 0) uniform Matrices {
+    mat4 view;
+    mat4 projection;
+};
+
+/* one frame per row, three texels with the matrix rows per joint */
+layout (binding = 1) uniform sampler2D bakedPalettes;
+
+/* x: first frame row, y: frame count, z: clip length, w: sample rate */
+layout (std430, binding = 4) readonly buffer BakedClips {
+  vec4 clips[];
+};
+
+struct BakedInstanceData {
+  mat4 worldMatrix;
+  vec4 animation;
+};
+
+layout (std430, binding = 3) readonly buffer InstanceDatas {
+  BakedInstanceData instances[];
+};
+
+#ifdef LOCAL_PALETTES
+/* joints of the sub-mesh in the shared palette, bound for every draw group */
+layout (std430, binding = 12) readonly buffer PaletteJoints {
+  int paletteJoints[];
+};
+
+ivec4 getPaletteJoints(vec4 jointNums) {
+  ivec4 joints = ivec4(jointNums);
+  return ivec4(paletteJoints[joints.x], paletteJoints[joints.y], paletteJoints[joints.z],
+               paletteJoints[joints.w]);
+}
+#else
+ivec4 getPaletteJoints(vec4 jointNums) {
+  return ivec4(jointNums);
+}
+#endif
+
+uniform float animTime;
+uniform float animTimePosition;
+uniform float animSpeed;
+uniform int playBackward;
+
+mat4 getBakedJoint(int frame, int joint) {
+  vec4 row0 = texelFetch(bakedPalettes, ivec2(joint * 3, frame), 0);
+  vec4 row1 = texelFetch(bakedPalettes, ivec2(joint * 3 + 1, frame), 0);
+  vec4 row2 = texelFetch(bakedPalettes, ivec2(joint * 3 + 2, frame), 0);
+  return transpose(mat4(row0, row1, row2, vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
+mat4 getJointMatrix(ivec2 frames, float alpha, int joint) {
+  return mix(getBakedJoint(frames.x, joint), getBakedJoint(frames.y, joint), alpha);
+}
+
+mat4 getSkinMat(ivec2 frames, float alpha, ivec4 joints, vec4 weights) {
+  return weights.x * getJointMatrix(frames, alpha, joints.x) +
+    weights.y * getJointMatrix(frames, alpha, joints.y) +
+    weights.z * getJointMatrix(frames, alpha, joints.z) +
+    weights.w * getJointMatrix(frames, alpha, joints.w);
+}
+
+void main() {
+  BakedInstanceData instance = instances[gl_InstanceID + gl_BaseInstance];
+  vec4 clip = clips[int(instance.animation.x)];
+
+  /* same clock as the CPU animation */
+  float clipTime = 0.0;
+  if (clip.z > 0.0) {
+    clipTime = mod(animTimePosition + (animTime + instance.animation.y) * animSpeed, clip.z);
+  }
+  if (playBackward != 0) {
+    clipTime = clip.z - clipTime;
+  }
+
+  float framePos = clipTime * clip.w;
+  int lastFrame = int(clip.y) - 1;
+  int frame = min(int(framePos), lastFrame);
+  ivec2 frames = ivec2(frame, min(frame + 1, lastFrame)) + int(clip.x);
+  float alpha = clamp(framePos - float(frame), 0.0, 1.0);
+
+  mat4 skinMat = getSkinMat(frames, alpha, getPaletteJoints(aJointNum), aJointWeight);
+#ifdef SECOND_JOINT_SET
+  skinMat += getSkinMat(frames, alpha, getPaletteJoints(aJointNum1), aJointWeight1);
+#endif
+
+  vec3 position = positionOffset + aPos * positionScale;
+  gl_Position = projection * view * instance.worldMatrix * skinMat * vec4(position, 1.0);
+  normal = normalize(mat3(instance.worldMatrix) * mat3(skinMat) * aNormal);
+  texCoord = aTexCoord;
+}
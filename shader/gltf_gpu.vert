@@ -1,30 +1,185 @@
 #version 460 core
+/* Permutations, set by the renderer:
+ * DUAL_QUAT_SKINNING  blend dual quaternions instead of matrices
+ * JOINT_INFLUENCES    1, 2, 4 or 8 joints per vertex, 8 reads the second set
+ * PALETTE_3X4         linear skinning with the three upper rows of the joint matrices
+ * INSTANCING          world matrix and palette offset per instance, else uniforms
+ * LOCAL_PALETTES      the joint numbers index the palette of the drawn sub-mesh
+ */
+#ifndef JOINT_INFLUENCES
+#define JOINT_INFLUENCES 4
+#endif
+
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoord;
 layout (location = 3) in vec4 aJointNum;
 layout (location = 4) in vec4 aJointWeight;
+#if JOINT_INFLUENCES > 4
+layout (location = 5) in vec4 aJointNum1;
+layout (location = 6) in vec4 aJointWeight1;
+#endif
 
 layout (location = 0) out vec3 normal;
 layout (location = 1) out vec2 texCoord;
 
+/* the positions are stored as unorm16 inside the bounds of the model */
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
 layout (std140, binding = 0) uniform Matrices {
-    mat4 view;
-    mat4 projection;
+  mat4 view;
+  mat4 projection;
 };
 
+#if defined(DUAL_QUAT_SKINNING)
+layout (std430, binding = 2) readonly buffer JointDualQuats {
+  mat2x4 jointDQs[];
+};
+#elif defined(PALETTE_3X4)
+/* the rows of the joint matrices, the last one is always 0, 0, 0, 1 */
+layout (std430, binding = 1) readonly buffer JointMatrices {
+  mat3x4 jointMat[];
+};
+#else
 layout (std430, binding = 1) readonly buffer JointMatrices {
-    mat4 jointMat[];
+  mat4 jointMat[];
+};
+#endif
+
+#ifdef INSTANCING
+struct InstanceData {
+  mat4 worldMatrix;
+  ivec4 paletteOffset;
+};
+
+layout (std430, binding = 3) readonly buffer InstanceDatas {
+  InstanceData instances[];
 };
+#else
+uniform mat4 worldMatrix;
+uniform int paletteOffset;
+#endif
+
+#ifdef LOCAL_PALETTES
+/* joints of the sub-mesh in the shared palette, bound for every draw group */
+layout (std430, binding = 12) readonly buffer PaletteJoints {
+  int paletteJoints[];
+};
+
+ivec4 getPaletteJoints(vec4 jointNums) {
+  ivec4 joints = ivec4(jointNums);
+  return ivec4(paletteJoints[joints.x], paletteJoints[joints.y], paletteJoints[joints.z],
+               paletteJoints[joints.w]);
+}
+#else
+ivec4 getPaletteJoints(vec4 jointNums) {
+  return ivec4(jointNums);
+}
+#endif
+
+/* joint numbers and weights of the influences, the unused ones have no weight */
+void getInfluences(int offset, out ivec4 joints[2], out vec4 weights[2]) {
+  joints[0] = getPaletteJoints(aJointNum) + offset;
+  weights[0] = aJointWeight;
+#if JOINT_INFLUENCES > 4
+  joints[1] = getPaletteJoints(aJointNum1) + offset;
+  weights[1] = aJointWeight1;
+#else
+  joints[1] = joints[0];
+  weights[1] = vec4(0.0);
+#endif
+}
+
+#ifdef DUAL_QUAT_SKINNING
+/* weights of the influences, flipped for the shortest rotation */
+mat2x4 addJointTransforms(mat2x4 result, vec4 first, ivec4 joints, vec4 weights) {
+  for (int i = 0; i < min(JOINT_INFLUENCES, 4); ++i) {
+    mat2x4 dq = jointDQs[joints[i]];
+    result += weights[i] * sign(dot(first, dq[0])) * dq;
+  }
+  return result;
+}
+
+mat2x4 getJointTransform(int offset) {
+  ivec4 joints[2];
+  vec4 weights[2];
+  getInfluences(offset, joints, weights);
+
+  vec4 first = jointDQs[joints[0].x][0];
+  mat2x4 result = addJointTransforms(mat2x4(0.0), first, joints[0], weights[0]);
+#if JOINT_INFLUENCES > 4
+  result = addJointTransforms(result, first, joints[1], weights[1]);
+#endif
+
+  // normalize the dual quaternion
+  float norm = length(result[0]);
+  return result / norm;
+}
+
+/* rotation of a vector by a unit quaternion */
+vec3 rotateQuat(vec4 q, vec3 v) {
+  return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+/* rotation and translation of a unit dual quaternion, no matrix needed */
+vec3 transformDualQuat(mat2x4 dq, vec3 position) {
+  vec4 r = dq[0];
+  vec4 t = dq[1];
+  return rotateQuat(r, position) + 2.0 * (r.w * t.xyz - t.w * r.xyz + cross(r.xyz, t.xyz));
+}
+#else
+#ifdef PALETTE_3X4
+#define PALETTE_MATRIX mat3x4
+#else
+#define PALETTE_MATRIX mat4
+#endif
+
+PALETTE_MATRIX addSkinMats(PALETTE_MATRIX result, ivec4 joints, vec4 weights) {
+  for (int i = 0; i < min(JOINT_INFLUENCES, 4); ++i) {
+    result += weights[i] * jointMat[joints[i]];
+  }
+  return result;
+}
+
+PALETTE_MATRIX getSkinMat(int offset) {
+  ivec4 joints[2];
+  vec4 weights[2];
+  getInfluences(offset, joints, weights);
+
+  PALETTE_MATRIX result = addSkinMats(PALETTE_MATRIX(0.0), joints[0], weights[0]);
+#if JOINT_INFLUENCES > 4
+  result = addSkinMats(result, joints[1], weights[1]);
+#endif
+  return result;
+}
+#endif
 
 void main() {
-  mat4 skinMat =
-		aJointWeight.x * jointMat[int(aJointNum.x)] +
-		aJointWeight.y * jointMat[int(aJointNum.y)] +
-		aJointWeight.z * jointMat[int(aJointNum.z)] +
-		aJointWeight.w * jointMat[int(aJointNum.w)];
-  gl_Position = projection * view * skinMat * vec4(aPos, 1.0);
-  normal = vec3(transpose(inverse(skinMat)) * vec4(aNormal, 1.0));
+#ifdef INSTANCING
+  InstanceData instance = instances[gl_InstanceID + gl_BaseInstance];
+  mat4 worldMatrix = instance.worldMatrix;
+  int paletteOffset = instance.paletteOffset.x;
+#endif
+
+  vec3 position = positionOffset + aPos * positionScale;
+#if defined(DUAL_QUAT_SKINNING)
+  mat2x4 bone = getJointTransform(paletteOffset);
+  position = transformDualQuat(bone, position);
+  /* a rigid transform, the rotation is enough for the normal */
+  normal = mat3(worldMatrix) * rotateQuat(bone[0], aNormal);
+#elif defined(PALETTE_3X4)
+  /* the rows of the matrix, the vector is multiplied from the left */
+  mat3x4 skinRows = getSkinMat(paletteOffset);
+  position = vec4(position, 1.0) * skinRows;
+  normal = mat3(worldMatrix) * (vec4(aNormal, 0.0) * skinRows);
+#else
+  mat4 skinMat = getSkinMat(paletteOffset);
+  position = vec3(skinMat * vec4(position, 1.0));
+  /* the joints only rotate and scale uniformly, the rigid part transforms the normal */
+  normal = mat3(worldMatrix) * mat3(skinMat) * aNormal;
+#endif
+
+  gl_Position = projection * view * worldMatrix * vec4(position, 1.0);
   texCoord = aTexCoord;
 }
-
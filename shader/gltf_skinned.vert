@@ -0,0 +1,18 @@
+#version 460 core
+layout (location = 0) in vec4 aPositionU;
+layout (location = 1) in vec4 aNormalV;
+
+layout (location = 0) out vec3 normal;
+layout (location = 1) out vec2 texCoord;
+
+layout (std140, binding = 0) uniform Matrices {
+  mat4 view;
+  mat4 projection;
+};
+
+/* Vertices pre-skinned in world space by the compute shader. */
+void main() {
+  gl_Position = projection * view * vec4(aPositionU.xyz, 1.0);
+  normal = aNormalV.xyz;
+  texCoord = vec2(aPositionU.w, aNormalV.w);
+}
@@ -0,0 +1,82 @@
+#version 460 core
+layout (location = 2) in vec2 aTexCoord;
+
+layout (location = 0) out vec3 normal;
+layout (location = 1) out vec2 texCoord;
+
+layout (std140, binding = 0) uniform Matrices {
+    mat4 view;
+    mat4 projection;
+};
+
+/* skinned vertices, one texel per vertex, rowsPerFrame rows per frame */
+layout (binding = 1) uniform sampler2D vatPositions;
+layout (binding = 2) uniform sampler2D vatNormals;
+
+/* per clip: first frame, frame count, clip length, sample rate; bounds minimum; bounds extents */
+layout (std430, binding = 4) readonly buffer VatClips {
+  vec4 clips[];
+};
+
+/* texel column of every vertex, the mesh LOD copies share the one of their source vertex */
+layout (std430, binding = 5) readonly buffer VatVertices {
+  int vatVertices[];
+};
+
+struct BakedInstanceData {
+  mat4 worldMatrix;
+  vec4 animation;
+};
+
+layout (std430, binding = 3) readonly buffer InstanceDatas {
+  BakedInstanceData instances[];
+};
+
+uniform float animTime;
+uniform float animTimePosition;
+uniform float animSpeed;
+uniform int playBackward;
+uniform int rowsPerFrame;
+/* gl_VertexID includes the offset of the model in the geometry arena */
+uniform int baseVertex;
+
+ivec2 getTexel(int frame, int vertex) {
+  int width = textureSize(vatPositions, 0).x;
+  return ivec2(vertex % width, frame * rowsPerFrame + vertex / width);
+}
+
+void main() {
+  BakedInstanceData instance = instances[gl_InstanceID + gl_BaseInstance];
+  int clipNum = int(instance.animation.x);
+  vec4 clip = clips[clipNum * 3];
+  vec3 boundsMin = clips[clipNum * 3 + 1].xyz;
+  vec3 boundsExtents = clips[clipNum * 3 + 2].xyz;
+
+  /* same clock as the CPU animation */
+  float clipTime = 0.0;
+  if (clip.z > 0.0) {
+    clipTime = mod(animTimePosition + (animTime + instance.animation.y) * animSpeed, clip.z);
+  }
+  if (playBackward != 0) {
+    clipTime = clip.z - clipTime;
+  }
+
+  float framePos = clipTime * clip.w;
+  int lastFrame = int(clip.y) - 1;
+  int frame = min(int(framePos), lastFrame);
+  ivec2 frames = ivec2(frame, min(frame + 1, lastFrame)) + int(clip.x);
+  float alpha = clamp(framePos - float(frame), 0.0, 1.0);
+
+  int vertex = vatVertices[gl_VertexID - baseVertex];
+  ivec2 texel0 = getTexel(frames.x, vertex);
+  ivec2 texel1 = getTexel(frames.y, vertex);
+  vec3 position = mix(texelFetch(vatPositions, texel0, 0).xyz,
+                      texelFetch(vatPositions, texel1, 0).xyz, alpha);
+  vec3 vertexNormal = mix(texelFetch(vatNormals, texel0, 0).xyz,
+                          texelFetch(vatNormals, texel1, 0).xyz, alpha);
+
+  gl_Position = projection * view * instance.worldMatrix *
+      vec4(boundsMin + position * boundsExtents, 1.0);
+  normal = normalize(mat3(instance.worldMatrix) * vertexNormal);
+  texCoord = aTexCoord;
+}
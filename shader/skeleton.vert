@@ -0,0 +1,72 @@
+#version 460 core
+layout (location = 0) out vec4 lineColor;
+
+layout (std140, binding = 0) uniform Matrices {
+  mat4 view;
+  mat4 projection;
+};
+
+/* PALETTE_3X4: the three upper rows of the joint matrices */
+layout (std430, binding = 1) readonly buffer JointMatrices {
+#ifdef PALETTE_3X4
+  mat3x4 jointMat[];
+#else
+  mat4 jointMat[];
+#endif
+};
+
+layout (std430, binding = 2) readonly buffer JointDualQuats {
+  mat2x4 jointDQs[];
+};
+
+struct InstanceData {
+  mat4 worldMatrix;
+  ivec4 paletteOffset;
+};
+
+layout (std430, binding = 3) readonly buffer InstanceDatas {
+  InstanceData instances[];
+};
+
+/* x: joint, y: parent joint */
+layout (std430, binding = 4) readonly buffer Bones {
+  ivec2 bones[];
+};
+
+/* origin of every joint in model space */
+layout (std430, binding = 5) readonly buffer BindPositions {
+  vec4 bindPositions[];
+};
+
+uniform int dualQuatSkinning;
+
+/* rotation and translation of a unit dual quaternion */
+vec3 transformDualQuat(mat2x4 dq, vec3 position) {
+  vec4 r = dq[0];
+  vec4 t = dq[1];
+  vec3 rotated = position + 2.0 * cross(r.xyz, cross(r.xyz, position) + r.w * position);
+  return rotated + 2.0 * (r.w * t.xyz - t.w * r.xyz + cross(r.xyz, t.xyz));
+}
+
+/* Two vertices per bone, the first one at the parent joint. */
+void main() {
+  InstanceData instance = instances[gl_InstanceID];
+  ivec2 bone = bones[gl_VertexID / 2];
+  int joint = gl_VertexID % 2 == 0 ? bone.y : bone.x;
+  int paletteJoint = instance.paletteOffset.x + joint;
+  vec3 bindPosition = bindPositions[joint].xyz;
+
+  vec3 position;
+  if (dualQuatSkinning == 1) {
+    position = transformDualQuat(jointDQs[paletteJoint], bindPosition);
+  } else {
+#ifdef PALETTE_3X4
+    position = vec4(bindPosition, 1.0) * jointMat[paletteJoint];
+#else
+    position = vec3(jointMat[paletteJoint] * vec4(bindPosition, 1.0));
+#endif
+  }
+
+  gl_Position = projection * view * instance.worldMatrix * vec4(position, 1.0);
+  lineColor = gl_VertexID % 2 == 0 ? vec4(0.0, 1.0, 1.0, 1.0) : vec4(0.0, 0.0, 1.0, 1.0);
+}
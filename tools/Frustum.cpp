@@ -0,0 +1,37 @@
+#include "Frustum.h"
+
+void Frustum::update(const glm::mat4 &viewProjectionMatrix) {
+  /* GLM matrices are column major, get the rows first */
+  glm::vec4 rows[4];
+  for (int i = 0; i < 4; ++i) {
+    rows[i] = glm::vec4(viewProjectionMatrix[0][i],
+                        viewProjectionMatrix[1][i],
+                        viewProjectionMatrix[2][i],
+                        viewProjectionMatrix[3][i]);
+  }
+
+  /* left, right, bottom, top, near, far */
+  mPlanes.at(0) = rows[3] + rows[0];
+  mPlanes.at(1) = rows[3] - rows[0];
+  mPlanes.at(2) = rows[3] + rows[1];
+  mPlanes.at(3) = rows[3] - rows[1];
+  mPlanes.at(4) = rows[3] + rows[2];
+  mPlanes.at(5) = rows[3] - rows[2];
+
+  for (auto &plane : mPlanes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+}
+
+/* The box is outside if the corner furthest along the normal of any plane is behind it. */
+bool Frustum::isBoxVisible(const BoundingBox &box) {
+  for (const auto &plane : mPlanes) {
+    glm::vec3 positiveCorner = glm::vec3(plane.x > 0.0f ? box.max.x : box.min.x,
+                                         plane.y > 0.0f ? box.max.y : box.min.y,
+                                         plane.z > 0.0f ? box.max.z : box.min.z);
+    if (glm::dot(glm::vec3(plane), positiveCorner) + plane.w < 0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <array>
+#include <glm/glm.hpp>
+
+#include "OGLRenderData.h"
+
+/* View frustum as six planes, extracted from the combined view and projection matrix.
+ * The plane normals point to the inside of the frustum.
+ */
+class Frustum {
+ public:
+  void update(const glm::mat4 &viewProjectionMatrix);
+  bool isBoxVisible(const BoundingBox &box);
+
+ private:
+  std::array<glm::vec4, 6> mPlanes{};
+};
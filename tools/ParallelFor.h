@@ -0,0 +1,32 @@
+#pragma once
+#include <algorithm>
+#include <future>
+#include <thread>
+#include <vector>
+
+/* Calls work(i) for every i below count, split into one chunk per core. The
+ * chunks run on std::async threads and the calling thread takes the first one,
+ * as the instance chunks of the animation update. The work must not touch GL state.
+ */
+template <typename Work>
+void parallelFor(size_t count, Work work) {
+  size_t numThreads = std::clamp<size_t>(
+      count, 1, std::max(std::thread::hardware_concurrency(), 1u));
+  size_t itemsPerThread = (count + numThreads - 1) / numThreads;
+  auto runChunk = [&work](size_t first, size_t last) {
+    for (size_t i = first; i < last; ++i) {
+      work(i);
+    }
+  };
+
+  std::vector<std::future<void>> chunkFutures{};
+  for (size_t first = itemsPerThread; first < count; first += itemsPerThread) {
+    size_t last = std::min(first + itemsPerThread, count);
+    chunkFutures.emplace_back(std::async(std::launch::async, runChunk, first, last));
+  }
+  runChunk(0, std::min(itemsPerThread, count));
+
+  for (auto &chunkFuture : chunkFutures) {
+    chunkFuture.get();
+  }
+}
@@ -1,7 +1,7 @@
 #include "Window.h"
 #include "Logger.h"
 
-bool Window::init(unsigned int width, unsigned int height, std::string title) {
+bool Window::init(unsigned int width, unsigned int height, std::string title, bool visible) {
   // Check to see if glfw inits on our system
   if (!glfwInit()) {
     Logger::log(1, "%s: glfwInit() error\n", __FUNCTION__);
@@ -12,6 +12,7 @@ bool Window::init(unsigned int width, unsigned int height, std::string title) {
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
 
   mWindow = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
 
@@ -84,6 +85,16 @@ void Window::mainLoop() {
   }
 }
 
+void Window::runBenchmark() {
+  /* no vertical sync, the frames are not shown anyway */
+  glfwSwapInterval(0);
+
+  const int benchmarkFrameCount = 200;
+  for (int instanceCount : {1, 100, 1000}) {
+    mRenderer->runSkinningBenchmark(instanceCount, benchmarkFrameCount);
+  }
+}
+
 void Window::cleanup() {
   Logger::log(1, "%s: Terminating Window\n", __FUNCTION__);
   glfwDestroyWindow(mWindow);
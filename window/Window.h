@@ -6,8 +6,11 @@
 
 class Window {
  public:
-  bool init(unsigned int width, unsigned int height, std::string title);
+  /* A hidden window has a context for benchmarks, nothing is shown. */
+  bool init(unsigned int width, unsigned int height, std::string title, bool visible);
   void mainLoop();
+  /* Measures the skinning paths and returns, no user input needed. */
+  void runBenchmark();
   void cleanup();
 
   /** Keyboard event handler. */